@@ -2,10 +2,14 @@
 #include <dlfcn.h>
 #include <atomic>
 #include <chrono>
+#include <climits>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <string>
 
+#include "wait_strategy.h"
+
 // ── Result ──────────────────────────────────────────────────────────────────
 struct BandwidthResult {
   double bandwidth_gbps  = 0.0;
@@ -16,28 +20,10 @@ struct BandwidthResult {
   std::string error;
 };
 
-// ── Spin barrier (C++17, no std::barrier) ───────────────────────────────────
-class SpinBarrier {
-public:
-  explicit SpinBarrier(int count) : count_(count), waiting_(0), phase_(0) {}
-
-  void arrive_and_wait() {
-    int cur = phase_.load(std::memory_order_relaxed);
-    if (waiting_.fetch_add(1, std::memory_order_acq_rel) == count_ - 1) {
-      waiting_.store(0, std::memory_order_relaxed);
-      phase_.fetch_add(1, std::memory_order_release);
-    } else {
-      while (phase_.load(std::memory_order_acquire) == cur) {
-        // spin
-      }
-    }
-  }
-
-private:
-  int count_;
-  std::atomic<int> waiting_;
-  std::atomic<int> phase_;
-};
+// ── Barrier (C++17, no std::barrier) ────────────────────────────────────────
+// The concurrent run synchronises GPU/NPU/CPU start on a SenseBarrier<W> from
+// wait_strategy.h; W is chosen at runtime by --wait (default spin, which keeps
+// start skew minimal) and reaches the engines through dispatch_wait.
 
 // ── Timing ──────────────────────────────────────────────────────────────────
 inline double now_seconds() {
@@ -84,15 +70,21 @@ inline RpcMemApi& getRpcMemApi() {
 
 constexpr int RPCMEM_HEAP_ID_SYSTEM = 25;
 
-// Allocate an ION buffer via rpcmem.  Caller owns the memory.
-inline bool allocIonBuffer(size_t size, uint8_t fillValue, IonBuffer& out) {
+// rpcmem only: no host (memfd) backend in this project, see ion_pool.h
+inline bool ionBackendHost() { return false; }
+
+// Raw allocation behind the pool (ion_pool.h), contents undefined
+inline bool ionBackendAlloc(size_t size, IonBuffer& out) {
   auto& rpc = getRpcMemApi();
   if (!rpc.alloc || !rpc.toFd) return false;
 
+  if (size > static_cast<size_t>(INT_MAX)) {  // rpcmem_alloc takes an int size
+    printf("[ION] %zu bytes exceeds the 2 GB rpcmem limit; split it into segments\n", size);
+    return false;
+  }
   out.ptr = rpc.alloc(RPCMEM_HEAP_ID_SYSTEM, 0, static_cast<int>(size));
   if (!out.ptr) return false;
   out.size = size;
-  std::memset(out.ptr, fillValue, size);
 
   out.fd = rpc.toFd(out.ptr);
   if (out.fd < 0) {
@@ -103,15 +95,26 @@ inline bool allocIonBuffer(size_t size, uint8_t fillValue, IonBuffer& out) {
   return true;
 }
 
-inline void freeIonBuffer(IonBuffer& buf) {
-  if (buf.ptr) {
-    auto& rpc = getRpcMemApi();
-    if (rpc.freeMem) rpc.freeMem(buf.ptr);
-    buf.ptr = nullptr;
-    buf.fd  = -1;
-    buf.size = 0;
-  }
+inline void ionBackendFree(IonBuffer& buf) {
+  auto& rpc = getRpcMemApi();
+  if (rpc.freeMem) rpc.freeMem(buf.ptr);
 }
 
+// ── Buffer pool ─────────────────────────────────────────────────────────────
+// allocIonBuffer / freeIonBuffer go through a size-classed pool over rpcmem:
+// a released buffer keeps its fd and mapping for the next allocation of a
+// similar size (ion_pool.h). provisionIonBuffer() picks the fill policy
+// (none / parallel value / pattern, ion_fill.h); allocIonBuffer() is a
+// parallel value fill.
+#include "ion_pool.h"
+#include "ion_fill.h"
+
+// Allocate an ION buffer via rpcmem.  Caller owns the memory.
+inline bool allocIonBuffer(size_t size, uint8_t fillValue, IonBuffer& out) {
+  return provisionIonBuffer(size, IonFillSpec::value_of(fillValue), out);
+}
+
+inline void freeIonBuffer(IonBuffer& buf) { ionPool().release(buf); }
+
 // ── Theoretical peak ────────────────────────────────────────────────────────
 constexpr double kTheoreticalBandwidthGBps = 84.8;  // LPDDR5X-5300 4ch x 16bit
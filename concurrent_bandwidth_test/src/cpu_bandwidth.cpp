@@ -0,0 +1,116 @@
+#include "cpu_bandwidth.h"
+#include "cpu_kernels.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <unistd.h>
+
+// ── File-scope CPU stream state ─────────────────────────────────────────────
+namespace {
+const SegmentedIonBuffer* g_a = nullptr;
+const SegmentedIonBuffer* g_b = nullptr;
+const SegmentedIonBuffer* g_c = nullptr;
+size_t         g_data_size   = 0;  // bytes per tensor (cpu partition)
+int            g_num_threads = 0;
+int            g_first_core  = -1;
+
+void pin_to_core(int core_id) {
+  if (core_id < 0) return;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(core_id, &mask);
+  sched_setaffinity(0, sizeof(mask), &mask);
+}
+}  // namespace
+
+void cpu_print_info() {
+  if (!g_c) return;
+  printf("  线程数: %d, SIMD: %s\n", g_num_threads, cpuk::simd_name());
+  if (g_first_core >= 0)
+    printf("  绑核: %d-%d\n", g_first_core, g_first_core + g_num_threads - 1);
+}
+
+bool cpu_init(const SegmentedIonBuffer& A, const SegmentedIonBuffer& B,
+              const SegmentedIonBuffer& C, int num_threads, int first_core) {
+  if (A.segs.empty() || B.segs.empty() || C.segs.empty()) {
+    printf("[CPU] null buffer\n");
+    return false;
+  }
+  if (A.segment_bytes != B.segment_bytes || A.segment_bytes != C.segment_bytes) {
+    printf("[CPU] A/B/C segment sizes differ\n");
+    return false;
+  }
+  if (num_threads <= 0)
+    num_threads = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN) / 2);
+  g_a = &A;
+  g_b = &B;
+  g_c = &C;
+  g_data_size   = std::min({A.size, B.size, C.size});
+  g_num_threads = num_threads;
+  g_first_core  = first_core;
+  return true;
+}
+
+template <typename W>
+BandwidthResult cpu_run(int num_warmup, int num_iters, SenseBarrier<W>* barrier) {
+  BandwidthResult res;
+  res.num_iterations = num_iters;
+  res.total_data_bytes = (double)g_data_size * 3.0 * num_iters;  // 2 read + 1 write
+  if (!g_c) { res.error = "CPU not initialized"; return res; }
+
+  // Contiguous 4 KB-aligned chunk per worker
+  const int nthreads = g_num_threads;
+  size_t chunk = (g_data_size + nthreads - 1) / nthreads;
+  chunk = (chunk + 4095) & ~size_t(4095);
+
+  // Workers warm up, then wait on `start` together with this thread, which
+  // takes the timestamp once every stream (GPU / NPU / CPU) has arrived
+  SenseBarrier<W> start(nthreads + 1);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < nthreads; ++t) {
+    workers.emplace_back([&, t]() {
+      pin_to_core(g_first_core >= 0 ? g_first_core + t : -1);
+      size_t lo = std::min(g_data_size, t * chunk);
+      size_t hi = std::min(g_data_size, lo + chunk);
+      auto add_chunk = [&]() {
+        for_each_segment(*g_c, lo, hi, [](size_t s, size_t off, size_t n) {
+          cpuk::add_u8(static_cast<uint8_t*>(g_c->segs[s].ptr) + off,
+                       static_cast<const uint8_t*>(g_a->segs[s].ptr) + off,
+                       static_cast<const uint8_t*>(g_b->segs[s].ptr) + off, n);
+        });
+      };
+      for (int i = 0; i < num_warmup; ++i) add_chunk();
+      start.arrive_and_wait();
+      for (int i = 0; i < num_iters; ++i) add_chunk();
+    });
+  }
+
+  // Barrier: synchronized start with GPU / NPU
+  if (barrier) barrier->arrive_and_wait();
+  start.arrive_and_wait();
+
+  // Timed run: ends when the slowest worker is done
+  double t0 = now_seconds();
+  for (auto& w : workers) w.join();
+  double t1 = now_seconds();
+
+  res.elapsed_seconds = t1 - t0;
+  res.bandwidth_gbps  = (res.total_data_bytes / (1024.0*1024.0*1024.0)) / res.elapsed_seconds;
+  res.success = true;
+  return res;
+}
+
+#define INSTANTIATE_CPU_RUN(W) \
+  template BandwidthResult cpu_run<W>(int, int, SenseBarrier<W>*);
+WAIT_STRATEGY_LIST(INSTANTIATE_CPU_RUN)
+#undef INSTANTIATE_CPU_RUN
+
+void cpu_cleanup() {
+  g_a = nullptr; g_b = nullptr; g_c = nullptr;
+  g_data_size = 0;
+  g_num_threads = 0;
+  g_first_core = -1;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "common.h"
+#include "ion_segments.h"
+
+// Initialize the CPU stream: num_threads worker threads (0 = half the online
+// CPUs), worker i pinned to first_core + i (first_core < 0: no pinning).
+// Each worker adds its own contiguous chunk of A + B into C (NEON / AVX2),
+// cut at segment boundaries.
+bool cpu_init(const SegmentedIonBuffer& A, const SegmentedIonBuffer& B,
+              const SegmentedIonBuffer& C, int num_threads, int first_core);
+
+// Run bandwidth test.  If barrier != nullptr, waits on it after warmup.
+// Instantiated for every strategy in WAIT_STRATEGY_LIST.
+template <typename W>
+BandwidthResult cpu_run(int num_warmup, int num_iters, SenseBarrier<W>* barrier);
+
+// Print worker / SIMD info.
+void cpu_print_info();
+
+// Forget the buffers (no threads outlive cpu_run).
+void cpu_cleanup();
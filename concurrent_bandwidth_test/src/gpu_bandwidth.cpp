@@ -4,6 +4,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 // Qualcomm ION extension for zero-copy buffer import
 #ifndef CL_MEM_ION_HOST_PTR_QCOM
@@ -34,12 +35,17 @@ cl_device_id      g_device   = nullptr;
 cl_context        g_context  = nullptr;
 cl_command_queue   g_queue    = nullptr;
 cl_program        g_program  = nullptr;
-cl_kernel         g_kernel   = nullptr;
-cl_mem            g_bufA     = nullptr;
-cl_mem            g_bufB     = nullptr;
-cl_mem            g_bufC     = nullptr;
 size_t            g_data_size = 0;  // bytes per tensor (gpu partition)
-size_t            g_num_vecs  = 0;  // data_size / 16 (uchar16)
+
+// One kernel object + imported buffer triple per segment, args pre-bound
+struct Segment {
+  cl_kernel kernel   = nullptr;
+  cl_mem    bufA     = nullptr;
+  cl_mem    bufB     = nullptr;
+  cl_mem    bufC     = nullptr;
+  size_t    num_vecs = 0;  // segment bytes / 16 (uchar16)
+};
+std::vector<Segment> g_segs;
 
 static char* read_file(const char* path, size_t* out_size) {
   FILE* f = fopen(path, "r");
@@ -91,8 +97,8 @@ void gpu_print_info() {
   printf("  计算单元: %u, 全局内存: %.2f GB\n", cu, mem / (1024.0*1024.0*1024.0));
 }
 
-bool gpu_init(const IonBuffer& A, const IonBuffer& B, const IonBuffer& C,
-              const char* kernel_path) {
+bool gpu_init(const SegmentedIonBuffer& A, const SegmentedIonBuffer& B,
+              const SegmentedIonBuffer& C, const char* kernel_path) {
   cl_int err;
 
   // Platform & device
@@ -129,45 +135,67 @@ bool gpu_init(const IonBuffer& A, const IonBuffer& B, const IonBuffer& C,
     return false;
   }
 
-  g_kernel = clCreateKernel(g_program, "element_add_uchar16", &err);
-  if (err != CL_SUCCESS) { printf("[GPU] clCreateKernel: %d\n", err); return false; }
-
-  // Import ION buffers into OpenCL
-  g_bufA = import_ion_buffer(A, CL_MEM_READ_ONLY);
-  g_bufB = import_ion_buffer(B, CL_MEM_READ_ONLY);
-  g_bufC = import_ion_buffer(C, CL_MEM_WRITE_ONLY);
-  if (!g_bufA || !g_bufB || !g_bufC) return false;
+  if (A.count() != B.count() || A.count() != C.count()) {
+    printf("[GPU] A/B/C segment counts differ\n");
+    return false;
+  }
+  cl_ulong max_alloc = 0;
+  clGetDeviceInfo(g_device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc), &max_alloc, nullptr);
 
+  // Import ION buffers into OpenCL, segment by segment
   g_data_size = A.size;
-  g_num_vecs  = g_data_size / 16;  // uchar16 = 16 bytes
-
-  // Set kernel args
-  int nv = static_cast<int>(g_num_vecs);
-  clSetKernelArg(g_kernel, 0, sizeof(cl_mem), &g_bufC);
-  clSetKernelArg(g_kernel, 1, sizeof(cl_mem), &g_bufA);
-  clSetKernelArg(g_kernel, 2, sizeof(cl_mem), &g_bufB);
-  clSetKernelArg(g_kernel, 3, sizeof(int), &nv);
+  g_segs.assign(A.count(), Segment{});
+  for (size_t i = 0; i < A.count(); ++i) {
+    Segment& sg = g_segs[i];
+    if (max_alloc && A.segs[i].size > max_alloc) {
+      printf("[GPU] segment %zu: %zu bytes > CL_DEVICE_MAX_MEM_ALLOC_SIZE %llu\n", i,
+             A.segs[i].size, (unsigned long long)max_alloc);
+      return false;
+    }
+    sg.kernel = clCreateKernel(g_program, "element_add_uchar16", &err);
+    if (err != CL_SUCCESS) { printf("[GPU] clCreateKernel: %d\n", err); return false; }
+
+    sg.bufA = import_ion_buffer(A.segs[i], CL_MEM_READ_ONLY);
+    sg.bufB = import_ion_buffer(B.segs[i], CL_MEM_READ_ONLY);
+    sg.bufC = import_ion_buffer(C.segs[i], CL_MEM_WRITE_ONLY);
+    if (!sg.bufA || !sg.bufB || !sg.bufC) return false;
+    sg.num_vecs = A.segs[i].size / 16;  // uchar16 = 16 bytes
+
+    // Set kernel args
+    int nv = static_cast<int>(sg.num_vecs);
+    clSetKernelArg(sg.kernel, 0, sizeof(cl_mem), &sg.bufC);
+    clSetKernelArg(sg.kernel, 1, sizeof(cl_mem), &sg.bufA);
+    clSetKernelArg(sg.kernel, 2, sizeof(cl_mem), &sg.bufB);
+    clSetKernelArg(sg.kernel, 3, sizeof(int), &nv);
+  }
 
   return true;
 }
 
-BandwidthResult gpu_run(int num_warmup, int num_iters, SpinBarrier* barrier) {
+template <typename W>
+BandwidthResult gpu_run(int num_warmup, int num_iters, SenseBarrier<W>* barrier) {
   BandwidthResult res;
   res.num_iterations = num_iters;
   res.total_data_bytes = (double)g_data_size * 3.0 * num_iters;  // 2 read + 1 write
 
-  // Work sizes
-  size_t global = g_num_vecs;
+  // Work sizes, per segment
   size_t local  = 256;
   size_t max_wg;
   clGetDeviceInfo(g_device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_wg), &max_wg, nullptr);
   if (local > max_wg) local = max_wg;
-  if (global % local != 0)
-    global = ((global / local) + 1) * local;
+  std::vector<size_t> global(g_segs.size());
+  for (size_t s = 0; s < g_segs.size(); ++s)
+    global[s] = (g_segs[s].num_vecs + local - 1) / local * local;
+
+  // One iteration = one launch per segment, in order
+  auto enqueue_all = [&]() {
+    for (size_t s = 0; s < g_segs.size(); ++s)
+      clEnqueueNDRangeKernel(g_queue, g_segs[s].kernel, 1, nullptr, &global[s], &local, 0,
+                             nullptr, nullptr);
+  };
 
   // Warmup
-  for (int i = 0; i < num_warmup; ++i)
-    clEnqueueNDRangeKernel(g_queue, g_kernel, 1, nullptr, &global, &local, 0, nullptr, nullptr);
+  for (int i = 0; i < num_warmup; ++i) enqueue_all();
   clFinish(g_queue);
 
   // Barrier: synchronized start with NPU
@@ -175,8 +203,7 @@ BandwidthResult gpu_run(int num_warmup, int num_iters, SpinBarrier* barrier) {
 
   // Timed run
   double t0 = now_seconds();
-  for (int i = 0; i < num_iters; ++i)
-    clEnqueueNDRangeKernel(g_queue, g_kernel, 1, nullptr, &global, &local, 0, nullptr, nullptr);
+  for (int i = 0; i < num_iters; ++i) enqueue_all();
   clFinish(g_queue);
   double t1 = now_seconds();
 
@@ -186,14 +213,21 @@ BandwidthResult gpu_run(int num_warmup, int num_iters, SpinBarrier* barrier) {
   return res;
 }
 
+#define INSTANTIATE_GPU_RUN(W) \
+  template BandwidthResult gpu_run<W>(int, int, SenseBarrier<W>*);
+WAIT_STRATEGY_LIST(INSTANTIATE_GPU_RUN)
+#undef INSTANTIATE_GPU_RUN
+
 void gpu_cleanup() {
-  if (g_kernel)  clReleaseKernel(g_kernel);
-  if (g_bufA)    clReleaseMemObject(g_bufA);
-  if (g_bufB)    clReleaseMemObject(g_bufB);
-  if (g_bufC)    clReleaseMemObject(g_bufC);
+  for (Segment& sg : g_segs) {
+    if (sg.kernel) clReleaseKernel(sg.kernel);
+    if (sg.bufA)   clReleaseMemObject(sg.bufA);
+    if (sg.bufB)   clReleaseMemObject(sg.bufB);
+    if (sg.bufC)   clReleaseMemObject(sg.bufC);
+  }
+  g_segs.clear();
   if (g_program) clReleaseProgram(g_program);
   if (g_queue)   clReleaseCommandQueue(g_queue);
   if (g_context) clReleaseContext(g_context);
-  g_kernel = nullptr; g_bufA = nullptr; g_bufB = nullptr; g_bufC = nullptr;
   g_program = nullptr; g_queue = nullptr; g_context = nullptr;
 }
@@ -1,12 +1,17 @@
 #pragma once
 #include "common.h"
+#include "ion_segments.h"
 
-// Initialize OpenCL: import ION buffers, compile kernel.
-bool gpu_init(const IonBuffer& A, const IonBuffer& B, const IonBuffer& C,
-              const char* kernel_path);
+// Initialize OpenCL: import ION buffers, compile kernel.  A/B/C are segmented
+// alike; each segment is imported on its own (within
+// CL_DEVICE_MAX_MEM_ALLOC_SIZE) and gets its own NDRange launch per iteration.
+bool gpu_init(const SegmentedIonBuffer& A, const SegmentedIonBuffer& B,
+              const SegmentedIonBuffer& C, const char* kernel_path);
 
 // Run bandwidth test.  If barrier != nullptr, waits on it after warmup.
-BandwidthResult gpu_run(int num_warmup, int num_iters, SpinBarrier* barrier);
+// Instantiated for every strategy in WAIT_STRATEGY_LIST.
+template <typename W>
+BandwidthResult gpu_run(int num_warmup, int num_iters, SenseBarrier<W>* barrier);
 
 // Print device info.
 void gpu_print_info();
@@ -1,10 +1,12 @@
 #include "htp_bandwidth.h"
+#include "htp_shape_plan.h"
 
 #include <dlfcn.h>
 #include <cstring>
 #include <cstdio>
 #include <cstdint>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "QNN/QnnBackend.h"
@@ -17,6 +19,7 @@
 #include "QNN/QnnTensor.h"
 #include "QNN/HTP/QnnHtpDevice.h"
 #include "QNN/HTP/QnnHtpGraph.h"
+#include "QNN/HTP/QnnHtpMem.h"
 #include "QNN/HTP/QnnHtpPerfInfrastructure.h"
 
 // ── File-scope QNN state ────────────────────────────────────────────────────
@@ -33,44 +36,63 @@ Qnn_GraphHandle_t           g_graph          = nullptr;
 uint32_t                    g_htpCoreCount   = 0;
 size_t                      g_data_size      = 0;
 
-// Registered memory handles (for deregistration)
+// Registered memory handles (for deregistration), one per buffer per part
+// (parts of every segment, in order)
 struct RegMem { Qnn_MemHandle_t handle = nullptr; };
-RegMem g_regA, g_regB, g_regC;
-
-// Execution tensors (pre-built, reused across iterations)
-Qnn_Tensor_t g_execInputs[2];
-Qnn_Tensor_t g_execOutputs[1];
-
-// Tensor dimensions (computed from data_size)
-uint32_t g_dims[kTensorRank];
+std::vector<RegMem> g_regs;
+
+// Execution tensors (pre-built, reused across iterations): per part
+// input0/input1, and output
+std::vector<Qnn_Tensor_t> g_execInputs;
+std::vector<Qnn_Tensor_t> g_execOutputs;
+std::vector<std::string>  g_tensorNames;
+
+// Tensor shapes, planned per segment; the dims live in the parts
+struct SegmentPart {
+  size_t        segment;
+  HtpTensorPart part;
+};
+std::vector<HtpShapePlan> g_plans;   // one per segment
+std::vector<SegmentPart>  g_parts;   // every segment's parts, flattened
 
 bool check(Qnn_ErrorHandle_t s, const char* w) {
   if (s != QNN_SUCCESS) { printf("[HTP] %s failed: %lu\n", w, (unsigned long)s); return false; }
   return true;
 }
 
-// ── Compute NHWC dims from byte count. C must be <= 1048576 ─────────────────
-// Layout: [N, 1, 1, C] where N*C = total_elements
-void computeDims(size_t totalBytes, uint32_t dims[4]) {
-  uint32_t total = static_cast<uint32_t>(totalBytes);  // 1 byte per element
-  uint32_t C = 1048576;  // max channel
-  if (total < C) C = total;
-  uint32_t N = total / C;
-  dims[0] = N; dims[1] = 1; dims[2] = 1; dims[3] = C;
-}
-
 // ── Register an externally-allocated ION buffer with QNN ────────────────────
+// A planned part past offset 0 is a sub-region: use HTP shared buffer API for
+// precise sub-region mapping.
 bool registerBuffer(const IonBuffer& ion, const uint32_t* dims, uint32_t ndims,
-                    RegMem& out) {
+                    RegMem& out, size_t offset = 0) {
   Qnn_MemDescriptor_t desc = QNN_MEM_DESCRIPTOR_INIT;
   desc.memShape.numDim  = ndims;
   desc.memShape.dimSize = const_cast<uint32_t*>(dims);
   desc.dataType         = QNN_DATATYPE_UFIXED_POINT_8;
-  desc.memType          = QNN_MEM_TYPE_ION;
-  desc.ionInfo.fd       = ion.fd;
+
+  // Compute tensor byte count from dims (1 byte per element for UFIXED_POINT_8)
+  size_t tensor_bytes = 1;
+  for (uint32_t i = 0; i < ndims; ++i) tensor_bytes *= dims[i];
+
+  QnnMemHtp_Descriptor_t htpDesc;
+  if (offset > 0 || tensor_bytes < ion.size) {
+    // Sub-region: use HTP shared buffer API with explicit offset
+    htpDesc.type = QNN_HTP_MEM_SHARED_BUFFER;
+    htpDesc.size = ion.size;
+    htpDesc.sharedBufferConfig.fd     = ion.fd;
+    htpDesc.sharedBufferConfig.offset = offset;
+
+    desc.memType    = QNN_MEM_TYPE_CUSTOM;
+    desc.customInfo = &htpDesc;
+  } else {
+    // Full buffer: standard ION registration
+    desc.memType   = QNN_MEM_TYPE_ION;
+    desc.ionInfo.fd = ion.fd;
+  }
 
   if (QNN_SUCCESS != g_qnn->memRegister(g_context, &desc, 1, &out.handle)) {
-    printf("[HTP] memRegister failed (fd=%d, size=%zu)\n", ion.fd, ion.size);
+    printf("[HTP] memRegister failed (fd=%d, ion_size=%zu, tensor=%zu, offset=%zu)\n",
+           ion.fd, ion.size, tensor_bytes, offset);
     return false;
   }
   return true;
@@ -79,12 +101,11 @@ bool registerBuffer(const IonBuffer& ion, const uint32_t* dims, uint32_t ndims,
 void deregisterAll() {
   if (!g_qnn || !g_qnn->memDeRegister) return;
   std::vector<Qnn_MemHandle_t> handles;
-  if (g_regA.handle) handles.push_back(g_regA.handle);
-  if (g_regB.handle) handles.push_back(g_regB.handle);
-  if (g_regC.handle) handles.push_back(g_regC.handle);
+  for (const RegMem& r : g_regs)
+    if (r.handle) handles.push_back(r.handle);
   if (!handles.empty())
     g_qnn->memDeRegister(handles.data(), static_cast<uint32_t>(handles.size()));
-  g_regA.handle = g_regB.handle = g_regC.handle = nullptr;
+  g_regs.clear();
 }
 
 // ── Power config: BURST mode, DCVS disabled ─────────────────────────────────
@@ -147,7 +168,7 @@ uint32_t queryCoreCount() {
   return cores;
 }
 
-Qnn_Tensor_t makeTensor(const char* name, Qnn_TensorType_t type, uint32_t* dims) {
+Qnn_Tensor_t makeTensor(const char* name, Qnn_TensorType_t type, const uint32_t* dims) {
   Qnn_Tensor_t t = QNN_TENSOR_INIT;
   t.version      = QNN_TENSOR_VERSION_1;
   t.v1.id        = 0;
@@ -160,7 +181,7 @@ Qnn_Tensor_t makeTensor(const char* name, Qnn_TensorType_t type, uint32_t* dims)
   t.v1.quantizeParams.scaleOffsetEncoding.scale  = 1.0f;
   t.v1.quantizeParams.scaleOffsetEncoding.offset = 0;
   t.v1.rank           = kTensorRank;
-  t.v1.dimensions     = dims;
+  t.v1.dimensions     = const_cast<uint32_t*>(dims);
   t.v1.memType        = QNN_TENSORMEMTYPE_RAW;
   t.v1.clientBuf      = QNN_CLIENT_BUFFER_INIT;
   return t;
@@ -172,13 +193,28 @@ Qnn_Tensor_t makeTensor(const char* name, Qnn_TensorType_t type, uint32_t* dims)
 
 void htp_print_info() {
   printf("  Hexagon V81, %u core(s), 8 HVX threads, BURST 模式\n", g_htpCoreCount);
-  printf("  张量: [%u, %u, %u, %u] UFIXED_POINT_8\n",
-         g_dims[0], g_dims[1], g_dims[2], g_dims[3]);
+  printf("  张量 (UFIXED_POINT_8, %zu 个 Add 节点", g_parts.size());
+  if (g_plans.size() > 1) printf(", %zu 个段", g_plans.size());
+  printf("):\n");
+  for (size_t s = 0; s < g_plans.size(); ++s) {
+    if (g_plans.size() > 1) printf("    段 %zu:\n", s);
+    htp_print_plan(g_plans[s], "    ");
+  }
 }
 
-bool htp_init(const IonBuffer& A, const IonBuffer& B, const IonBuffer& C) {
+bool htp_init(const SegmentedIonBuffer& A, const SegmentedIonBuffer& B,
+              const SegmentedIonBuffer& C) {
+  if (A.count() != B.count() || A.count() != C.count()) {
+    printf("[HTP] A/B/C segment counts differ\n");
+    return false;
+  }
   g_data_size = A.size;
-  computeDims(g_data_size, g_dims);
+  g_plans.clear();
+  g_parts.clear();
+  for (size_t s = 0; s < A.count(); ++s) {
+    g_plans.push_back(htp_plan_shape(A.segs[s].size, 1));
+    for (const HtpTensorPart& part : g_plans.back().parts) g_parts.push_back({s, part});
+  }
 
   // dlopen QNN backend
   g_libHandle = dlopen("libQnnHtp.so", RTLD_NOW | RTLD_LOCAL);
@@ -224,11 +260,17 @@ bool htp_init(const IonBuffer& A, const IonBuffer& B, const IonBuffer& C) {
   if (!check(g_qnn->contextCreate(g_backend, g_device, nullptr, &g_context), "contextCreate"))
     return false;
 
-  // Register ION buffers
-  if (!registerBuffer(A, g_dims, kTensorRank, g_regA) ||
-      !registerBuffer(B, g_dims, kTensorRank, g_regB) ||
-      !registerBuffer(C, g_dims, kTensorRank, g_regC))
-    return false;
+  // Register ION buffers: A/B/C segments for every planned part
+  const size_t numParts = g_parts.size();
+  g_regs.assign(numParts * 3, RegMem{});
+  for (size_t p = 0; p < numParts; ++p) {
+    const size_t seg = g_parts[p].segment;
+    const HtpTensorPart& part = g_parts[p].part;
+    if (!registerBuffer(A.segs[seg], part.dims, kTensorRank, g_regs[p * 3 + 0], part.offset_bytes) ||
+        !registerBuffer(B.segs[seg], part.dims, kTensorRank, g_regs[p * 3 + 1], part.offset_bytes) ||
+        !registerBuffer(C.segs[seg], part.dims, kTensorRank, g_regs[p * 3 + 2], part.offset_bytes))
+      return false;
+  }
 
   // Build graph
   g_htpCoreCount = queryCoreCount();
@@ -252,61 +294,78 @@ bool htp_init(const IonBuffer& A, const IonBuffer& B, const IonBuffer& C) {
   if (!check(g_qnn->graphCreate(g_context, "add_graph", graphCfgList, &g_graph), "graphCreate"))
     return false;
 
-  // Graph tensors
-  Qnn_Tensor_t in0 = makeTensor("input0", QNN_TENSOR_TYPE_APP_WRITE, g_dims);
-  Qnn_Tensor_t in1 = makeTensor("input1", QNN_TENSOR_TYPE_APP_WRITE, g_dims);
-  Qnn_Tensor_t out = makeTensor("output", QNN_TENSOR_TYPE_APP_READ,  g_dims);
-
-  if (!check(g_qnn->tensorCreateGraphTensor(g_graph, &in0), "tensor in0") ||
-      !check(g_qnn->tensorCreateGraphTensor(g_graph, &in1), "tensor in1") ||
-      !check(g_qnn->tensorCreateGraphTensor(g_graph, &out), "tensor out"))
-    return false;
-
-  // Add node
-  Qnn_Tensor_t opIn[2]  = {in0, in1};
-  Qnn_Tensor_t opOut[1] = {out};
-  Qnn_OpConfig_t addCfg = QNN_OPCONFIG_INIT;
-  addCfg.version = QNN_OPCONFIG_VERSION_1;
-  addCfg.v1.name         = "elementwise_add";
-  addCfg.v1.packageName  = QNN_OP_PACKAGE_NAME_QTI_AISW;
-  addCfg.v1.typeName     = QNN_OP_ELEMENT_WISE_ADD;
-  addCfg.v1.numOfParams  = 0;
-  addCfg.v1.params       = nullptr;
-  addCfg.v1.numOfInputs  = 2;
-  addCfg.v1.inputTensors = opIn;
-  addCfg.v1.numOfOutputs = 1;
-  addCfg.v1.outputTensors = opOut;
-
-  if (!check(g_qnn->graphAddNode(g_graph, addCfg), "graphAddNode"))
-    return false;
+  // Graph tensors + one Add node per part
+  g_tensorNames.clear();
+  g_tensorNames.reserve(numParts * 4);
+  g_execInputs.assign(numParts * 2, QNN_TENSOR_INIT);
+  g_execOutputs.assign(numParts, QNN_TENSOR_INIT);
+  for (size_t p = 0; p < numParts; ++p) {
+    const uint32_t* dims = g_parts[p].part.dims;
+    const std::string sfx = numParts > 1 ? "_p" + std::to_string(p) : "";
+    g_tensorNames.push_back("input0" + sfx);
+    g_tensorNames.push_back("input1" + sfx);
+    g_tensorNames.push_back("output" + sfx);
+    g_tensorNames.push_back("elementwise_add" + sfx);
+    const std::string* names = &g_tensorNames[p * 4];
+
+    Qnn_Tensor_t in0 = makeTensor(names[0].c_str(), QNN_TENSOR_TYPE_APP_WRITE, dims);
+    Qnn_Tensor_t in1 = makeTensor(names[1].c_str(), QNN_TENSOR_TYPE_APP_WRITE, dims);
+    Qnn_Tensor_t out = makeTensor(names[2].c_str(), QNN_TENSOR_TYPE_APP_READ,  dims);
+
+    if (!check(g_qnn->tensorCreateGraphTensor(g_graph, &in0), "tensor in0") ||
+        !check(g_qnn->tensorCreateGraphTensor(g_graph, &in1), "tensor in1") ||
+        !check(g_qnn->tensorCreateGraphTensor(g_graph, &out), "tensor out"))
+      return false;
+
+    // Add node
+    Qnn_Tensor_t opIn[2]  = {in0, in1};
+    Qnn_Tensor_t opOut[1] = {out};
+    Qnn_OpConfig_t addCfg = QNN_OPCONFIG_INIT;
+    addCfg.version = QNN_OPCONFIG_VERSION_1;
+    addCfg.v1.name         = names[3].c_str();
+    addCfg.v1.packageName  = QNN_OP_PACKAGE_NAME_QTI_AISW;
+    addCfg.v1.typeName     = QNN_OP_ELEMENT_WISE_ADD;
+    addCfg.v1.numOfParams  = 0;
+    addCfg.v1.params       = nullptr;
+    addCfg.v1.numOfInputs  = 2;
+    addCfg.v1.inputTensors = opIn;
+    addCfg.v1.numOfOutputs = 1;
+    addCfg.v1.outputTensors = opOut;
+
+    if (!check(g_qnn->graphAddNode(g_graph, addCfg), "graphAddNode"))
+      return false;
+
+    // Execution tensors with registered mem handles
+    g_execInputs[p * 2 + 0] = in0;
+    g_execInputs[p * 2 + 0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+    g_execInputs[p * 2 + 0].v1.memHandle = g_regs[p * 3 + 0].handle;
+
+    g_execInputs[p * 2 + 1] = in1;
+    g_execInputs[p * 2 + 1].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+    g_execInputs[p * 2 + 1].v1.memHandle = g_regs[p * 3 + 1].handle;
+
+    g_execOutputs[p] = out;
+    g_execOutputs[p].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+    g_execOutputs[p].v1.memHandle = g_regs[p * 3 + 2].handle;
+  }
   if (!check(g_qnn->graphFinalize(g_graph, nullptr, nullptr), "graphFinalize"))
     return false;
 
-  // Prepare execution tensors with registered mem handles
-  g_execInputs[0] = in0;
-  g_execInputs[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
-  g_execInputs[0].v1.memHandle = g_regA.handle;
-
-  g_execInputs[1] = in1;
-  g_execInputs[1].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
-  g_execInputs[1].v1.memHandle = g_regB.handle;
-
-  g_execOutputs[0] = out;
-  g_execOutputs[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
-  g_execOutputs[0].v1.memHandle = g_regC.handle;
-
   return true;
 }
 
-BandwidthResult htp_run(int num_warmup, int num_iters, SpinBarrier* barrier) {
+template <typename W>
+BandwidthResult htp_run(int num_warmup, int num_iters, SenseBarrier<W>* barrier) {
   BandwidthResult res;
   res.num_iterations   = num_iters;
   res.total_data_bytes = (double)g_data_size * 3.0 * num_iters;  // 2 read + 1 write
+  const uint32_t numInputs  = static_cast<uint32_t>(g_execInputs.size());
+  const uint32_t numOutputs = static_cast<uint32_t>(g_execOutputs.size());
 
   // Warmup
   for (int i = 0; i < num_warmup; ++i) {
-    if (!check(g_qnn->graphExecute(g_graph, g_execInputs, 2, g_execOutputs, 1,
-                                   nullptr, nullptr), "warmup")) {
+    if (!check(g_qnn->graphExecute(g_graph, g_execInputs.data(), numInputs,
+                                   g_execOutputs.data(), numOutputs, nullptr, nullptr), "warmup")) {
       res.error = "warmup failed";
       return res;
     }
@@ -318,8 +377,8 @@ BandwidthResult htp_run(int num_warmup, int num_iters, SpinBarrier* barrier) {
   // Timed run
   double t0 = now_seconds();
   for (int i = 0; i < num_iters; ++i) {
-    if (!check(g_qnn->graphExecute(g_graph, g_execInputs, 2, g_execOutputs, 1,
-                                   nullptr, nullptr), "exec")) {
+    if (!check(g_qnn->graphExecute(g_graph, g_execInputs.data(), numInputs,
+                                   g_execOutputs.data(), numOutputs, nullptr, nullptr), "exec")) {
       res.error = "exec failed";
       return res;
     }
@@ -332,6 +391,11 @@ BandwidthResult htp_run(int num_warmup, int num_iters, SpinBarrier* barrier) {
   return res;
 }
 
+#define INSTANTIATE_HTP_RUN(W) \
+  template BandwidthResult htp_run<W>(int, int, SenseBarrier<W>*);
+WAIT_STRATEGY_LIST(INSTANTIATE_HTP_RUN)
+#undef INSTANTIATE_HTP_RUN
+
 void htp_cleanup() {
   deregisterAll();
   if (g_qnn && g_context) g_qnn->contextFree(g_context, nullptr);
@@ -340,4 +404,6 @@ void htp_cleanup() {
   if (g_libHandle) dlclose(g_libHandle);
   g_context = nullptr; g_device = nullptr; g_backend = nullptr;
   g_graph = nullptr; g_qnn = nullptr; g_libHandle = nullptr;
+  g_execInputs.clear(); g_execOutputs.clear(); g_tensorNames.clear();
+  g_plans.clear(); g_parts.clear();
 }
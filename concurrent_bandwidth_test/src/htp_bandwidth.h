@@ -1,12 +1,18 @@
 #pragma once
 #include "common.h"
+#include "ion_segments.h"
 
 // Initialize QNN HTP: dlopen, backend, device, power, graph, register buffers.
-// The IonBuffer A/B/C are allocated externally (main) and registered here.
-bool htp_init(const IonBuffer& A, const IonBuffer& B, const IonBuffer& C);
+// The buffers A/B/C are allocated externally (main) and registered here; each
+// segment is shape-planned on its own and every planned part becomes one
+// registered sub-tensor triple + Add node of the single graph.
+bool htp_init(const SegmentedIonBuffer& A, const SegmentedIonBuffer& B,
+              const SegmentedIonBuffer& C);
 
 // Run bandwidth test.  If barrier != nullptr, waits on it after warmup.
-BandwidthResult htp_run(int num_warmup, int num_iters, SpinBarrier* barrier);
+// Instantiated for every strategy in WAIT_STRATEGY_LIST.
+template <typename W>
+BandwidthResult htp_run(int num_warmup, int num_iters, SenseBarrier<W>* barrier);
 
 // Print device info.
 void htp_print_info();
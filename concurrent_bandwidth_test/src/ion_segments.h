@@ -0,0 +1,82 @@
+#pragma once
+// Segmented ION buffer: one logical tensor stitched from several allocations.
+//
+// rpcmem_alloc takes an int size (2 GB ceiling) and the GPU caps a single
+// buffer at CL_DEVICE_MAX_MEM_ALLOC_SIZE, but multi-GB working sets are what
+// defeat the system cache and match real weight sizes. A SegmentedIonBuffer
+// is `count()` ION buffers of `segment_bytes` each (the last one shorter)
+// covering [0, size) in order; the engines run one piece of work per segment:
+//
+//   GPU  one imported buffer triple + NDRange launch per segment
+//   NPU  each segment planned (htp_shape_plan.h) and registered as its own
+//        sub-tensors, one Add node per sub-tensor, all in one graph
+//   CPU  worker ranges cut at segment boundaries (for_each_segment)
+//
+// The segment size is rounded down to whole MB so every segment keeps the
+// 1 MB alignment the QNN shape plan and CL sub-buffers rely on.
+
+#include "common.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+constexpr size_t kIonSegmentAlign      = 1ull << 20;
+constexpr size_t kIonDefaultSegmentMax = 1ull << 30;  // 1 GB: under the rpcmem int limit
+
+struct SegmentedIonBuffer {
+  std::vector<IonBuffer> segs;
+  size_t size          = 0;  // logical bytes
+  size_t segment_bytes = 0;  // every segment but the last
+
+  size_t count() const { return segs.size(); }
+  size_t segment_offset(size_t i) const { return i * segment_bytes; }
+
+  // Host pointer of logical byte `offset`
+  uint8_t* at(size_t offset) const {
+    const size_t i = offset / segment_bytes;
+    return static_cast<uint8_t*>(segs[i].ptr) + (offset - i * segment_bytes);
+  }
+};
+
+// Calls fn(segment, offset_in_segment, bytes) for each piece of the logical
+// range [lo, hi), in order
+template <typename Fn>
+void for_each_segment(const SegmentedIonBuffer& buf, size_t lo, size_t hi, Fn fn) {
+  hi = std::min(hi, buf.size);
+  while (lo < hi) {
+    const size_t i   = lo / buf.segment_bytes;
+    const size_t off = lo - buf.segment_offset(i);
+    const size_t n   = std::min(hi - lo, buf.segs[i].size - off);
+    fn(i, off, n);
+    lo += n;
+  }
+}
+
+inline void freeSegmentedIonBuffer(SegmentedIonBuffer& buf) {
+  for (IonBuffer& s : buf.segs) freeIonBuffer(s);
+  buf = SegmentedIonBuffer{};
+}
+
+// `size` bytes in segments of at most `max_segment` (whole MB), each
+// provisioned per `fill`
+inline bool allocSegmentedIonBuffer(size_t size, size_t max_segment, const IonFillSpec& fill,
+                                    SegmentedIonBuffer& out) {
+  out = SegmentedIonBuffer{};
+  if (size == 0) return false;
+  size_t seg = std::max(kIonSegmentAlign, max_segment / kIonSegmentAlign * kIonSegmentAlign);
+  if (seg >= size) seg = size;
+  out.size          = size;
+  out.segment_bytes = seg;
+  for (size_t off = 0; off < size; off += seg) {
+    IonBuffer b;
+    if (!provisionIonBuffer(std::min(seg, size - off), fill, b)) {
+      printf("[ION] segment %zu (%zu bytes at %zu) alloc failed\n", out.segs.size(),
+             std::min(seg, size - off), off);
+      freeSegmentedIonBuffer(out);
+      return false;
+    }
+    out.segs.push_back(b);
+  }
+  return true;
+}
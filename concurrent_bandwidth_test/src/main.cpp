@@ -1,6 +1,8 @@
 #include "common.h"
+#include "cpu_bandwidth.h"
 #include "gpu_bandwidth.h"
 #include "htp_bandwidth.h"
+#include "ion_segments.h"
 
 #include <cstdio>
 #include <cstdlib>
@@ -19,15 +21,24 @@ static void print_result(const char* label, const BandwidthResult& r) {
          label, r.bandwidth_gbps, r.num_iterations, r.elapsed_seconds);
 }
 
-enum class Mode { GPU, NPU, CONCURRENT, ALL };
+enum class Mode { GPU, NPU, CPU, CONCURRENT, ALL };
+
+// Wait strategy for the concurrent start barrier (--wait).
+static WaitKind g_wait = WaitKind::SPIN;
 
 static void print_usage(const char* prog) {
   printf("Usage: %s [options]\n", prog);
-  printf("  --mode gpu|npu|concurrent|all   (default: all)\n");
+  printf("  --mode gpu|npu|cpu|concurrent|all (default: all)\n");
   printf("  --total-size-mb N               total data MB (default: 256)\n");
   printf("  --gpu-ratio R                   GPU partition 0.0-1.0 (default: 0.5)\n");
   printf("  --gpu-iters N                   GPU iterations (default: auto)\n");
   printf("  --npu-iters N                   NPU iterations (default: auto)\n");
+  printf("  --cpu-ratio R                   CPU partition 0.0-1.0, NPU gets the rest (default: 0 = no CPU stream)\n");
+  printf("  --cpu-threads N                 CPU worker threads (default: 0 = half the online CPUs)\n");
+  printf("  --cpu-core N                    pin CPU workers to cores N, N+1, ... (default: -1 = no pin)\n");
+  printf("  --cpu-iters N                   CPU iterations (default: auto)\n");
+  printf("  --segment-mb N                  largest single ION allocation; bigger tensors are split (default: 1024)\n");
+  printf("  --wait spin|yield|futex|atomic|wfe  concurrent start barrier (default: spin)\n");
 }
 
 // Auto-compute iterations targeting ~100ms runtime
@@ -38,122 +49,180 @@ static int auto_iters(size_t partition_bytes, double estimated_bw_gbps) {
   return iters;
 }
 
+// Largest single ION allocation; bigger tensors are segmented (--segment-mb)
+static size_t g_segment_bytes = kIonDefaultSegmentMax;
+
+// A / B / C provisioning: a bandwidth run only needs the pages, so inputs get
+// a parallel value fill (ion_fill.h) and C, which every stream overwrites, none
+static bool alloc_abc(size_t bytes, SegmentedIonBuffer& A, SegmentedIonBuffer& B,
+                      SegmentedIonBuffer& C) {
+  return allocSegmentedIonBuffer(bytes, g_segment_bytes, IonFillSpec::value_of(1), A) &&
+         allocSegmentedIonBuffer(bytes, g_segment_bytes, IonFillSpec::value_of(2), B) &&
+         allocSegmentedIonBuffer(bytes, g_segment_bytes, IonFillSpec::none(), C);
+}
+
 // ── Test runners ────────────────────────────────────────────────────────────
 
 static BandwidthResult run_gpu_only(size_t size_bytes, int iters) {
-  IonBuffer A, B, C;
-  if (!allocIonBuffer(size_bytes, 1, A) ||
-      !allocIonBuffer(size_bytes, 2, B) ||
-      !allocIonBuffer(size_bytes, 0, C)) {
-    freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
+  SegmentedIonBuffer A, B, C;
+  if (!alloc_abc(size_bytes, A, B, C)) {
+    freeSegmentedIonBuffer(A); freeSegmentedIonBuffer(B); freeSegmentedIonBuffer(C);
     return {.error = "ION alloc failed"};
   }
 
   if (!gpu_init(A, B, C, "kernels/element_add.cl")) {
     gpu_cleanup();
-    freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
+    freeSegmentedIonBuffer(A); freeSegmentedIonBuffer(B); freeSegmentedIonBuffer(C);
     return {.error = "GPU init failed"};
   }
 
-  auto res = gpu_run(3, iters, nullptr);
+  auto res = gpu_run<SpinWait>(3, iters, nullptr);
   gpu_cleanup();
-  freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
+  freeSegmentedIonBuffer(A); freeSegmentedIonBuffer(B); freeSegmentedIonBuffer(C);
   return res;
 }
 
 static BandwidthResult run_npu_only(size_t size_bytes, int iters) {
-  IonBuffer A, B, C;
-  if (!allocIonBuffer(size_bytes, 1, A) ||
-      !allocIonBuffer(size_bytes, 2, B) ||
-      !allocIonBuffer(size_bytes, 0, C)) {
-    freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
+  SegmentedIonBuffer A, B, C;
+  if (!alloc_abc(size_bytes, A, B, C)) {
+    freeSegmentedIonBuffer(A); freeSegmentedIonBuffer(B); freeSegmentedIonBuffer(C);
     return {.error = "ION alloc failed"};
   }
 
   if (!htp_init(A, B, C)) {
     htp_cleanup();
-    freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
+    freeSegmentedIonBuffer(A); freeSegmentedIonBuffer(B); freeSegmentedIonBuffer(C);
     return {.error = "HTP init failed"};
   }
 
-  auto res = htp_run(3, iters, nullptr);
+  auto res = htp_run<SpinWait>(3, iters, nullptr);
   htp_cleanup();
-  freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
+  freeSegmentedIonBuffer(A); freeSegmentedIonBuffer(B); freeSegmentedIonBuffer(C);
+  return res;
+}
+
+static BandwidthResult run_cpu_only(size_t size_bytes, int iters, int threads, int first_core) {
+  SegmentedIonBuffer A, B, C;
+  if (!alloc_abc(size_bytes, A, B, C)) {
+    freeSegmentedIonBuffer(A); freeSegmentedIonBuffer(B); freeSegmentedIonBuffer(C);
+    return {.error = "ION alloc failed"};
+  }
+
+  if (!cpu_init(A, B, C, threads, first_core)) {
+    freeSegmentedIonBuffer(A); freeSegmentedIonBuffer(B); freeSegmentedIonBuffer(C);
+    return {.error = "CPU init failed"};
+  }
+
+  auto res = cpu_run<SpinWait>(3, iters, nullptr);
+  cpu_cleanup();
+  freeSegmentedIonBuffer(A); freeSegmentedIonBuffer(B); freeSegmentedIonBuffer(C);
   return res;
 }
 
 struct ConcurrentResult {
   BandwidthResult gpu;
   BandwidthResult npu;
+  BandwidthResult cpu;  // only when a CPU partition is given
   double wall_seconds;
 };
 
+// CPU stream of the concurrent run (cpu_bytes == 0: GPU + NPU only)
+struct CpuStream {
+  size_t bytes   = 0;
+  int    iters   = 0;
+  int    threads = 0;
+  int    first_core = -1;
+};
+
 static ConcurrentResult run_concurrent(
     size_t gpu_bytes, size_t npu_bytes,
-    int gpu_iters, int npu_iters) {
+    int gpu_iters, int npu_iters, const CpuStream& cs) {
 
   ConcurrentResult cr = {};
 
   // Allocate ION buffers for GPU partition
-  IonBuffer gA, gB, gC;
-  if (!allocIonBuffer(gpu_bytes, 1, gA) ||
-      !allocIonBuffer(gpu_bytes, 2, gB) ||
-      !allocIonBuffer(gpu_bytes, 0, gC)) {
-    freeIonBuffer(gA); freeIonBuffer(gB); freeIonBuffer(gC);
+  SegmentedIonBuffer gA, gB, gC;
+  if (!alloc_abc(gpu_bytes, gA, gB, gC)) {
+    freeSegmentedIonBuffer(gA); freeSegmentedIonBuffer(gB); freeSegmentedIonBuffer(gC);
     cr.gpu.error = "GPU ION alloc failed";
     return cr;
   }
 
   // Allocate ION buffers for NPU partition
-  IonBuffer nA, nB, nC;
-  if (!allocIonBuffer(npu_bytes, 1, nA) ||
-      !allocIonBuffer(npu_bytes, 2, nB) ||
-      !allocIonBuffer(npu_bytes, 0, nC)) {
-    freeIonBuffer(gA); freeIonBuffer(gB); freeIonBuffer(gC);
-    freeIonBuffer(nA); freeIonBuffer(nB); freeIonBuffer(nC);
+  SegmentedIonBuffer nA, nB, nC;
+  if (!alloc_abc(npu_bytes, nA, nB, nC)) {
+    freeSegmentedIonBuffer(gA); freeSegmentedIonBuffer(gB); freeSegmentedIonBuffer(gC);
+    freeSegmentedIonBuffer(nA); freeSegmentedIonBuffer(nB); freeSegmentedIonBuffer(nC);
     cr.npu.error = "NPU ION alloc failed";
     return cr;
   }
 
+  // Allocate ION buffers for CPU partition
+  SegmentedIonBuffer cA, cB, cC;
+  if (cs.bytes > 0 && !alloc_abc(cs.bytes, cA, cB, cC)) {
+    freeSegmentedIonBuffer(gA); freeSegmentedIonBuffer(gB); freeSegmentedIonBuffer(gC);
+    freeSegmentedIonBuffer(nA); freeSegmentedIonBuffer(nB); freeSegmentedIonBuffer(nC);
+    freeSegmentedIonBuffer(cA); freeSegmentedIonBuffer(cB); freeSegmentedIonBuffer(cC);
+    cr.cpu.error = "CPU ION alloc failed";
+    return cr;
+  }
+
   // Initialize both (sequentially — dlopen not thread-safe)
   if (!gpu_init(gA, gB, gC, "kernels/element_add.cl")) {
     cr.gpu.error = "GPU init failed";
     gpu_cleanup();
-    freeIonBuffer(gA); freeIonBuffer(gB); freeIonBuffer(gC);
-    freeIonBuffer(nA); freeIonBuffer(nB); freeIonBuffer(nC);
+    freeSegmentedIonBuffer(gA); freeSegmentedIonBuffer(gB); freeSegmentedIonBuffer(gC);
+    freeSegmentedIonBuffer(nA); freeSegmentedIonBuffer(nB); freeSegmentedIonBuffer(nC);
+    freeSegmentedIonBuffer(cA); freeSegmentedIonBuffer(cB); freeSegmentedIonBuffer(cC);
     return cr;
   }
 
   if (!htp_init(nA, nB, nC)) {
     cr.npu.error = "HTP init failed";
     gpu_cleanup(); htp_cleanup();
-    freeIonBuffer(gA); freeIonBuffer(gB); freeIonBuffer(gC);
-    freeIonBuffer(nA); freeIonBuffer(nB); freeIonBuffer(nC);
+    freeSegmentedIonBuffer(gA); freeSegmentedIonBuffer(gB); freeSegmentedIonBuffer(gC);
+    freeSegmentedIonBuffer(nA); freeSegmentedIonBuffer(nB); freeSegmentedIonBuffer(nC);
+    freeSegmentedIonBuffer(cA); freeSegmentedIonBuffer(cB); freeSegmentedIonBuffer(cC);
     return cr;
   }
 
+  bool with_cpu = cs.bytes > 0;
+  if (with_cpu) cpu_init(cA, cB, cC, cs.threads, cs.first_core);
+
   // Launch concurrent threads with barrier
-  SpinBarrier barrier(2);
+  dispatch_wait(g_wait, [&](auto strategy) {
+    using W = decltype(strategy);
+    SenseBarrier<W> barrier(with_cpu ? 3 : 2);
+
+    double wall_t0 = now_seconds();
+
+    std::thread gpu_thread([&]() {
+      cr.gpu = gpu_run<W>(3, gpu_iters, &barrier);
+    });
+    std::thread npu_thread([&]() {
+      cr.npu = htp_run<W>(3, npu_iters, &barrier);
+    });
+    std::thread cpu_thread;
+    if (with_cpu) {
+      cpu_thread = std::thread([&]() {
+        cr.cpu = cpu_run<W>(3, cs.iters, &barrier);
+      });
+    }
 
-  double wall_t0 = now_seconds();
+    gpu_thread.join();
+    npu_thread.join();
+    if (with_cpu) cpu_thread.join();
 
-  std::thread gpu_thread([&]() {
-    cr.gpu = gpu_run(3, gpu_iters, &barrier);
-  });
-  std::thread npu_thread([&]() {
-    cr.npu = htp_run(3, npu_iters, &barrier);
+    cr.wall_seconds = now_seconds() - wall_t0;
   });
 
-  gpu_thread.join();
-  npu_thread.join();
-
-  cr.wall_seconds = now_seconds() - wall_t0;
-
   // Cleanup
   gpu_cleanup();
   htp_cleanup();
-  freeIonBuffer(gA); freeIonBuffer(gB); freeIonBuffer(gC);
-  freeIonBuffer(nA); freeIonBuffer(nB); freeIonBuffer(nC);
+  cpu_cleanup();
+  freeSegmentedIonBuffer(gA); freeSegmentedIonBuffer(gB); freeSegmentedIonBuffer(gC);
+  freeSegmentedIonBuffer(nA); freeSegmentedIonBuffer(nB); freeSegmentedIonBuffer(nC);
+  freeSegmentedIonBuffer(cA); freeSegmentedIonBuffer(cB); freeSegmentedIonBuffer(cC);
   return cr;
 }
 
@@ -165,12 +234,17 @@ int main(int argc, char* argv[]) {
   double gpu_ratio    = 0.5;
   int gpu_iters_arg   = 0;  // 0 = auto
   int npu_iters_arg   = 0;
+  double cpu_ratio    = 0.0;
+  int cpu_threads     = 0;  // 0 = half the online CPUs
+  int cpu_core        = -1;
+  int cpu_iters_arg   = 0;
 
   for (int i = 1; i < argc; ++i) {
     if (!strcmp(argv[i], "--mode") && i+1 < argc) {
       ++i;
       if (!strcmp(argv[i], "gpu"))        mode = Mode::GPU;
       else if (!strcmp(argv[i], "npu"))   mode = Mode::NPU;
+      else if (!strcmp(argv[i], "cpu"))   mode = Mode::CPU;
       else if (!strcmp(argv[i], "concurrent")) mode = Mode::CONCURRENT;
       else                                mode = Mode::ALL;
     } else if (!strcmp(argv[i], "--total-size-mb") && i+1 < argc) {
@@ -181,6 +255,18 @@ int main(int argc, char* argv[]) {
       gpu_iters_arg = atoi(argv[++i]);
     } else if (!strcmp(argv[i], "--npu-iters") && i+1 < argc) {
       npu_iters_arg = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--cpu-ratio") && i+1 < argc) {
+      cpu_ratio = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--cpu-threads") && i+1 < argc) {
+      cpu_threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--cpu-core") && i+1 < argc) {
+      cpu_core = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--cpu-iters") && i+1 < argc) {
+      cpu_iters_arg = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--segment-mb") && i+1 < argc) {
+      g_segment_bytes = std::max(1, atoi(argv[++i])) * 1024ULL * 1024ULL;
+    } else if (!strcmp(argv[i], "--wait") && i+1 < argc) {
+      if (!parse_wait_kind(argv[++i], g_wait)) { print_usage(argv[0]); return 1; }
     } else if (!strcmp(argv[i], "--help")) {
       print_usage(argv[0]); return 0;
     }
@@ -188,27 +274,41 @@ int main(int argc, char* argv[]) {
 
   size_t total_bytes = total_mb * 1024ULL * 1024ULL;
   size_t gpu_bytes   = static_cast<size_t>(total_bytes * gpu_ratio);
-  size_t npu_bytes   = total_bytes - gpu_bytes;
+  cpu_ratio = std::clamp(cpu_ratio, 0.0, std::max(0.0, 1.0 - gpu_ratio));
+  size_t cpu_bytes   = static_cast<size_t>(total_bytes * cpu_ratio);
+  size_t npu_bytes   = total_bytes - gpu_bytes - cpu_bytes;
 
   // Align to 1MB boundary (for QNN tensor shape compatibility)
   gpu_bytes = (gpu_bytes / (1024*1024)) * (1024*1024);
   npu_bytes = (npu_bytes / (1024*1024)) * (1024*1024);
+  cpu_bytes = (cpu_bytes / (1024*1024)) * (1024*1024);
   if (gpu_bytes == 0) gpu_bytes = 1024*1024;
   if (npu_bytes == 0) npu_bytes = 1024*1024;
+  if (cpu_ratio > 0 && cpu_bytes == 0) cpu_bytes = 1024*1024;
 
   int gpu_iters = gpu_iters_arg > 0 ? gpu_iters_arg : auto_iters(gpu_bytes, 50.0);
   int npu_iters = npu_iters_arg > 0 ? npu_iters_arg : auto_iters(npu_bytes, 45.0);
   int gpu_full_iters = gpu_iters_arg > 0 ? gpu_iters_arg : auto_iters(total_bytes, 50.0);
   int npu_full_iters = npu_iters_arg > 0 ? npu_iters_arg : auto_iters(total_bytes, 45.0);
+  int cpu_iters      = cpu_iters_arg > 0 ? cpu_iters_arg : auto_iters(std::max(cpu_bytes, (size_t)1), 25.0);
+  int cpu_full_iters = cpu_iters_arg > 0 ? cpu_iters_arg : auto_iters(total_bytes, 25.0);
 
   printf("=== 异构并发带宽测试 ===\n");
   printf("理论峰值: %.1f GB/s (LPDDR5X-5300, 4ch x 16bit)\n", kTheoreticalBandwidthGBps);
   printf("任务: Element-wise Add (C = A + B)\n");
-  printf("总大小: %zu MB, GPU: %zu MB (%.0f%%), NPU: %zu MB (%.0f%%)\n\n",
+  printf("总大小: %zu MB, GPU: %zu MB (%.0f%%), NPU: %zu MB (%.0f%%)",
          total_mb, gpu_bytes/(1024*1024), gpu_ratio*100,
-         npu_bytes/(1024*1024), (1.0-gpu_ratio)*100);
-
-  BandwidthResult gpu_solo = {}, npu_solo = {};
+         npu_bytes/(1024*1024), (1.0-gpu_ratio-cpu_ratio)*100);
+  if (cpu_bytes > 0)
+    printf(", CPU: %zu MB (%.0f%%)", cpu_bytes/(1024*1024), cpu_ratio*100);
+  printf("\n");
+  if (total_bytes > g_segment_bytes)
+    printf("分段: 单块 ION 上限 %zu MB，更大的张量拆成多段 (GPU 每段一次 NDRange, NPU 每段独立注册子张量)\n",
+           g_segment_bytes / (1024*1024));
+  printf("并发启动屏障: %s\n", wait_kind_name(g_wait));
+  printf("\n");
+
+  BandwidthResult gpu_solo = {}, npu_solo = {}, cpu_solo = {};
   ConcurrentResult concurrent = {};
 
   // ── GPU-only baseline ───────────────────────────────────────────────────
@@ -216,13 +316,13 @@ int main(int argc, char* argv[]) {
     printf("--- GPU 设备信息 ---\n");
     {
       // Quick init just to print info, then cleanup
-      IonBuffer tmp;
-      allocIonBuffer(1024*1024, 0, tmp);
+      SegmentedIonBuffer tmp;
+      allocSegmentedIonBuffer(1024*1024, g_segment_bytes, IonFillSpec::value_of(0), tmp);
       if (gpu_init(tmp, tmp, tmp, "kernels/element_add.cl")) {
         gpu_print_info();
         gpu_cleanup();
       }
-      freeIonBuffer(tmp);
+      freeSegmentedIonBuffer(tmp);
     }
     printf("\n=== GPU-Only 基线 (全量 %zu MB) ===\n", total_mb);
     gpu_solo = run_gpu_only(total_bytes, gpu_full_iters);
@@ -232,20 +332,24 @@ int main(int argc, char* argv[]) {
     printf("\n");
   }
 
+  // Between cases: released buffers (up to the pool's cache limit) would
+  // otherwise stay mapped on top of the next case's peak
+  ionPool().trim();
+
   // ── NPU-only baseline ──────────────────────────────────────────────────
   if (mode == Mode::NPU || mode == Mode::ALL) {
     printf("--- NPU 设备信息 ---\n");
     {
       // Use small separate buffers (like GPU info path) to avoid memRegister failure
-      IonBuffer tA, tB, tC;
-      allocIonBuffer(1024*1024, 1, tA);
-      allocIonBuffer(1024*1024, 2, tB);
-      allocIonBuffer(1024*1024, 0, tC);
+      SegmentedIonBuffer tA, tB, tC;
+      allocSegmentedIonBuffer(1024*1024, g_segment_bytes, IonFillSpec::value_of(1), tA);
+      allocSegmentedIonBuffer(1024*1024, g_segment_bytes, IonFillSpec::value_of(2), tB);
+      allocSegmentedIonBuffer(1024*1024, g_segment_bytes, IonFillSpec::value_of(0), tC);
       if (htp_init(tA, tB, tC)) {
         htp_print_info();
         htp_cleanup();
       }
-      freeIonBuffer(tA); freeIonBuffer(tB); freeIonBuffer(tC);
+      freeSegmentedIonBuffer(tA); freeSegmentedIonBuffer(tB); freeSegmentedIonBuffer(tC);
     }
     printf("\n=== NPU-Only 基线 (全量 %zu MB) ===\n", total_mb);
     npu_solo = run_npu_only(total_bytes, npu_full_iters);
@@ -255,22 +359,67 @@ int main(int argc, char* argv[]) {
     printf("\n");
   }
 
+  // Between cases: released buffers (up to the pool's cache limit) would
+  // otherwise stay mapped on top of the next case's peak
+  ionPool().trim();
+
+  // ── CPU-only baseline (--mode cpu, or all with a CPU partition) ─────────
+  if (mode == Mode::CPU || (mode == Mode::ALL && cpu_bytes > 0)) {
+    printf("--- CPU 设备信息 ---\n");
+    {
+      SegmentedIonBuffer tmp;
+      allocSegmentedIonBuffer(1024*1024, g_segment_bytes, IonFillSpec::value_of(0), tmp);
+      if (cpu_init(tmp, tmp, tmp, cpu_threads, cpu_core)) {
+        cpu_print_info();
+        cpu_cleanup();
+      }
+      freeSegmentedIonBuffer(tmp);
+    }
+    printf("\n=== CPU-Only 基线 (全量 %zu MB) ===\n", total_mb);
+    cpu_solo = run_cpu_only(total_bytes, cpu_full_iters, cpu_threads, cpu_core);
+    print_result("CPU", cpu_solo);
+    if (cpu_solo.success)
+      printf("  利用率: %.1f%%\n", cpu_solo.bandwidth_gbps / kTheoreticalBandwidthGBps * 100);
+    printf("\n");
+  }
+
+  // Between cases: released buffers (up to the pool's cache limit) would
+  // otherwise stay mapped on top of the next case's peak
+  ionPool().trim();
+
   // ── Concurrent ────────────────────────────────────────────────────────
   if (mode == Mode::CONCURRENT || mode == Mode::ALL) {
-    printf("=== GPU + NPU 并发 (GPU %zuMB + NPU %zuMB) ===\n",
-           gpu_bytes/(1024*1024), npu_bytes/(1024*1024));
-    concurrent = run_concurrent(gpu_bytes, npu_bytes, gpu_iters, npu_iters);
+    CpuStream cs;
+    cs.bytes = cpu_bytes;
+    cs.iters = cpu_iters;
+    cs.threads = cpu_threads;
+    cs.first_core = cpu_core;
+    bool with_cpu = cpu_bytes > 0;
+    if (with_cpu)
+      printf("=== GPU + NPU + CPU 并发 (GPU %zuMB + NPU %zuMB + CPU %zuMB) ===\n",
+             gpu_bytes/(1024*1024), npu_bytes/(1024*1024), cpu_bytes/(1024*1024));
+    else
+      printf("=== GPU + NPU 并发 (GPU %zuMB + NPU %zuMB) ===\n",
+             gpu_bytes/(1024*1024), npu_bytes/(1024*1024));
+    concurrent = run_concurrent(gpu_bytes, npu_bytes, gpu_iters, npu_iters, cs);
     print_result("GPU", concurrent.gpu);
     print_result("NPU", concurrent.npu);
+    if (with_cpu) print_result("CPU", concurrent.cpu);
 
-    if (concurrent.gpu.success && concurrent.npu.success) {
-      double aggregate = concurrent.gpu.bandwidth_gbps + concurrent.npu.bandwidth_gbps;
+    if (concurrent.gpu.success && concurrent.npu.success &&
+        (!with_cpu || concurrent.cpu.success)) {
+      double aggregate = concurrent.gpu.bandwidth_gbps + concurrent.npu.bandwidth_gbps +
+                         concurrent.cpu.bandwidth_gbps;
+      // Overlap: share of the shorter streams' time hidden under the longest one
       double overlap = 0;
       double tg = concurrent.gpu.elapsed_seconds;
       double tn = concurrent.npu.elapsed_seconds;
+      double tc = concurrent.cpu.elapsed_seconds;
       double tw = concurrent.wall_seconds;
-      if (std::min(tg, tn) > 0)
-        overlap = (tg + tn - tw) / std::min(tg, tn) * 100.0;
+      double busy = tg + tn + tc;
+      double others = busy - std::max({tg, tn, tc});
+      if (others > 0)
+        overlap = (busy - tw) / others * 100.0;
 
       printf("  Wall clock: %.3fs, Overlap: %.1f%%\n", tw, overlap);
       printf("  聚合带宽: %.2f GB/s (%.1f%%)\n",
@@ -282,29 +431,43 @@ int main(int argc, char* argv[]) {
   // ── Summary table ─────────────────────────────────────────────────────
   if (mode == Mode::ALL) {
     printf("=== 总结 ===\n");
-    printf("+-----------+-----------+-----------+---------+---------+\n");
-    printf("| 模式      | GPU GB/s  | NPU GB/s  | 聚合    | 利用率  |\n");
-    printf("+-----------+-----------+-----------+---------+---------+\n");
+    printf("+-----------+-----------+-----------+-----------+---------+---------+\n");
+    printf("| 模式      | GPU GB/s  | NPU GB/s  | CPU GB/s  | 聚合    | 利用率  |\n");
+    printf("+-----------+-----------+-----------+-----------+---------+---------+\n");
 
     if (gpu_solo.success)
-      printf("| GPU only  | %9.2f |     --    | %7.2f | %5.1f%%  |\n",
+      printf("| GPU only  | %9.2f |     --    |     --    | %7.2f | %5.1f%%  |\n",
              gpu_solo.bandwidth_gbps, gpu_solo.bandwidth_gbps,
              gpu_solo.bandwidth_gbps / kTheoreticalBandwidthGBps * 100);
 
     if (npu_solo.success)
-      printf("| NPU only  |     --    | %9.2f | %7.2f | %5.1f%%  |\n",
+      printf("| NPU only  |     --    | %9.2f |     --    | %7.2f | %5.1f%%  |\n",
              npu_solo.bandwidth_gbps, npu_solo.bandwidth_gbps,
              npu_solo.bandwidth_gbps / kTheoreticalBandwidthGBps * 100);
 
+    if (cpu_solo.success)
+      printf("| CPU only  |     --    |     --    | %9.2f | %7.2f | %5.1f%%  |\n",
+             cpu_solo.bandwidth_gbps, cpu_solo.bandwidth_gbps,
+             cpu_solo.bandwidth_gbps / kTheoreticalBandwidthGBps * 100);
+
     if (concurrent.gpu.success && concurrent.npu.success) {
-      double agg = concurrent.gpu.bandwidth_gbps + concurrent.npu.bandwidth_gbps;
-      printf("| 并发      | %9.2f | %9.2f | %7.2f | %5.1f%%  |\n",
-             concurrent.gpu.bandwidth_gbps, concurrent.npu.bandwidth_gbps,
-             agg, agg / kTheoreticalBandwidthGBps * 100);
+      double agg = concurrent.gpu.bandwidth_gbps + concurrent.npu.bandwidth_gbps +
+                   concurrent.cpu.bandwidth_gbps;
+      if (concurrent.cpu.success)
+        printf("| 并发      | %9.2f | %9.2f | %9.2f | %7.2f | %5.1f%%  |\n",
+               concurrent.gpu.bandwidth_gbps, concurrent.npu.bandwidth_gbps,
+               concurrent.cpu.bandwidth_gbps, agg, agg / kTheoreticalBandwidthGBps * 100);
+      else
+        printf("| 并发      | %9.2f | %9.2f |     --    | %7.2f | %5.1f%%  |\n",
+               concurrent.gpu.bandwidth_gbps, concurrent.npu.bandwidth_gbps,
+               agg, agg / kTheoreticalBandwidthGBps * 100);
     }
-    printf("+-----------+-----------+-----------+---------+---------+\n");
+    printf("+-----------+-----------+-----------+-----------+---------+---------+\n");
 
   }
 
+  ionPrintProvisionStats("");
+  ionPool().print_stats("");
+
   return 0;
 }
@@ -1,15 +1,16 @@
 //=============================================================================
 //  HeteroEdge HTP Op Package - Interface
 //
-//  Combined package containing both SyncWait and RmsNorm ops.
+//  Combined package containing the SyncWait, RmsNorm and PersistentRmsNorm ops.
 //  By placing both ops in the same package, QNN/HTP can schedule them
 //  without inter-package boundary overhead (confirmed 8.3x speedup vs
 //  separate packages via test_graph_overhead unit test).
 //
 //  Package: heteroedge.HvxOpPackage
 //  Ops:
-//    SyncWait - polls GPU flag in ION shared memory; data passthrough
-//    RmsNorm  - FP16 RMSNorm via HVX intrinsics
+//    SyncWait          - polls GPU flag in ION shared memory; data passthrough
+//    RmsNorm           - FP16 RMSNorm via HVX intrinsics
+//    PersistentRmsNorm - N flag-gated RmsNorm steps per graphExecute (burst)
 //=============================================================================
 
 #include "HTP/QnnHtpCommon.h"
@@ -28,6 +29,7 @@ BEGIN_PKG_OPS_OPTS_LIST()
 
 DECLARE_PKG_OPS_OPTS_LIST(PKG_SyncWait)
 DECLARE_PKG_OPS_OPTS_LIST(PKG_RmsNorm)
+DECLARE_PKG_OPS_OPTS_LIST(PKG_PersistentRmsNorm)
 
 END_PKG_OPS_OPTS_LIST()
 
@@ -35,7 +37,8 @@ END_PKG_OPS_OPTS_LIST()
 static constexpr auto sg_packageName   = THIS_PKG_NAME_STR;
 static constexpr auto sg_opSyncWait    = "SyncWait";
 static constexpr auto sg_opRmsNorm     = "RmsNorm";
-static std::array<const char *, 2> sg_opNames{{sg_opSyncWait, sg_opRmsNorm}};
+static constexpr auto sg_opPersistent  = "PersistentRmsNorm";
+static std::array<const char *, 3> sg_opNames{{sg_opSyncWait, sg_opRmsNorm, sg_opPersistent}};
 
 static Qnn_ApiVersion_t sg_sdkApiVersion = QNN_HTP_API_VERSION_INIT;
 static Qnn_Version_t sg_opsetVersion = {
@@ -119,6 +122,11 @@ Qnn_ErrorHandle_t heteroedgeValidateOpConfig(Qnn_OpConfig_t opConfig) {
     if (opConfig.v1.numOfInputs != 2 || opConfig.v1.numOfOutputs != 1 ||
         opConfig.v1.numOfParams > 1)
       return QNN_OP_PACKAGE_ERROR_VALIDATION_FAILURE;
+  } else if (typeName == sg_opPersistent) {
+    // PersistentRmsNorm: 3 inputs (data, gamma, burst), 1 output, 6 params
+    if (opConfig.v1.numOfInputs != 3 || opConfig.v1.numOfOutputs != 1 ||
+        opConfig.v1.numOfParams != 6)
+      return QNN_OP_PACKAGE_ERROR_VALIDATION_FAILURE;
   } else {
     return QNN_OP_PACKAGE_ERROR_VALIDATION_FAILURE;
   }
@@ -0,0 +1,227 @@
+//=============================================================================
+//  HeteroEdge HTP Op Package - PersistentRmsNorm implementation
+//
+//  One graphExecute runs a burst of N RmsNorm steps on the DSP, so the
+//  FastRPC round trip of graphExecute (~270 us fixed cost, ~80 us before the
+//  first op even starts) is paid once per burst instead of once per step.
+//  Loop and descriptor: persistent_protocol.h.
+//
+//  DSP-side execution:
+//  1. HAP_mmap_get() the flag table, input and output ION buffers. Every
+//     step reads / writes the shared buffers in place: QNN's tensor copies
+//     are taken once at launch and would go stale after step 0.
+//  2. Per step i: poll the producer flag (flag_offset) until it reaches
+//     wait_epoch + i, invalidate the input lines, HVX RmsNorm into the output
+//     buffer, clean the output lines, then store done_epoch + i into the NPU
+//     completion flag (done_offset) and clean that line.
+//  3. Copy the last output to the op's output tensor (graph dependency).
+//
+//  Inputs:
+//    data  (FP16 {1,1,1,hidden_dim}) — the producer's output buffer (dims only)
+//    gamma (FP16 {hidden_dim})
+//    burst (UINT32 {1,1,1,3})        — PersistentBurst {wait_epoch, steps, done_epoch}
+//  Static parameters (UINT32 scalars except epsilon):
+//    epsilon      FLOAT32
+//    flag_ion_fd  ION fd of the epoch flag table
+//    flag_offset  byte offset of the producer flag in the table
+//    done_offset  byte offset of the NPU completion flag in the table
+//    in_ion_fd    ION fd of the input buffer  (= the data tensor's buffer)
+//    out_ion_fd   ION fd of the output buffer (the producer's next input)
+//  Output:
+//    out   (FP16, same dims as data) — result of the last completed step
+//
+//  A producer that stops posting ends the burst after the poll timeout; the
+//  host sees fewer published epochs than it asked for. A burst the op cannot
+//  run at all (no HAP mapping, or the generic host implementation) fails with
+//  GraphStatus::ErrorFatal instead of passing its input through silently, so
+//  graphExecute returns an error and no epoch is published.
+//=============================================================================
+
+#include <cstring>
+
+#ifdef __hexagon__
+#include "HAP_mem.h"
+#endif
+
+#include "HTP/core/constraints.h"
+#include "HTP/core/op_package_feature_support.h"
+#include "HTP/core/op_register_ext.h"
+#include "HTP/core/optimize.h"
+#include "HTP/core/simple_reg.h"
+#include "HeteroEdgeRmsNorm.h"
+#include "persistent_protocol.h"
+
+BEGIN_PKG_OP_DEFINITION(PKG_PersistentRmsNorm);
+
+DEF_PACKAGE_PARAM_ORDER("PersistentRmsNorm",
+                        "epsilon", true, nullptr,
+                        "flag_ion_fd", true, nullptr,
+                        "flag_offset", true, nullptr,
+                        "done_offset", true, nullptr,
+                        "in_ion_fd", true, nullptr,
+                        "out_ion_fd", true, nullptr)
+
+// Forward declarations
+template <typename Ttype>
+int persistent_rmsnorm_impl(Ttype &out, const Ttype &data_in, const Ttype &gamma,
+                            const Tensor &burst, const Tensor &epsilon,
+                            const Tensor &flag_ion_fd, const Tensor &flag_offset,
+                            const Tensor &done_offset, const Tensor &in_ion_fd,
+                            const Tensor &out_ion_fd);
+
+template <typename DType>
+int persistent_rmsnorm_fp16_impl(DType &out, const DType &data_in, const DType &gamma,
+                                 const Tensor &burst, const Tensor &epsilon,
+                                 const Tensor &flag_ion_fd, const Tensor &flag_offset,
+                                 const Tensor &done_offset, const Tensor &in_ion_fd,
+                                 const Tensor &out_ion_fd);
+
+// Generic fallback (graph compilation on ARM host)
+DEF_PACKAGE_OP((persistent_rmsnorm_impl<Tensor>), "PersistentRmsNorm")
+
+// HVX variants
+DEF_PACKAGE_OP_AND_COST_AND_FLAGS((persistent_rmsnorm_fp16_impl<PlainFloat16Tensor>),
+                                  "PersistentRmsNorm",
+                                  FAST,
+                                  Flags::RESOURCE_HVX)
+DEF_PACKAGE_OP_AND_COST_AND_FLAGS((persistent_rmsnorm_fp16_impl<PlainFloat16Tensor_TCM>),
+                                  "PersistentRmsNorm",
+                                  FAST,
+                                  Flags::RESOURCE_HVX)
+
+DEF_TENSOR_PROPERTIES(Op("PersistentRmsNorm", "data", "gamma", "burst"),
+                      Flat("*", "data", "gamma"))
+
+// Steps the host asked for; 0 (no descriptor written) runs nothing
+static uint32_t requested_steps(const Tensor &burst) {
+  heteroedge::PersistentBurst b = {};
+  if (burst.raw_data_const())
+    memcpy(&b, burst.raw_data_const(), sizeof(b));
+  return b.steps;
+}
+
+#ifdef __hexagon__
+static uint32_t read_u32_param(const Tensor &param) {
+  uint32_t v = 0;
+  if (param.raw_data_const())
+    memcpy(&v, param.raw_data_const(), sizeof(uint32_t));
+  return v;
+}
+
+static inline void dc_invalidate(const void *p, size_t bytes) {
+  const char *c = (const char *)p;
+  for (size_t off = 0; off < bytes; off += 32)
+    asm volatile("dcinva(%0)" : : "r"(c + off));
+  asm volatile("" ::: "memory");
+}
+
+static inline void dc_clean(const void *p, size_t bytes) {
+  const char *c = (const char *)p;
+  for (size_t off = 0; off < bytes; off += 32)
+    asm volatile("dccleaninva(%0)" : : "r"(c + off));
+  asm volatile("syncht" ::: "memory");
+}
+
+// DSP hooks for run_persistent_burst(): direct DDR access through HAP VAs
+struct DspBurstDev {
+  volatile uint32_t *ready = nullptr;  // producer flag
+  volatile uint32_t *done  = nullptr;  // NPU completion flag
+  const Float16 *in    = nullptr;
+  Float16       *out   = nullptr;
+  const Float16 *gamma = nullptr;
+  float  epsilon = 1e-6f;
+  int    length  = 0;
+
+  bool wait(uint32_t target) {
+    const int kTimeout = 10000000;  // same bound as SyncWait
+    for (int t = 0; t < kTimeout; ++t) {
+      asm volatile("dcinva(%0)" : : "r"(ready));
+      asm volatile("" ::: "memory");
+      if (heteroedge::burst_epoch_reached(*ready, target)) return true;
+    }
+    return false;
+  }
+  void step() {
+    const size_t bytes = (size_t)length * 2;
+    dc_invalidate(in, bytes);
+    rmsnorm_hvx_row(out, in, gamma, epsilon, length);
+    dc_clean(out, bytes);  // output reaches DDR before the flag does
+  }
+  void publish(uint32_t epoch) {
+    *done = epoch;
+    dc_clean((const void *)done, sizeof(uint32_t));
+  }
+};
+
+// Map the three ION buffers, run the burst, copy the last output to result,
+// unmap. Returns false if any mapping fails (nothing was run).
+static bool run_burst_on_dsp(const Tensor &burst, float eps, const Float16 *gamma, int length,
+                             uint32_t flag_fd, uint32_t flag_off, uint32_t done_off,
+                             uint32_t in_fd, uint32_t out_fd, void *result) {
+  heteroedge::PersistentBurst b;
+  memcpy(&b, burst.raw_data_const(), sizeof(b));
+
+  void *flag_va = nullptr, *in_va = nullptr, *out_va = nullptr;
+  uint64 paddr = 0;
+  bool ok = HAP_mmap_get((int)flag_fd, &flag_va, &paddr) == 0 && flag_va;
+  ok = ok && HAP_mmap_get((int)in_fd, &in_va, &paddr) == 0 && in_va;
+  ok = ok && HAP_mmap_get((int)out_fd, &out_va, &paddr) == 0 && out_va;
+  if (ok) {
+    DspBurstDev dev;
+    dev.ready   = (volatile uint32_t *)((char *)flag_va + flag_off);
+    dev.done    = (volatile uint32_t *)((char *)flag_va + done_off);
+    dev.in      = (const Float16 *)in_va;
+    dev.out     = (Float16 *)out_va;
+    dev.gamma   = gamma;
+    dev.epsilon = eps;
+    dev.length  = length;
+    heteroedge::run_persistent_burst(b, dev);
+    memcpy(result, out_va, (size_t)length * 2);
+  }
+  if (out_va)  HAP_mmap_put((int)out_fd);
+  if (in_va)   HAP_mmap_put((int)in_fd);
+  if (flag_va) HAP_mmap_put((int)flag_fd);
+  return ok;
+}
+#endif  // __hexagon__
+
+template <typename DType>
+int persistent_rmsnorm_fp16_impl(DType &out, const DType &data_in, const DType &gamma,
+                                 const Tensor &burst, const Tensor &epsilon,
+                                 const Tensor &flag_ion_fd, const Tensor &flag_offset,
+                                 const Tensor &done_offset, const Tensor &in_ion_fd,
+                                 const Tensor &out_ion_fd) {
+  auto [b, h, w, d] = data_in.dims();
+  const size_t data_bytes = (size_t)b * h * w * d * 2;
+  out.set_dims(data_in);
+
+#ifdef __hexagon__
+  if (run_burst_on_dsp(burst, epsilon(0, 0, 0, 0), &gamma.get_raw(0, 0, 0, 0), (int)d,
+                       read_u32_param(flag_ion_fd), read_u32_param(flag_offset),
+                       read_u32_param(done_offset), read_u32_param(in_ion_fd),
+                       read_u32_param(out_ion_fd), out.raw_data()))
+    return GraphStatus::Success;
+#endif  // __hexagon__
+
+  // No DSP mapping: a burst can't run, fail rather than publish nothing
+  if (requested_steps(burst) > 0) return GraphStatus::ErrorFatal;
+  memcpy(out.raw_data(), data_in.raw_data_const(), data_bytes);
+  return GraphStatus::Success;
+}
+
+// Generic fallback (ARM host for graph compilation; never runs on DSP at inference)
+template <typename Ttype>
+int persistent_rmsnorm_impl(Ttype &out, const Ttype &data_in, const Ttype &gamma,
+                            const Tensor &burst, const Tensor &epsilon,
+                            const Tensor &flag_ion_fd, const Tensor &flag_offset,
+                            const Tensor &done_offset, const Tensor &in_ion_fd,
+                            const Tensor &out_ion_fd) {
+  auto [b, h, w, d] = data_in.dims();
+  const size_t data_bytes = (size_t)b * h * w * d * 2;
+  out.set_dims(data_in);
+  if (requested_steps(burst) > 0) return GraphStatus::ErrorFatal;  // no shared-buffer access here
+  memcpy(out.raw_data(), data_in.raw_data_const(), data_bytes);
+  return GraphStatus::Success;
+}
+
+END_PKG_OP_DEFINITION(PKG_PersistentRmsNorm);
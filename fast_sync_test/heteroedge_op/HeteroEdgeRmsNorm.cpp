@@ -15,6 +15,7 @@
 #include "HTP/core/op_register_ext.h"
 #include "HTP/core/optimize.h"
 #include "HTP/core/simple_reg.h"
+#include "HeteroEdgeRmsNorm.h"
 
 BEGIN_PKG_OP_DEFINITION(PKG_RmsNorm);
 
@@ -82,8 +83,8 @@ DEF_PACKAGE_OPTIMIZATION(QNN,
 //   4. Output: y[i] = x[i] * gamma[i] * scale
 //=============================================================================
 
-static void rmsnorm_hvx_row(Float16 *pout, const Float16 *pin, const Float16 *pgamma,
-                             float epsilon, int length) {
+void rmsnorm_hvx_row(Float16 *pout, const Float16 *pin, const Float16 *pgamma,
+                     float epsilon, int length) {
   union {
     float f;
     int32_t i;
@@ -0,0 +1,13 @@
+//=============================================================================
+//  HeteroEdge HTP Op Package - shared HVX RMSNorm row kernel
+//
+//  Defined in HeteroEdgeRmsNorm.cpp; also used by PersistentRmsNorm, which
+//  runs it directly on HAP_mmap_get() views of the shared ION buffers.
+//=============================================================================
+#pragma once
+
+#include "HTP/core/simple_reg.h"
+
+// y[i] = x[i] * rsqrt(sum(x^2)/length + epsilon) * gamma[i], one row of FP16
+void rmsnorm_hvx_row(Float16 *pout, const Float16 *pin, const Float16 *pgamma,
+                     float epsilon, int length);
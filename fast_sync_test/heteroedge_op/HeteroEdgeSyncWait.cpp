@@ -2,16 +2,30 @@
 //  HeteroEdge HTP Op Package - SyncWait implementation
 //
 //  DSP-side execution:
-//  1. Get DSP VA for the flag ION buffer via HAP_mmap_get(ion_fd)
-//  2. Poll the DSP VA directly (bypasses QNN TCM DMA copy)
+//  1. Get DSP VA for the flag table ION buffer via HAP_mmap_get(ion_fd)
+//  2. Poll the flag at flag_offset directly (bypasses QNN TCM DMA copy)
+//     until it reaches the target epoch
 //  3. Invalidate DSP data cache for input data buffer
 //  4. Memcpy input data → output (establishes tensor dependency for RmsNorm)
 //
+//  Epoch protocol: the GPU kernel stores a monotonically increasing epoch into
+//  its flag and never resets it. The "flag" input tensor carries the epoch
+//  this execution waits for; the host writes it before graphExecute, so the
+//  QNN DMA copy of it is exactly the value we want. Target 0 is the legacy
+//  protocol: wait for any non-zero flag value (flag preset / written as 1).
+//
 //  Static parameter "flag_ion_fd" (UINT32 scalar):
-//    The file descriptor of the flag ION buffer (rpcmem_to_fd result).
+//    The file descriptor of the flag table ION buffer (rpcmem_to_fd result).
 //    When > 0: HAP_mmap_get(fd) is used to get the DSP VA for direct DDR polling.
-//    When 0:   fallback to QNN tensor pointer (TCM DMA copy — will timeout
-//              if CPU/GPU writes after graphExecute starts).
+//    When 0 (or the mapping fails) there is no live view of the flag. Under
+//    the epoch protocol the flag tensor holds the target, not the flag, so
+//    the op fails (GraphStatus::ErrorFatal, graphExecute returns an error)
+//    rather than run RmsNorm on data the GPU may not have finished. Target 0
+//    (legacy) polls the QNN copy of the flag, which only passes if it was
+//    set before graphExecute.
+//  A poll that times out also fails the op.
+//  Static parameter "flag_offset" (UINT32 scalar, optional, default 0):
+//    Byte offset of the flag inside the flag table (one cache line per flag).
 //=============================================================================
 
 #include <cstring>
@@ -30,19 +44,21 @@
 
 BEGIN_PKG_OP_DEFINITION(PKG_SyncWait);
 
-// Static parameter: ION file descriptor of the flag buffer.
-// Passed as a UINT32 scalar Qnn_Param_t named "flag_ion_fd".
-// On DSP: HAP_mmap_get(fd) → DSP VA for direct DDR polling.
-DEF_PACKAGE_PARAM_ORDER("SyncWait", "flag_ion_fd", false, nullptr)
+// Static parameters: ION file descriptor of the flag table and byte offset of
+// the flag inside it. Passed as UINT32 scalar Qnn_Param_t's named
+// "flag_ion_fd" and "flag_offset".
+// On DSP: HAP_mmap_get(fd) + offset → DSP VA for direct DDR polling.
+DEF_PACKAGE_PARAM_ORDER("SyncWait", "flag_ion_fd", false, nullptr,
+                        "flag_offset", false, nullptr)
 
 // Forward declarations
 template <typename Ttype>
 int syncwait_impl(Ttype &out, const Ttype &data_in, const Ttype &flag_in,
-                  const Tensor &flag_ion_fd);
+                  const Tensor &flag_ion_fd, const Tensor &flag_offset);
 
 template <typename DType>
 int syncwait_fp16_impl(DType &out, const DType &data_in, const Tensor &flag_in,
-                       const Tensor &flag_ion_fd);
+                       const Tensor &flag_ion_fd, const Tensor &flag_offset);
 
 // Generic fallback (used during graph compilation on ARM host)
 DEF_PACKAGE_OP((syncwait_impl<Tensor>), "SyncWait")
@@ -64,23 +80,45 @@ DEF_TENSOR_PROPERTIES(Op("SyncWait", "data", "flag"), Flat("*", "data"))
 // SyncWait implementation
 //
 // Input 0 (data):      FP16 tensor {1,1,1,hidden_dim} — GPU's output data
-// Input 1 (flag):      UINT32 tensor {1,1,1,1}         — GPU done flag (QNN copy)
-// Param  0 (flag_ion_fd): UINT32 scalar — ION fd for the flag buffer
+// Input 1 (flag):      UINT32 tensor {1,1,1,1}         — target epoch (QNN copy)
+// Param  0 (flag_ion_fd): UINT32 scalar — ION fd for the flag table
+// Param  1 (flag_offset): UINT32 scalar — byte offset of the flag in the table
 // Output 0 (out):      FP16 tensor same dims as data    — copy of data input
 //=============================================================================
 
-// HVX-optimized variant: DType = PlainFloat16Tensor or PlainFloat16Tensor_TCM
-template <typename DType>
-int syncwait_fp16_impl(DType &out, const DType &data_in, const Tensor &flag_in,
-                       const Tensor &flag_ion_fd) {
-  auto [b, h, w, d] = data_in.dims();
-  const size_t data_bytes = (size_t)b * h * w * d * 2;  // FP16 = 2 bytes/element
-
 #ifdef __hexagon__
-  // Read ION fd from static param (raw bytes to avoid float conversion)
-  uint32_t ion_fd = 0;
-  if (flag_ion_fd.raw_data_const())
-    memcpy(&ion_fd, flag_ion_fd.raw_data_const(), sizeof(uint32_t));
+// Read a UINT32 scalar param (raw bytes to avoid float conversion).
+// An absent optional param reads as 0.
+static uint32_t read_u32_param(const Tensor &param) {
+  uint32_t v = 0;
+  if (param.raw_data_const())
+    memcpy(&v, param.raw_data_const(), sizeof(uint32_t));
+  return v;
+}
+
+// Wrap-safe "observed >= target"; target 0 = legacy "any non-zero value"
+static inline bool flag_reached(uint32_t observed, uint32_t target) {
+  if (target == 0) return observed != 0;
+  return (int32_t)(observed - target) >= 0;
+}
+
+// Bounded spin until *pflag reaches target; false on timeout
+static bool poll_flag(volatile uint32_t *pflag, uint32_t target) {
+  const int kTimeout = 10000000;
+  int timeout = kTimeout;
+  while (timeout-- > 0) {
+    asm volatile("dcinva(%0)" : : "r"(pflag));
+    asm volatile("" ::: "memory");
+    if (flag_reached(*pflag, target)) return true;
+  }
+  return false;
+}
+
+// Wait until the GPU flag reaches the target epoch carried by flag_in.
+// False if there is no flag to poll or the poll timed out.
+static bool wait_flag_epoch(const Tensor &flag_in, uint32_t ion_fd, uint32_t offset) {
+  volatile uint32_t *pcopy = (volatile uint32_t *)flag_in.raw_data_const();
+  const uint32_t target = *pcopy;
 
   if (ion_fd > 0) {
     // ---- Path A: Direct DDR polling via HAP_mmap_get ----
@@ -96,39 +134,33 @@ int syncwait_fp16_impl(DType &out, const DType &data_in, const Tensor &flag_in,
     uint64 paddr = 0;
     int ret = HAP_mmap_get((int)ion_fd, &vaddr, &paddr);
     if (ret == 0 && vaddr != nullptr) {
-      volatile uint32_t *pflag = (volatile uint32_t *)vaddr;
-      const int kTimeout = 10000000;
-      int timeout = kTimeout;
-      while (timeout-- > 0) {
-        asm volatile("dcinva(%0)" : : "r"(pflag));
-        asm volatile("" ::: "memory");
-        if (*pflag == 1) break;
-      }
+      bool reached = poll_flag((volatile uint32_t *)((char *)vaddr + offset), target);
       HAP_mmap_put((int)ion_fd);  // release reference count
-    } else {
-      // HAP_mmap_get failed: fallback to TCM copy
-      volatile uint32_t *pflag = (volatile uint32_t *)flag_in.raw_data_const();
-      const int kTimeout = 10000000;
-      int timeout = kTimeout;
-      while (timeout-- > 0) {
-        asm volatile("dcinva(%0)" : : "r"(pflag));
-        asm volatile("" ::: "memory");
-        if (*pflag == 1) break;
-      }
-    }
-  } else {
-    // ---- Path B: Fallback to QNN tensor pointer (TCM DMA copy) ----
-    // Only works if flag was already 1 before graphExecute (pre-set).
-    volatile uint32_t *pflag = (volatile uint32_t *)flag_in.raw_data_const();
-    const int kTimeout = 10000000;
-    int timeout = kTimeout;
-    while (timeout-- > 0) {
-      asm volatile("dcinva(%0)" : : "r"(pflag));
-      asm volatile("" ::: "memory");
-      if (*pflag == 1) break;
+      return reached;
     }
+    // HAP_mmap_get failed: no live view of the flag
   }
 
+  // ---- Path B: QNN tensor pointer (TCM DMA copy) ----
+  // An epoch target is not a flag: polling it would compare the target with
+  // itself and pass at once, so fail instead.
+  if (target != 0) return false;
+  // Legacy: the copy is the flag value as of graphExecute
+  return poll_flag(pcopy, target);
+}
+#endif  // __hexagon__
+
+// HVX-optimized variant: DType = PlainFloat16Tensor or PlainFloat16Tensor_TCM
+template <typename DType>
+int syncwait_fp16_impl(DType &out, const DType &data_in, const Tensor &flag_in,
+                       const Tensor &flag_ion_fd, const Tensor &flag_offset) {
+  auto [b, h, w, d] = data_in.dims();
+  const size_t data_bytes = (size_t)b * h * w * d * 2;  // FP16 = 2 bytes/element
+
+#ifdef __hexagon__
+  if (!wait_flag_epoch(flag_in, read_u32_param(flag_ion_fd), read_u32_param(flag_offset)))
+    return GraphStatus::ErrorFatal;
+
   // Invalidate DSP cache for data buffer
   const char *dptr = (const char *)data_in.raw_data_const();
   for (size_t off = 0; off < data_bytes; off += 32) {
@@ -146,49 +178,13 @@ int syncwait_fp16_impl(DType &out, const DType &data_in, const Tensor &flag_in,
 // Generic fallback (ARM host for graph compilation; never runs on DSP at inference)
 template <typename Ttype>
 int syncwait_impl(Ttype &out, const Ttype &data_in, const Ttype &flag_in,
-                  const Tensor &flag_ion_fd) {
+                  const Tensor &flag_ion_fd, const Tensor &flag_offset) {
   auto [b, h, w, d] = data_in.dims();
   const size_t data_bytes = (size_t)b * h * w * d * 2;
 
 #ifdef __hexagon__
-  uint32_t ion_fd = 0;
-  if (flag_ion_fd.raw_data_const())
-    memcpy(&ion_fd, flag_ion_fd.raw_data_const(), sizeof(uint32_t));
-
-  if (ion_fd > 0) {
-    void *vaddr = nullptr;
-    uint64 paddr = 0;
-    int ret = HAP_mmap_get((int)ion_fd, &vaddr, &paddr);
-    if (ret == 0 && vaddr != nullptr) {
-      volatile uint32_t *pflag = (volatile uint32_t *)vaddr;
-      const int kTimeout = 10000000;
-      int timeout = kTimeout;
-      while (timeout-- > 0) {
-        asm volatile("dcinva(%0)" : : "r"(pflag));
-        asm volatile("" ::: "memory");
-        if (*pflag == 1) break;
-      }
-      HAP_mmap_put((int)ion_fd);
-    } else {
-      volatile uint32_t *pflag = (volatile uint32_t *)flag_in.raw_data_const();
-      const int kTimeout = 10000000;
-      int timeout = kTimeout;
-      while (timeout-- > 0) {
-        asm volatile("dcinva(%0)" : : "r"(pflag));
-        asm volatile("" ::: "memory");
-        if (*pflag == 1) break;
-      }
-    }
-  } else {
-    volatile uint32_t *pflag = (volatile uint32_t *)flag_in.raw_data_const();
-    const int kTimeout = 10000000;
-    int timeout = kTimeout;
-    while (timeout-- > 0) {
-      asm volatile("dcinva(%0)" : : "r"(pflag));
-      asm volatile("" ::: "memory");
-      if (*pflag == 1) break;
-    }
-  }
+  if (!wait_flag_epoch(flag_in, read_u32_param(flag_ion_fd), read_u32_param(flag_offset)))
+    return GraphStatus::ErrorFatal;
 
   const char *dptr = (const char *)data_in.raw_data_const();
   for (size_t off = 0; off < data_bytes; off += 32) {
@@ -5,7 +5,7 @@ export QNN_SDK_ROOT="${QNN_SDK_ROOT:-/home/yinrun/software/qualcomm/qairt/2.42.0
 export HEXAGON_SDK_ROOT="${HEXAGON_SDK_ROOT:-/local/mnt/workspace/Qualcomm/Hexagon_SDK/6.5.0.0}"
 export ANDROID_NDK_ROOT="${ANDROID_NDK_ROOT:-/home/yinrun/Android/Sdk/android-ndk-r25c}"
 
-echo "=== Building HeteroEdge HTP Op Package (SyncWait + RmsNorm) ==="
+echo "=== Building HeteroEdge HTP Op Package (SyncWait + RmsNorm + PersistentRmsNorm) ==="
 echo "QNN_SDK_ROOT:     ${QNN_SDK_ROOT}"
 echo "HEXAGON_SDK_ROOT: ${HEXAGON_SDK_ROOT}"
 echo "ANDROID_NDK_ROOT: ${ANDROID_NDK_ROOT}"
@@ -0,0 +1,66 @@
+//=============================================================================
+//  HeteroEdge HTP Op Package - persistent burst protocol
+//
+//  One graphExecute of PersistentRmsNorm runs a burst of N steps on the DSP:
+//
+//    for i in 0 .. N-1:
+//      wait until the producer flag reaches wait_epoch + i   (per-step doorbell)
+//      RmsNorm(input) → output                                (shared ION buffers)
+//      publish done_epoch + i into the NPU completion flag
+//
+//  Both flags are epoch words in the GPU epoch flag table (monotonic, never
+//  reset, wrap-safe compare), so the producer (GPU kernel, CPU engine) keeps
+//  its usual flag contract and waits on the NPU flag exactly like the NPU
+//  waits on it.
+//
+//  The burst descriptor is the op's UINT32 "burst" input tensor {1,1,1,3}.
+//  The host writes it before graphExecute; QNN's DMA copy of it is exactly
+//  the value wanted (same trick as SyncWait's wait epoch).
+//
+//  Header-only, no HTP dependencies: the DSP op and the host reference
+//  (fast_sync_test/src/persistent_ref.h) run the same loop with different
+//  device hooks, so the protocol can be exercised on a Linux host.
+//=============================================================================
+#pragma once
+
+#include <cstdint>
+
+namespace heteroedge {
+
+struct PersistentBurst {
+  uint32_t wait_epoch;  // producer epoch step 0 waits for (step i: wait_epoch + i)
+  uint32_t steps;       // N
+  uint32_t done_epoch;  // epoch step 0 publishes (step i: done_epoch + i)
+};
+static constexpr uint32_t kBurstWords = 3;
+
+// Wrap-safe "observed >= target"
+inline bool burst_epoch_reached(uint32_t observed, uint32_t target) {
+  return (int32_t)(observed - target) >= 0;
+}
+
+// Steps of a finished burst that published, from the NPU completion flag's
+// value afterwards (the host's view: a failed or timed-out op publishes less)
+inline uint32_t burst_steps_done(const PersistentBurst &burst, uint32_t done_flag) {
+  if (!burst_epoch_reached(done_flag, burst.done_epoch)) return 0;
+  uint32_t n = done_flag - burst.done_epoch + 1;
+  return n < burst.steps ? n : burst.steps;
+}
+
+// Run one burst. Dev provides:
+//   bool wait(uint32_t target)   block until the producer flag reaches target;
+//                                false on timeout (the burst ends early)
+//   void step()                  one RmsNorm on the shared buffers
+//   void publish(uint32_t epoch) make the output visible, then store the epoch
+// Returns the number of steps completed (< steps only after a timeout).
+template <typename Dev>
+uint32_t run_persistent_burst(const PersistentBurst &burst, Dev &dev) {
+  for (uint32_t i = 0; i < burst.steps; ++i) {
+    if (!dev.wait(burst.wait_epoch + i)) return i;
+    dev.step();
+    dev.publish(burst.done_epoch + i);
+  }
+  return burst.steps;
+}
+
+}  // namespace heteroedge
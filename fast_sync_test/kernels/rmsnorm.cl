@@ -4,17 +4,23 @@
 // Each work-item handles hidden_dim / local_size elements.
 // Uses float accumulation for numerical stability even in FP16 mode.
 //
-// Compile with -DUSE_FP16 for half precision.
+// Compile with -DUSE_FP16 for half precision, or -DUSE_HALF_STORAGE for FP16
+// buffers on devices without cl_khr_fp16 (e.g. an OpenCL CPU device): data is
+// loaded / stored with vload_half / vstore_half, which are core OpenCL.
 
-#ifdef USE_FP16
+#if defined(USE_FP16)
 #pragma OPENCL EXTENSION cl_khr_fp16 : enable
 typedef half  scalar_t;
-#define TO_FLOAT(x)  convert_float(x)
-#define TO_SCALAR(x) convert_half(x)
+#define LOAD(p, i)     convert_float((p)[i])
+#define STORE(p, i, v) ((p)[i] = convert_half(v))
+#elif defined(USE_HALF_STORAGE)
+typedef half  scalar_t;
+#define LOAD(p, i)     vload_half((i), (p))
+#define STORE(p, i, v) vstore_half((v), (i), (p))
 #else
 typedef float scalar_t;
-#define TO_FLOAT(x)  (x)
-#define TO_SCALAR(x) (x)
+#define LOAD(p, i)     ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
 #endif
 
 __kernel void rmsnorm(
@@ -24,7 +30,9 @@ __kernel void rmsnorm(
     const int hidden_dim,
     const float epsilon,
     __local float* sdata,                // local memory for reduction
-    __global volatile uint*  done_flag)  // completion flag (NULL = skip)
+    __global volatile uint*  done_flag,  // epoch flag table (NULL = skip)
+    const uint flag_word,                // flag index in uints (slot * 16: one cache line per flag)
+    const uint epoch)                    // value published on completion (monotonic, never reset)
 {
   int row = get_group_id(0);    // which batch element
   int lid = get_local_id(0);
@@ -36,7 +44,7 @@ __kernel void rmsnorm(
   // Phase 1: Partial sum of squares (float accumulation)
   float partial = 0.0f;
   for (int i = lid; i < hidden_dim; i += lsz) {
-    float val = TO_FLOAT(x[i]);
+    float val = LOAD(x, i);
     partial += val * val;
   }
   sdata[lid] = partial;
@@ -54,15 +62,106 @@ __kernel void rmsnorm(
 
   // Phase 4: Normalize and scale by gamma
   for (int i = lid; i < hidden_dim; i += lsz) {
-    float val = TO_FLOAT(x[i]);
-    float g   = TO_FLOAT(gamma[i]);
-    y[i] = TO_SCALAR(val * rms_inv * g);
+    float val = LOAD(x, i);
+    float g   = LOAD(gamma, i);
+    STORE(y, i, val * rms_inv * g);
   }
 
-  // Phase 5: Write completion flag (for fast sync — CPU polls this)
+  // Phase 5: Publish completion epoch (for fast sync — CPU/DSP wait for >= epoch)
   if (done_flag) {
     barrier(CLK_GLOBAL_MEM_FENCE);  // ensure all output writes are committed
     if (lid == 0)
-      *done_flag = 1u;
+      done_flag[flag_word] = epoch;
+  }
+}
+
+// Persistent RMSNorm: one launch serves many steps (GpuEngine::start_persistent).
+//
+// Work-item 0 polls a doorbell in the shared flag table; the host posts step
+// N by storing N there (a plain store, no clEnqueue / clFlush). For each
+// posted step the work-group runs the same RMSNorm as above and publishes
+// epoch_base + N into the completion flag. Control words, one cache line
+// (ctrl + ctrl_word):
+//   [0] doorbell: last step posted   (host)
+//   [1] stop request                 (host)
+//   [2] consumed: last step finished (kernel)
+//   [3] exited: idle timeout hit     (kernel; the host relaunches on its next post)
+// After max_idle_polls empty polls the kernel exits so an idle host never
+// trips the GPU watchdog: it sets exited, re-reads the doorbell once (Dekker
+// with the host's post-then-check) and finishes whatever was posted meanwhile.
+// A relaunch sits behind this instance on the in-order queue and resumes from
+// consumed.
+// All control-word reads are atomics so they go to memory, not a stale cache.
+__kernel void rmsnorm_persistent(
+    __global scalar_t*       output,
+    __global const scalar_t* input,
+    __global const scalar_t* gamma,
+    const int hidden_dim,
+    const float epsilon,
+    __local float* sdata,
+    __global volatile uint*  table,      // epoch flag table (flag + control lines)
+    const uint flag_word,                // completion flag index in uints
+    const uint ctrl_word,                // control line index in uints
+    const uint epoch_base,               // flag value = epoch_base + step
+    const uint max_idle_polls)
+{
+  int lid = get_local_id(0);
+  int lsz = get_local_size(0);
+  __global volatile uint* ctrl = table + ctrl_word;
+  __local uint posted;
+  __local int  quit;
+
+  uint seq = atomic_add(&ctrl[2], 0);  // resume after the previous instance
+  for (;;) {
+    // Wait for a step (work-item 0), broadcast through local memory
+    if (lid == 0) {
+      uint db = atomic_add(&ctrl[0], 0);
+      uint idle = 0;
+      int  stop = 0;
+      while (db == seq) {
+        if ((stop = atomic_add(&ctrl[1], 0)) != 0) break;
+        if (++idle == max_idle_polls) {
+          atomic_xchg(&ctrl[3], 1u);
+          mem_fence(CLK_GLOBAL_MEM_FENCE);
+          db = atomic_add(&ctrl[0], 0);
+          stop = 1;  // exit once the steps posted meanwhile are done
+          break;
+        }
+        db = atomic_add(&ctrl[0], 0);
+      }
+      posted = db;
+      quit = stop;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    uint target = posted;
+    int  done   = quit;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Run every step posted so far, in order
+    for (; seq != target; ++seq) {
+      float partial = 0.0f;
+      for (int i = lid; i < hidden_dim; i += lsz) {
+        float val = LOAD(input, i);
+        partial += val * val;
+      }
+      sdata[lid] = partial;
+      barrier(CLK_LOCAL_MEM_FENCE);
+      for (int s = lsz >> 1; s > 0; s >>= 1) {
+        if (lid < s)
+          sdata[lid] += sdata[lid + s];
+        barrier(CLK_LOCAL_MEM_FENCE);
+      }
+      float rms_inv = rsqrt(sdata[0] / (float)hidden_dim + epsilon);
+      for (int i = lid; i < hidden_dim; i += lsz)
+        STORE(output, i, LOAD(input, i) * rms_inv * LOAD(gamma, i));
+
+      barrier(CLK_GLOBAL_MEM_FENCE);  // all output writes committed
+      if (lid == 0) {
+        atomic_xchg(&ctrl[2], seq + 1);
+        atomic_xchg(&table[flag_word], epoch_base + seq + 1);
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);  // sdata reused by the next step
+    }
+    if (done) return;
   }
 }
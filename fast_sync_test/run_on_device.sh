@@ -9,6 +9,7 @@ HTP_DIR="${DEVICE_DIR}/htp"
 adb shell "mkdir -p ${DEVICE_DIR}/kernels ${LIB_DIR} ${HTP_DIR}"
 
 adb push build/android/fast_sync_test "${DEVICE_DIR}/"
+adb push build/android/test_persistent_burst "${DEVICE_DIR}/"
 adb push kernels/rmsnorm.cl "${DEVICE_DIR}/kernels/"
 
 # QNN runtime libraries
@@ -25,7 +26,7 @@ adb push "${QNN_SDK_ROOT}/lib/hexagon-v81/unsigned/libCalculator_skel.so" "${HTP
 adb push "${QNN_SDK_ROOT}/lib/hexagon-v81/unsigned/libQnnSystem.so" "${HTP_DIR}/"
 adb push "${QNN_SDK_ROOT}/lib/hexagon-v81/unsigned/libQnnSaver.so" "${HTP_DIR}/"
 
-# Combined HeteroEdge op package (SyncWait + RmsNorm, for --mode parallel)
+# Combined HeteroEdge op package (SyncWait + RmsNorm + PersistentRmsNorm, for --mode parallel)
 HETEROEDGE_DIR="heteroedge_op/build"
 if [ -d "${HETEROEDGE_DIR}" ]; then
   adb push "${HETEROEDGE_DIR}/aarch64-android/libQnnHtpHeteroEdgeOpPackage.so" "${DEVICE_DIR}/"
@@ -44,7 +45,7 @@ if [ -d "${RMSNORM_DIR}" ]; then
   adb push "${RMSNORM_DIR}/hexagon-v81/libQnnHtpRmsNormOpPackage.so" "${HTP_DIR}/"
 fi
 
-adb shell "chmod 755 ${DEVICE_DIR}/fast_sync_test"
+adb shell "chmod 755 ${DEVICE_DIR}/fast_sync_test ${DEVICE_DIR}/test_persistent_burst"
 
 adb shell "cd ${DEVICE_DIR} && \
   export LD_LIBRARY_PATH=${LIB_DIR}:/vendor/lib64:\$LD_LIBRARY_PATH && \
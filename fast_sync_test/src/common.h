@@ -1,15 +1,22 @@
 #pragma once
 #include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <atomic>
 #include <chrono>
+#include <climits>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <numeric>
 #include <string>
 #include <vector>
 
+#include "wait_strategy.h"
+
 // ── Sync mode ────────────────────────────────────────────────────────────────
 enum class SyncMode {
   SEQUENTIAL_BLOCKING,   // clFinish + blocking graphExecute, main thread
@@ -17,7 +24,11 @@ enum class SyncMode {
   EVENT_POLL,            // clFlush + cl_event poll for GPU (driver-level, not paper's approach)
   FAST_SYNC,             // clFlush + shared memory flag poll (paper Section 4.3)
   FAST_SYNC_DIRECT,      // NPU thread directly polls flag, main thread freed
-  PARALLEL_SYNC          // GPU+NPU parallel launch; DSP polls GPU flag via SyncWait custom op
+  PARALLEL_SYNC,         // GPU+NPU parallel launch; DSP polls GPU flag via SyncWait custom op
+  ASYNC_NPU,             // shared memory flag poll + graphExecuteAsync, no NPU thread
+  PIPELINED,             // Fast Sync Direct with K steps in flight over a ring of buffer slots
+  LAYERED,               // L-layer stack per step, per-layer GPU / NPU placement
+  CUSTOM                 // any valid GpuSync × NpuLaunch combination (PipelineConfig)
 };
 
 inline const char* sync_mode_name(SyncMode m) {
@@ -28,17 +39,89 @@ inline const char* sync_mode_name(SyncMode m) {
     case SyncMode::FAST_SYNC:           return "Fast Sync";
     case SyncMode::FAST_SYNC_DIRECT:    return "Fast Sync Direct";
     case SyncMode::PARALLEL_SYNC:       return "Parallel Sync";
+    case SyncMode::ASYNC_NPU:           return "Async NPU";
+    case SyncMode::PIPELINED:           return "Pipelined";
+    case SyncMode::LAYERED:             return "Layered";
+    case SyncMode::CUSTOM:              return "Custom";
   }
   return "Unknown";
 }
 
+// ── Sync policies ────────────────────────────────────────────────────────────
+// The single-stream modes are points in GpuSync × NpuLaunch; the executor
+// (pipeline.cpp, policies in sync_policy.h) is instantiated per combination.
+
+// How the host learns the GPU step finished
+enum class GpuSync {
+  FINISH,           // clFinish (blocking)
+  EVENT_POLL,       // clFlush + clGetEventInfo poll
+  EVENT_CALLBACK,   // clFlush + clSetEventCallback(CL_COMPLETE) bumps a host word
+  FLAG,             // clFlush + shared-memory epoch flag poll
+  PERSISTENT,       // resident kernel: shared-memory doorbell store, epoch flag poll
+  CPU               // stage 1 runs on the host CPU engine instead, epoch flag poll
+};
+
+// How the NPU step is launched once (or before) the GPU is done
+enum class NpuLaunch {
+  INLINE,           // graphExecute on the main thread
+  WORKER,           // main waits GPU, then hands the step to the NPU thread
+  DIRECT,           // NPU thread waits GPU itself, then graphExecute
+  SYNC_WAIT,        // NPU thread launches immediately; DSP SyncWait op waits the GPU flag
+  ASYNC,            // main waits GPU, then graphExecuteAsync; QNN notify callback completes
+  PERSISTENT        // NPU thread runs one persistent-graph burst per --burst steps; the DSP
+                    // waits the GPU flag per step and publishes the NPU done flag
+};
+
+inline const char* gpu_sync_name(GpuSync g) {
+  switch (g) {
+    case GpuSync::FINISH:         return "finish";
+    case GpuSync::EVENT_POLL:     return "event";
+    case GpuSync::EVENT_CALLBACK: return "callback";
+    case GpuSync::FLAG:           return "flag";
+    case GpuSync::PERSISTENT:     return "persistent";
+    case GpuSync::CPU:            return "cpu";
+  }
+  return "unknown";
+}
+
+inline const char* npu_launch_name(NpuLaunch l) {
+  switch (l) {
+    case NpuLaunch::INLINE:     return "inline";
+    case NpuLaunch::WORKER:     return "worker";
+    case NpuLaunch::DIRECT:     return "direct";
+    case NpuLaunch::SYNC_WAIT:  return "syncwait";
+    case NpuLaunch::ASYNC:      return "async";
+    case NpuLaunch::PERSISTENT: return "persistent";
+  }
+  return "unknown";
+}
+
+// The (GpuSync, NpuLaunch) pair a fixed single-stream mode stands for.
+// Returns false for modes that are not a plain combination (PIPELINED, LAYERED, CUSTOM).
+inline bool sync_mode_policies(SyncMode m, GpuSync& g, NpuLaunch& l) {
+  switch (m) {
+    case SyncMode::SEQUENTIAL_BLOCKING: g = GpuSync::FINISH;     l = NpuLaunch::INLINE;    return true;
+    case SyncMode::THREADED_CLFINISH:   g = GpuSync::FINISH;     l = NpuLaunch::WORKER;    return true;
+    case SyncMode::EVENT_POLL:          g = GpuSync::EVENT_POLL; l = NpuLaunch::WORKER;    return true;
+    case SyncMode::FAST_SYNC:           g = GpuSync::FLAG;       l = NpuLaunch::WORKER;    return true;
+    case SyncMode::FAST_SYNC_DIRECT:    g = GpuSync::FLAG;       l = NpuLaunch::DIRECT;    return true;
+    case SyncMode::PARALLEL_SYNC:       g = GpuSync::FLAG;       l = NpuLaunch::SYNC_WAIT; return true;
+    case SyncMode::ASYNC_NPU:           g = GpuSync::FLAG;       l = NpuLaunch::ASYNC;     return true;
+    case SyncMode::PIPELINED:
+    case SyncMode::LAYERED:
+    case SyncMode::CUSTOM:              return false;
+  }
+  return false;
+}
+
 // ── Per-step timing ──────────────────────────────────────────────────────────
 struct StepTiming {
   double gpu_compute_us;   // GPU kernel execution (from profiling)
   double gpu_sync_us;      // GPU sync overhead (clFinish or event poll)
   double npu_compute_us;   // NPU graphExecute time
   double npu_sync_us;      // NPU completion wait time
-  double step_total_us;    // end-to-end one step
+  double step_total_us;    // end-to-end one step (pipelined: completion interval)
+  double step_latency_us;  // pipelined only: GPU submit → NPU done of the same step
 };
 
 // ── Statistics ───────────────────────────────────────────────────────────────
@@ -58,12 +141,35 @@ inline Stats compute_stats(std::vector<double>& data) {
   return s;
 }
 
+// ── Predictive wait counters (predictive_wait.h) ────────────────────────────
+struct PredictStats {
+  const char* name  = "";
+  int    waits      = 0;  // completed waits
+  int    sleeps     = 0;  // waits that slept before spinning
+  int    late       = 0;  // sleeps that woke up after the completion
+  double slept_us   = 0;  // total time asleep
+  double spun_us    = 0;  // total time spinning (after the wake-up, or the whole wait)
+  double predict_us = 0;  // final predicted duration (EWMA mean)
+};
+
 // ── Pipeline result ──────────────────────────────────────────────────────────
 struct PipelineResult {
   std::vector<StepTiming> steps;
   double total_us       = 0;
   double avg_step_us    = 0;
+  double cpu_us         = 0;  // process CPU time (all threads) over the measured steps
+  double setup_ms       = 0;  // buffer allocation + engine init + slot setup
+  int    ion_buffers    = 0;  // ION allocations made for the pipeline's tensors
+  std::vector<PredictStats> predict;  // one entry per predictive waiter (--predict)
   int    num_steps      = 0;
+  // LAYERED only
+  int    layers         = 0;  // layers per step (token)
+  int    gpu_layers     = 0;  // of which on the GPU
+  int    boundaries     = 0;  // GPU <-> NPU switches per step, around the ring
+  double gpu_layer_us   = 0;  // per-layer cost on the GPU with no boundary (0: no GPU layer)
+  double npu_layer_us   = 0;  // per-layer cost on the NPU with no boundary (0: no NPU layer)
+  // NpuLaunch::PERSISTENT only
+  int    npu_bursts     = 0;  // graphExecute calls (each ran up to burst_steps steps)
   bool   success        = false;
   std::string error;
 };
@@ -74,10 +180,20 @@ struct PipelineConfig {
   float epsilon     = 1e-6f;
   int num_warmup    = 10;
   int num_steps     = 100;
-  int usleep_hint   = 0;  // microseconds, for fast sync NPU wait (0 = pure spin)
+  bool predict_wait = false;  // sleep until just before the predicted completion, then spin
   SyncMode mode     = SyncMode::SEQUENTIAL_BLOCKING;
   int main_core     = -1; // CPU core affinity for main thread (-1 = no pinning)
   int npu_core      = -1; // CPU core affinity for NPU worker thread (-1 = no pinning)
+  int cpu_threads   = 0;  // GpuSync::CPU: CPU engine workers (0 = half the online CPUs)
+  int cpu_core      = -1; // GpuSync::CPU: first core of the CPU engine workers (-1 = no pinning)
+  int pipeline_depth = 2; // PIPELINED: steps in flight (= number of buffer slots)
+  int burst_steps   = 16; // NpuLaunch::PERSISTENT: steps per graphExecute
+  int num_layers    = 32; // LAYERED: layers per step
+  std::string placement = "GN";  // LAYERED: device per layer, G / N, repeated over the layers
+  WaitKind wait     = WaitKind::SPIN;  // how every flag / handoff wait is done
+  bool arena        = false; // carve the pipeline's tensors from one ION allocation (ion_arena.h)
+  GpuSync gpu_sync     = GpuSync::FLAG;      // CUSTOM only
+  NpuLaunch npu_launch = NpuLaunch::DIRECT;  // CUSTOM; PIPELINED: ASYNC drops the NPU thread
 };
 
 // ── Timing ───────────────────────────────────────────────────────────────────
@@ -89,13 +205,38 @@ inline double now_seconds() {
 
 inline double now_us() { return now_seconds() * 1e6; }
 
+// CPU time consumed by the whole process (all threads), in us
+inline double now_cpu_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
 // ── ION buffer ───────────────────────────────────────────────────────────────
 struct IonBuffer {
   void*  ptr  = nullptr;
   int    fd   = -1;
   size_t size = 0;
+  bool   host = false;  // memfd-backed host memory, not rpcmem (fd is a memfd)
+  // Arena view (ion_arena.h): ptr/size are the tensor, `offset` its position
+  // in the fd's allocation of `alloc_size` bytes. 0 / 0 for a whole buffer.
+  size_t offset     = 0;
+  size_t alloc_size = 0;
 };
 
+inline bool ionIsView(const IonBuffer& b) { return b.alloc_size != 0; }
+
+// The whole allocation behind a view (the buffer itself otherwise)
+inline IonBuffer ionParent(const IonBuffer& b) {
+  if (!ionIsView(b)) return b;
+  IonBuffer p = b;
+  p.ptr  = static_cast<uint8_t*>(b.ptr) - b.offset;
+  p.size = b.alloc_size;
+  p.offset = 0;
+  p.alloc_size = 0;
+  return p;
+}
+
 // ── rpcmem helpers ───────────────────────────────────────────────────────────
 struct RpcMemApi {
   void* libHandle = nullptr;
@@ -127,13 +268,47 @@ inline RpcMemApi& getRpcMemApi() {
 
 constexpr int RPCMEM_HEAP_ID_SYSTEM = 25;
 
-inline bool allocIonBuffer(size_t size, uint8_t fillValue, IonBuffer& out) {
+// Host backend: force memfd buffers even when rpcmem is available (--sim)
+inline bool& ionUseMemfd() {
+  static bool memfd = false;
+  return memfd;
+}
+
+// memfd_create + MAP_SHARED: page-aligned, shareable through the fd like an
+// ION buffer, but nothing outside this process can import it (host = true)
+inline bool allocMemfdBuffer(size_t size, IonBuffer& out) {
+  int fd = static_cast<int>(syscall(SYS_memfd_create, "ion_host", MFD_CLOEXEC));
+  if (fd < 0) return false;
+  size_t mapped = (size + 4095) & ~size_t(4095);
+  if (ftruncate(fd, static_cast<off_t>(mapped)) != 0) { close(fd); return false; }
+  void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) { close(fd); return false; }
+  out.ptr  = p;
+  out.fd   = fd;
+  out.size = size;
+  out.host = true;
+  return true;
+}
+
+// Without libcdsprpc (plain Linux host) or with ionUseMemfd() set, buffers are
+// memfd-backed host memory: the CPU engine, the simulated devices and the
+// OpenCL CPU-device fallback can use them, the real NPU (memRegister) cannot.
+inline bool ionBackendHost() {
   auto& rpc = getRpcMemApi();
-  if (!rpc.alloc || !rpc.toFd) return false;
+  return ionUseMemfd() || !rpc.alloc || !rpc.toFd;
+}
+
+// Raw allocation behind the pool (ion_pool.h), contents undefined
+inline bool ionBackendAlloc(size_t size, IonBuffer& out) {
+  if (ionBackendHost()) return allocMemfdBuffer(size, out);
+  auto& rpc = getRpcMemApi();
+  if (size > static_cast<size_t>(INT_MAX)) {  // rpcmem_alloc takes an int size
+    printf("[ION] %zu bytes exceeds the 2 GB rpcmem limit; split it into segments\n", size);
+    return false;
+  }
   out.ptr = rpc.alloc(RPCMEM_HEAP_ID_SYSTEM, 0, static_cast<int>(size));
   if (!out.ptr) return false;
   out.size = size;
-  std::memset(out.ptr, fillValue, size);
   out.fd = rpc.toFd(out.ptr);
   if (out.fd < 0) {
     rpc.freeMem(out.ptr);
@@ -143,16 +318,83 @@ inline bool allocIonBuffer(size_t size, uint8_t fillValue, IonBuffer& out) {
   return true;
 }
 
-inline void freeIonBuffer(IonBuffer& buf) {
-  if (buf.ptr) {
+inline void ionBackendFree(IonBuffer& buf) {
+  if (buf.host) {
+    munmap(buf.ptr, (buf.size + 4095) & ~size_t(4095));
+    close(buf.fd);
+  } else {
     auto& rpc = getRpcMemApi();
     if (rpc.freeMem) rpc.freeMem(buf.ptr);
-    buf.ptr = nullptr;
-    buf.fd  = -1;
-    buf.size = 0;
   }
 }
 
+// ── Buffer pool ──────────────────────────────────────────────────────────────
+// allocIonBuffer / freeIonBuffer go through a size-classed pool over the
+// backend above: a released buffer keeps its fd and mapping for the next
+// allocation of a similar size (ion_pool.h). provisionIonBuffer() picks the
+// fill policy (none / parallel value / pattern, ion_fill.h); allocIonBuffer()
+// is a parallel value fill.
+#include "ion_pool.h"
+#include "ion_fill.h"
+
+inline bool allocIonBuffer(size_t size, uint8_t fillValue, IonBuffer& out) {
+  return provisionIonBuffer(size, IonFillSpec::value_of(fillValue), out);
+}
+
+// Views are owned by their arena: only forgotten here
+inline void freeIonBuffer(IonBuffer& buf) {
+  if (ionIsView(buf)) {
+    buf = IonBuffer{};
+    return;
+  }
+  ionPool().release(buf);
+}
+
+// ── Epoch flag table ─────────────────────────────────────────────────────────
+// Completion flags live in one shared ION page, one cache line per flag so
+// producers writing different flags never contend for the same line. A
+// producer publishes step N by storing epoch N (epochs start at 1 and only
+// grow); a consumer waits until the flag reaches the epoch it expects. There
+// is no reset write before submit, so a late observer can never mistake a
+// reset for "not done yet" or miss a completion, and several streams / steps
+// in flight can share one page by using different flag indices.
+constexpr size_t kFlagStrideBytes = 64;                              // one cache line
+constexpr int    kFlagTableSlots  = 64;
+constexpr size_t kFlagTableBytes  = kFlagStrideBytes * kFlagTableSlots;  // 4 KB page
+
+// Wrap-safe "observed >= target" (serial number arithmetic): correct as long
+// as producer and consumer are less than 2^31 (2^63) epochs apart.
+inline bool epoch_reached(uint32_t observed, uint32_t target) {
+  return static_cast<int32_t>(observed - target) >= 0;
+}
+inline bool epoch_reached(uint64_t observed, uint64_t target) {
+  return static_cast<int64_t>(observed - target) >= 0;
+}
+
+inline size_t flag_offset_bytes(int index) { return index * kFlagStrideBytes; }
+
+// Typed view over a flag table page. EpochT is uint32_t for flags written by
+// the GPU kernel / DSP, uint64_t for host-side producers that never wrap.
+template <typename EpochT>
+struct EpochFlagTable {
+  static_assert(sizeof(EpochT) == 4 || sizeof(EpochT) == 8, "32/64-bit epochs only");
+
+  uint8_t* base = nullptr;
+
+  EpochFlagTable() = default;
+  explicit EpochFlagTable(const IonBuffer& page) : base(static_cast<uint8_t*>(page.ptr)) {}
+
+  volatile EpochT* flag(int index) const {
+    return reinterpret_cast<volatile EpochT*>(base + flag_offset_bytes(index));
+  }
+  EpochT load(int index) const { return *flag(index); }
+  bool reached(int index, EpochT target) const { return epoch_reached(load(index), target); }
+  void publish(int index, EpochT epoch) const {
+    std::atomic_thread_fence(std::memory_order_release);
+    *flag(index) = epoch;
+  }
+};
+
 // ── FP16 conversion ─────────────────────────────────────────────────────────
 inline uint16_t float_to_half(float f) {
   uint32_t x;
@@ -0,0 +1,210 @@
+#include "cpu_engine.h"
+#include "cpu_kernels.h"
+
+#include <cmath>
+#include <cstdio>
+#include <sched.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t kChunkAlign = 32;  // elements: one 64 B line of FP16 per chunk edge
+
+CpuEngine g_engine;  // process-default instance (cpu_* wrappers)
+
+void pin_to_core(int core_id) {
+  if (core_id < 0) return;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(core_id, &mask);
+  sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+// Worker id's share [lo, hi) of n elements, cache-line aligned
+void chunk_range(size_t n, int id, int nthreads, size_t& lo, size_t& hi) {
+  size_t per = (n + nthreads - 1) / nthreads;
+  per = (per + kChunkAlign - 1) / kChunkAlign * kChunkAlign;
+  lo = std::min(n, (size_t)id * per);
+  hi = std::min(n, lo + per);
+}
+
+}  // namespace
+
+// ── CpuEngine ───────────────────────────────────────────────────────────────
+
+void CpuEngine::print_info() const {
+  if (workers_.empty()) return;
+  if (firstCore_ >= 0)
+    printf("  CPU: %d worker(s) on cores %d-%d, %s FP16\n", num_threads(), firstCore_,
+           firstCore_ + num_threads() - 1, cpuk::simd_name());
+  else
+    printf("  CPU: %d worker(s), unpinned, %s FP16\n", num_threads(), cpuk::simd_name());
+}
+
+bool CpuEngine::init(int hidden_dim, float epsilon,
+                     const IonBuffer& ion_input, const IonBuffer& ion_output,
+                     int num_threads, int first_core) {
+  if (!ion_input.ptr || !ion_output.ptr) { printf("[CPU] null buffer\n"); return false; }
+  hidden_  = hidden_dim;
+  epsilon_ = epsilon;
+  input_   = static_cast<const uint16_t*>(ion_input.ptr);
+  output_  = static_cast<uint16_t*>(ion_output.ptr);
+  gamma_.assign(hidden_dim, float_to_half(1.0f));
+
+  if (num_threads <= 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = std::max(1L, online / 2);
+  }
+  numThreads_ = num_threads;
+  firstCore_  = first_core;
+  seq_ = 0; epoch_ = 0;
+  submitted_.store(0, std::memory_order_relaxed);
+  done_.store(0, std::memory_order_relaxed);
+  partials_.assign(num_threads, Partial{});
+  barrier_.reset(new SenseBarrier<SpinWait>(num_threads));
+
+  for (int i = 0; i < num_threads; ++i) {
+    int core = first_core >= 0 ? first_core + i : -1;
+    workers_.emplace_back([this, i, core] { worker_loop(i, core); });
+  }
+  return true;
+}
+
+bool CpuEngine::enable_flag(const IonBuffer& ion_flag_table, int flag_index) {
+  if (!ion_flag_table.ptr || ion_flag_table.size < kFlagTableBytes) {
+    printf("[CPU] flag table too small\n");
+    return false;
+  }
+  EpochFlagTable<uint32_t> table(ion_flag_table);
+  flagPtr_ = table.flag(flag_index);
+  // Keep handing out epochs past whatever this flag already holds
+  epoch_ = std::max(epoch_, table.load(flag_index));
+  return true;
+}
+
+void CpuEngine::disable_flag() {
+  flagPtr_ = nullptr;
+}
+
+uint32_t CpuEngine::enqueue(Op op, const uint16_t* a, const uint16_t* b, uint16_t* out, size_t n) {
+  const uint32_t seq = ++seq_;
+  // Job slot reuse: job seq - kQueueDepth must be done
+  SpinYieldWait::wait(done_, [seq](uint32_t d) { return seq - d <= kQueueDepth; });
+
+  Job& job = jobs_[seq % kQueueDepth];
+  job.op    = op;
+  job.a     = a;
+  job.b     = b;
+  job.out   = out;
+  job.n     = n;
+  job.epoch = op == Op::STOP ? 0 : ++epoch_;
+  job.flag  = flagPtr_;
+  job.remaining.store(num_threads(), std::memory_order_relaxed);
+
+  submitted_.store(seq, std::memory_order_release);
+  SpinFutexWait::notify(submitted_);
+  return job.epoch;
+}
+
+uint32_t CpuEngine::submit() {
+  return enqueue(Op::RMSNORM, input_, gamma_.data(), output_, hidden_);
+}
+
+uint32_t CpuEngine::submit_add(const IonBuffer& a, const IonBuffer& b, const IonBuffer& c) {
+  size_t bytes = std::min({a.size, b.size, c.size});
+  return enqueue(Op::ADD, static_cast<const uint16_t*>(a.ptr), static_cast<const uint16_t*>(b.ptr),
+                 static_cast<uint16_t*>(c.ptr), bytes / sizeof(uint16_t));
+}
+
+void CpuEngine::wait_idle() {
+  const uint32_t seq = seq_;
+  SpinYieldWait::wait(done_, [seq](uint32_t d) { return d == seq; });
+}
+
+double CpuEngine::execute_blocking() {
+  double t0 = now_us();
+  submit();
+  wait_idle();
+  return now_us() - t0;
+}
+
+void CpuEngine::worker_loop(int id, int core) {
+  pin_to_core(core);
+  const int nthreads = numThreads_;
+  for (uint32_t seq = 1;; ++seq) {
+    // Idle workers spin briefly, then sleep until the next submit
+    SpinFutexWait::wait(submitted_, [seq](uint32_t s) { return epoch_reached(s, seq); });
+    Job& job = jobs_[seq % kQueueDepth];
+    if (job.op == Op::STOP) return;
+
+    size_t lo, hi;
+    chunk_range(job.n, id, nthreads, lo, hi);
+    switch (job.op) {
+      case Op::RMSNORM: {
+        const int parity = seq & 1;
+        partials_[id].sumsq[parity] = cpuk::sumsq_f16(job.a + lo, hi - lo);
+        barrier_->arrive_and_wait();
+        float total = 0;
+        for (const Partial& p : partials_) total += p.sumsq[parity];
+        float s = 1.0f / std::sqrt(total / (float)job.n + epsilon_);
+        cpuk::scale_f16(job.out + lo, job.a + lo, job.b + lo, s, hi - lo);
+        break;
+      }
+      case Op::ADD:
+        cpuk::add_f16(job.out + lo, job.a + lo, job.b + lo, hi - lo);
+        break;
+      case Op::STOP:
+        break;
+    }
+    finish_job(job, seq);
+  }
+}
+
+// The last worker out publishes. Jobs complete in order: if the last worker
+// of job s-1 has not published yet, wait for it (a few instructions away) so
+// the flag never moves backwards.
+void CpuEngine::finish_job(Job& job, uint32_t seq) {
+  if (job.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+  SpinWait::wait(done_, [seq](uint32_t d) { return d == seq - 1; });
+  if (job.flag) {
+    std::atomic_thread_fence(std::memory_order_release);
+    *job.flag = job.epoch;
+  }
+  done_.store(seq, std::memory_order_release);
+}
+
+void CpuEngine::cleanup() {
+  if (!workers_.empty()) {
+    enqueue(Op::STOP, nullptr, nullptr, nullptr, 0);
+    for (auto& t : workers_) t.join();
+    workers_.clear();
+  }
+  barrier_.reset();
+  partials_.clear();
+  gamma_.clear();
+  input_ = nullptr; output_ = nullptr;
+  flagPtr_ = nullptr; epoch_ = 0; seq_ = 0;
+  submitted_.store(0, std::memory_order_relaxed);
+  done_.store(0, std::memory_order_relaxed);
+  numThreads_ = 0;
+  firstCore_  = -1;
+}
+
+// ── Process-default instance ────────────────────────────────────────────────
+
+CpuEngine& cpu_default_engine() { return g_engine; }
+
+bool cpu_init(int hidden_dim, float epsilon,
+              const IonBuffer& ion_input, const IonBuffer& ion_output,
+              int num_threads, int first_core) {
+  return g_engine.init(hidden_dim, epsilon, ion_input, ion_output, num_threads, first_core);
+}
+bool cpu_enable_flag(const IonBuffer& ion_flag_table, int flag_index) {
+  return g_engine.enable_flag(ion_flag_table, flag_index);
+}
+void cpu_disable_flag()               { g_engine.disable_flag(); }
+volatile uint32_t* cpu_get_flag_ptr() { return g_engine.flag_ptr(); }
+uint32_t cpu_submit()                 { return g_engine.submit(); }
+double cpu_execute_blocking()         { return g_engine.execute_blocking(); }
+void cpu_print_info()                 { g_engine.print_info(); }
+void cpu_cleanup()                    { g_engine.cleanup(); }
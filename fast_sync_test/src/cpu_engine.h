@@ -0,0 +1,119 @@
+#pragma once
+#include "common.h"
+#include "engine.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Host-CPU engine: a pool of worker threads running SIMD FP16 kernels
+// (cpu_kernels.h) on the same shared buffers as the GPU / NPU, with the GPU
+// engine's submit / flag contract:
+//   submit() enqueues one step and returns its epoch; the step is done once
+//   epoch_reached(*flag_ptr(), epoch). The last worker to finish a step
+//   publishes the epoch into the epoch flag table, so any consumer that waits
+//   on a GPU flag (host thread, DSP SyncWait) can wait on a CPU step instead.
+//
+// Steps run in submission order, up to kQueueDepth in flight; every worker
+// takes a contiguous chunk of every step. RMSNorm reduces per-worker partial
+// sums of squares across one barrier.
+//
+// submit() / execute_blocking() must be called from one thread.
+class CpuEngine : public Engine {
+public:
+  static constexpr uint32_t kQueueDepth = 64;
+
+  enum class Op : uint32_t { RMSNORM, ADD, STOP };
+
+  CpuEngine() = default;
+  ~CpuEngine() override { cleanup(); }
+
+  // RMSNorm input → output (FP16, batch=1). num_threads workers (0 = half the
+  // online CPUs); worker i is pinned to first_core + i (first_core < 0: no pinning).
+  bool init(int hidden_dim, float epsilon,
+            const IonBuffer& ion_input, const IonBuffer& ion_output,
+            int num_threads = 0, int first_core = -1);
+
+  // Publish completions into flag `flag_index` of an epoch flag table
+  // (>= kFlagTableBytes). Without a flag only wait_idle() / execute_blocking()
+  // observe completion.
+  bool enable_flag(const IonBuffer& ion_flag_table, int flag_index = 0);
+  void disable_flag();
+  volatile uint32_t* flag_ptr() const { return flagPtr_; }
+
+  // Enqueue RMSNorm on the init() buffers. Returns the epoch it publishes.
+  uint32_t submit();
+
+  // Enqueue c = a + b over min(a, b, c) bytes of FP16. Returns the epoch.
+  uint32_t submit_add(const IonBuffer& a, const IonBuffer& b, const IonBuffer& c);
+
+  // Block until every submitted step has finished
+  void wait_idle();
+
+  // submit() + wait. Returns wall-clock time in us.
+  double execute_blocking() override;
+
+  int num_threads() const { return numThreads_; }
+
+  const char* name() const override { return "cpu"; }
+  void print_info() const override;
+  void cleanup() override;
+
+private:
+  struct alignas(64) Job {
+    Op              op  = Op::STOP;
+    const uint16_t* a   = nullptr;
+    const uint16_t* b   = nullptr;  // ADD: second operand; RMSNORM: gamma
+    uint16_t*       out = nullptr;
+    size_t          n   = 0;        // elements
+    uint32_t        epoch = 0;      // published into flag when done
+    volatile uint32_t* flag = nullptr;
+    std::atomic<int> remaining{0};  // workers still running this job
+  };
+
+  // Per-worker RMSNorm partial sum, double-buffered by job parity: a fast
+  // worker can start job s+1 while a slow one still reads the sums of job s,
+  // but cannot reach s+2 before the slow one has passed the barrier of s+1.
+  struct alignas(64) Partial { float sumsq[2]; };
+
+  uint32_t enqueue(Op op, const uint16_t* a, const uint16_t* b, uint16_t* out, size_t n);
+  void worker_loop(int id, int core);
+  void finish_job(Job& job, uint32_t seq);
+
+  int   hidden_  = 0;
+  float epsilon_ = 1e-6f;
+  const uint16_t* input_  = nullptr;
+  uint16_t*       output_ = nullptr;
+  std::vector<uint16_t> gamma_;
+
+  volatile uint32_t* flagPtr_ = nullptr;
+  uint32_t epoch_ = 0;  // last flag epoch handed out (submitting thread)
+  uint32_t seq_   = 0;  // jobs enqueued (submitting thread)
+
+  // Jobs are numbered 1, 2, ... (seq); job s lives in jobs_[s % kQueueDepth]
+  Job jobs_[kQueueDepth];
+  alignas(64) std::atomic<uint32_t> submitted_{0};  // last seq enqueued
+  alignas(64) std::atomic<uint32_t> done_{0};       // last seq finished (in order)
+  std::vector<Partial> partials_;
+  std::unique_ptr<SenseBarrier<SpinWait>> barrier_;
+  std::vector<std::thread> workers_;
+  int numThreads_ = 0;  // fixed before the workers start
+  int firstCore_ = -1;
+};
+
+// ── Process-default instance ────────────────────────────────────────────────
+// Thin wrappers over one CpuEngine (the CPU stage of the single-op pipeline).
+
+CpuEngine& cpu_default_engine();
+
+bool cpu_init(int hidden_dim, float epsilon,
+              const IonBuffer& ion_input, const IonBuffer& ion_output,
+              int num_threads = 0, int first_core = -1);
+bool cpu_enable_flag(const IonBuffer& ion_flag_table, int flag_index = 0);
+void cpu_disable_flag();
+volatile uint32_t* cpu_get_flag_ptr();
+uint32_t cpu_submit();
+double cpu_execute_blocking();
+void cpu_print_info();
+void cpu_cleanup();
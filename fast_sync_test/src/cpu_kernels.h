@@ -0,0 +1,259 @@
+#pragma once
+// SIMD host-CPU kernels on FP16 / uint8 buffers (CPU engine, CPU bandwidth streams).
+//
+// aarch64: NEON (FP16 <-> FP32 with vcvt_f32_f16 / vcvt_f16_f32, base ARMv8).
+// x86-64:  AVX2 + F16C when the CPU has them (runtime check, no build flags
+//          needed), SSE2 / scalar otherwise.
+// Math is done in FP32 like the GPU kernel (kernels/rmsnorm.cl).
+//
+// All functions work on [0, n) and are safe to call from several threads on
+// disjoint ranges.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace cpuk {
+
+// ── Scalar FP16 <-> FP32 (tails and the portable fallback) ──────────────────
+inline float half_to_float(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp  = (h >> 10) & 0x1F;
+  uint32_t mant = h & 0x3FF;
+  uint32_t x;
+  if (exp == 0) {
+    if (mant == 0) {
+      x = sign;
+    } else {  // subnormal: normalize
+      exp = 127 - 15 + 1;
+      while (!(mant & 0x400)) { mant <<= 1; --exp; }
+      x = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+    }
+  } else if (exp == 31) {
+    x = sign | 0x7F800000 | (mant << 13);
+  } else {
+    x = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+  }
+  float f;
+  memcpy(&f, &x, 4);
+  return f;
+}
+
+inline uint16_t float_to_half(float f) {  // round to nearest even
+  uint32_t x;
+  memcpy(&x, &f, 4);
+  uint16_t sign = (x >> 16) & 0x8000;
+  int exp = (int)((x >> 23) & 0xFF) - 127 + 15;
+  uint32_t mant = x & 0x7FFFFF;
+  if (((x >> 23) & 0xFF) == 0xFF) return sign | 0x7C00 | (mant ? 0x200 : 0);
+  if (exp >= 31) return sign | 0x7C00;
+  if (exp <= 0) {
+    if (exp < -10) return sign;
+    mant |= 0x800000;
+    uint32_t shift = 14 - exp;
+    uint32_t h = mant >> shift;
+    uint32_t rem = mant & ((1u << shift) - 1), half = 1u << (shift - 1);
+    if (rem > half || (rem == half && (h & 1))) ++h;
+    return sign | h;
+  }
+  uint32_t h = ((uint32_t)exp << 10) | (mant >> 13);
+  uint32_t rem = mant & 0x1FFF;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) ++h;  // may carry into exp: still correct
+  return sign | h;
+}
+
+namespace detail {
+
+inline float sumsq_scalar(const uint16_t* x, size_t i, size_t n) {
+  float s = 0;
+  for (; i < n; ++i) { float v = half_to_float(x[i]); s += v * v; }
+  return s;
+}
+inline void scale_scalar(uint16_t* y, const uint16_t* x, const uint16_t* g, float s, size_t i, size_t n) {
+  for (; i < n; ++i) y[i] = float_to_half(half_to_float(x[i]) * s * half_to_float(g[i]));
+}
+inline void add_f16_scalar(uint16_t* c, const uint16_t* a, const uint16_t* b, size_t i, size_t n) {
+  for (; i < n; ++i) c[i] = float_to_half(half_to_float(a[i]) + half_to_float(b[i]));
+}
+
+#if defined(__x86_64__)
+inline bool has_avx2_f16c() {
+  static const bool ok = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c") &&
+                         __builtin_cpu_supports("fma");
+  return ok;
+}
+
+__attribute__((target("avx2,f16c,fma")))
+inline float sumsq_avx2(const uint16_t* x, size_t n) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256 v0 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(x + i)));
+    __m256 v1 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(x + i + 8)));
+    acc0 = _mm256_fmadd_ps(v0, v0, acc0);
+    acc1 = _mm256_fmadd_ps(v1, v1, acc1);
+  }
+  __m256 acc = _mm256_add_ps(acc0, acc1);
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  s = _mm_hadd_ps(s, s);
+  s = _mm_hadd_ps(s, s);
+  return _mm_cvtss_f32(s) + sumsq_scalar(x, i, n);
+}
+
+__attribute__((target("avx2,f16c,fma")))
+inline void scale_avx2(uint16_t* y, const uint16_t* x, const uint16_t* g, float s, size_t n) {
+  __m256 vs = _mm256_set1_ps(s);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v  = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(x + i)));
+    __m256 vg = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(g + i)));
+    __m256 r  = _mm256_mul_ps(_mm256_mul_ps(v, vs), vg);
+    _mm_storeu_si128((__m128i*)(y + i), _mm256_cvtps_ph(r, _MM_FROUND_TO_NEAREST_INT));
+  }
+  scale_scalar(y, x, g, s, i, n);
+}
+
+__attribute__((target("avx2,f16c,fma")))
+inline void add_f16_avx2(uint16_t* c, const uint16_t* a, const uint16_t* b, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 va = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(a + i)));
+    __m256 vb = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(b + i)));
+    _mm_storeu_si128((__m128i*)(c + i),
+                     _mm256_cvtps_ph(_mm256_add_ps(va, vb), _MM_FROUND_TO_NEAREST_INT));
+  }
+  add_f16_scalar(c, a, b, i, n);
+}
+
+__attribute__((target("avx2")))
+inline void add_u8_avx2(uint8_t* c, const uint8_t* a, const uint8_t* b, size_t n) {
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i a1 = _mm256_loadu_si256((const __m256i*)(a + i + 32));
+    __m256i b0 = _mm256_loadu_si256((const __m256i*)(b + i));
+    __m256i b1 = _mm256_loadu_si256((const __m256i*)(b + i + 32));
+    _mm256_storeu_si256((__m256i*)(c + i),      _mm256_add_epi8(a0, b0));
+    _mm256_storeu_si256((__m256i*)(c + i + 32), _mm256_add_epi8(a1, b1));
+  }
+  for (; i < n; ++i) c[i] = (uint8_t)(a[i] + b[i]);
+}
+#endif
+
+}  // namespace detail
+
+// ── Kernels ─────────────────────────────────────────────────────────────────
+
+// SIMD path the kernels below take on this CPU
+inline const char* simd_name() {
+#if defined(__aarch64__)
+  return "NEON";
+#elif defined(__x86_64__)
+  return detail::has_avx2_f16c() ? "AVX2+F16C" : "SSE2/scalar";
+#else
+  return "scalar";
+#endif
+}
+
+// sum(x[i]^2), FP32 accumulation
+inline float sumsq_f16(const uint16_t* x, size_t n) {
+#if defined(__aarch64__)
+  float32x4_t acc0 = vdupq_n_f32(0), acc1 = vdupq_n_f32(0);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint16x8_t h = vld1q_u16(x + i);
+    float32x4_t v0 = vcvt_f32_f16(vreinterpret_f16_u16(vget_low_u16(h)));
+    float32x4_t v1 = vcvt_f32_f16(vreinterpret_f16_u16(vget_high_u16(h)));
+    acc0 = vfmaq_f32(acc0, v0, v0);
+    acc1 = vfmaq_f32(acc1, v1, v1);
+  }
+  return vaddvq_f32(vaddq_f32(acc0, acc1)) + detail::sumsq_scalar(x, i, n);
+#elif defined(__x86_64__)
+  if (detail::has_avx2_f16c()) return detail::sumsq_avx2(x, n);
+  return detail::sumsq_scalar(x, 0, n);
+#else
+  return detail::sumsq_scalar(x, 0, n);
+#endif
+}
+
+// y[i] = x[i] * s * g[i]   (RMSNorm second pass, s = 1 / rms)
+inline void scale_f16(uint16_t* y, const uint16_t* x, const uint16_t* g, float s, size_t n) {
+#if defined(__aarch64__)
+  float32x4_t vs = vdupq_n_f32(s);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t v  = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(x + i)));
+    float32x4_t vg = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(g + i)));
+    float32x4_t r  = vmulq_f32(vmulq_f32(v, vs), vg);
+    vst1_u16(y + i, vreinterpret_u16_f16(vcvt_f16_f32(r)));
+  }
+  detail::scale_scalar(y, x, g, s, i, n);
+#elif defined(__x86_64__)
+  if (detail::has_avx2_f16c()) detail::scale_avx2(y, x, g, s, n);
+  else                         detail::scale_scalar(y, x, g, s, 0, n);
+#else
+  detail::scale_scalar(y, x, g, s, 0, n);
+#endif
+}
+
+// Whole-row RMSNorm (single thread): y = x / sqrt(mean(x^2) + eps) * g
+inline void rmsnorm_f16(uint16_t* y, const uint16_t* x, const uint16_t* g, size_t n, float eps) {
+  float s = 1.0f / std::sqrt(sumsq_f16(x, n) / (float)n + eps);
+  scale_f16(y, x, g, s, n);
+}
+
+// c[i] = a[i] + b[i], FP16 in / out
+inline void add_f16(uint16_t* c, const uint16_t* a, const uint16_t* b, size_t n) {
+#if defined(__aarch64__)
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t va = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(a + i)));
+    float32x4_t vb = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(b + i)));
+    vst1_u16(c + i, vreinterpret_u16_f16(vcvt_f16_f32(vaddq_f32(va, vb))));
+  }
+  detail::add_f16_scalar(c, a, b, i, n);
+#elif defined(__x86_64__)
+  if (detail::has_avx2_f16c()) detail::add_f16_avx2(c, a, b, n);
+  else                         detail::add_f16_scalar(c, a, b, 0, n);
+#else
+  detail::add_f16_scalar(c, a, b, 0, n);
+#endif
+}
+
+// c[i] = a[i] + b[i], uint8 wrap-around (same op as the bandwidth kernels)
+inline void add_u8(uint8_t* c, const uint8_t* a, const uint8_t* b, size_t n) {
+#if defined(__aarch64__)
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    uint8x16x4_t va = vld1q_u8_x4(a + i);
+    uint8x16x4_t vb = vld1q_u8_x4(b + i);
+    uint8x16x4_t vc;
+    vc.val[0] = vaddq_u8(va.val[0], vb.val[0]);
+    vc.val[1] = vaddq_u8(va.val[1], vb.val[1]);
+    vc.val[2] = vaddq_u8(va.val[2], vb.val[2]);
+    vc.val[3] = vaddq_u8(va.val[3], vb.val[3]);
+    vst1q_u8_x4(c + i, vc);
+  }
+  for (; i < n; ++i) c[i] = (uint8_t)(a[i] + b[i]);
+#elif defined(__x86_64__)
+  if (__builtin_cpu_supports("avx2")) { detail::add_u8_avx2(c, a, b, n); return; }
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    _mm_storeu_si128((__m128i*)(c + i), _mm_add_epi8(va, vb));
+  }
+  for (; i < n; ++i) c[i] = (uint8_t)(a[i] + b[i]);
+#else
+  for (size_t i = 0; i < n; ++i) c[i] = (uint8_t)(a[i] + b[i]);
+#endif
+}
+
+}  // namespace cpuk
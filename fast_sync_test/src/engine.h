@@ -0,0 +1,29 @@
+#pragma once
+// Common interface of the compute engines (GpuEngine, NpuEngine).
+//
+// An engine owns everything it needs to run its op on one device — OpenCL
+// context, queue and kernels for the GPU, QNN context and graph for the NPU —
+// so any number of instances can live side by side and several queues /
+// graphs can be in flight at once. The gpu_* / npu_* free functions drive one
+// process-default instance of each (the single-op pipeline).
+//
+// Setup goes through the device-specific init(). An instance is not thread
+// safe: drive it from one thread at a time.
+
+class Engine {
+public:
+  Engine() = default;
+  virtual ~Engine() = default;
+  Engine(const Engine&) = delete;
+  Engine& operator=(const Engine&) = delete;
+
+  virtual const char* name() const = 0;
+
+  // One step on the engine's own buffers. Returns wall-clock time in us.
+  virtual double execute_blocking() = 0;
+
+  virtual void print_info() const = 0;
+
+  // Release all device resources. Safe to call more than once.
+  virtual void cleanup() = 0;
+};
@@ -1,6 +1,8 @@
 #define CL_TARGET_OPENCL_VERSION 200
 #include "gpu_engine.h"
+#include "sim_engine.h"
 #include <CL/cl.h>
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -30,20 +32,21 @@ typedef struct {
 
 namespace {
 
-cl_platform_id   g_platform = nullptr;
-cl_device_id     g_device   = nullptr;
-cl_context       g_context  = nullptr;
-cl_command_queue  g_queue    = nullptr;
-cl_program       g_program  = nullptr;
-cl_kernel        g_kernel   = nullptr;
-cl_mem           g_bufInput = nullptr;
-cl_mem           g_bufOutput= nullptr;
-cl_mem           g_bufGamma = nullptr;
-cl_mem           g_bufFlag  = nullptr;
-volatile uint32_t* g_flagPtr = nullptr;
-int              g_hidden   = 0;
-size_t           g_local    = 256;
-size_t           g_global   = 0;
+// Kernel args 6..8: flag table, flag word index, epoch
+constexpr cl_uint kArgFlag  = 6;
+constexpr cl_uint kArgWord  = 7;
+constexpr cl_uint kArgEpoch = 8;
+
+// rmsnorm_persistent args 6..10 and control line words (see rmsnorm.cl)
+constexpr cl_uint kArgPersistTable = 6;
+constexpr cl_uint kArgPersistFlag  = 7;
+constexpr cl_uint kArgPersistCtrl  = 8;
+constexpr cl_uint kArgPersistBase  = 9;
+constexpr cl_uint kArgPersistIdle  = 10;
+constexpr int kCtrlDoorbell = 0;  // host: last step posted
+constexpr int kCtrlStop     = 1;  // host: stop request
+constexpr int kCtrlConsumed = 2;  // kernel: last step finished
+constexpr int kCtrlExited   = 3;  // kernel: parked after the idle timeout
 
 char* read_file(const char* path, size_t* out_size) {
   FILE* f = fopen(path, "r");
@@ -59,17 +62,66 @@ char* read_file(const char* path, size_t* out_size) {
   return buf;
 }
 
-cl_mem import_ion_buffer(const IonBuffer& ion, cl_mem_flags flags) {
-  cl_mem_ion_host_ptr ion_mem = {};
-  ion_mem.ext_host_ptr.allocation_type   = CL_MEM_ION_HOST_PTR_QCOM;
-  ion_mem.ext_host_ptr.host_cache_policy = CL_MEM_HOST_UNCACHED_QCOM;
-  ion_mem.ion_filedesc = ion.fd;
-  ion_mem.ion_hostptr  = ion.ptr;
+bool has_extension(cl_device_id dev, const char* ext) {
+  size_t sz = 0;
+  if (clGetDeviceInfo(dev, CL_DEVICE_EXTENSIONS, 0, nullptr, &sz) != CL_SUCCESS) return false;
+  std::vector<char> exts(sz + 1, '\0');
+  clGetDeviceInfo(dev, CL_DEVICE_EXTENSIONS, sz, exts.data(), nullptr);
+  return strstr(exts.data(), ext) != nullptr;
+}
+
+// First device of `type` on any platform
+bool find_device(cl_device_type type, cl_platform_id* platform, cl_device_id* device) {
+  cl_uint n = 0;
+  if (clGetPlatformIDs(0, nullptr, &n) != CL_SUCCESS || n == 0) return false;
+  std::vector<cl_platform_id> platforms(n);
+  clGetPlatformIDs(n, platforms.data(), nullptr);
+  for (cl_platform_id p : platforms) {
+    if (clGetDeviceIDs(p, type, 1, device, nullptr) == CL_SUCCESS) {
+      *platform = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+GpuEngine g_engine;  // process-default instance (gpu_* wrappers)
+
+}  // namespace
 
+// ── GpuEngine ───────────────────────────────────────────────────────────────
+
+bool GpuEngine::select_device() {
+  if (find_device(CL_DEVICE_TYPE_GPU, &platform_, &device_)) {
+    cpuFallback_ = false;
+    return true;
+  }
+  if (find_device(CL_DEVICE_TYPE_CPU, &platform_, &device_)) {
+    printf("[GPU] No GPU device, falling back to OpenCL CPU device\n");
+    cpuFallback_ = true;
+    return true;
+  }
+  printf("[GPU] No OpenCL GPU or CPU device\n");
+  return false;
+}
+
+cl_mem GpuEngine::import_buffer(const IonBuffer& ion, cl_mem_flags flags) {
+  if (ionIsView(ion)) return import_view(ion, flags);
   cl_int err;
-  cl_mem buf = clCreateBuffer(g_context,
-      flags | CL_MEM_USE_HOST_PTR | CL_MEM_EXT_HOST_PTR_QCOM,
-      ion.size, &ion_mem, &err);
+  cl_mem buf;
+  if (ionImport_ && ion.fd >= 0 && !ion.host) {
+    cl_mem_ion_host_ptr ion_mem = {};
+    ion_mem.ext_host_ptr.allocation_type   = CL_MEM_ION_HOST_PTR_QCOM;
+    ion_mem.ext_host_ptr.host_cache_policy = CL_MEM_HOST_UNCACHED_QCOM;
+    ion_mem.ion_filedesc = ion.fd;
+    ion_mem.ion_hostptr  = ion.ptr;
+    buf = clCreateBuffer(context_,
+        flags | CL_MEM_USE_HOST_PTR | CL_MEM_EXT_HOST_PTR_QCOM,
+        ion.size, &ion_mem, &err);
+  } else {
+    // No ION import (CPU device / host memory): the device uses ion.ptr in place
+    buf = clCreateBuffer(context_, flags | CL_MEM_USE_HOST_PTR, ion.size, ion.ptr, &err);
+  }
   if (err != CL_SUCCESS) {
     printf("[GPU] ION import failed: %d\n", err);
     return nullptr;
@@ -77,166 +129,315 @@ cl_mem import_ion_buffer(const IonBuffer& ion, cl_mem_flags flags) {
   return buf;
 }
 
-}  // namespace
+// Sub-buffer of the (once-imported) allocation behind an arena view
+cl_mem GpuEngine::import_view(const IonBuffer& view, cl_mem_flags flags) {
+  if (view.offset % baseAlign_) {
+    printf("[GPU] view offset %zu not aligned to CL_DEVICE_MEM_BASE_ADDR_ALIGN (%zu B)\n",
+           view.offset, baseAlign_);
+    return nullptr;
+  }
+  const IonBuffer whole = ionParent(view);
+  cl_mem parent = nullptr;
+  for (const Parent& p : parents_)
+    if (p.fd == whole.fd && p.base == whole.ptr) parent = p.mem;
+  if (!parent) {
+    parent = import_buffer(whole, CL_MEM_READ_WRITE);
+    if (!parent) return nullptr;
+    parents_.push_back({whole.fd, whole.ptr, parent});
+  }
 
-void gpu_print_info() {
-  if (!g_device) return;
+  cl_int err;
+  cl_buffer_region region = {view.offset, view.size};
+  cl_mem buf = clCreateSubBuffer(parent, flags, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+  if (err != CL_SUCCESS) {
+    printf("[GPU] clCreateSubBuffer(offset=%zu) failed: %d\n", view.offset, err);
+    return nullptr;
+  }
+  return buf;
+}
+
+bool GpuEngine::bind_args(cl_kernel kernel, cl_mem output, cl_mem input) {
+  int hd = hidden_;
+  cl_mem null_mem = nullptr;
+  cl_uint zero = 0;
+  cl_int err = CL_SUCCESS;
+  err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &output);
+  err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &input);
+  err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &bufGamma_);
+  err |= clSetKernelArg(kernel, 3, sizeof(int), &hd);
+  err |= clSetKernelArg(kernel, 4, sizeof(float), &epsilon_);
+  err |= clSetKernelArg(kernel, 5, local_ * sizeof(float), nullptr);
+  // Arg 6: done_flag (NULL = disabled, kernel skips flag write)
+  err |= clSetKernelArg(kernel, kArgFlag,  sizeof(cl_mem), &null_mem);
+  err |= clSetKernelArg(kernel, kArgWord,  sizeof(cl_uint), &zero);
+  err |= clSetKernelArg(kernel, kArgEpoch, sizeof(cl_uint), &zero);
+  if (err != CL_SUCCESS) { printf("[GPU] clSetKernelArg failed\n"); return false; }
+  return true;
+}
+
+void GpuEngine::print_info() const {
+  if (!device_) return;
   char name[256];
-  clGetDeviceInfo(g_device, CL_DEVICE_NAME, sizeof(name), name, nullptr);
+  clGetDeviceInfo(device_, CL_DEVICE_NAME, sizeof(name), name, nullptr);
   cl_uint cu;
-  clGetDeviceInfo(g_device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cu), &cu, nullptr);
+  clGetDeviceInfo(device_, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cu), &cu, nullptr);
   cl_ulong mem;
-  clGetDeviceInfo(g_device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(mem), &mem, nullptr);
-  printf("  GPU: %s, %u CU, %.2f GB\n", name, cu, mem / (1024.0*1024.0*1024.0));
+  clGetDeviceInfo(device_, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(mem), &mem, nullptr);
+  printf("  GPU: %s, %u CU, %.2f GB%s\n", name, cu, mem / (1024.0*1024.0*1024.0),
+         cpuFallback_ ? " (OpenCL CPU fallback)" : "");
 }
 
-bool gpu_init(int hidden_dim, float epsilon,
-              const IonBuffer& ion_input, const IonBuffer& ion_output,
-              const char* kernel_path) {
+bool GpuEngine::init(int hidden_dim, float epsilon,
+                     const IonBuffer& ion_input, const IonBuffer& ion_output,
+                     const char* kernel_path) {
   cl_int err;
-  g_hidden = hidden_dim;
+  hidden_ = hidden_dim;
+  epsilon_ = epsilon;
 
   // Platform & device
-  err = clGetPlatformIDs(1, &g_platform, nullptr);
-  if (err != CL_SUCCESS) { printf("[GPU] clGetPlatformIDs: %d\n", err); return false; }
-  err = clGetDeviceIDs(g_platform, CL_DEVICE_TYPE_GPU, 1, &g_device, nullptr);
-  if (err != CL_SUCCESS) { printf("[GPU] clGetDeviceIDs: %d\n", err); return false; }
+  if (!select_device()) return false;
+  ionImport_ = has_extension(device_, "cl_qcom_ion_host_ptr");
+  cl_uint align_bits = 8;
+  clGetDeviceInfo(device_, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(align_bits), &align_bits, nullptr);
+  baseAlign_ = std::max<size_t>(align_bits / 8, 1);
 
   // Context
-  g_context = clCreateContext(nullptr, 1, &g_device, nullptr, nullptr, &err);
+  context_ = clCreateContext(nullptr, 1, &device_, nullptr, nullptr, &err);
   if (err != CL_SUCCESS) { printf("[GPU] clCreateContext: %d\n", err); return false; }
 
   // Queue with profiling enabled (to separate compute from sync)
   cl_queue_properties props[] = {CL_QUEUE_PROPERTIES, CL_QUEUE_PROFILING_ENABLE, 0};
-  g_queue = clCreateCommandQueueWithProperties(g_context, g_device, props, &err);
+  queue_ = clCreateCommandQueueWithProperties(context_, device_, props, &err);
   if (err != CL_SUCCESS) { printf("[GPU] clCreateCommandQueue: %d\n", err); return false; }
 
-  // Compile kernel
+  // Compile kernel: native half arithmetic where supported, otherwise FP16
+  // storage with float math (vload_half / vstore_half are core OpenCL)
   size_t src_size = 0;
   char* src = read_file(kernel_path, &src_size);
   if (!src) { printf("[GPU] Cannot read %s\n", kernel_path); return false; }
-  g_program = clCreateProgramWithSource(g_context, 1, (const char**)&src, &src_size, &err);
+  program_ = clCreateProgramWithSource(context_, 1, (const char**)&src, &src_size, &err);
   free(src);
   if (err != CL_SUCCESS) { printf("[GPU] clCreateProgramWithSource: %d\n", err); return false; }
 
-  err = clBuildProgram(g_program, 1, &g_device, "-DUSE_FP16", nullptr, nullptr);
+  const char* opts = has_extension(device_, "cl_khr_fp16") ? "-DUSE_FP16" : "-DUSE_HALF_STORAGE";
+  err = clBuildProgram(program_, 1, &device_, opts, nullptr, nullptr);
   if (err != CL_SUCCESS) {
     size_t log_sz;
-    clGetProgramBuildInfo(g_program, g_device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_sz);
+    clGetProgramBuildInfo(program_, device_, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_sz);
     char* log = (char*)malloc(log_sz);
-    clGetProgramBuildInfo(g_program, g_device, CL_PROGRAM_BUILD_LOG, log_sz, log, nullptr);
+    clGetProgramBuildInfo(program_, device_, CL_PROGRAM_BUILD_LOG, log_sz, log, nullptr);
     printf("[GPU] Build error:\n%s\n", log);
     free(log);
     return false;
   }
 
-  g_kernel = clCreateKernel(g_program, "rmsnorm", &err);
+  kernel_ = clCreateKernel(program_, "rmsnorm", &err);
   if (err != CL_SUCCESS) { printf("[GPU] clCreateKernel: %d\n", err); return false; }
 
   // Import ION buffers for zero-copy sharing with NPU
-  g_bufInput  = import_ion_buffer(ion_input,  CL_MEM_READ_ONLY);
-  g_bufOutput = import_ion_buffer(ion_output, CL_MEM_WRITE_ONLY);
-  if (!g_bufInput || !g_bufOutput) return false;
+  bufInput_  = import_buffer(ion_input,  CL_MEM_READ_ONLY);
+  bufOutput_ = import_buffer(ion_output, CL_MEM_WRITE_ONLY);
+  if (!bufInput_ || !bufOutput_) return false;
 
   // Gamma buffer (local to GPU, not shared)
   size_t gamma_bytes = (size_t)hidden_dim * 2;
-  g_bufGamma = clCreateBuffer(g_context, CL_MEM_READ_ONLY, gamma_bytes, nullptr, &err);
+  bufGamma_ = clCreateBuffer(context_, CL_MEM_READ_ONLY, gamma_bytes, nullptr, &err);
   if (err != CL_SUCCESS) { printf("[GPU] gamma buffer: %d\n", err); return false; }
   std::vector<uint16_t> host_gamma(hidden_dim, float_to_half(1.0f));
-  clEnqueueWriteBuffer(g_queue, g_bufGamma, CL_TRUE, 0, gamma_bytes, host_gamma.data(), 0, nullptr, nullptr);
+  clEnqueueWriteBuffer(queue_, bufGamma_, CL_TRUE, 0, gamma_bytes, host_gamma.data(), 0, nullptr, nullptr);
 
   // Work sizes: batch=1, one work-group
   size_t max_wg;
-  clGetDeviceInfo(g_device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_wg), &max_wg, nullptr);
-  g_local = 256;
-  if (g_local > max_wg) g_local = max_wg;
-  g_global = g_local;  // batch=1
-
-  // Set kernel args
-  int hd = hidden_dim;
-  clSetKernelArg(g_kernel, 0, sizeof(cl_mem), &g_bufOutput);
-  clSetKernelArg(g_kernel, 1, sizeof(cl_mem), &g_bufInput);
-  clSetKernelArg(g_kernel, 2, sizeof(cl_mem), &g_bufGamma);
-  clSetKernelArg(g_kernel, 3, sizeof(int), &hd);
-  clSetKernelArg(g_kernel, 4, sizeof(float), &epsilon);
-  clSetKernelArg(g_kernel, 5, g_local * sizeof(float), nullptr);
-  // Arg 6: done_flag (NULL = disabled, kernel skips flag write)
-  cl_mem null_mem = nullptr;
-  clSetKernelArg(g_kernel, 6, sizeof(cl_mem), &null_mem);
+  clGetDeviceInfo(device_, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_wg), &max_wg, nullptr);
+  local_ = 256;
+  while (local_ > max_wg) local_ >>= 1;  // tree reduction needs a power of two
+  global_ = local_;  // batch=1
 
-  return true;
+  epoch_ = 0;
+  return bind_args(kernel_, bufOutput_, bufInput_);
 }
 
-bool gpu_enable_flag(const IonBuffer& ion_flag) {
-  g_bufFlag = import_ion_buffer(ion_flag, CL_MEM_WRITE_ONLY);
-  if (!g_bufFlag) return false;
-  g_flagPtr = reinterpret_cast<volatile uint32_t*>(ion_flag.ptr);
-  clSetKernelArg(g_kernel, 6, sizeof(cl_mem), &g_bufFlag);
+bool GpuEngine::enable_flag(const IonBuffer& ion_flag_table, int flag_index) {
+  bufFlag_ = import_buffer(ion_flag_table, CL_MEM_WRITE_ONLY);
+  if (!bufFlag_) return false;
+  EpochFlagTable<uint32_t> table(ion_flag_table);
+  flagPtr_ = table.flag(flag_index);
+  // Keep handing out epochs past whatever this flag already holds
+  epoch_ = std::max(epoch_, table.load(flag_index));
+  flagWord_ = static_cast<cl_uint>(flag_offset_bytes(flag_index) / sizeof(uint32_t));
+  clSetKernelArg(kernel_, kArgFlag, sizeof(cl_mem), &bufFlag_);
+  clSetKernelArg(kernel_, kArgWord, sizeof(cl_uint), &flagWord_);
   return true;
 }
 
-void gpu_disable_flag() {
+void GpuEngine::disable_flag() {
   cl_mem null_mem = nullptr;
-  clSetKernelArg(g_kernel, 6, sizeof(cl_mem), &null_mem);
-  if (g_bufFlag) { clReleaseMemObject(g_bufFlag); g_bufFlag = nullptr; }
-  g_flagPtr = nullptr;
+  if (kernel_) clSetKernelArg(kernel_, kArgFlag, sizeof(cl_mem), &null_mem);
+  if (bufFlag_) { clReleaseMemObject(bufFlag_); bufFlag_ = nullptr; }
+  flagPtr_ = nullptr;
 }
 
-volatile uint32_t* gpu_get_flag_ptr() {
-  return g_flagPtr;
+uint32_t GpuEngine::submit() {
+  if (persistent()) {
+    // Step N publishes epoch_base + N: the epoch stays in lockstep with the doorbell
+    uint32_t epoch = ++epoch_;
+    std::atomic_thread_fence(std::memory_order_release);
+    ctrl_[kCtrlDoorbell] = ++posted_;
+    // Post, then check for a parked kernel. The kernel sets exited, then
+    // re-reads the doorbell: at least one side sees the other's store.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ctrl_[kCtrlExited]) {
+      ctrl_[kCtrlExited] = 0;
+      launch_persistent();  // queued behind the parking instance, resumes from consumed
+    }
+    return epoch;
+  }
+  // Epoch is a by-value kernel arg: captured at enqueue, no shared-memory write
+  uint32_t epoch = ++epoch_;
+  clSetKernelArg(kernel_, kArgEpoch, sizeof(cl_uint), &epoch);
+  clEnqueueNDRangeKernel(queue_, kernel_, 1, nullptr, &global_, &local_, 0, nullptr, nullptr);
+  clFlush(queue_);
+  return epoch;
 }
 
-void gpu_submit() {
-  if (g_flagPtr) *g_flagPtr = 0;  // reset flag before submission
-  clEnqueueNDRangeKernel(g_queue, g_kernel, 1, nullptr, &g_global, &g_local, 0, nullptr, nullptr);
-  clFlush(g_queue);
+int GpuEngine::add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output,
+                        const IonBuffer& ion_flag_table, int flag_index) {
+  cl_int err;
+  Slot slot;
+  slot.kernel = clCreateKernel(program_, "rmsnorm", &err);
+  if (err != CL_SUCCESS) { printf("[GPU] clCreateKernel(slot): %d\n", err); return -1; }
+  slot.input  = import_buffer(ion_input,      CL_MEM_READ_ONLY);
+  slot.output = import_buffer(ion_output,     CL_MEM_WRITE_ONLY);
+  slot.flag   = import_buffer(ion_flag_table, CL_MEM_WRITE_ONLY);
+  if (!slot.input || !slot.output || !slot.flag ||
+      !bind_args(slot.kernel, slot.output, slot.input)) {
+    if (slot.input)  clReleaseMemObject(slot.input);
+    if (slot.output) clReleaseMemObject(slot.output);
+    if (slot.flag)   clReleaseMemObject(slot.flag);
+    clReleaseKernel(slot.kernel);
+    return -1;
+  }
+  EpochFlagTable<uint32_t> table(ion_flag_table);
+  slot.flagPtr = table.flag(flag_index);
+  slot.epoch   = table.load(flag_index);
+
+  cl_uint word = static_cast<cl_uint>(flag_offset_bytes(flag_index) / sizeof(uint32_t));
+  clSetKernelArg(slot.kernel, kArgFlag, sizeof(cl_mem), &slot.flag);
+  clSetKernelArg(slot.kernel, kArgWord, sizeof(cl_uint), &word);
+
+  slots_.push_back(slot);
+  return static_cast<int>(slots_.size()) - 1;
 }
 
-double gpu_execute_blocking(double* gpu_compute_us) {
+bool GpuEngine::start_persistent(const IonBuffer& ion_flag_table, int ctrl_index,
+                                 uint32_t max_idle_polls) {
+  if (!flagPtr_) { printf("[GPU] persistent mode needs enable_flag()\n"); return false; }
+  if (persistent()) stop_persistent();
+  cl_int err;
+  persistKernel_ = clCreateKernel(program_, "rmsnorm_persistent", &err);
+  if (err != CL_SUCCESS) { printf("[GPU] clCreateKernel(persistent): %d\n", err); return false; }
+  // The kernel reads the control words, so the table is imported read-write
+  persistTable_ = import_buffer(ion_flag_table, CL_MEM_READ_WRITE);
+  if (!persistTable_ || !bind_args(persistKernel_, bufOutput_, bufInput_)) {
+    stop_persistent();
+    return false;
+  }
+
+  EpochFlagTable<uint32_t> table(ion_flag_table);
+  ctrl_ = table.flag(ctrl_index);
+  for (int i = kCtrlDoorbell; i <= kCtrlExited; ++i) ctrl_[i] = 0;
+  posted_ = 0;
+  std::atomic_thread_fence(std::memory_order_release);
+
+  cl_uint ctrl_word = static_cast<cl_uint>(flag_offset_bytes(ctrl_index) / sizeof(uint32_t));
+  cl_uint base = epoch_;  // step N publishes base + N
+  cl_int e = CL_SUCCESS;
+  e |= clSetKernelArg(persistKernel_, kArgPersistTable, sizeof(cl_mem), &persistTable_);
+  e |= clSetKernelArg(persistKernel_, kArgPersistFlag,  sizeof(cl_uint), &flagWord_);
+  e |= clSetKernelArg(persistKernel_, kArgPersistCtrl,  sizeof(cl_uint), &ctrl_word);
+  e |= clSetKernelArg(persistKernel_, kArgPersistBase,  sizeof(cl_uint), &base);
+  e |= clSetKernelArg(persistKernel_, kArgPersistIdle,  sizeof(cl_uint), &max_idle_polls);
+  if (e != CL_SUCCESS) {
+    printf("[GPU] clSetKernelArg(persistent) failed\n");
+    stop_persistent();
+    return false;
+  }
+  launch_persistent();
+  return true;
+}
+
+void GpuEngine::launch_persistent() {
+  clEnqueueNDRangeKernel(queue_, persistKernel_, 1, nullptr, &global_, &local_, 0, nullptr, nullptr);
+  clFlush(queue_);
+}
+
+void GpuEngine::stop_persistent() {
+  if (ctrl_) {
+    ctrl_[kCtrlStop] = 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    clFinish(queue_);  // the kernel drains the posted steps, then returns
+  }
+  if (persistKernel_) clReleaseKernel(persistKernel_);
+  if (persistTable_)  clReleaseMemObject(persistTable_);
+  persistKernel_ = nullptr; persistTable_ = nullptr; ctrl_ = nullptr;
+  posted_ = 0;
+}
+
+uint32_t GpuEngine::submit_slot(int slot, cl_uint num_wait, const cl_event* wait_list,
+                                cl_event* event) {
+  if (persistent()) stop_persistent();
+  Slot& s = slots_[slot];
+  uint32_t epoch = ++s.epoch;
+  clSetKernelArg(s.kernel, kArgEpoch, sizeof(cl_uint), &epoch);
+  clEnqueueNDRangeKernel(queue_, s.kernel, 1, nullptr, &global_, &local_, num_wait,
+                         num_wait ? wait_list : nullptr, event);
+  clFlush(queue_);
+  return epoch;
+}
+
+double GpuEngine::execute_blocking(double* compute_us) {
+  if (persistent()) stop_persistent();
   cl_event evt;
   double t0 = now_us();
-  clEnqueueNDRangeKernel(g_queue, g_kernel, 1, nullptr, &g_global, &g_local, 0, nullptr, &evt);
-  clFinish(g_queue);
+  clEnqueueNDRangeKernel(queue_, kernel_, 1, nullptr, &global_, &local_, 0, nullptr, &evt);
+  clFinish(queue_);
   double t1 = now_us();
 
-  if (gpu_compute_us) {
-    cl_ulong t_start, t_end;
-    clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_START, sizeof(t_start), &t_start, nullptr);
-    clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_END, sizeof(t_end), &t_end, nullptr);
-    *gpu_compute_us = (t_end - t_start) / 1000.0;
-  }
+  if (compute_us) *compute_us = event_compute_us(evt);
   clReleaseEvent(evt);
   return t1 - t0;
 }
 
-double gpu_execute_blocking_noprof() {
+double GpuEngine::execute_blocking() {
+  if (persistent()) stop_persistent();
   double t0 = now_us();
-  clEnqueueNDRangeKernel(g_queue, g_kernel, 1, nullptr, &g_global, &g_local, 0, nullptr, nullptr);
-  clFinish(g_queue);
+  clEnqueueNDRangeKernel(queue_, kernel_, 1, nullptr, &global_, &local_, 0, nullptr, nullptr);
+  clFinish(queue_);
   return now_us() - t0;
 }
 
-cl_event gpu_execute_nonblocking() {
+cl_event GpuEngine::execute_nonblocking() {
+  if (persistent()) stop_persistent();
   cl_event evt;
-  clEnqueueNDRangeKernel(g_queue, g_kernel, 1, nullptr, &g_global, &g_local, 0, nullptr, &evt);
-  clFlush(g_queue);
+  clEnqueueNDRangeKernel(queue_, kernel_, 1, nullptr, &global_, &local_, 0, nullptr, &evt);
+  clFlush(queue_);
   return evt;
 }
 
-bool gpu_poll_event(cl_event evt) {
+bool GpuEngine::poll_event(cl_event evt) {
   cl_int status;
   clGetEventInfo(evt, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, nullptr);
   return status == CL_COMPLETE;
 }
 
-double gpu_event_compute_us(cl_event evt) {
+double GpuEngine::event_compute_us(cl_event evt) {
   cl_ulong t_start, t_end;
   clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_START, sizeof(t_start), &t_start, nullptr);
   clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_END, sizeof(t_end), &t_end, nullptr);
   return (t_end - t_start) / 1000.0;
 }
 
-GpuProfilingInfo gpu_event_profiling(cl_event evt) {
+GpuProfilingInfo GpuEngine::event_profiling(cl_event evt) {
   cl_ulong t_queued, t_submit, t_start, t_end;
   clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_QUEUED, sizeof(t_queued), &t_queued, nullptr);
   clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_SUBMIT, sizeof(t_submit), &t_submit, nullptr);
@@ -255,17 +456,114 @@ GpuProfilingInfo gpu_event_profiling(cl_event evt) {
   return info;
 }
 
+void GpuEngine::cleanup() {
+  stop_persistent();
+  for (auto& s : slots_) {
+    clReleaseKernel(s.kernel);
+    clReleaseMemObject(s.input);
+    clReleaseMemObject(s.output);
+    clReleaseMemObject(s.flag);
+  }
+  slots_.clear();
+  if (kernel_)    clReleaseKernel(kernel_);
+  if (bufInput_)  clReleaseMemObject(bufInput_);
+  if (bufOutput_) clReleaseMemObject(bufOutput_);
+  if (bufGamma_)  clReleaseMemObject(bufGamma_);
+  if (bufFlag_)   clReleaseMemObject(bufFlag_);
+  for (auto& p : parents_) clReleaseMemObject(p.mem);
+  parents_.clear();
+  if (program_)   clReleaseProgram(program_);
+  if (queue_)     clReleaseCommandQueue(queue_);
+  if (context_)   clReleaseContext(context_);
+  kernel_ = nullptr; bufInput_ = nullptr; bufOutput_ = nullptr; bufGamma_ = nullptr;
+  bufFlag_ = nullptr; flagPtr_ = nullptr; epoch_ = 0; flagWord_ = 0;
+  program_ = nullptr; queue_ = nullptr; context_ = nullptr;
+  platform_ = nullptr; device_ = nullptr;
+  ionImport_ = false; cpuFallback_ = false; baseAlign_ = 1;
+}
+
+// ── Process-default instance ────────────────────────────────────────────────
+// With --sim every wrapper goes to the simulated engine instead (sim_engine.h).
+
+GpuEngine& gpu_default_engine() { return g_engine; }
+
+bool gpu_init(int hidden_dim, float epsilon,
+              const IonBuffer& ion_input, const IonBuffer& ion_output,
+              const char* kernel_path) {
+  if (sim_enabled()) return sim_gpu_engine().init(hidden_dim, epsilon, ion_input, ion_output);
+  return g_engine.init(hidden_dim, epsilon, ion_input, ion_output, kernel_path);
+}
+bool gpu_enable_flag(const IonBuffer& ion_flag_table, int flag_index) {
+  if (sim_enabled()) return sim_gpu_engine().enable_flag(ion_flag_table, flag_index);
+  return g_engine.enable_flag(ion_flag_table, flag_index);
+}
+void gpu_disable_flag() {
+  if (sim_enabled()) sim_gpu_engine().disable_flag();
+  else               g_engine.disable_flag();
+}
+volatile uint32_t* gpu_get_flag_ptr() {
+  return sim_enabled() ? sim_gpu_engine().flag_ptr() : g_engine.flag_ptr();
+}
+double gpu_execute_blocking(double* gpu_compute_us) {
+  return sim_enabled() ? sim_gpu_engine().execute_blocking(gpu_compute_us)
+                       : g_engine.execute_blocking(gpu_compute_us);
+}
+double gpu_execute_blocking_noprof() {
+  return sim_enabled() ? sim_gpu_engine().execute_blocking() : g_engine.execute_blocking();
+}
+cl_event gpu_execute_nonblocking() {
+  return sim_enabled() ? sim_gpu_engine().execute_nonblocking() : g_engine.execute_nonblocking();
+}
+uint32_t gpu_submit() {
+  return sim_enabled() ? sim_gpu_engine().submit() : g_engine.submit();
+}
+bool gpu_start_persistent(const IonBuffer& ion_flag_table, int ctrl_index) {
+  if (sim_enabled()) return sim_gpu_engine().start_persistent(ion_flag_table, ctrl_index);
+  return g_engine.start_persistent(ion_flag_table, ctrl_index);
+}
+void gpu_stop_persistent() {
+  if (sim_enabled()) sim_gpu_engine().stop_persistent();
+  else               g_engine.stop_persistent();
+}
+int gpu_add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output,
+                 const IonBuffer& ion_flag_table, int flag_index) {
+  if (sim_enabled()) return sim_gpu_engine().add_slot(ion_input, ion_output, ion_flag_table, flag_index);
+  return g_engine.add_slot(ion_input, ion_output, ion_flag_table, flag_index);
+}
+uint32_t gpu_submit_slot(int slot, cl_uint num_wait, const cl_event* wait_list, cl_event* event) {
+  return sim_enabled() ? sim_gpu_engine().submit_slot(slot, num_wait, wait_list, event)
+                       : g_engine.submit_slot(slot, num_wait, wait_list, event);
+}
+volatile uint32_t* gpu_get_slot_flag_ptr(int slot) {
+  return sim_enabled() ? sim_gpu_engine().slot_flag_ptr(slot) : g_engine.slot_flag_ptr(slot);
+}
+bool gpu_poll_event(cl_event evt) {
+  return sim_enabled() ? SimGpuEngine::poll_event(evt) : GpuEngine::poll_event(evt);
+}
+double gpu_event_compute_us(cl_event evt) {
+  return sim_enabled() ? SimGpuEngine::event_compute_us(evt) : GpuEngine::event_compute_us(evt);
+}
+GpuProfilingInfo gpu_event_profiling(cl_event evt) {
+  return sim_enabled() ? SimGpuEngine::event_profiling(evt) : GpuEngine::event_profiling(evt);
+}
+void gpu_wait_event(cl_event evt) {
+  if (sim_enabled()) SimGpuEngine::wait_event(evt);
+  else               clWaitForEvents(1, &evt);
+}
+void gpu_release_event(cl_event evt) {
+  if (sim_enabled()) SimGpuEngine::release_event(evt);
+  else               clReleaseEvent(evt);
+}
+bool gpu_set_complete_callback(cl_event evt, void (CL_CALLBACK* fn)(cl_event, cl_int, void*),
+                               void* user_data) {
+  if (sim_enabled()) return SimGpuEngine::set_complete_callback(evt, fn, user_data);
+  return clSetEventCallback(evt, CL_COMPLETE, fn, user_data) == CL_SUCCESS;
+}
+void gpu_print_info() {
+  if (sim_enabled()) sim_gpu_engine().print_info();
+  else               g_engine.print_info();
+}
 void gpu_cleanup() {
-  if (g_kernel)    clReleaseKernel(g_kernel);
-  if (g_bufInput)  clReleaseMemObject(g_bufInput);
-  if (g_bufOutput) clReleaseMemObject(g_bufOutput);
-  if (g_bufGamma)  clReleaseMemObject(g_bufGamma);
-  if (g_bufFlag)   clReleaseMemObject(g_bufFlag);
-  if (g_program)   clReleaseProgram(g_program);
-  if (g_queue)     clReleaseCommandQueue(g_queue);
-  if (g_context)   clReleaseContext(g_context);
-  g_kernel = nullptr; g_bufInput = nullptr; g_bufOutput = nullptr; g_bufGamma = nullptr;
-  g_bufFlag = nullptr; g_flagPtr = nullptr;
-  g_program = nullptr; g_queue = nullptr; g_context = nullptr;
-  g_platform = nullptr; g_device = nullptr;
+  if (sim_enabled()) sim_gpu_engine().cleanup();
+  else               g_engine.cleanup();
 }
@@ -1,41 +1,15 @@
 #pragma once
 #include "common.h"
+#include "engine.h"
 
 #define CL_TARGET_OPENCL_VERSION 200
 #include <CL/cl.h>
 
-// GPU RMSNorm engine with blocking and non-blocking execution modes.
-// Accepts external ION buffers for zero-copy sharing with NPU.
-
-bool gpu_init(int hidden_dim, float epsilon,
-              const IonBuffer& ion_input, const IonBuffer& ion_output,
-              const char* kernel_path);
-
-// Enable flag-based fast sync: GPU kernel writes flag to shared memory on completion.
-// Must be called after gpu_init(). Pass an ION buffer of >= 4 bytes.
-bool gpu_enable_flag(const IonBuffer& ion_flag);
-
-// Disable flag mode: kernel arg set to NULL, kernel skips flag write.
-void gpu_disable_flag();
-
-// Get CPU-mapped flag pointer (for direct polling). Only valid when flag is enabled.
-volatile uint32_t* gpu_get_flag_ptr();
-
-// Blocking: enqueue + clFinish. Returns total wall-clock time in us.
-// Fills gpu_compute_us via profiling if profiling is enabled.
-double gpu_execute_blocking(double* gpu_compute_us);
-
-// Non-blocking: enqueue + clFlush. Returns cl_event for polling.
-cl_event gpu_execute_nonblocking();
+#include <vector>
 
-// Submit for flag-based sync: reset flag, enqueue, clFlush. No waiting.
-void gpu_submit();
-
-// Poll event status. Returns true if CL_COMPLETE.
-bool gpu_poll_event(cl_event evt);
-
-// Get GPU compute time from profiling info on a completed event. Returns us.
-double gpu_event_compute_us(cl_event evt);
+// GPU RMSNorm engine with blocking and non-blocking execution modes.
+// Accepts external ION buffers for zero-copy sharing with NPU. Arena views
+// (ion_arena.h) become sub-buffers of one import of their allocation.
 
 // Get full profiling breakdown from a completed event. All values in us.
 struct GpuProfilingInfo {
@@ -48,10 +22,177 @@ struct GpuProfilingInfo {
   double compute;      // end - start: actual kernel execution
   double total_device; // end - queued: total device-side time
 };
-GpuProfilingInfo gpu_event_profiling(cl_event evt);
 
-// Execute blocking without profiling (uses clFinish only, returns wall time)
-double gpu_execute_blocking_noprof();
+// One OpenCL context + in-order profiling queue + rmsnorm kernel.
+//
+// Without a GPU device (plain Linux host) init() falls back to an OpenCL CPU
+// device: buffers are then wrapped with CL_MEM_USE_HOST_PTR instead of the
+// Qualcomm ION import, and devices without cl_khr_fp16 load/store the FP16
+// data with vload_half / vstore_half. The host still sees the flag table
+// directly, so every sync mode runs unchanged.
+class GpuEngine : public Engine {
+public:
+  // Empty doorbell polls before the persistent kernel parks (~0.1-1 s)
+  static constexpr uint32_t kPersistentIdlePolls = 1u << 20;
+
+  GpuEngine() = default;
+  ~GpuEngine() override { cleanup(); }
+
+  bool init(int hidden_dim, float epsilon,
+            const IonBuffer& ion_input, const IonBuffer& ion_output,
+            const char* kernel_path);
+
+  // Enable flag-based fast sync: the kernel publishes a monotonically
+  // increasing epoch into flag `flag_index` of a shared epoch flag table on
+  // completion. Must be called after init(). Pass a buffer of >= kFlagTableBytes.
+  bool enable_flag(const IonBuffer& ion_flag_table, int flag_index = 0);
+
+  // Disable flag mode: kernel arg set to NULL, kernel skips flag write.
+  void disable_flag();
+
+  // CPU-mapped flag pointer (for direct polling). Only valid when flag is enabled.
+  volatile uint32_t* flag_ptr() const { return flagPtr_; }
+
+  // Blocking: enqueue + clFinish. Returns total wall-clock time in us.
+  // Fills compute_us via profiling if non-null.
+  double execute_blocking(double* compute_us);
+
+  // Blocking without profiling (clFinish only, returns wall time)
+  double execute_blocking() override;
 
+  // Non-blocking: enqueue + clFlush. Returns cl_event for polling.
+  cl_event execute_nonblocking();
+
+  // Submit for flag-based sync: enqueue, clFlush. No waiting, no host write
+  // to the flag. Returns the epoch the kernel will publish; the step is done
+  // once epoch_reached(*flag_ptr(), epoch).
+  uint32_t submit();
+
+  // Pipelined mode: register an extra (input, output) buffer pair ("slot")
+  // that publishes into flag `flag_index` of the shared flag table. Each slot
+  // owns its own kernel object with buffer args pre-bound, so submitting a
+  // slot only sets the epoch arg. Returns the slot index, or -1 on failure.
+  int add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output,
+               const IonBuffer& ion_flag_table, int flag_index);
+
+  // Submit one slot: enqueue, clFlush. Returns the epoch the slot's kernel will publish.
+  // The kernel waits for wait_list on the device (GPU → GPU edges need no
+  // host sync); event, if non-null, receives its cl_event (caller releases).
+  uint32_t submit_slot(int slot, cl_uint num_wait = 0, const cl_event* wait_list = nullptr,
+                       cl_event* event = nullptr);
+
+  // CPU-mapped flag pointer of a slot.
+  volatile uint32_t* slot_flag_ptr(int slot) const { return slots_[slot].flagPtr; }
+
+  // Persistent mode: launch rmsnorm_persistent once; from then on submit()
+  // only bumps a doorbell word in line `ctrl_index` of the flag table and the
+  // resident kernel runs the step and publishes the epoch into the
+  // enable_flag() flag (same contract as above, no clEnqueue / clFlush per
+  // step). After max_idle_polls empty polls the kernel exits rather than
+  // trip the GPU watchdog; the next submit() relaunches it.
+  // The kernel owns the in-order queue: execute_blocking() / _nonblocking()
+  // and submit_slot() stop it first. Requires enable_flag().
+  bool start_persistent(const IonBuffer& ion_flag_table, int ctrl_index,
+                        uint32_t max_idle_polls = kPersistentIdlePolls);
+  void stop_persistent();  // stop request + clFinish
+  bool persistent() const { return persistKernel_ != nullptr; }
+
+  // Event helpers (independent of the engine that produced the event)
+  static bool poll_event(cl_event evt);                  // true if CL_COMPLETE
+  static double event_compute_us(cl_event evt);          // START → END, us
+  static GpuProfilingInfo event_profiling(cl_event evt);
+
+  // True when running on the OpenCL CPU-device fallback
+  bool cpu_fallback() const { return cpuFallback_; }
+
+  const char* name() const override { return "gpu"; }
+  void print_info() const override;
+  void cleanup() override;
+
+private:
+  // Pipelined mode: one kernel object + imported buffers per slot
+  struct Slot {
+    cl_kernel kernel = nullptr;
+    cl_mem    input  = nullptr;
+    cl_mem    output = nullptr;
+    cl_mem    flag   = nullptr;
+    volatile uint32_t* flagPtr = nullptr;
+    uint32_t  epoch  = 0;
+  };
+
+  // Imported allocation behind arena views, shared by their sub-buffers
+  struct Parent {
+    int    fd   = -1;
+    void*  base = nullptr;
+    cl_mem mem  = nullptr;
+  };
+
+  bool select_device();
+  cl_mem import_buffer(const IonBuffer& ion, cl_mem_flags flags);
+  cl_mem import_view(const IonBuffer& view, cl_mem_flags flags);
+  bool bind_args(cl_kernel kernel, cl_mem output, cl_mem input);
+  void launch_persistent();
+
+  cl_platform_id   platform_ = nullptr;
+  cl_device_id     device_   = nullptr;
+  cl_context       context_  = nullptr;
+  cl_command_queue queue_    = nullptr;
+  cl_program       program_  = nullptr;
+  cl_kernel        kernel_   = nullptr;
+  cl_mem           bufInput_ = nullptr;
+  cl_mem           bufOutput_= nullptr;
+  cl_mem           bufGamma_ = nullptr;
+  cl_mem           bufFlag_  = nullptr;
+  volatile uint32_t* flagPtr_ = nullptr;
+  uint32_t         epoch_    = 0;   // last epoch handed out by submit()
+  cl_uint          flagWord_ = 0;   // enable_flag() flag, index in uints
+  int              hidden_   = 0;
+  float            epsilon_  = 1e-6f;
+  size_t           local_    = 256;
+  size_t           global_   = 0;
+  bool             ionImport_   = false;  // cl_qcom_ion_host_ptr available
+  bool             cpuFallback_ = false;
+  size_t           baseAlign_   = 1;      // CL_DEVICE_MEM_BASE_ADDR_ALIGN, bytes
+  std::vector<Slot> slots_;
+  std::vector<Parent> parents_;           // released after every sub-buffer
+
+  // Persistent mode
+  cl_kernel        persistKernel_ = nullptr;
+  cl_mem           persistTable_  = nullptr;  // flag table, read-write
+  volatile uint32_t* ctrl_        = nullptr;  // control line (CPU mapping)
+  uint32_t         posted_        = 0;        // last step on the doorbell
+};
+
+// ── Process-default instance ────────────────────────────────────────────────
+// Thin wrappers over one GpuEngine, used by the single-op pipeline (over the
+// simulated GPU while sim_enabled()). Events only go through these helpers.
+
+GpuEngine& gpu_default_engine();
+
+bool gpu_init(int hidden_dim, float epsilon,
+              const IonBuffer& ion_input, const IonBuffer& ion_output,
+              const char* kernel_path);
+bool gpu_enable_flag(const IonBuffer& ion_flag_table, int flag_index = 0);
+void gpu_disable_flag();
+volatile uint32_t* gpu_get_flag_ptr();
+double gpu_execute_blocking(double* gpu_compute_us);
+double gpu_execute_blocking_noprof();
+cl_event gpu_execute_nonblocking();
+uint32_t gpu_submit();
+bool gpu_start_persistent(const IonBuffer& ion_flag_table, int ctrl_index);
+void gpu_stop_persistent();
+int gpu_add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output,
+                 const IonBuffer& ion_flag_table, int flag_index);
+uint32_t gpu_submit_slot(int slot, cl_uint num_wait = 0, const cl_event* wait_list = nullptr,
+                         cl_event* event = nullptr);
+volatile uint32_t* gpu_get_slot_flag_ptr(int slot);
+bool gpu_poll_event(cl_event evt);
+double gpu_event_compute_us(cl_event evt);
+GpuProfilingInfo gpu_event_profiling(cl_event evt);
+void gpu_wait_event(cl_event evt);     // clWaitForEvents
+void gpu_release_event(cl_event evt);  // clReleaseEvent
+// clSetEventCallback(CL_COMPLETE). Returns false if the callback can't be set.
+bool gpu_set_complete_callback(cl_event evt, void (CL_CALLBACK* fn)(cl_event, cl_int, void*),
+                               void* user_data);
 void gpu_print_info();
 void gpu_cleanup();
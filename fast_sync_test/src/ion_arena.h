@@ -0,0 +1,88 @@
+#pragma once
+// Single-fd tensor arena.
+//
+// One allocIonBuffer for every tensor of a pipeline instead of one per
+// tensor: fewer fds, one SMMU mapping on the DSP and one ION import on the
+// GPU. carve() hands out views (IonBuffer with offset / alloc_size set) at
+// increasing aligned offsets; the engines turn a view into
+//
+//   GPU  clCreateSubBuffer(region = {offset, size}) of the imported
+//        allocation (origin must be CL_DEVICE_MEM_BASE_ADDR_ALIGN aligned)
+//   NPU  QNN_HTP_MEM_SHARED_BUFFER registration {fd, offset}
+//
+// which is what unified_bandwidth_test sets up by hand. The default
+// alignment is one page: above the Adreno base-address alignment (1024 bits)
+// and the HTP shared-buffer offset granularity, and it keeps every tensor on
+// its own pages. freeIonBuffer() on a view only forgets it; the allocation
+// goes away with release() (or the destructor), after the engines that
+// imported or registered views are cleaned up.
+
+#include "common.h"
+
+#include <cstdio>
+
+class IonArena {
+public:
+  static constexpr size_t kDefaultAlign = 4096;
+
+  IonArena() = default;
+  IonArena(const IonArena&) = delete;
+  IonArena& operator=(const IonArena&) = delete;
+  ~IonArena() { release(); }
+
+  // Bytes one tensor of `bytes` takes in an arena (for sizing init())
+  static size_t span(size_t bytes, size_t align = kDefaultAlign) {
+    return (bytes + align - 1) / align * align;
+  }
+
+  // Allocate the backing buffer (zero-filled, like allocIonBuffer(..., 0, ...))
+  bool init(size_t capacity, size_t align = kDefaultAlign) {
+    release();
+    align_ = align ? align : 1;
+    if (!allocIonBuffer(capacity, 0, buf_)) {
+      printf("[ARENA] ION alloc of %zu bytes failed\n", capacity);
+      return false;
+    }
+    return true;
+  }
+
+  // Next `bytes` at an aligned offset; false when the arena is full
+  bool carve(size_t bytes, IonBuffer& out) {
+    if (!view_at(span(used_, align_), bytes, out)) return false;
+    used_ = out.offset + bytes;
+    return true;
+  }
+
+  // View at a planned offset (memory_plan.h); views placed this way may
+  // overlap, the plan guarantees their lifetimes don't
+  bool view_at(size_t offset, size_t bytes, IonBuffer& out) {
+    if (!buf_.ptr || offset % align_ || offset + bytes > buf_.size) {
+      printf("[ARENA] no view of %zu bytes at %zu (size %zu, align %zu)\n", bytes, offset,
+             buf_.size, align_);
+      return false;
+    }
+    out = buf_;
+    out.ptr  = static_cast<uint8_t*>(buf_.ptr) + offset;
+    out.size = bytes;
+    out.offset     = offset;
+    out.alloc_size = buf_.size;
+    ++views_;
+    return true;
+  }
+
+  void release() {
+    freeIonBuffer(buf_);
+    used_ = 0;
+    views_ = 0;
+  }
+
+  const IonBuffer& backing() const { return buf_; }
+  size_t used() const { return used_; }
+  int    views() const { return views_; }
+
+private:
+  IonBuffer buf_;
+  size_t align_ = kDefaultAlign;
+  size_t used_  = 0;
+  int    views_ = 0;
+};
@@ -1,21 +1,51 @@
 #include "common.h"
+#include "cpu_engine.h"
 #include "gpu_engine.h"
 #include "npu_engine.h"
+#include "op_dag.h"
 #include "pipeline.h"
+#include "sim_engine.h"
+#include "sync_policy.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
 
 static void print_usage(const char* prog) {
   printf("Usage: %s [options]\n", prog);
   printf("  --hidden-dim N   hidden dimension (default: 4096)\n");
   printf("  --steps N        measured iterations (default: 100)\n");
   printf("  --warmup N       warmup iterations (default: 10)\n");
-  printf("  --usleep-hint N  NPU wait hint in us (default: 0 = pure spin)\n");
-  printf("  --mode MODE      seq|threaded|event|fast|direct|parallel|all (default: all)\n");
+  printf("  --predict        sleep until just before the predicted GPU/NPU completion, then spin\n");
+  printf("  --mode MODE      seq|threaded|event|fast|direct|parallel|async|pipelined|all (default: all)\n");
+  printf("                   custom: one --gpu × --launch combination; matrix: every valid combination\n");
+  printf("                   layered: --layers stack per token, per-layer device from --placement\n");
+  printf("                   dag: demo op DAG (GPU/NPU/CPU branches) on flag and cl_event edges\n");
+  printf("                   async-queue: --steps (at least 3 x queue depth) back-to-back async NPU\n");
+  printf("                   launches; checks every notify ran once, in order (exit 1 on failure)\n");
+  printf("  --gpu G          finish|event|callback|flag|persistent|cpu: GPU completion policy (custom, default: flag)\n");
+  printf("                   persistent: one resident kernel, each step is a shared-memory doorbell store\n");
+  printf("                   cpu: stage 1 runs on the host CPU engine (SIMD FP16), epoch flag completion\n");
+  printf("  --launch L       inline|worker|direct|syncwait|async|persistent: NPU launch policy (custom, default: direct)\n");
+  printf("                   async: graphExecuteAsync + notify callback, no NPU thread (also --mode pipelined)\n");
+  printf("                   persistent: one graphExecute of the PersistentRmsNorm graph per --burst steps\n");
+  printf("  --burst N        --launch persistent: steps per graphExecute (default: 16)\n");
+  printf("  --depth N        pipelined: steps in flight / buffer slots (default: 2)\n");
+  printf("  --layers N       layered: layers per token (default: 32, max 63)\n");
+  printf("  --placement P    layered: device per layer, G|N, repeated over the layers (default: GN)\n");
   printf("  --main-core N    pin main thread to CPU core N (default: -1 = no pin)\n");
   printf("  --npu-core N     pin NPU worker thread to CPU core N (default: -1 = no pin)\n");
+  printf("  --cpu-threads N  --gpu cpu: CPU engine workers (default: 0 = half the online CPUs)\n");
+  printf("  --cpu-core N     --gpu cpu: pin CPU engine workers to cores N, N+1, ... (default: -1 = no pin)\n");
+  printf("  --arena          carve every pipeline tensor from one ION allocation (GPU sub-buffers, NPU offsets)\n");
+  printf("                   dag: tensors with disjoint lifetimes share offsets (memory plan)\n");
+  printf("  --wait W         spin|yield|futex|atomic|wfe: flag/handoff wait strategy (default: spin)\n");
+  printf("  --wait-bench N   host-only: measure every wait strategy with an N us producer delay, then exit\n");
+  printf("  --sim            simulate GPU / NPU on host threads (memfd buffers, latency model)\n");
+  printf("  --sim-latency S  --sim: override latencies, S = name=mean[/stddev],... (us), names:\n");
+  printf("                   gpu_queue gpu_sched gpu_compute gpu_driver gpu_doorbell npu_rpc npu_compute npu_sync_wait\n");
+  printf("  --sim-seed N     --sim: latency sampling seed (default: 42)\n");
 }
 
 static void print_stats_row(const char* label, Stats& s) {
@@ -51,11 +81,70 @@ static void print_mode_result(const char* mode_name, PipelineResult& r) {
   print_stats_row("npu_compute", s_nc);
   print_stats_row("npu_sync", s_ns);
   print_stats_row("step_total", s_st);
+
+  std::vector<double> latency;
+  for (auto& st : r.steps)
+    if (st.step_latency_us > 0) latency.push_back(st.step_latency_us);
+  if (!latency.empty()) {
+    Stats s_lat = compute_stats(latency);
+    print_stats_row("step_latency", s_lat);
+  }
+  if (r.layers > 0) {
+    int npu_layers = r.layers - r.gpu_layers;
+    printf("  layers: %d (%d GPU, %d NPU), %d boundaries/token, %.1f tokens/s\n",
+           r.layers, r.gpu_layers, npu_layers, r.boundaries, 1e6 * r.num_steps / r.total_us);
+    printf("  no-boundary layer cost: gpu %.1f us, npu %.1f us\n", r.gpu_layer_us, r.npu_layer_us);
+    if (r.boundaries > 0) {
+      double layer_us = r.gpu_layers * r.gpu_layer_us + npu_layers * r.npu_layer_us;
+      printf("  sync per boundary: %.1f us ((step p50 %.1f - layers %.1f) / %d)\n",
+             (s_st.p50 - layer_us) / r.boundaries, s_st.p50, layer_us, r.boundaries);
+    }
+  }
+  if (r.npu_bursts > 0)
+    printf("  NPU bursts: %d graphExecute for %d steps (%.1f steps each)\n",
+           r.npu_bursts, r.num_steps, (double)r.num_steps / r.npu_bursts);
+  printf("  setup: %.2f ms, %d ION buffer%s\n", r.setup_ms, r.ion_buffers,
+         r.ion_buffers == 1 ? " (arena)" : "s");
+  if (r.total_us > 0)
+    printf("  cpu: %.1f us/step (%.0f%% of one core)\n",
+           r.cpu_us / r.num_steps, 100.0 * r.cpu_us / r.total_us);
+  for (auto& p : r.predict) {
+    if (p.waits == 0) continue;
+    printf("  predict %-9s: ~%.1f us, slept %d/%d waits (%.1f us avg), spin %.1f us/wait, late %d (%.1f%%)\n",
+           p.name, p.predict_us, p.sleeps, p.waits,
+           p.sleeps ? p.slept_us / p.sleeps : 0.0, p.spun_us / p.waits,
+           p.late, p.sleeps ? 100.0 * p.late / p.sleeps : 0.0);
+  }
+}
+
+// Returns false if name is not a known policy
+static bool parse_gpu_sync(const char* name, GpuSync& out) {
+  const GpuSync all[] = {GpuSync::FINISH, GpuSync::EVENT_POLL, GpuSync::EVENT_CALLBACK, GpuSync::FLAG,
+                         GpuSync::PERSISTENT, GpuSync::CPU};
+  for (GpuSync g : all)
+    if (!strcmp(name, gpu_sync_name(g))) { out = g; return true; }
+  return false;
 }
 
+static bool parse_npu_launch(const char* name, NpuLaunch& out) {
+  const NpuLaunch all[] = {NpuLaunch::INLINE, NpuLaunch::WORKER, NpuLaunch::DIRECT, NpuLaunch::SYNC_WAIT,
+                           NpuLaunch::ASYNC, NpuLaunch::PERSISTENT};
+  for (NpuLaunch l : all)
+    if (!strcmp(name, npu_launch_name(l))) { out = l; return true; }
+  return false;
+}
+
+// One benchmark run: a fixed mode, or a CUSTOM policy combination
+struct RunCase {
+  std::string name;
+  SyncMode mode;
+  GpuSync gpu_sync;
+  NpuLaunch npu_launch;
+};
+
 struct ModeResult {
   SyncMode mode;
-  const char* name;
+  std::string name;
   PipelineResult result;
   Stats step_stats;
   Stats gpu_sync_stats;
@@ -66,39 +155,94 @@ int main(int argc, char* argv[]) {
   int hidden_dim  = 4096;
   int steps       = 100;
   int warmup      = 10;
-  int usleep_hint = 0;
+  bool predict    = false;
+  bool arena      = false;
   int main_core   = -1;
   int npu_core    = -1;
+  int cpu_threads = 0;
+  int cpu_core    = -1;
+  int depth       = 2;
+  int burst       = 16;
+  int layers      = 32;
+  std::string placement = "GN";
+  WaitKind wait   = WaitKind::SPIN;
+  GpuSync gpu_sync     = GpuSync::FLAG;
+  NpuLaunch npu_launch = NpuLaunch::DIRECT;
+  bool run_custom = false, run_matrix = false, run_layered = false, run_dag = false;
+  bool run_async_queue = false;
   bool run_seq = true, run_threaded = true, run_event = true, run_fast = true, run_direct = true, run_parallel = true;
+  bool run_async = true, run_pipelined = true;
+  bool sim = false;
+  SimConfig sim_cfg;
 
   for (int i = 1; i < argc; ++i) {
     if (!strcmp(argv[i], "--hidden-dim") && i+1 < argc) hidden_dim = atoi(argv[++i]);
     else if (!strcmp(argv[i], "--steps") && i+1 < argc) steps = atoi(argv[++i]);
     else if (!strcmp(argv[i], "--warmup") && i+1 < argc) warmup = atoi(argv[++i]);
-    else if (!strcmp(argv[i], "--usleep-hint") && i+1 < argc) usleep_hint = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--predict")) predict = true;
+    else if (!strcmp(argv[i], "--arena")) arena = true;
     else if (!strcmp(argv[i], "--main-core") && i+1 < argc) main_core = atoi(argv[++i]);
     else if (!strcmp(argv[i], "--npu-core") && i+1 < argc) npu_core = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--cpu-threads") && i+1 < argc) cpu_threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--cpu-core") && i+1 < argc) cpu_core = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--depth") && i+1 < argc) depth = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--burst") && i+1 < argc) burst = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--layers") && i+1 < argc) layers = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--placement") && i+1 < argc) placement = argv[++i];
+    else if (!strcmp(argv[i], "--wait") && i+1 < argc) {
+      if (!parse_wait_kind(argv[++i], wait)) { print_usage(argv[0]); return 1; }
+    }
+    else if (!strcmp(argv[i], "--gpu") && i+1 < argc) {
+      if (!parse_gpu_sync(argv[++i], gpu_sync)) { print_usage(argv[0]); return 1; }
+    }
+    else if (!strcmp(argv[i], "--launch") && i+1 < argc) {
+      if (!parse_npu_launch(argv[++i], npu_launch)) { print_usage(argv[0]); return 1; }
+    }
+    else if (!strcmp(argv[i], "--sim")) sim = true;
+    else if (!strcmp(argv[i], "--sim-latency") && i+1 < argc) {
+      if (!sim_parse_latency(argv[++i], sim_cfg)) { print_usage(argv[0]); return 1; }
+    }
+    else if (!strcmp(argv[i], "--sim-seed") && i+1 < argc) sim_cfg.seed = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--wait-bench") && i+1 < argc) {
+      run_wait_benchmark(atoi(argv[++i]), steps);
+      return 0;
+    }
     else if (!strcmp(argv[i], "--mode") && i+1 < argc) {
       ++i;
       run_seq = run_threaded = run_event = run_fast = run_direct = run_parallel = false;
+      run_async = run_pipelined = run_custom = run_matrix = run_layered = run_dag = false;
+      run_async_queue = false;
       if (!strcmp(argv[i], "seq")) run_seq = true;
       else if (!strcmp(argv[i], "threaded")) run_threaded = true;
       else if (!strcmp(argv[i], "event")) run_event = true;
       else if (!strcmp(argv[i], "fast")) run_fast = true;
       else if (!strcmp(argv[i], "direct")) run_direct = true;
       else if (!strcmp(argv[i], "parallel")) run_parallel = true;
-      else { run_seq = run_threaded = run_event = run_fast = run_direct = run_parallel = true; }
+      else if (!strcmp(argv[i], "async")) run_async = true;
+      else if (!strcmp(argv[i], "pipelined")) run_pipelined = true;
+      else if (!strcmp(argv[i], "custom")) run_custom = true;
+      else if (!strcmp(argv[i], "matrix")) run_matrix = true;
+      else if (!strcmp(argv[i], "layered")) run_layered = true;
+      else if (!strcmp(argv[i], "dag")) run_dag = true;
+      else if (!strcmp(argv[i], "async-queue")) run_async_queue = true;
+      else { run_seq = run_threaded = run_event = run_fast = run_direct = run_parallel = run_async = run_pipelined = true; }
     }
     else if (!strcmp(argv[i], "--help")) { print_usage(argv[0]); return 0; }
   }
 
+  if (sim) sim_enable(sim_cfg);
+
   printf("=== Fast Sync Benchmark: GPU<->NPU Pipeline ===\n");
-  printf("Platform: SM8850, Adreno 840 + Hexagon V81\n");
+  if (sim)
+    sim_print_config(sim_cfg);
+  else
+    printf("Platform: SM8850, Adreno 840 + Hexagon V81\n");
   printf("Config: hidden=%d, batch=1, FP16, steps=%d, warmup=%d\n", hidden_dim, steps, warmup);
-  if (usleep_hint > 0)
-    printf("NPU usleep hint: %d us\n", usleep_hint);
+  if (predict)
+    printf("Predictive wait: on (EWMA sleep-then-spin)\n");
   if (main_core >= 0 || npu_core >= 0)
     printf("CPU affinity: main_core=%d, npu_core=%d\n", main_core, npu_core);
+  printf("Wait strategy: %s\n", wait_kind_name(wait));
   printf("\n");
 
   // Print device info
@@ -113,6 +257,10 @@ int main(int argc, char* argv[]) {
       gpu_print_info();
       gpu_cleanup();
     }
+    if (cpu_init(hidden_dim, 1e-6f, tmp0, tmp1, cpu_threads, cpu_core)) {
+      cpu_print_info();
+      cpu_cleanup();
+    }
     if (npu_init(hidden_dim, 1e-6f, tmp1, tmp0)) {
       npu_print_info();
       npu_cleanup();
@@ -125,37 +273,67 @@ int main(int argc, char* argv[]) {
   const char* kernel_path = "kernels/rmsnorm.cl";
 
   // GPU-only diagnostic: isolate clFinish overhead
-  run_gpu_diagnostic(hidden_dim, steps, kernel_path);
+  run_gpu_diagnostic(hidden_dim, steps, kernel_path, wait);
   printf("\n");
 
   std::vector<ModeResult> results;
 
-  // Run each mode
-  SyncMode modes[] = {SyncMode::SEQUENTIAL_BLOCKING, SyncMode::THREADED_CLFINISH, SyncMode::EVENT_POLL, SyncMode::FAST_SYNC, SyncMode::FAST_SYNC_DIRECT, SyncMode::PARALLEL_SYNC};
-  bool     run_flags[] = {run_seq, run_threaded, run_event, run_fast, run_direct, run_parallel};
-  const char* names[] = {"Seq Blocking", "Thread+clFinish", "Event Poll", "Fast Sync", "Fast Sync Direct", "Parallel Sync"};
+  // Build the run list: fixed modes, then policy combinations
+  std::vector<RunCase> cases;
+  SyncMode modes[] = {SyncMode::SEQUENTIAL_BLOCKING, SyncMode::THREADED_CLFINISH, SyncMode::EVENT_POLL, SyncMode::FAST_SYNC, SyncMode::FAST_SYNC_DIRECT, SyncMode::PARALLEL_SYNC, SyncMode::ASYNC_NPU, SyncMode::PIPELINED};
+  bool     run_flags[] = {run_seq, run_threaded, run_event, run_fast, run_direct, run_parallel, run_async, run_pipelined};
+  for (int m = 0; m < 8; ++m) {
+    if (run_flags[m])
+      cases.push_back({sync_mode_name(modes[m]), modes[m], gpu_sync, npu_launch});
+  }
+  auto add_combo = [&](GpuSync g, NpuLaunch l) {
+    cases.push_back({std::string(gpu_sync_name(g)) + "+" + npu_launch_name(l),
+                     SyncMode::CUSTOM, g, l});
+  };
+  if (run_custom) add_combo(gpu_sync, npu_launch);
+  if (run_layered)
+    cases.push_back({std::string(sync_mode_name(SyncMode::LAYERED)) + " " + placement,
+                     SyncMode::LAYERED, gpu_sync, npu_launch});
+  if (run_matrix) {
+    const GpuSync gs[] = {GpuSync::FINISH, GpuSync::EVENT_POLL, GpuSync::EVENT_CALLBACK, GpuSync::FLAG,
+                          GpuSync::PERSISTENT, GpuSync::CPU};
+    const NpuLaunch ls[] = {NpuLaunch::INLINE, NpuLaunch::WORKER, NpuLaunch::DIRECT, NpuLaunch::SYNC_WAIT,
+                            NpuLaunch::ASYNC, NpuLaunch::PERSISTENT};
+    for (GpuSync g : gs)
+      for (NpuLaunch l : ls)
+        if (sync_combo_valid(g, l)) add_combo(g, l);
+  }
 
-  for (int m = 0; m < 6; ++m) {
-    if (!run_flags[m]) continue;
+  for (const RunCase& rc : cases) {
 
     PipelineConfig cfg;
     cfg.hidden_dim  = hidden_dim;
     cfg.epsilon     = 1e-6f;
     cfg.num_warmup  = warmup;
     cfg.num_steps   = steps;
-    cfg.usleep_hint = usleep_hint;
+    cfg.predict_wait = predict;
+    cfg.arena       = arena;
     cfg.main_core   = main_core;
     cfg.npu_core    = npu_core;
-    cfg.mode        = modes[m];
+    cfg.cpu_threads = cpu_threads;
+    cfg.cpu_core    = cpu_core;
+    cfg.pipeline_depth = depth;
+    cfg.burst_steps = burst;
+    cfg.num_layers  = layers;
+    cfg.placement   = placement;
+    cfg.wait        = wait;
+    cfg.mode        = rc.mode;
+    cfg.gpu_sync    = rc.gpu_sync;
+    cfg.npu_launch  = rc.npu_launch;
 
-    printf("Running %s...\n", names[m]);
+    printf("Running %s...\n", rc.name.c_str());
     PipelineResult r = run_pipeline(cfg, kernel_path);
-    print_mode_result(names[m], r);
+    print_mode_result(rc.name.c_str(), r);
 
     if (r.success) {
       ModeResult mr;
-      mr.mode = modes[m];
-      mr.name = names[m];
+      mr.mode = rc.mode;
+      mr.name = rc.name;
       mr.result = r;
 
       std::vector<double> step_vals, gpu_sync_vals, npu_sync_vals;
@@ -171,29 +349,52 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  if (run_dag) {
+    PipelineConfig cfg;
+    cfg.hidden_dim = hidden_dim;
+    cfg.epsilon    = 1e-6f;
+    cfg.num_warmup = warmup;
+    cfg.num_steps  = steps;
+    cfg.wait       = wait;
+    cfg.arena      = arena;
+    run_dag_benchmark(cfg, kernel_path);
+  }
+
+  bool async_queue_ok = true;
+  if (run_async_queue) {
+    int launches = std::max(steps, 3 * static_cast<int>(NpuEngine::kAsyncQueueDepth));
+    async_queue_ok = run_async_queue_check(hidden_dim, launches);
+  }
+
   // Summary table
   if (results.size() > 1) {
     printf("\n=== Summary ===\n");
-    printf("%-20s %10s %10s %10s %10s %10s\n",
-           "Mode", "step_p50", "gpu_sync", "npu_sync", "sync_tot", "speedup");
-    for (int i = 0; i < 72; ++i) printf("-");
+    printf("%-20s %10s %10s %10s %10s %10s %8s\n",
+           "Mode", "step_p50", "gpu_sync", "npu_sync", "sync_tot", "speedup", "cpu");
+    for (int i = 0; i < 81; ++i) printf("-");
     printf("\n");
 
     double baseline_step = results[0].step_stats.p50;
     for (auto& mr : results) {
       double sync_tot = mr.gpu_sync_stats.p50 + mr.npu_sync_stats.p50;
       double speedup = baseline_step / mr.step_stats.p50;
-      printf("%-20s %8.1f us %8.1f us %8.1f us %8.1f us %8.2fx\n",
-             mr.name,
+      double cpu_pct = 100.0 * mr.result.cpu_us / mr.result.total_us;
+      printf("%-20s %8.1f us %8.1f us %8.1f us %8.1f us %8.2fx %7.0f%%\n",
+             mr.name.c_str(),
              mr.step_stats.p50,
              mr.gpu_sync_stats.p50,
              mr.npu_sync_stats.p50,
              sync_tot,
-             speedup);
+             speedup,
+             cpu_pct);
     }
 
     printf("\nPaper prediction: 2-4x speedup from fast sync (Section 5.5, Figure 17)\n");
   }
 
-  return 0;
+  printf("\n");
+  ionPrintProvisionStats("");
+  ionPool().print_stats("");
+
+  return async_queue_ok ? 0 : 1;
 }
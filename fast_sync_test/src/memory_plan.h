@@ -0,0 +1,74 @@
+#pragma once
+// Offline activation memory planner.
+//
+// Given tensor sizes and which pairs can be live at the same time, assign
+// every tensor an offset in one arena such that live-together tensors never
+// overlap. Greedy by size, as in the mobile inference runtimes (TFLite's
+// GreedyBySize): tensors are placed largest first, each into the best-fitting
+// (smallest sufficient) gap between the already placed tensors it conflicts
+// with, or above the highest of them. Offsets are aligned to `align`, which
+// should be the arena's (ion_arena.h) so every tensor stays a valid GPU
+// sub-buffer / HTP shared-buffer view.
+//
+// The plan also reports the naive footprint (one buffer per tensor) so the
+// saving is visible. What "live together" means is the caller's: a tensor
+// written by one op and read by later ones, a graph input the host fills
+// once (live always), a concurrent DAG branch (op_dag.cpp).
+//
+// Header-only and QNN-free, like htp_shape_plan.h.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct MemPlan {
+  std::vector<size_t> offsets;  // per tensor
+  size_t peak_bytes  = 0;       // arena size the plan needs
+  size_t naive_bytes = 0;       // sum of the (aligned) tensor sizes
+
+  double saved() const { return naive_bytes ? 1.0 - (double)peak_bytes / naive_bytes : 0.0; }
+};
+
+// live_together(i, j) -> bool, symmetric, for i != j
+template <typename LiveTogether>
+MemPlan mem_plan_greedy_by_size(const std::vector<size_t>& bytes, LiveTogether live_together,
+                                size_t align) {
+  const int n = static_cast<int>(bytes.size());
+  if (align == 0) align = 1;
+  auto span = [align](size_t b) { return (b + align - 1) / align * align; };
+
+  MemPlan plan;
+  plan.offsets.assign(n, 0);
+  std::vector<int> order(n);
+  for (int i = 0; i < n; ++i) {
+    order[i] = i;
+    plan.naive_bytes += span(bytes[i]);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](int a, int b) { return span(bytes[a]) > span(bytes[b]); });
+
+  struct Range { size_t begin, end; };
+  std::vector<int>   placed;
+  std::vector<Range> busy;
+  for (int t : order) {
+    const size_t need = span(bytes[t]);
+    busy.clear();
+    for (int u : placed)
+      if (live_together(t, u)) busy.push_back({plan.offsets[u], plan.offsets[u] + span(bytes[u])});
+    std::sort(busy.begin(), busy.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+
+    size_t best = SIZE_MAX, best_gap = SIZE_MAX, top = 0;
+    for (const Range& r : busy) {
+      if (r.begin > top && r.begin - top >= need && r.begin - top < best_gap) {
+        best = top;
+        best_gap = r.begin - top;
+      }
+      top = std::max(top, r.end);
+    }
+    plan.offsets[t] = best != SIZE_MAX ? best : top;
+    plan.peak_bytes = std::max(plan.peak_bytes, plan.offsets[t] + need);
+    placed.push_back(t);
+  }
+  return plan;
+}
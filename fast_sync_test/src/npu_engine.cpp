@@ -1,4 +1,7 @@
 #include "npu_engine.h"
+#include "htp_shape_plan.h"
+#include "persistent_protocol.h"  // heteroedge_op/
+#include "sim_engine.h"
 
 #include <dlfcn.h>
 #include <cstring>
@@ -23,36 +26,22 @@ namespace {
 
 constexpr uint32_t kTensorRank = 4;
 
-void*                        g_libHandle  = nullptr;
-const QNN_INTERFACE_VER_TYPE* g_qnn       = nullptr;
-Qnn_LogHandle_t              g_log        = nullptr;
-Qnn_BackendHandle_t          g_backend    = nullptr;
-Qnn_DeviceHandle_t           g_device     = nullptr;
-Qnn_ContextHandle_t          g_context    = nullptr;
-Qnn_GraphHandle_t            g_graph      = nullptr;
-uint32_t                     g_coreCount  = 0;
-
-// NPU owns gamma/beta; input/output are external ION buffers
-IonBuffer g_ionGamma, g_ionBeta;
-
-// ION fd of the GPU flag buffer — passed to SyncWait as static param
-// for DSP-side HAP_mmap_get() direct DDR polling
-uint32_t g_flagIonFd = 0;
-
-struct RegMem { Qnn_MemHandle_t handle = nullptr; };
-RegMem g_regInput, g_regOutput, g_regFlag;
-
-// Support up to 2 exec inputs: [data] for standard, [data, flag] for sync mode
-Qnn_Tensor_t g_execInputs[2];
-Qnn_Tensor_t g_execOutputs[1];
-uint32_t g_numExecInputs = 1;
-
-uint32_t g_dimsIO[kTensorRank];
-uint32_t g_dimsFlagIO[kTensorRank];   // {1,1,1,1} for flag tensor
-uint32_t g_dimsGamma1D[1];
-uint32_t g_dimsAxes[1];
-
-int g_hidden = 0;
+// libQnnHtp.so + interface + log + backend + device: one per process, shared
+// by every NpuEngine (each engine only owns its context / graph). Engines are
+// created and destroyed on the main thread, so the count needs no locking.
+struct QnnRuntime {
+  int                           refs       = 0;
+  void*                         libHandle  = nullptr;
+  const QNN_INTERFACE_VER_TYPE* qnn        = nullptr;
+  Qnn_LogHandle_t               log        = nullptr;
+  Qnn_BackendHandle_t           backend    = nullptr;
+  Qnn_DeviceHandle_t            device     = nullptr;
+  uint32_t                      coreCount  = 0;
+  bool                          syncOpPackage = false;  // HeteroEdge package registered
+};
+QnnRuntime g_rt;
+
+NpuEngine g_engine;  // process-default instance (npu_* wrappers)
 
 void qnnLogCallback(const char* fmt, QnnLog_Level_t level,
                      uint64_t /*timestamp*/, va_list args) {
@@ -70,36 +59,10 @@ bool check(Qnn_ErrorHandle_t s, const char* w) {
   return true;
 }
 
-bool registerBuffer(const IonBuffer& ion, const uint32_t* dims, uint32_t ndims,
-                    Qnn_DataType_t dtype, RegMem& out) {
-  Qnn_MemDescriptor_t desc = QNN_MEM_DESCRIPTOR_INIT;
-  desc.memShape.numDim  = ndims;
-  desc.memShape.dimSize = const_cast<uint32_t*>(dims);
-  desc.dataType         = dtype;
-  desc.memType          = QNN_MEM_TYPE_ION;
-  desc.ionInfo.fd       = ion.fd;
-  if (QNN_SUCCESS != g_qnn->memRegister(g_context, &desc, 1, &out.handle)) {
-    printf("[NPU] memRegister failed (fd=%d)\n", ion.fd);
-    return false;
-  }
-  return true;
-}
-
-void deregisterAll() {
-  if (!g_qnn || !g_qnn->memDeRegister) return;
-  std::vector<Qnn_MemHandle_t> handles;
-  if (g_regInput.handle)  handles.push_back(g_regInput.handle);
-  if (g_regOutput.handle) handles.push_back(g_regOutput.handle);
-  if (g_regFlag.handle)   handles.push_back(g_regFlag.handle);
-  if (!handles.empty())
-    g_qnn->memDeRegister(handles.data(), static_cast<uint32_t>(handles.size()));
-  g_regInput.handle = g_regOutput.handle = g_regFlag.handle = nullptr;
-}
-
 void setHighPerformanceMode() {
-  if (!g_qnn->deviceGetInfrastructure) return;
+  if (!g_rt.qnn->deviceGetInfrastructure) return;
   QnnDevice_Infrastructure_t infra = nullptr;
-  if (QNN_SUCCESS != g_qnn->deviceGetInfrastructure(&infra) || !infra) return;
+  if (QNN_SUCCESS != g_rt.qnn->deviceGetInfrastructure(&infra) || !infra) return;
   auto* htpInfra = reinterpret_cast<QnnHtpDevice_Infrastructure_t*>(infra);
   if (htpInfra->infraType != QNN_HTP_DEVICE_INFRASTRUCTURE_TYPE_PERF) return;
   auto& perf = htpInfra->perfInfra;
@@ -138,9 +101,9 @@ void setHighPerformanceMode() {
 }
 
 uint32_t queryCoreCount() {
-  if (!g_qnn->deviceGetPlatformInfo) return 0;
+  if (!g_rt.qnn->deviceGetPlatformInfo) return 0;
   const QnnDevice_PlatformInfo_t* info = nullptr;
-  if (QNN_SUCCESS != g_qnn->deviceGetPlatformInfo(nullptr, &info) || !info) return 0;
+  if (QNN_SUCCESS != g_rt.qnn->deviceGetPlatformInfo(nullptr, &info) || !info) return 0;
   uint32_t cores = 0;
   if (info->version == QNN_DEVICE_PLATFORM_INFO_VERSION_1) {
     for (uint32_t i = 0; i < info->v1.numHwDevices; ++i) {
@@ -150,10 +113,93 @@ uint32_t queryCoreCount() {
       if (ext && ext->devType == QNN_HTP_DEVICE_TYPE_ON_CHIP) { cores = dev.v1.numCores; break; }
     }
   }
-  if (g_qnn->deviceFreePlatformInfo) g_qnn->deviceFreePlatformInfo(nullptr, info);
+  if (g_rt.qnn->deviceFreePlatformInfo) g_rt.qnn->deviceFreePlatformInfo(nullptr, info);
   return cores;
 }
 
+void release_runtime() {
+  if (g_rt.refs > 0 && --g_rt.refs > 0) return;
+  if (g_rt.qnn && g_rt.device && g_rt.qnn->deviceFree) g_rt.qnn->deviceFree(g_rt.device);
+  if (g_rt.qnn && g_rt.backend) g_rt.qnn->backendFree(g_rt.backend);
+  if (g_rt.qnn && g_rt.log && g_rt.qnn->logFree) g_rt.qnn->logFree(g_rt.log);
+  if (g_rt.libHandle) dlclose(g_rt.libHandle);
+  g_rt = QnnRuntime{};
+}
+
+// dlopen QNN and create backend/device on first use; later callers share them
+bool acquire_runtime() {
+  if (g_rt.refs > 0) { ++g_rt.refs; return true; }
+  g_rt.refs = 1;
+
+  g_rt.libHandle = dlopen("libQnnHtp.so", RTLD_NOW | RTLD_LOCAL);
+  if (!g_rt.libHandle) { printf("[NPU] dlopen failed: %s\n", dlerror()); release_runtime(); return false; }
+
+  using GetProvidersFn = decltype(&QnnInterface_getProviders);
+  auto getProviders = reinterpret_cast<GetProvidersFn>(
+      dlsym(g_rt.libHandle, "QnnInterface_getProviders"));
+  if (!getProviders) { printf("[NPU] getProviders not found\n"); release_runtime(); return false; }
+
+  const QnnInterface_t** providers = nullptr;
+  uint32_t numProviders = 0;
+  if (getProviders(&providers, &numProviders) != QNN_SUCCESS || numProviders == 0) {
+    printf("[NPU] No providers\n"); release_runtime(); return false;
+  }
+
+  const QnnInterface_t* best = nullptr;
+  for (uint32_t i = 0; i < numProviders; ++i) {
+    if (!providers[i]) continue;
+    if (providers[i]->apiVersion.coreApiVersion.major == QNN_API_VERSION_MAJOR) {
+      if (!best || providers[i]->apiVersion.coreApiVersion.minor >
+                       best->apiVersion.coreApiVersion.minor)
+        best = providers[i];
+    }
+  }
+  if (!best) best = providers[0];
+  g_rt.qnn = &best->QNN_INTERFACE_VER_NAME;
+
+  if (g_rt.qnn->logCreate)
+    g_rt.qnn->logCreate(qnnLogCallback, QNN_LOG_LEVEL_ERROR, &g_rt.log);
+
+  if (!check(g_rt.qnn->backendCreate(g_rt.log, nullptr, &g_rt.backend), "backendCreate")) {
+    release_runtime(); return false;
+  }
+  if (g_rt.qnn->deviceCreate) {
+    auto s = g_rt.qnn->deviceCreate(nullptr, nullptr, &g_rt.device);
+    if (s != QNN_SUCCESS && s != QNN_DEVICE_ERROR_UNSUPPORTED_FEATURE) {
+      printf("[NPU] deviceCreate failed: %lu\n", (unsigned long)s);
+      release_runtime(); return false;
+    }
+  }
+
+  setHighPerformanceMode();
+  g_rt.coreCount = queryCoreCount();
+  return true;
+}
+
+// Register combined HeteroEdge op package (SyncWait + RmsNorm in one .so),
+// once per backend. Single package eliminates the inter-package execution
+// boundary overhead (~8x overhead confirmed by test_graph_overhead unit test).
+bool register_sync_op_package() {
+  if (g_rt.syncOpPackage) return true;
+  if (!check(g_rt.qnn->backendRegisterOpPackage(
+        g_rt.backend,
+        "./libQnnHtpHeteroEdgeOpPackage.so",  // aarch64 ARM stub (for prepare)
+        "heteroedgeInterfaceProvider",
+        "CPU"), "registerOpPackage-HeteroEdge-CPU")) {
+    printf("[NPU] Warning: HeteroEdge CPU op package registration failed\n");
+  }
+  if (!check(g_rt.qnn->backendRegisterOpPackage(
+        g_rt.backend,
+        "./htp/libQnnHtpHeteroEdgeOpPackage.so",  // Hexagon V81 DSP skel
+        "heteroedgeInterfaceProvider",
+        "HTP"), "registerOpPackage-HeteroEdge-HTP")) {
+    printf("[NPU] HeteroEdge HTP op package registration failed\n");
+    return false;
+  }
+  g_rt.syncOpPackage = true;
+  return true;
+}
+
 Qnn_Tensor_t makeFp16Tensor(const char* name, Qnn_TensorType_t type,
                               uint32_t* dims, uint32_t rank = kTensorRank) {
   Qnn_Tensor_t t = QNN_TENSOR_INIT;
@@ -172,8 +218,51 @@ Qnn_Tensor_t makeFp16Tensor(const char* name, Qnn_TensorType_t type,
   return t;
 }
 
-bool createAxesTensor(Qnn_Tensor_t& out, uint32_t* axes_data, uint32_t num_axes) {
-  g_dimsAxes[0] = num_axes;
+// Helper: make a UINT32 tensor
+Qnn_Tensor_t makeUint32Tensor(const char* name, Qnn_TensorType_t type,
+                               uint32_t* dims, uint32_t rank = kTensorRank) {
+  Qnn_Tensor_t t = QNN_TENSOR_INIT;
+  t.version      = QNN_TENSOR_VERSION_1;
+  t.v1.id        = 0;
+  t.v1.name      = name;
+  t.v1.type      = type;
+  t.v1.dataFormat     = QNN_TENSOR_DATA_FORMAT_FLAT_BUFFER;
+  t.v1.dataType       = QNN_DATATYPE_UINT_32;
+  t.v1.quantizeParams.encodingDefinition   = QNN_DEFINITION_UNDEFINED;
+  t.v1.quantizeParams.quantizationEncoding = QNN_QUANTIZATION_ENCODING_UNDEFINED;
+  t.v1.rank           = rank;
+  t.v1.dimensions     = dims;
+  t.v1.memType        = QNN_TENSORMEMTYPE_RAW;
+  t.v1.clientBuf      = QNN_CLIENT_BUFFER_INIT;
+  return t;
+}
+
+}  // namespace
+
+// ── NpuEngine ───────────────────────────────────────────────────────────────
+
+// An arena view registers as a shared buffer at its offset in the allocation
+bool NpuEngine::registerBuffer(const IonBuffer& ion, const uint32_t* dims, uint32_t ndims,
+                               Qnn_DataType_t dtype, RegMem& out) {
+  out.handle = memCache_.acquire(ionParent(ion), ion.offset, dims, ndims, dtype);
+  return out.handle != nullptr;
+}
+
+void NpuEngine::deregisterAll() {
+  memCache_.release(regInput_.handle);
+  memCache_.release(regOutput_.handle);
+  memCache_.release(regFlag_.handle);
+  for (auto& slot : slots_) {
+    memCache_.release(slot.input.handle);
+    memCache_.release(slot.output.handle);
+  }
+  slots_.clear();
+  memCache_.clear();
+  regInput_.handle = regOutput_.handle = regFlag_.handle = nullptr;
+}
+
+bool NpuEngine::createAxesTensor(Qnn_Tensor_t& out, uint32_t* axes_data, uint32_t num_axes) {
+  dimsAxes_[0] = num_axes;
   out = QNN_TENSOR_INIT;
   out.version = QNN_TENSOR_VERSION_1;
   out.v1.name = "axes";
@@ -182,27 +271,27 @@ bool createAxesTensor(Qnn_Tensor_t& out, uint32_t* axes_data, uint32_t num_axes)
   out.v1.dataType = QNN_DATATYPE_UINT_32;
   out.v1.quantizeParams.encodingDefinition = QNN_DEFINITION_UNDEFINED;
   out.v1.rank = 1;
-  out.v1.dimensions = g_dimsAxes;
+  out.v1.dimensions = dimsAxes_;
   out.v1.memType = QNN_TENSORMEMTYPE_RAW;
   out.v1.clientBuf.data     = axes_data;
   out.v1.clientBuf.dataSize = num_axes * sizeof(uint32_t);
-  return check(g_qnn->tensorCreateGraphTensor(g_graph, &out), "tensor axes");
-}
-
-bool buildNativeGraph() {
-  Qnn_Tensor_t input  = makeFp16Tensor("input",  QNN_TENSOR_TYPE_APP_WRITE, g_dimsIO);
-  Qnn_Tensor_t output = makeFp16Tensor("output", QNN_TENSOR_TYPE_APP_READ,  g_dimsIO);
-  Qnn_Tensor_t gamma  = makeFp16Tensor("gamma",  QNN_TENSOR_TYPE_STATIC,    g_dimsGamma1D, 1);
-  Qnn_Tensor_t beta   = makeFp16Tensor("beta",   QNN_TENSOR_TYPE_STATIC,    g_dimsGamma1D, 1);
-  gamma.v1.clientBuf.data     = g_ionGamma.ptr;
-  gamma.v1.clientBuf.dataSize = static_cast<uint32_t>(g_ionGamma.size);
-  beta.v1.clientBuf.data      = g_ionBeta.ptr;
-  beta.v1.clientBuf.dataSize  = static_cast<uint32_t>(g_ionBeta.size);
-
-  if (!check(g_qnn->tensorCreateGraphTensor(g_graph, &input),  "tensor input") ||
-      !check(g_qnn->tensorCreateGraphTensor(g_graph, &gamma),  "tensor gamma") ||
-      !check(g_qnn->tensorCreateGraphTensor(g_graph, &beta),   "tensor beta") ||
-      !check(g_qnn->tensorCreateGraphTensor(g_graph, &output), "tensor output"))
+  return check(qnn_->tensorCreateGraphTensor(graph_, &out), "tensor axes");
+}
+
+bool NpuEngine::buildNativeGraph() {
+  Qnn_Tensor_t input  = makeFp16Tensor("input",  QNN_TENSOR_TYPE_APP_WRITE, dimsIO_);
+  Qnn_Tensor_t output = makeFp16Tensor("output", QNN_TENSOR_TYPE_APP_READ,  dimsIO_);
+  Qnn_Tensor_t gamma  = makeFp16Tensor("gamma",  QNN_TENSOR_TYPE_STATIC,    dimsGamma1D_, 1);
+  Qnn_Tensor_t beta   = makeFp16Tensor("beta",   QNN_TENSOR_TYPE_STATIC,    dimsGamma1D_, 1);
+  gamma.v1.clientBuf.data     = ionGamma_.ptr;
+  gamma.v1.clientBuf.dataSize = static_cast<uint32_t>(ionGamma_.size);
+  beta.v1.clientBuf.data      = ionBeta_.ptr;
+  beta.v1.clientBuf.dataSize  = static_cast<uint32_t>(ionBeta_.size);
+
+  if (!check(qnn_->tensorCreateGraphTensor(graph_, &input),  "tensor input") ||
+      !check(qnn_->tensorCreateGraphTensor(graph_, &gamma),  "tensor gamma") ||
+      !check(qnn_->tensorCreateGraphTensor(graph_, &beta),   "tensor beta") ||
+      !check(qnn_->tensorCreateGraphTensor(graph_, &output), "tensor output"))
     return false;
 
   Qnn_Param_t eps_param = QNN_PARAM_INIT;
@@ -234,64 +323,52 @@ bool buildNativeGraph() {
   op.v1.numOfInputs  = 3; op.v1.inputTensors  = opIn;
   op.v1.numOfOutputs = 1; op.v1.outputTensors = opOut;
 
-  if (!check(g_qnn->graphAddNode(g_graph, op), "graphAddNode(RmsNorm)"))
+  if (!check(qnn_->graphAddNode(graph_, op), "graphAddNode(RmsNorm)"))
     return false;
 
-  g_execInputs[0] = input;
-  g_execOutputs[0] = output;
+  execInputs_[0] = input;
+  execOutputs_[0] = output;
   return true;
 }
 
-// Helper: make a UINT32 tensor
-Qnn_Tensor_t makeUint32Tensor(const char* name, Qnn_TensorType_t type,
-                               uint32_t* dims, uint32_t rank = kTensorRank) {
-  Qnn_Tensor_t t = QNN_TENSOR_INIT;
-  t.version      = QNN_TENSOR_VERSION_1;
-  t.v1.id        = 0;
-  t.v1.name      = name;
-  t.v1.type      = type;
-  t.v1.dataFormat     = QNN_TENSOR_DATA_FORMAT_FLAT_BUFFER;
-  t.v1.dataType       = QNN_DATATYPE_UINT_32;
-  t.v1.quantizeParams.encodingDefinition   = QNN_DEFINITION_UNDEFINED;
-  t.v1.quantizeParams.quantizationEncoding = QNN_QUANTIZATION_ENCODING_UNDEFINED;
-  t.v1.rank           = rank;
-  t.v1.dimensions     = dims;
-  t.v1.memType        = QNN_TENSORMEMTYPE_RAW;
-  t.v1.clientBuf      = QNN_CLIENT_BUFFER_INIT;
-  return t;
-}
-
 // Build graph with SyncWait custom op:
-//   Input[ION] + GPUFlag[ION] → SyncWait → sw_out[NATIVE] → RmsNorm → Output[ION]
-bool buildSyncGraph() {
+//   Input[ION] + WaitEpoch[ION] → SyncWait → sw_out[NATIVE] → RmsNorm → Output[ION]
+bool NpuEngine::buildSyncGraph() {
   // Tensors for SyncWait op
-  Qnn_Tensor_t sw_input = makeFp16Tensor("sw_input", QNN_TENSOR_TYPE_APP_WRITE, g_dimsIO);
-  Qnn_Tensor_t sw_flag  = makeUint32Tensor("sw_flag", QNN_TENSOR_TYPE_APP_WRITE, g_dimsFlagIO);
-  Qnn_Tensor_t sw_out   = makeFp16Tensor("sw_out", QNN_TENSOR_TYPE_NATIVE, g_dimsIO);
+  Qnn_Tensor_t sw_input = makeFp16Tensor("sw_input", QNN_TENSOR_TYPE_APP_WRITE, dimsIO_);
+  Qnn_Tensor_t sw_flag  = makeUint32Tensor("sw_flag", QNN_TENSOR_TYPE_APP_WRITE, dimsFlagIO_);
+  Qnn_Tensor_t sw_out   = makeFp16Tensor("sw_out", QNN_TENSOR_TYPE_NATIVE, dimsIO_);
 
   // Tensors for custom HVX RmsNorm op (no beta - custom op only takes data + gamma)
-  Qnn_Tensor_t output = makeFp16Tensor("output", QNN_TENSOR_TYPE_APP_READ, g_dimsIO);
-  Qnn_Tensor_t gamma  = makeFp16Tensor("gamma",  QNN_TENSOR_TYPE_STATIC, g_dimsGamma1D, 1);
-  gamma.v1.clientBuf.data     = g_ionGamma.ptr;
-  gamma.v1.clientBuf.dataSize = static_cast<uint32_t>(g_ionGamma.size);
-
-  if (!check(g_qnn->tensorCreateGraphTensor(g_graph, &sw_input),  "tensor sw_input") ||
-      !check(g_qnn->tensorCreateGraphTensor(g_graph, &sw_flag),   "tensor sw_flag") ||
-      !check(g_qnn->tensorCreateGraphTensor(g_graph, &sw_out),    "tensor sw_out") ||
-      !check(g_qnn->tensorCreateGraphTensor(g_graph, &gamma),     "tensor gamma") ||
-      !check(g_qnn->tensorCreateGraphTensor(g_graph, &output),    "tensor output"))
+  Qnn_Tensor_t output = makeFp16Tensor("output", QNN_TENSOR_TYPE_APP_READ, dimsIO_);
+  Qnn_Tensor_t gamma  = makeFp16Tensor("gamma",  QNN_TENSOR_TYPE_STATIC, dimsGamma1D_, 1);
+  gamma.v1.clientBuf.data     = ionGamma_.ptr;
+  gamma.v1.clientBuf.dataSize = static_cast<uint32_t>(ionGamma_.size);
+
+  if (!check(qnn_->tensorCreateGraphTensor(graph_, &sw_input),  "tensor sw_input") ||
+      !check(qnn_->tensorCreateGraphTensor(graph_, &sw_flag),   "tensor sw_flag") ||
+      !check(qnn_->tensorCreateGraphTensor(graph_, &sw_out),    "tensor sw_out") ||
+      !check(qnn_->tensorCreateGraphTensor(graph_, &gamma),     "tensor gamma") ||
+      !check(qnn_->tensorCreateGraphTensor(graph_, &output),    "tensor output"))
     return false;
 
-  // SyncWait node: polls GPU flag on DSP, then passes data through
-  // flag_ion_fd param enables HAP_mmap_get() for direct DDR polling on DSP
+  // SyncWait node: waits on DSP until the GPU flag reaches the wait epoch, then
+  // passes data through. flag_ion_fd + flag_offset locate the flag in the GPU
+  // flag table via HAP_mmap_get() for direct DDR polling on DSP
   {
     Qnn_Param_t fd_param = QNN_PARAM_INIT;
     fd_param.paramType                = QNN_PARAMTYPE_SCALAR;
     fd_param.name                     = "flag_ion_fd";
     fd_param.scalarParam.dataType     = QNN_DATATYPE_UINT_32;
-    fd_param.scalarParam.uint32Value  = g_flagIonFd;
+    fd_param.scalarParam.uint32Value  = flagIonFd_;
+
+    Qnn_Param_t off_param = QNN_PARAM_INIT;
+    off_param.paramType               = QNN_PARAMTYPE_SCALAR;
+    off_param.name                    = "flag_offset";
+    off_param.scalarParam.dataType    = QNN_DATATYPE_UINT_32;
+    off_param.scalarParam.uint32Value = flagOffset_;
 
-    Qnn_Param_t sw_params[] = {fd_param};
+    Qnn_Param_t sw_params[] = {fd_param, off_param};
     Qnn_Tensor_t swIn[]  = {sw_input, sw_flag};
     Qnn_Tensor_t swOut[] = {sw_out};
     Qnn_OpConfig_t op = QNN_OPCONFIG_INIT;
@@ -299,10 +376,10 @@ bool buildSyncGraph() {
     op.v1.name        = "syncwait";
     op.v1.packageName = "heteroedge.HvxOpPackage";
     op.v1.typeName    = "SyncWait";
-    op.v1.numOfParams  = 1; op.v1.params = sw_params;
+    op.v1.numOfParams  = 2; op.v1.params = sw_params;
     op.v1.numOfInputs  = 2; op.v1.inputTensors  = swIn;
     op.v1.numOfOutputs = 1; op.v1.outputTensors = swOut;
-    if (!check(g_qnn->graphAddNode(g_graph, op), "graphAddNode(SyncWait)"))
+    if (!check(qnn_->graphAddNode(graph_, op), "graphAddNode(SyncWait)"))
       return false;
   }
 
@@ -326,19 +403,76 @@ bool buildSyncGraph() {
     op.v1.numOfParams  = 1; op.v1.params        = params;
     op.v1.numOfInputs  = 2; op.v1.inputTensors  = opIn;
     op.v1.numOfOutputs = 1; op.v1.outputTensors = opOut;
-    if (!check(g_qnn->graphAddNode(g_graph, op), "graphAddNode(RmsNorm)"))
+    if (!check(qnn_->graphAddNode(graph_, op), "graphAddNode(RmsNorm)"))
       return false;
   }
 
-  // Exec tensors: 2 inputs (data + flag), 1 output
-  g_execInputs[0] = sw_input;
-  g_execInputs[1] = sw_flag;
-  g_execOutputs[0] = output;
-  g_numExecInputs = 2;
+  // Exec tensors: 2 inputs (data + wait epoch), 1 output
+  execInputs_[0] = sw_input;
+  execInputs_[1] = sw_flag;
+  execOutputs_[0] = output;
+  numExecInputs_ = 2;
+  return true;
+}
+
+// Build graph with the persistent custom op (heteroedge_op/persistent_protocol.h):
+//   Input[ION] + Burst[ION] → PersistentRmsNorm → Output[ION scratch]
+// The op reads / writes the shared buffers itself via HAP_mmap_get(); the
+// graph tensors only carry the burst descriptor and the graph dependency.
+bool NpuEngine::buildPersistentGraph() {
+  Qnn_Tensor_t pr_input = makeFp16Tensor("pr_input", QNN_TENSOR_TYPE_APP_WRITE, dimsIO_);
+  Qnn_Tensor_t pr_burst = makeUint32Tensor("pr_burst", QNN_TENSOR_TYPE_APP_WRITE, dimsBurst_);
+  Qnn_Tensor_t output   = makeFp16Tensor("output", QNN_TENSOR_TYPE_APP_READ, dimsIO_);
+  Qnn_Tensor_t gamma    = makeFp16Tensor("gamma",  QNN_TENSOR_TYPE_STATIC, dimsGamma1D_, 1);
+  gamma.v1.clientBuf.data     = ionGamma_.ptr;
+  gamma.v1.clientBuf.dataSize = static_cast<uint32_t>(ionGamma_.size);
+
+  if (!check(qnn_->tensorCreateGraphTensor(graph_, &pr_input), "tensor pr_input") ||
+      !check(qnn_->tensorCreateGraphTensor(graph_, &pr_burst), "tensor pr_burst") ||
+      !check(qnn_->tensorCreateGraphTensor(graph_, &gamma),    "tensor gamma") ||
+      !check(qnn_->tensorCreateGraphTensor(graph_, &output),   "tensor output"))
+    return false;
+
+  auto u32 = [](const char* name, uint32_t v) {
+    Qnn_Param_t p = QNN_PARAM_INIT;
+    p.paramType               = QNN_PARAMTYPE_SCALAR;
+    p.name                    = name;
+    p.scalarParam.dataType    = QNN_DATATYPE_UINT_32;
+    p.scalarParam.uint32Value = v;
+    return p;
+  };
+  Qnn_Param_t eps_param = QNN_PARAM_INIT;
+  eps_param.paramType    = QNN_PARAMTYPE_SCALAR;
+  eps_param.name         = "epsilon";
+  eps_param.scalarParam.dataType   = QNN_DATATYPE_FLOAT_32;
+  eps_param.scalarParam.floatValue = 1e-6f;
+
+  Qnn_Param_t params[] = {eps_param,
+                          u32("flag_ion_fd", flagIonFd_), u32("flag_offset", flagOffset_),
+                          u32("done_offset", doneOffset_),
+                          u32("in_ion_fd", inIonFd_), u32("out_ion_fd", outIonFd_)};
+  Qnn_Tensor_t opIn[]  = {pr_input, gamma, pr_burst};
+  Qnn_Tensor_t opOut[] = {output};
+  Qnn_OpConfig_t op = QNN_OPCONFIG_INIT;
+  op.version = QNN_OPCONFIG_VERSION_1;
+  op.v1.name        = "persistent_rmsnorm";
+  op.v1.packageName = "heteroedge.HvxOpPackage";
+  op.v1.typeName    = "PersistentRmsNorm";
+  op.v1.numOfParams  = 6; op.v1.params        = params;
+  op.v1.numOfInputs  = 3; op.v1.inputTensors  = opIn;
+  op.v1.numOfOutputs = 1; op.v1.outputTensors = opOut;
+  if (!check(qnn_->graphAddNode(graph_, op), "graphAddNode(PersistentRmsNorm)"))
+    return false;
+
+  // Exec tensors: 2 inputs (data + burst descriptor), 1 output
+  execInputs_[0] = pr_input;
+  execInputs_[1] = pr_burst;
+  execOutputs_[0] = output;
+  numExecInputs_ = 2;
   return true;
 }
 
-bool buildGraph(bool use_sync = false) {
+bool NpuEngine::buildGraph(GraphKind kind) {
   QnnHtpGraph_CustomConfig_t htpCfgs[4] = {QNN_HTP_GRAPH_CUSTOM_CONFIG_INIT,
                                              QNN_HTP_GRAPH_CUSTOM_CONFIG_INIT,
                                              QNN_HTP_GRAPH_CUSTOM_CONFIG_INIT,
@@ -348,9 +482,9 @@ bool buildGraph(bool use_sync = false) {
   htpCfgs[cfgCount].option    = QNN_HTP_GRAPH_CONFIG_OPTION_PRECISION;
   htpCfgs[cfgCount].precision = QNN_PRECISION_FLOAT16;
   cfgCount++;
-  if (g_coreCount > 0) {
+  if (coreCount_ > 0) {
     htpCfgs[cfgCount].option   = QNN_HTP_GRAPH_CONFIG_OPTION_NUM_CORES;
-    htpCfgs[cfgCount].numCores = g_coreCount;
+    htpCfgs[cfgCount].numCores = coreCount_;
     cfgCount++;
   }
   htpCfgs[cfgCount].option        = QNN_HTP_GRAPH_CONFIG_OPTION_NUM_HVX_THREADS;
@@ -362,179 +496,350 @@ bool buildGraph(bool use_sync = false) {
   graphCfg.customConfig = htpCfgs;
   const QnnGraph_Config_t* graphCfgList[] = {&graphCfg, nullptr};
 
-  const char* graph_name = use_sync ? "rmsnorm_sync_graph" : "rmsnorm_graph";
-  if (!check(g_qnn->graphCreate(g_context, graph_name, graphCfgList, &g_graph), "graphCreate"))
+  const char* graph_name = kind == GraphKind::SYNC       ? "rmsnorm_sync_graph"
+                         : kind == GraphKind::PERSISTENT ? "rmsnorm_persistent_graph"
+                                                         : "rmsnorm_graph";
+  if (!check(qnn_->graphCreate(context_, graph_name, graphCfgList, &graph_), "graphCreate"))
     return false;
 
-  bool ok = use_sync ? buildSyncGraph() : buildNativeGraph();
-  if (!ok) { g_graph = nullptr; return false; }
+  bool ok = kind == GraphKind::SYNC       ? buildSyncGraph()
+          : kind == GraphKind::PERSISTENT ? buildPersistentGraph()
+                                          : buildNativeGraph();
+  if (!ok) { graph_ = nullptr; return false; }
 
-  if (!check(g_qnn->graphFinalize(g_graph, nullptr, nullptr), "graphFinalize")) {
-    g_graph = nullptr; return false;
+  if (!check(qnn_->graphFinalize(graph_, nullptr, nullptr), "graphFinalize")) {
+    graph_ = nullptr; return false;
   }
   return true;
 }
 
-}  // namespace
-
-void npu_print_info() {
-  printf("  NPU: Hexagon V81, %u core(s), Native RmsNorm (FP16)\n", g_coreCount);
+void NpuEngine::print_info() const {
+  printf("  NPU: Hexagon V81, %u core(s), Native RmsNorm (FP16)\n", coreCount_);
 }
 
-// Shared init logic: dlopen QNN, create backend/device/context.
-// Returns false on failure. Sets g_qnn, g_backend, g_device, g_context, g_coreCount.
-static bool npu_init_common(int hidden_dim) {
-  g_hidden = hidden_dim;
+// Shared init logic: take a reference on the QNN runtime, create this
+// engine's context. Returns false on failure.
+bool NpuEngine::init_common(int hidden_dim) {
+  hidden_ = hidden_dim;
   size_t gamma_bytes = (size_t)hidden_dim * 2;
 
-  g_dimsIO[0] = 1; g_dimsIO[1] = 1; g_dimsIO[2] = 1; g_dimsIO[3] = hidden_dim;
-  g_dimsFlagIO[0] = 1; g_dimsFlagIO[1] = 1; g_dimsFlagIO[2] = 1; g_dimsFlagIO[3] = 1;
-  g_dimsGamma1D[0] = hidden_dim;
-
-  if (!allocIonBuffer(gamma_bytes, 0, g_ionGamma) ||
-      !allocIonBuffer(gamma_bytes, 0, g_ionBeta)) {
+  dimsIO_[0] = 1; dimsIO_[1] = 1; dimsIO_[2] = 1; dimsIO_[3] = hidden_dim;
+  dimsFlagIO_[0] = 1; dimsFlagIO_[1] = 1; dimsFlagIO_[2] = 1; dimsFlagIO_[3] = 1;
+  dimsBurst_[0] = 1; dimsBurst_[1] = 1; dimsBurst_[2] = 1;
+  dimsBurst_[3] = heteroedge::kBurstWords;
+  dimsGamma1D_[0] = hidden_dim;
+  if (!htp_dims_ok(dimsIO_))  // C is the normalized axis here: cannot be re-planned
+    printf("[NPU] hidden=%d exceeds the HTP channel limit %u: expect a tiler fallback\n",
+           hidden_dim, kHtpMaxChannels);
+
+  if (!allocIonBuffer(gamma_bytes, 0, ionGamma_) ||
+      !allocIonBuffer(gamma_bytes, 0, ionBeta_)) {
     printf("[NPU] Failed to alloc ION gamma/beta\n"); return false;
   }
   uint16_t one = float_to_half(1.0f);
-  uint16_t* gp = reinterpret_cast<uint16_t*>(g_ionGamma.ptr);
+  uint16_t* gp = reinterpret_cast<uint16_t*>(ionGamma_.ptr);
   for (int i = 0; i < hidden_dim; ++i) gp[i] = one;
 
-  g_libHandle = dlopen("libQnnHtp.so", RTLD_NOW | RTLD_LOCAL);
-  if (!g_libHandle) { printf("[NPU] dlopen failed: %s\n", dlerror()); return false; }
+  if (!acquire_runtime()) return false;
+  qnn_ = g_rt.qnn;
+  coreCount_ = g_rt.coreCount;
 
-  using GetProvidersFn = decltype(&QnnInterface_getProviders);
-  auto getProviders = reinterpret_cast<GetProvidersFn>(
-      dlsym(g_libHandle, "QnnInterface_getProviders"));
-  if (!getProviders) { printf("[NPU] getProviders not found\n"); return false; }
+  if (!check(qnn_->contextCreate(g_rt.backend, g_rt.device, nullptr, &context_), "contextCreate"))
+    return false;
+  memCache_.init(qnn_, context_);
+  return true;
+}
 
-  const QnnInterface_t** providers = nullptr;
-  uint32_t numProviders = 0;
-  if (getProviders(&providers, &numProviders) != QNN_SUCCESS || numProviders == 0) {
-    printf("[NPU] No providers\n"); return false;
-  }
+bool NpuEngine::init(int hidden_dim, float epsilon,
+                     const IonBuffer& ion_input, const IonBuffer& ion_output) {
+  if (!init_common(hidden_dim)) return false;
 
-  const QnnInterface_t* best = nullptr;
-  for (uint32_t i = 0; i < numProviders; ++i) {
-    if (!providers[i]) continue;
-    if (providers[i]->apiVersion.coreApiVersion.major == QNN_API_VERSION_MAJOR) {
-      if (!best || providers[i]->apiVersion.coreApiVersion.minor >
-                       best->apiVersion.coreApiVersion.minor)
-        best = providers[i];
-    }
-  }
-  if (!best) best = providers[0];
-  g_qnn = &best->QNN_INTERFACE_VER_NAME;
-
-  if (g_qnn->logCreate)
-    g_qnn->logCreate(qnnLogCallback, QNN_LOG_LEVEL_ERROR, &g_log);
+  numExecInputs_ = 1;
 
-  if (!check(g_qnn->backendCreate(g_log, nullptr, &g_backend), "backendCreate"))
+  if (!registerBuffer(ion_input,  dimsIO_, kTensorRank, QNN_DATATYPE_FLOAT_16, regInput_) ||
+      !registerBuffer(ion_output, dimsIO_, kTensorRank, QNN_DATATYPE_FLOAT_16, regOutput_))
     return false;
-  if (g_qnn->deviceCreate) {
-    auto s = g_qnn->deviceCreate(nullptr, nullptr, &g_device);
-    if (s != QNN_SUCCESS && s != QNN_DEVICE_ERROR_UNSUPPORTED_FEATURE) {
-      printf("[NPU] deviceCreate failed: %lu\n", (unsigned long)s); return false;
-    }
-  }
 
-  setHighPerformanceMode();
-
-  if (!check(g_qnn->contextCreate(g_backend, g_device, nullptr, &g_context), "contextCreate"))
+  if (!buildGraph(GraphKind::NATIVE))
     return false;
 
-  g_coreCount = queryCoreCount();
+  execInputs_[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+  execInputs_[0].v1.memHandle = regInput_.handle;
+  execOutputs_[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+  execOutputs_[0].v1.memHandle = regOutput_.handle;
+
   return true;
 }
 
-bool npu_init(int hidden_dim, float epsilon,
-              const IonBuffer& ion_input, const IonBuffer& ion_output) {
-  if (!npu_init_common(hidden_dim)) return false;
+bool NpuEngine::init_with_sync(int hidden_dim, float epsilon,
+                               const IonBuffer& ion_input, const IonBuffer& ion_output,
+                               const IonBuffer& ion_flag_table, int flag_index) {
+  if (ion_flag_table.fd <= 0) {
+    // SyncWait would have nothing to poll and fail every execution
+    printf("[NPU] SyncWait needs an ION flag table (fd %d)\n", ion_flag_table.fd);
+    return false;
+  }
+  if (!init_common(hidden_dim)) return false;
+
+  // Store flag table ION fd + flag offset for buildSyncGraph() → SyncWait static params.
+  // On DSP, HAP_mmap_get(fd) maps this to DSP VA for direct DDR polling.
+  flagIonFd_  = (uint32_t)ion_flag_table.fd;
+  flagOffset_ = (uint32_t)(ion_flag_table.offset + flag_offset_bytes(flag_index));
+  printf("[NPU] SyncWait: flag_ion_fd=%u offset=%u (HAP_mmap_get for direct DDR polling)\n",
+         flagIonFd_, flagOffset_);
+
+  if (!allocIonBuffer(sizeof(uint32_t), 0, ionWaitEpoch_)) {
+    printf("[NPU] Failed to alloc ION wait epoch\n"); return false;
+  }
 
-  g_numExecInputs = 1;
+  if (!register_sync_op_package())
+    return false;
+
+  numExecInputs_ = 2;
 
-  if (!registerBuffer(ion_input,  g_dimsIO, kTensorRank, QNN_DATATYPE_FLOAT_16, g_regInput) ||
-      !registerBuffer(ion_output, g_dimsIO, kTensorRank, QNN_DATATYPE_FLOAT_16, g_regOutput))
+  if (!registerBuffer(ion_input,     dimsIO_,     kTensorRank, QNN_DATATYPE_FLOAT_16, regInput_) ||
+      !registerBuffer(ion_output,    dimsIO_,     kTensorRank, QNN_DATATYPE_FLOAT_16, regOutput_) ||
+      !registerBuffer(ionWaitEpoch_, dimsFlagIO_, kTensorRank, QNN_DATATYPE_UINT_32,  regFlag_))
     return false;
 
-  if (!buildGraph(false))
+  if (!buildGraph(GraphKind::SYNC))
     return false;
 
-  g_execInputs[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
-  g_execInputs[0].v1.memHandle = g_regInput.handle;
-  g_execOutputs[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
-  g_execOutputs[0].v1.memHandle = g_regOutput.handle;
+  // Bind input[0] = data, input[1] = wait epoch
+  execInputs_[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+  execInputs_[0].v1.memHandle = regInput_.handle;
+  execInputs_[1].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+  execInputs_[1].v1.memHandle = regFlag_.handle;
+  execOutputs_[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+  execOutputs_[0].v1.memHandle = regOutput_.handle;
 
   return true;
 }
 
-bool npu_init_with_sync(int hidden_dim, float epsilon,
-                        const IonBuffer& ion_input, const IonBuffer& ion_output,
-                        const IonBuffer& ion_gpu_flag) {
-  if (!npu_init_common(hidden_dim)) return false;
-
-  // Store flag ION fd for buildSyncGraph() → SyncWait static param.
-  // On DSP, HAP_mmap_get(fd) maps this to DSP VA for direct DDR polling.
-  g_flagIonFd = (uint32_t)ion_gpu_flag.fd;
-  printf("[NPU] SyncWait: flag_ion_fd=%u (HAP_mmap_get for direct DDR polling)\n", g_flagIonFd);
-
-  // Register combined HeteroEdge op package (SyncWait + RmsNorm in one .so).
-  // Single package eliminates the inter-package execution boundary overhead
-  // (~8x overhead confirmed by test_graph_overhead unit test).
-  if (!check(g_qnn->backendRegisterOpPackage(
-        g_backend,
-        "./libQnnHtpHeteroEdgeOpPackage.so",  // aarch64 ARM stub (for prepare)
-        "heteroedgeInterfaceProvider",
-        "CPU"), "registerOpPackage-HeteroEdge-CPU")) {
-    printf("[NPU] Warning: HeteroEdge CPU op package registration failed\n");
+bool NpuEngine::init_persistent(int hidden_dim, float epsilon,
+                                const IonBuffer& ion_input, const IonBuffer& ion_output,
+                                const IonBuffer& ion_flag_table, int wait_index, int done_index) {
+  // The op maps the in/out fds itself and reads from their start
+  if (ionIsView(ion_input) || ionIsView(ion_output)) {
+    printf("[NPU] PersistentRmsNorm needs whole input/output buffers, not arena views\n");
+    return false;
   }
-  if (!check(g_qnn->backendRegisterOpPackage(
-        g_backend,
-        "./htp/libQnnHtpHeteroEdgeOpPackage.so",  // Hexagon V81 DSP skel
-        "heteroedgeInterfaceProvider",
-        "HTP"), "registerOpPackage-HeteroEdge-HTP")) {
-    printf("[NPU] HeteroEdge HTP op package registration failed\n");
+  if (ion_flag_table.fd <= 0 || ion_flag_table.size < kFlagTableBytes) {
+    printf("[NPU] PersistentRmsNorm needs an ION flag table (fd %d)\n", ion_flag_table.fd);
     return false;
   }
+  if (!init_common(hidden_dim)) return false;
+
+  flagIonFd_  = (uint32_t)ion_flag_table.fd;
+  flagOffset_ = (uint32_t)(ion_flag_table.offset + flag_offset_bytes(wait_index));
+  doneOffset_ = (uint32_t)(ion_flag_table.offset + flag_offset_bytes(done_index));
+  doneFlag_   = EpochFlagTable<uint32_t>(ion_flag_table).flag(done_index);
+  inIonFd_    = (uint32_t)ion_input.fd;
+  outIonFd_   = (uint32_t)ion_output.fd;
+  printf("[NPU] PersistentRmsNorm: flag_ion_fd=%u wait=%u done=%u in_fd=%u out_fd=%u\n",
+         flagIonFd_, flagOffset_, doneOffset_, inIonFd_, outIonFd_);
+
+  if (!allocIonBuffer(sizeof(heteroedge::PersistentBurst), 0, ionBurst_) ||
+      !allocIonBuffer((size_t)hidden_dim * 2, 0, ionBurstOut_)) {
+    printf("[NPU] Failed to alloc ION burst descriptor\n"); return false;
+  }
 
-  g_numExecInputs = 2;
-
-  if (!registerBuffer(ion_input,    g_dimsIO,     kTensorRank, QNN_DATATYPE_FLOAT_16, g_regInput) ||
-      !registerBuffer(ion_output,   g_dimsIO,     kTensorRank, QNN_DATATYPE_FLOAT_16, g_regOutput) ||
-      !registerBuffer(ion_gpu_flag, g_dimsFlagIO, kTensorRank, QNN_DATATYPE_UINT_32,  g_regFlag))
+  if (!register_sync_op_package())
     return false;
 
-  if (!buildGraph(true))
+  // The op maps the shared buffers itself; registering them still puts the
+  // fds in the CDSP address space for HAP_mmap_get()
+  if (!registerBuffer(ion_input,    dimsIO_,    kTensorRank, QNN_DATATYPE_FLOAT_16, regInput_) ||
+      !registerBuffer(ionBurstOut_, dimsIO_,    kTensorRank, QNN_DATATYPE_FLOAT_16, regOutput_) ||
+      !registerBuffer(ionBurst_,    dimsBurst_, kTensorRank, QNN_DATATYPE_UINT_32,  regFlag_))
     return false;
 
-  // Bind input[0] = data, input[1] = GPU flag
-  g_execInputs[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
-  g_execInputs[0].v1.memHandle = g_regInput.handle;
-  g_execInputs[1].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
-  g_execInputs[1].v1.memHandle = g_regFlag.handle;
-  g_execOutputs[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
-  g_execOutputs[0].v1.memHandle = g_regOutput.handle;
+  if (!buildGraph(GraphKind::PERSISTENT))
+    return false;
 
+  execInputs_[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+  execInputs_[0].v1.memHandle = regInput_.handle;
+  execInputs_[1].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+  execInputs_[1].v1.memHandle = regFlag_.handle;
+  execOutputs_[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+  execOutputs_[0].v1.memHandle = regOutput_.handle;
   return true;
 }
 
-double npu_execute_blocking() {
+uint32_t NpuEngine::execute_burst(uint32_t wait_epoch, uint32_t steps, uint32_t done_epoch) {
+  auto* burst = reinterpret_cast<volatile heteroedge::PersistentBurst*>(ionBurst_.ptr);
+  burst->wait_epoch = wait_epoch;
+  burst->steps      = steps;
+  burst->done_epoch = done_epoch;
+  execute_blocking();  // a burst the op could not run fails here, publishing nothing
+  return heteroedge::burst_steps_done({wait_epoch, steps, done_epoch}, *doneFlag_);
+}
+
+void NpuEngine::set_wait_epoch(uint32_t epoch) {
+  *reinterpret_cast<volatile uint32_t*>(ionWaitEpoch_.ptr) = epoch;
+}
+
+double NpuEngine::execute_blocking() {
   double t0 = now_us();
-  g_qnn->graphExecute(g_graph, g_execInputs, g_numExecInputs, g_execOutputs, 1, nullptr, nullptr);
+  // A failed SyncWait (no flag mapping, poll timeout) surfaces here
+  check(qnn_->graphExecute(graph_, execInputs_, numExecInputs_, execOutputs_, 1, nullptr, nullptr),
+        "graphExecute");
   double t1 = now_us();
   return t1 - t0;
 }
 
-void npu_cleanup() {
+int NpuEngine::add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output) {
+  Slot slot;
+  if (!registerBuffer(ion_input,  dimsIO_, kTensorRank, QNN_DATATYPE_FLOAT_16, slot.input) ||
+      !registerBuffer(ion_output, dimsIO_, kTensorRank, QNN_DATATYPE_FLOAT_16, slot.output)) {
+    memCache_.release(slot.input.handle);
+    memCache_.release(slot.output.handle);
+    return -1;
+  }
+
+  // Same graph tensors as slot-less execution, rebound to this slot's handles
+  for (uint32_t i = 0; i < numExecInputs_; ++i) slot.execInputs[i] = execInputs_[i];
+  slot.execOutputs[0] = execOutputs_[0];
+  slot.execInputs[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+  slot.execInputs[0].v1.memHandle = slot.input.handle;
+  slot.execOutputs[0].v1.memType   = QNN_TENSORMEMTYPE_MEMHANDLE;
+  slot.execOutputs[0].v1.memHandle = slot.output.handle;
+
+  slots_.push_back(slot);
+  return static_cast<int>(slots_.size()) - 1;
+}
+
+double NpuEngine::execute_slot(int slot) {
+  Slot& s = slots_[slot];
+  double t0 = now_us();
+  check(qnn_->graphExecute(graph_, s.execInputs, numExecInputs_, s.execOutputs, 1, nullptr, nullptr),
+        "graphExecute");
+  return now_us() - t0;
+}
+
+bool NpuEngine::execute_async(int slot, void (*fn)(void*), void* param) {
+  std::lock_guard<std::mutex> lock(asyncMutex_);
+  // Ring full: the slot about to be reused belongs to a call whose notify has
+  // not run yet; wait for it rather than overwrite its fn / param
+  const uint32_t launched = asyncLaunched_;
+  SpinYieldWait::wait(asyncCompleted_, [launched](uint32_t done) {
+    return launched - done < kAsyncQueueDepth;
+  });
+  AsyncCall& call = asyncCalls_[launched % kAsyncQueueDepth];
+  call.engine = this;
+  call.fn = fn;
+  call.param = param;
+  const Qnn_Tensor_t* inputs = slot >= 0 ? slots_[slot].execInputs : execInputs_;
+  Qnn_Tensor_t* outputs = slot >= 0 ? slots_[slot].execOutputs : execOutputs_;
+  if (!check(qnn_->graphExecuteAsync(graph_, inputs, numExecInputs_, outputs, 1, nullptr,
+                                     nullptr, &onAsyncNotify, &call),
+             "graphExecuteAsync"))
+    return false;
+  ++asyncLaunched_;
+  return true;
+}
+
+void NpuEngine::onAsyncNotify(void* notifyParam, Qnn_NotifyStatus_t status) {
+  check(status.error, "async graph execution");
+  // Copy the call out, then free its ring slot before running the callback:
+  // the caller may launch again (and reuse the slot) from inside fn
+  AsyncCall* call = static_cast<AsyncCall*>(notifyParam);
+  const AsyncCall mine = *call;
+  mine.engine->asyncCompleted_.fetch_add(1, std::memory_order_release);
+  mine.fn(mine.param);
+  mine.engine->asyncFinished_.fetch_add(1, std::memory_order_release);
+}
+
+void NpuEngine::drain_async() {
+  std::lock_guard<std::mutex> lock(asyncMutex_);
+  const uint32_t launched = asyncLaunched_;
+  SpinYieldWait::wait(asyncFinished_, [launched](uint32_t done) { return done == launched; });
+}
+
+void NpuEngine::cleanup() {
+  memCache_.print_stats("[NPU]");
+  // Every notify must have returned before the context (and the caller's
+  // callback state) goes away
+  drain_async();
   deregisterAll();
-  if (g_qnn && g_context) g_qnn->contextFree(g_context, nullptr);
-  if (g_qnn && g_device && g_qnn->deviceFree) g_qnn->deviceFree(g_device);
-  if (g_qnn && g_backend) g_qnn->backendFree(g_backend);
-  if (g_qnn && g_log && g_qnn->logFree) g_qnn->logFree(g_log);
-  if (g_libHandle) dlclose(g_libHandle);
-  g_context = nullptr; g_device = nullptr; g_backend = nullptr;
-  g_graph = nullptr; g_qnn = nullptr; g_libHandle = nullptr; g_log = nullptr;
-  g_flagIonFd = 0;
-
-  freeIonBuffer(g_ionGamma);
-  freeIonBuffer(g_ionBeta);
+  if (qnn_ && context_) qnn_->contextFree(context_, nullptr);
+  if (qnn_) release_runtime();
+  context_ = nullptr; graph_ = nullptr; qnn_ = nullptr;
+  flagIonFd_ = 0; flagOffset_ = 0;
+  doneOffset_ = 0; doneFlag_ = nullptr; inIonFd_ = 0; outIonFd_ = 0;
+  asyncLaunched_ = 0;
+  asyncCompleted_.store(0, std::memory_order_relaxed);
+  asyncFinished_.store(0, std::memory_order_relaxed);
+
+  freeIonBuffer(ionGamma_);
+  freeIonBuffer(ionBeta_);
+  freeIonBuffer(ionWaitEpoch_);
+  freeIonBuffer(ionBurst_);
+  freeIonBuffer(ionBurstOut_);
+}
+
+// ── Process-default instance ────────────────────────────────────────────────
+// With --sim every wrapper goes to the simulated engine instead (sim_engine.h).
+
+NpuEngine& npu_default_engine() { return g_engine; }
+
+bool npu_init(int hidden_dim, float epsilon,
+              const IonBuffer& ion_input, const IonBuffer& ion_output) {
+  if (sim_enabled()) return sim_npu_engine().init(hidden_dim, epsilon, ion_input, ion_output);
+  return g_engine.init(hidden_dim, epsilon, ion_input, ion_output);
+}
+bool npu_init_with_sync(int hidden_dim, float epsilon,
+                        const IonBuffer& ion_input, const IonBuffer& ion_output,
+                        const IonBuffer& ion_flag_table, int flag_index) {
+  if (sim_enabled())
+    return sim_npu_engine().init_with_sync(hidden_dim, epsilon, ion_input, ion_output,
+                                           ion_flag_table, flag_index);
+  return g_engine.init_with_sync(hidden_dim, epsilon, ion_input, ion_output,
+                                 ion_flag_table, flag_index);
+}
+bool npu_init_persistent(int hidden_dim, float epsilon,
+                         const IonBuffer& ion_input, const IonBuffer& ion_output,
+                         const IonBuffer& ion_flag_table, int wait_index, int done_index) {
+  if (sim_enabled())
+    return sim_npu_engine().init_persistent(hidden_dim, epsilon, ion_input, ion_output,
+                                            ion_flag_table, wait_index, done_index);
+  return g_engine.init_persistent(hidden_dim, epsilon, ion_input, ion_output,
+                                  ion_flag_table, wait_index, done_index);
+}
+void npu_set_wait_epoch(uint32_t epoch) {
+  if (sim_enabled()) sim_npu_engine().set_wait_epoch(epoch);
+  else               g_engine.set_wait_epoch(epoch);
+}
+uint32_t npu_execute_burst(uint32_t wait_epoch, uint32_t steps, uint32_t done_epoch) {
+  return sim_enabled() ? sim_npu_engine().execute_burst(wait_epoch, steps, done_epoch)
+                       : g_engine.execute_burst(wait_epoch, steps, done_epoch);
+}
+const volatile uint32_t* npu_get_done_flag_ptr() {
+  return sim_enabled() ? sim_npu_engine().done_flag_ptr() : g_engine.done_flag_ptr();
+}
+double npu_execute_blocking() {
+  return sim_enabled() ? sim_npu_engine().execute_blocking() : g_engine.execute_blocking();
+}
+int npu_add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output) {
+  return sim_enabled() ? sim_npu_engine().add_slot(ion_input, ion_output)
+                       : g_engine.add_slot(ion_input, ion_output);
+}
+double npu_execute_slot(int slot) {
+  return sim_enabled() ? sim_npu_engine().execute_slot(slot) : g_engine.execute_slot(slot);
+}
+bool npu_execute_async(int slot, void (*fn)(void*), void* param) {
+  return sim_enabled() ? sim_npu_engine().execute_async(slot, fn, param)
+                       : g_engine.execute_async(slot, fn, param);
+}
+uint32_t npu_async_in_flight() {
+  return sim_enabled() ? sim_npu_engine().async_in_flight() : g_engine.async_in_flight();
+}
+
+void npu_print_info() {
+  if (sim_enabled()) sim_npu_engine().print_info();
+  else               g_engine.print_info();
+}
+void npu_cleanup() {
+  if (sim_enabled()) sim_npu_engine().cleanup();
+  else               g_engine.cleanup();
 }
@@ -1,24 +1,202 @@
 #pragma once
 #include "common.h"
+#include "engine.h"
+#include "qnn_mem_cache.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "QNN/QnnInterface.h"
+#include "QNN/QnnTypes.h"
 
 // NPU RMSNorm engine using QNN HTP.
 // Accepts external ION buffers for zero-copy sharing with GPU.
 // Init must be called from main thread (QNN is not thread-safe for init).
-// execute_blocking() can be called from any thread.
+// execute_blocking() can be called from any thread; execute_async() returns
+// at once and reports completion from a QNN thread.
+//
+// libQnnHtp.so, the QNN backend and device are shared by every instance in
+// the process (reference counted); each NpuEngine owns its own QNN context,
+// graph and registered buffers.
+class NpuEngine : public Engine {
+public:
+  NpuEngine() = default;
+  ~NpuEngine() override { cleanup(); }
+
+  // Standard init: Input[ION] → RmsNorm → Output[ION]
+  bool init(int hidden_dim, float epsilon,
+            const IonBuffer& ion_input, const IonBuffer& ion_output);
+
+  // Sync init: Input[ION] + WaitEpoch[ION] → SyncWait → Data[native] → RmsNorm → Output[ION]
+  // DSP polls flag `flag_index` of the GPU epoch flag table until it reaches
+  // the wait epoch, then executes RmsNorm, enabling GPU+NPU parallel launch.
+  // Requires SyncWait custom op .so files at runtime (set via ADSP_LIBRARY_PATH).
+  bool init_with_sync(int hidden_dim, float epsilon,
+                      const IonBuffer& ion_input, const IonBuffer& ion_output,
+                      const IonBuffer& ion_flag_table, int flag_index = 0);
+
+  // Persistent init: Input[ION] + Burst[ION] → PersistentRmsNorm → scratch.
+  // One graphExecute runs a burst of N steps on the DSP (execute_burst());
+  // step i waits for flag `wait_index` to reach wait_epoch + i, runs RmsNorm
+  // in place on the shared buffers and publishes done_epoch + i into flag
+  // `done_index` of the same table. Host reference: persistent_ref.h.
+  bool init_persistent(int hidden_dim, float epsilon,
+                       const IonBuffer& ion_input, const IonBuffer& ion_output,
+                       const IonBuffer& ion_flag_table, int wait_index, int done_index);
+
+  // Persistent graph only: one blocking graphExecute for `steps` steps;
+  // completion per step is the done flag (done_flag_ptr()). Returns the steps
+  // that published, read back from the done flag: < steps when the op timed
+  // out waiting for the producer or could not run the burst at all.
+  uint32_t execute_burst(uint32_t wait_epoch, uint32_t steps, uint32_t done_epoch);
+  const volatile uint32_t* done_flag_ptr() const { return doneFlag_; }
+
+  // Sync graph only: set the GPU epoch the next graphExecute waits for
+  // (the value returned by GpuEngine::submit()). Must be called before graphExecute.
+  void set_wait_epoch(uint32_t epoch);
+
+  // Blocking: calls graphExecute. Returns wall-clock time in us.
+  double execute_blocking() override;
+
+  // Pipelined mode: register an extra (input, output) buffer pair ("slot")
+  // for the already-built graph. Must be called after init(). Returns the
+  // slot index, or -1 on failure.
+  int add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output);
+
+  // Blocking graphExecute on a slot's buffers. Returns wall-clock time in us.
+  double execute_slot(int slot);
+
+  // graphExecuteAsync on the engine's buffers (slot -1) or a slot's. Returns
+  // at once; fn(param) runs on a QNN thread when the execution finished
+  // (failed executions are reported too). Executions of one graph complete
+  // in launch order. At most kAsyncQueueDepth may be in flight: a launch
+  // beyond that waits until the oldest one has completed. Safe to call from
+  // several threads. Returns false if QNN rejected the launch (fn is then
+  // never called). cleanup() waits for every outstanding callback first.
+  static constexpr uint32_t kAsyncQueueDepth = 64;
+  bool execute_async(int slot, void (*fn)(void*), void* param);
+  // Launched executions whose notify has not started (launching thread)
+  uint32_t async_in_flight() const {
+    return asyncLaunched_ - asyncCompleted_.load(std::memory_order_acquire);
+  }
+
+  const char* name() const override { return "npu"; }
+  void print_info() const override;
+  void cleanup() override;
+
+private:
+  static constexpr uint32_t kTensorRank = 4;
+
+  struct RegMem { Qnn_MemHandle_t handle = nullptr; };
+
+  // Caller's completion callback of one async execution (QNN notifyParam)
+  struct AsyncCall {
+    NpuEngine* engine = nullptr;
+    void (*fn)(void*) = nullptr;
+    void* param = nullptr;
+  };
+  static void onAsyncNotify(void* notifyParam, Qnn_NotifyStatus_t status);
+
+  // Pipelined mode: per-slot registered buffers + pre-bound exec tensors
+  struct Slot {
+    RegMem input, output;
+    Qnn_Tensor_t execInputs[2];
+    Qnn_Tensor_t execOutputs[1];
+  };
+
+  bool init_common(int hidden_dim);
+  bool registerBuffer(const IonBuffer& ion, const uint32_t* dims, uint32_t ndims,
+                      Qnn_DataType_t dtype, RegMem& out);
+  void deregisterAll();
+  bool createAxesTensor(Qnn_Tensor_t& out, uint32_t* axes_data, uint32_t num_axes);
+  bool buildNativeGraph();
+  bool buildSyncGraph();
+  bool buildPersistentGraph();
+  enum class GraphKind { NATIVE, SYNC, PERSISTENT };
+  bool buildGraph(GraphKind kind);
+
+  const QNN_INTERFACE_VER_TYPE* qnn_ = nullptr;  // set while holding the shared runtime
+  Qnn_ContextHandle_t context_ = nullptr;
+  Qnn_GraphHandle_t   graph_   = nullptr;
+  uint32_t            coreCount_ = 0;
+
+  // NPU owns gamma/beta; input/output are external ION buffers
+  IonBuffer ionGamma_, ionBeta_;
+
+  // ION fd of the GPU flag table and byte offset of our flag in it — passed
+  // to SyncWait as static params for DSP-side HAP_mmap_get() direct DDR polling
+  uint32_t flagIonFd_  = 0;
+  uint32_t flagOffset_ = 0;
+
+  // Wait epoch: one word written by the host before each graphExecute and fed
+  // to SyncWait as its flag input tensor (DMA-copied at launch, which is fine
+  // since it never changes while the graph runs)
+  IonBuffer ionWaitEpoch_;
+
+  // Persistent graph: NPU completion flag offset, fds of the shared buffers
+  // the op maps itself, the burst descriptor (host-written like the wait
+  // epoch) and a scratch output for the op's final copy
+  uint32_t doneOffset_ = 0;
+  const volatile uint32_t* doneFlag_ = nullptr;  // host view of the same flag
+  uint32_t inIonFd_    = 0;
+  uint32_t outIonFd_   = 0;
+  IonBuffer ionBurst_, ionBurstOut_;
+
+  // Every registration goes through the cache: slots and layers that reuse a
+  // buffer with the same shape share one handle
+  QnnMemCache memCache_;
+  RegMem regInput_, regOutput_, regFlag_;
+
+  // Support up to 2 exec inputs: [data] for standard, [data, wait epoch] for sync mode
+  Qnn_Tensor_t execInputs_[2];
+  Qnn_Tensor_t execOutputs_[1];
+  uint32_t numExecInputs_ = 1;
+
+  // Graph tensors point at these, so an engine is never copied or moved
+  uint32_t dimsIO_[kTensorRank];
+  uint32_t dimsFlagIO_[kTensorRank];   // {1,1,1,1} for flag tensor
+  uint32_t dimsBurst_[kTensorRank];    // {1,1,1,3} for the burst descriptor
+  uint32_t dimsGamma1D_[1];
+  uint32_t dimsAxes_[1];
+
+  int hidden_ = 0;
+  std::vector<Slot> slots_;
+
+  // Ring indexed by launch count. A slot is free again once its notify has
+  // copied it out, i.e. when asyncCompleted_ has passed it (completions come
+  // in launch order); asyncFinished_ counts callbacks that have returned.
+  AsyncCall asyncCalls_[kAsyncQueueDepth];
+  std::mutex asyncMutex_;                            // launchers
+  uint32_t  asyncLaunched_ = 0;                      // under asyncMutex_
+  alignas(64) std::atomic<uint32_t> asyncCompleted_{0};  // QNN notify thread
+  alignas(64) std::atomic<uint32_t> asyncFinished_{0};   // QNN notify thread
+
+  // Wait until every launched execution's callback has returned
+  void drain_async();
+};
+
+// ── Process-default instance ────────────────────────────────────────────────
+// Thin wrappers over one NpuEngine, used by the single-op pipeline (over the
+// simulated NPU while sim_enabled()).
+
+NpuEngine& npu_default_engine();
 
-// Standard init: Input[ION] → RmsNorm → Output[ION]
 bool npu_init(int hidden_dim, float epsilon,
               const IonBuffer& ion_input, const IonBuffer& ion_output);
-
-// Sync init: Input[ION] + GPUFlag[ION] → SyncWait → Data[native] → RmsNorm → Output[ION]
-// DSP polls gpu_flag before executing RmsNorm, enabling GPU+NPU parallel launch.
-// Requires SyncWait custom op .so files at runtime (set via ADSP_LIBRARY_PATH).
 bool npu_init_with_sync(int hidden_dim, float epsilon,
                         const IonBuffer& ion_input, const IonBuffer& ion_output,
-                        const IonBuffer& ion_gpu_flag);
-
-// Blocking: calls graphExecute. Returns wall-clock time in us.
+                        const IonBuffer& ion_flag_table, int flag_index = 0);
+bool npu_init_persistent(int hidden_dim, float epsilon,
+                         const IonBuffer& ion_input, const IonBuffer& ion_output,
+                         const IonBuffer& ion_flag_table, int wait_index, int done_index);
+void npu_set_wait_epoch(uint32_t epoch);
+uint32_t npu_execute_burst(uint32_t wait_epoch, uint32_t steps, uint32_t done_epoch);
+const volatile uint32_t* npu_get_done_flag_ptr();
 double npu_execute_blocking();
-
+int npu_add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output);
+double npu_execute_slot(int slot);
+bool npu_execute_async(int slot, void (*fn)(void*), void* param);
+uint32_t npu_async_in_flight();
 void npu_print_info();
 void npu_cleanup();
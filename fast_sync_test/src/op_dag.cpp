@@ -0,0 +1,420 @@
+#include "op_dag.h"
+#include "cpu_kernels.h"
+#include "npu_engine.h"
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+const char* device_name(OpDag::Device d) {
+  switch (d) {
+    case OpDag::Device::GPU: return "gpu";
+    case OpDag::Device::NPU: return "npu";
+    case OpDag::Device::CPU: return "cpu";
+  }
+  return "?";
+}
+
+}  // namespace
+
+// ── Building ────────────────────────────────────────────────────────────────
+
+bool OpDag::init(int hidden_dim, float epsilon) {
+  cleanup();
+  hidden_  = hidden_dim;
+  epsilon_ = epsilon;
+  if (!allocIonBuffer(kFlagTableBytes, 0, flagTable_)) {
+    printf("[DAG] flag table alloc failed\n");
+    return false;
+  }
+  return true;
+}
+
+int OpDag::add_tensor(const char* name) {
+  Tensor t;
+  t.name = name;
+  tensors_.push_back(t);
+  return static_cast<int>(tensors_.size()) - 1;
+}
+
+int OpDag::add_op(const char* name, Device dev, const std::vector<int>& inputs,
+                  const std::vector<int>& outputs) {
+  const int ntensors = static_cast<int>(tensors_.size());
+  for (int t : inputs)
+    if (t < 0 || t >= ntensors) { printf("[DAG] %s: unknown input %d\n", name, t); return -1; }
+  for (int t : outputs) {
+    if (t < 0 || t >= ntensors) { printf("[DAG] %s: unknown output %d\n", name, t); return -1; }
+    if (tensors_[t].producer >= 0) {
+      printf("[DAG] %s: %s already produced by %s\n", name, tensors_[t].name.c_str(),
+             ops_[tensors_[t].producer].name.c_str());
+      return -1;
+    }
+  }
+  if (dev == Device::GPU && gpuOps_ == kMaxGpuOps) {
+    printf("[DAG] %s: more than %d GPU ops\n", name, kMaxGpuOps);
+    return -1;
+  }
+
+  const int id = static_cast<int>(ops_.size());
+  Op op;
+  op.name = name;
+  op.dev = dev;
+  op.inputs = inputs;
+  op.outputs = outputs;
+  for (int t : inputs) {
+    int p = tensors_[t].producer;
+    if (p < 0 || std::find(op.deps.begin(), op.deps.end(), p) != op.deps.end()) continue;
+    op.deps.push_back(p);
+    if (dev == Device::GPU && ops_[p].dev == Device::GPU) ops_[p].keep_event = true;
+  }
+  for (int t : outputs) tensors_[t].producer = id;
+  if (dev == Device::GPU) ++gpuOps_;
+  if (dev == Device::NPU) ++npuOps_;
+  ops_.push_back(std::move(op));
+  return id;
+}
+
+int OpDag::add_gpu_rmsnorm(const char* name, int input, int output) {
+  return add_op(name, Device::GPU, {input}, {output});
+}
+
+int OpDag::add_npu_rmsnorm(const char* name, int input, int output) {
+  return add_op(name, Device::NPU, {input}, {output});
+}
+
+int OpDag::add_cpu(const char* name, const std::vector<int>& inputs,
+                   const std::vector<int>& outputs, CpuFn fn) {
+  int id = add_op(name, Device::CPU, inputs, outputs);
+  if (id >= 0) ops_[id].fn = std::move(fn);
+  return id;
+}
+
+bool OpDag::allocate_tensors(bool share_memory) {
+  const int nops = static_cast<int>(ops_.size());
+  const int ntensors = static_cast<int>(tensors_.size());
+
+  // anc[o][a]: op a completes before op o starts, in every schedule (ops are
+  // topologically ordered; a GPU → GPU event edge orders execution too)
+  std::vector<std::vector<bool>> anc(nops, std::vector<bool>(nops, false));
+  for (int o = 0; o < nops; ++o)
+    for (int d : ops_[o].deps) {
+      anc[o][d] = true;
+      for (int a = 0; a < d; ++a)
+        if (anc[d][a]) anc[o][a] = true;
+    }
+  std::vector<std::vector<int>> readers(ntensors);
+  for (int o = 0; o < nops; ++o)
+    for (int t : ops_[o].inputs) readers[t].push_back(o);
+
+  auto dead_before = [&](int t, int u) {  // t's last read precedes u's write
+    const int p = tensors_[u].producer;
+    if (p < 0 || tensors_[t].producer < 0 || readers[t].empty()) return false;  // in/outputs
+    for (int r : readers[t])
+      if (!anc[p][r]) return false;
+    return true;
+  };
+  const size_t bytes = (size_t)hidden_ * 2;
+  plan_ = mem_plan_greedy_by_size(
+      std::vector<size_t>(ntensors, bytes),
+      [&](int t, int u) { return !dead_before(t, u) && !dead_before(u, t); },
+      IonArena::kDefaultAlign);
+
+  if (share_memory) {
+    if (!arena_.init(plan_.peak_bytes)) return false;
+    for (int t = 0; t < ntensors; ++t)
+      if (!arena_.view_at(plan_.offsets[t], bytes, tensors_[t].buf)) return false;
+    return true;
+  }
+  for (Tensor& t : tensors_) {
+    if (!allocIonBuffer(bytes, 0, t.buf)) {
+      printf("[DAG] tensor %s alloc failed\n", t.name.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+bool OpDag::prepare(const char* kernel_path, bool share_memory) {
+  if (tensors_.size() < 2) { printf("[DAG] prepare needs two tensors\n"); return false; }
+  if (!allocate_tensors(share_memory)) return false;
+  const IonBuffer& a = tensors_[0].buf;
+  const IonBuffer& b = tensors_[1].buf;
+  if (gpuOps_ > 0) {
+    if (!gpu_init(hidden_, epsilon_, a, b, kernel_path)) return false;
+    gpuReady_ = true;
+  }
+  if (npuOps_ > 0) {
+    if (!npu_init(hidden_, epsilon_, a, b)) return false;
+    npuReady_ = true;
+  }
+
+  int flag = 1;
+  for (Op& op : ops_) {
+    if (op.dev == Device::CPU) continue;
+    const IonBuffer& in  = tensors_[op.inputs[0]].buf;
+    const IonBuffer& out = tensors_[op.outputs[0]].buf;
+    op.slot = op.dev == Device::GPU ? gpu_add_slot(in, out, flagTable_, flag++)
+                                    : npu_add_slot(in, out);
+    if (op.slot < 0) { printf("[DAG] %s: slot setup failed\n", op.name.c_str()); return false; }
+  }
+  npuDone_.reset(new NpuDone[ops_.size()]);
+  return true;
+}
+
+// ── Scheduling ──────────────────────────────────────────────────────────────
+
+bool OpDag::can_launch(const Op& op) const {
+  for (int d : op.deps) {
+    const Op& dep = ops_[d];
+    // GPU → GPU: enqueued is enough, the device honours the event
+    bool ok = op.dev == Device::GPU && dep.dev == Device::GPU ? dep.launched : dep.done;
+    if (!ok) return false;
+  }
+  return true;
+}
+
+void OpDag::launch(int id) {
+  Op& op = ops_[id];
+  op.launched = true;
+  op.launch_us = now_us();
+  switch (op.dev) {
+    case Device::GPU: {
+      cl_event waits[kMaxGpuOps];
+      cl_uint nwait = 0;
+      for (int d : op.deps)
+        if (ops_[d].dev == Device::GPU) waits[nwait++] = ops_[d].evt;
+      op.epoch = gpu_submit_slot(op.slot, nwait, waits, op.keep_event ? &op.evt : nullptr);
+      break;
+    }
+    case Device::NPU:
+      // Launched by run_with<W>, which knows the callback's wait strategy
+      break;
+    case Device::CPU:
+      op.fn();
+      op.done = true;
+      op.done_us = now_us();
+      break;
+  }
+}
+
+bool OpDag::complete(int id) const {
+  const Op& op = ops_[id];
+  switch (op.dev) {
+    case Device::GPU:
+      return epoch_reached(*gpu_get_slot_flag_ptr(op.slot), op.epoch);
+    case Device::NPU:
+      return npuDone_[id].run.load(std::memory_order_acquire) == npuDone_[id].target;
+    case Device::CPU:
+      return true;
+  }
+  return true;
+}
+
+template <typename W>
+void OpDag::on_npu_done(void* done) {
+  NpuDone* d = static_cast<NpuDone*>(done);
+  d->done_us = now_us();
+  d->run.store(d->target, std::memory_order_release);
+  W::notify(d->run);
+}
+
+template <typename W>
+void OpDag::run_with() {
+  const uint32_t run = ++runs_;
+  for (Op& op : ops_) {
+    op.launched = op.done = false;
+    op.evt = nullptr;
+  }
+  const double t0 = now_us();
+
+  for (;;) {
+    // Launch whatever became ready, collect whatever finished, until stable
+    for (bool progress = true; progress;) {
+      progress = false;
+      for (int i = 0; i < static_cast<int>(ops_.size()); ++i) {
+        Op& op = ops_[i];
+        if (!op.launched && can_launch(op)) {
+          launch(i);
+          if (op.dev == Device::NPU) {
+            NpuDone& d = npuDone_[i];
+            d.target = run;
+            if (!npu_execute_async(op.slot, &on_npu_done<W>, &d)) {
+              npu_execute_slot(op.slot);
+              d.done_us = now_us();
+              d.run.store(run, std::memory_order_relaxed);
+            }
+          }
+          progress = true;
+        }
+        if (op.launched && !op.done && complete(i)) {
+          op.done = true;
+          op.done_us = op.dev == Device::NPU ? npuDone_[i].done_us : now_us();
+          progress = true;
+        }
+      }
+    }
+    size_t remaining = 0;
+    for (const Op& op : ops_) remaining += !op.done;
+    if (remaining == 0) break;
+    W::until([&] {
+      for (int i = 0; i < static_cast<int>(ops_.size()); ++i)
+        if (ops_[i].launched && !ops_[i].done && complete(i)) return true;
+      return false;
+    });
+  }
+  finish_run(t0);
+}
+
+void OpDag::finish_run(double t0) {
+  for (Op& op : ops_) {
+    if (op.evt) gpu_release_event(op.evt);
+    op.evt = nullptr;
+
+    double ready = t0;
+    for (int d : op.deps) ready = std::max(ready, ops_[d].done_us);
+    op.wait_us += std::max(0.0, op.launch_us - ready);
+    op.run_us  += op.done_us - std::max(op.launch_us, ready);
+  }
+
+  int sink = 0;
+  for (int i = 1; i < static_cast<int>(ops_.size()); ++i)
+    if (ops_[i].done_us > ops_[sink].done_us) sink = i;
+  makespan_.push_back(ops_[sink].done_us - t0);
+
+  lastPath_.clear();
+  for (int i = sink; i >= 0;) {
+    lastPath_.push_back(i);
+    ++ops_[i].critical;
+    int next = -1;
+    for (int d : ops_[i].deps)
+      if (next < 0 || ops_[d].done_us > ops_[next].done_us) next = d;
+    i = next;
+  }
+}
+
+void OpDag::run(WaitKind wait) {
+  if (ops_.empty()) return;
+  dispatch_wait(wait, [&](auto w) { run_with<decltype(w)>(); });
+}
+
+// ── Stats ───────────────────────────────────────────────────────────────────
+
+void OpDag::reset_stats() {
+  makespan_.clear();
+  lastPath_.clear();
+  for (Op& op : ops_) {
+    op.critical = 0;
+    op.wait_us = op.run_us = 0;
+  }
+}
+
+void OpDag::print_graph() const {
+  printf("  memory: %zu tensors, %.1f KB one buffer each, %.1f KB planned (%.0f%% less)%s\n",
+         tensors_.size(), plan_.naive_bytes / 1024.0, plan_.peak_bytes / 1024.0,
+         100.0 * plan_.saved(), arena_.backing().ptr ? ", shared arena" : "");
+  printf("  offsets:");
+  for (size_t t = 0; t < tensors_.size(); ++t)
+    printf(" %s=%zu", tensors_[t].name.c_str(), plan_.offsets[t]);
+  printf("\n");
+  for (const Op& op : ops_) {
+    printf("  %-10s %s  ", op.name.c_str(), device_name(op.dev));
+    for (size_t i = 0; i < op.inputs.size(); ++i)
+      printf("%s%s", i ? "," : "", tensors_[op.inputs[i]].name.c_str());
+    printf(" -> ");
+    for (size_t i = 0; i < op.outputs.size(); ++i)
+      printf("%s%s", i ? "," : "", tensors_[op.outputs[i]].name.c_str());
+    printf("\n");
+  }
+}
+
+void OpDag::print_stats(const char* title) const {
+  const int runs = static_cast<int>(makespan_.size());
+  printf("\n=== %s (%zu ops: %d GPU, %d NPU, %zu CPU; %d runs) ===\n", title, ops_.size(),
+         gpuOps_, npuOps_, ops_.size() - gpuOps_ - npuOps_, runs);
+  if (runs == 0) return;
+
+  std::vector<double> m = makespan_;
+  Stats s = compute_stats(m);
+  printf("  %-14s %8s %8s %8s %8s %8s\n", "(us)", "min", "p50", "avg", "p99", "max");
+  printf("  %-14s %8.1f %8.1f %8.1f %8.1f %8.1f\n", "critical_path", s.min, s.p50, s.avg,
+         s.p99, s.max);
+
+  printf("  critical path (last run):");
+  for (auto it = lastPath_.rbegin(); it != lastPath_.rend(); ++it)
+    printf("%s %s", it == lastPath_.rbegin() ? "" : " ->", ops_[*it].name.c_str());
+  printf("\n");
+
+  double path_wait = 0, path_run = 0;
+  printf("  %-10s %-4s %8s %10s %10s\n", "op", "dev", "critical", "wait(us)", "run(us)");
+  for (const Op& op : ops_) {
+    printf("  %-10s %-4s %7.0f%% %10.1f %10.1f\n", op.name.c_str(), device_name(op.dev),
+           100.0 * op.critical / runs, op.wait_us / runs, op.run_us / runs);
+  }
+  for (int i : lastPath_) {
+    path_wait += ops_[i].wait_us / runs;
+    path_run  += ops_[i].run_us / runs;
+  }
+  printf("  last path avg: wait %.1f us + run %.1f us\n", path_wait, path_run);
+}
+
+void OpDag::cleanup() {
+  if (npuReady_) npu_cleanup();
+  if (gpuReady_) gpu_cleanup();
+  npuReady_ = gpuReady_ = false;
+  for (Tensor& t : tensors_) freeIonBuffer(t.buf);
+  tensors_.clear();
+  arena_.release();
+  plan_ = MemPlan{};
+  ops_.clear();
+  npuDone_.reset();
+  freeIonBuffer(flagTable_);
+  gpuOps_ = npuOps_ = 0;
+  runs_ = 0;
+  reset_stats();
+}
+
+// ── Benchmark ───────────────────────────────────────────────────────────────
+// Demo segment: two branches that cross devices, a CPU residual add joining
+// them, then a GPU → GPU chain (cl_event edge) into a final NPU op.
+//   x ─gpu0─▶ a ─npu1─▶ b ─┐
+//   x ─npu2─▶ c ─gpu3─▶ d ─┴─cpu_add─▶ e ─gpu5─▶ f ─gpu6─▶ g ─npu7─▶ y
+
+void run_dag_benchmark(const PipelineConfig& config, const char* kernel_path) {
+  OpDag dag;
+  if (!dag.init(config.hidden_dim, config.epsilon)) return;
+
+  const char* names[] = {"x", "a", "b", "c", "d", "e", "f", "g", "y"};
+  int t[9];
+  for (int i = 0; i < 9; ++i) t[i] = dag.add_tensor(names[i]);
+  int x = t[0], a = t[1], b = t[2], c = t[3], d = t[4], e = t[5], f = t[6], g = t[7], y = t[8];
+
+  // Tensors are allocated (and may share memory) at prepare(): look them up at run time
+  const size_t n = (size_t)config.hidden_dim;
+  auto f16 = [&dag](int id) { return static_cast<uint16_t*>(dag.tensor(id).ptr); };
+
+  bool ok = dag.add_gpu_rmsnorm("gpu0", x, a) >= 0 &&
+            dag.add_npu_rmsnorm("npu1", a, b) >= 0 &&
+            dag.add_npu_rmsnorm("npu2", x, c) >= 0 &&
+            dag.add_gpu_rmsnorm("gpu3", c, d) >= 0 &&
+            dag.add_cpu("cpu_add", {b, d}, {e}, [=] { cpuk::add_f16(f16(e), f16(b), f16(d), n); }) >= 0 &&
+            dag.add_gpu_rmsnorm("gpu5", e, f) >= 0 &&
+            dag.add_gpu_rmsnorm("gpu6", f, g) >= 0 &&
+            dag.add_npu_rmsnorm("npu7", g, y) >= 0;
+  if (!ok || !dag.prepare(kernel_path, config.arena)) {
+    printf("[DAG] setup failed\n");
+    return;
+  }
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> dist(0.1f, 1.0f);
+  uint16_t* px = f16(x);
+  for (int i = 0; i < config.hidden_dim; ++i) px[i] = float_to_half(dist(rng));
+
+  printf("Running Op DAG...\n");
+  dag.print_graph();
+  for (int i = 0; i < config.num_warmup; ++i) dag.run(config.wait);
+  dag.reset_stats();
+  for (int i = 0; i < config.num_steps; ++i) dag.run(config.wait);
+  dag.print_stats("Op DAG");
+}
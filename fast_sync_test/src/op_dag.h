@@ -0,0 +1,155 @@
+#pragma once
+#include "common.h"
+#include "gpu_engine.h"
+#include "ion_arena.h"
+#include "memory_plan.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Heterogeneous op DAG on the process-default engines (the simulated devices
+// with --sim).
+//
+// An op is a GPU rmsnorm kernel (one GpuEngine slot per op), an NPU RmsNorm
+// graph (one NpuEngine slot per op) or a host function (run on the scheduler
+// thread). Tensors are hidden_dim FP16 ION buffers owned by the DAG, so every
+// device reads and writes them in place. An op depends on the producers of
+// its inputs; ops are added producers first and a tensor has one producer,
+// which keeps the graph acyclic.
+//
+// prepare() plans tensor memory (memory_plan.h). Two tensors can share bytes
+// when every reader of one is an ancestor of the other's producer: then, in
+// any schedule run() can pick, the first is dead before the second is
+// written. Graph inputs (no producer, host-filled once) are live throughout,
+// outputs (no reader) from their write to the end of the run. With share_memory the
+// tensors are views at the planned offsets of one ION arena, otherwise one
+// buffer each; the plan is reported either way.
+//
+// run() executes the DAG once from one scheduler thread, launching every op
+// as soon as its dependencies allow:
+//   GPU  once its non-GPU inputs are complete and its GPU producers are
+//        enqueued: GPU → GPU edges are cl_event wait lists resolved on the
+//        device. Completion: the slot's epoch flag.
+//   NPU  once every input is complete, graphExecuteAsync. Completion: the
+//        word the notify callback stores (blocking graphExecute if the
+//        async launch is rejected).
+//   CPU  once every input is complete, inline.
+// Cross-device edges are thus shared-memory words the scheduler watches with
+// the wait strategy; nothing calls clFinish or blocks a thread in QNN.
+//
+// Per run the DAG records each op's launch and completion, the makespan
+// (run start → last completion) and the critical path: from the op that
+// completed last, back through its latest-completing input. Each op's time
+// splits into wait (latest input done → launch) and run (launch, or input
+// done if later, → completion seen).
+class OpDag {
+public:
+  enum class Device { GPU, NPU, CPU };
+  using CpuFn = std::function<void()>;
+
+  // GPU op k publishes into flag k+1 of the DAG's flag table
+  static constexpr int kMaxGpuOps = kFlagTableSlots - 1;
+
+  OpDag() = default;
+  ~OpDag() { cleanup(); }
+  OpDag(const OpDag&) = delete;
+  OpDag& operator=(const OpDag&) = delete;
+
+  // Tensor size and the RMSNorm epsilon of the GPU / NPU ops
+  bool init(int hidden_dim, float epsilon);
+
+  // New hidden_dim FP16 tensor, allocated by prepare(). Returns its id.
+  int add_tensor(const char* name);
+  const IonBuffer& tensor(int id) const { return tensors_[id].buf; }  // after prepare()
+
+  // Ops. Return the op id, or -1 for an unknown tensor, a tensor that already
+  // has a producer, or too many GPU ops.
+  int add_gpu_rmsnorm(const char* name, int input, int output);
+  int add_npu_rmsnorm(const char* name, int input, int output);
+  int add_cpu(const char* name, const std::vector<int>& inputs,
+              const std::vector<int>& outputs, CpuFn fn);
+
+  // Plan and allocate the tensors, init the default GPU / NPU engines (those
+  // the DAG uses) and register one slot per op. Call once, after the last
+  // add_*(); needs two tensors.
+  bool prepare(const char* kernel_path, bool share_memory = false);
+
+  // One pass over the whole DAG, waiting with the given strategy
+  void run(WaitKind wait);
+
+  // Drop the recorded runs (e.g. after warmup)
+  void reset_stats();
+  void print_stats(const char* title) const;
+  void print_graph() const;
+
+  void cleanup();
+
+private:
+  struct Tensor {
+    std::string name;
+    IonBuffer   buf = {};
+    int         producer = -1;
+  };
+
+  struct Op {
+    std::string name;
+    Device      dev = Device::CPU;
+    std::vector<int> inputs, outputs;  // tensors
+    std::vector<int> deps;             // producer ops of the inputs
+    CpuFn       fn;
+    int         slot = -1;             // GPU / NPU engine slot
+    bool        keep_event = false;    // a GPU consumer waits on our cl_event
+
+    // Current run
+    bool     launched  = false;
+    bool     done      = false;
+    double   launch_us = 0;
+    double   done_us   = 0;
+    uint32_t epoch     = 0;            // GPU: epoch the slot flag reaches
+    cl_event evt       = nullptr;      // GPU: kept for GPU consumers
+
+    // Accumulated over the recorded runs
+    int    critical = 0;               // runs with this op on the critical path
+    double wait_us  = 0;
+    double run_us   = 0;
+  };
+
+  // Completion word of one NPU op, written by the notify callback
+  struct alignas(64) NpuDone {
+    std::atomic<uint32_t> run{0};      // last run that completed
+    uint32_t target  = 0;              // run being waited for
+    double   done_us = 0;
+  };
+
+  int add_op(const char* name, Device dev, const std::vector<int>& inputs,
+             const std::vector<int>& outputs);
+  bool allocate_tensors(bool share_memory);
+  bool can_launch(const Op& op) const;
+  void launch(int id);
+  bool complete(int id) const;
+  void finish_run(double t0);
+  template <typename W> void run_with();
+  template <typename W> static void on_npu_done(void* done);
+
+  int   hidden_  = 0;
+  float epsilon_ = 1e-6f;
+  IonBuffer flagTable_ = {};
+  std::vector<Tensor> tensors_;
+  MemPlan   plan_;
+  IonArena  arena_;                     // backs the tensors with share_memory
+  std::vector<Op> ops_;
+  std::unique_ptr<NpuDone[]> npuDone_;  // indexed by op id
+  int  gpuOps_ = 0, npuOps_ = 0;
+  bool gpuReady_ = false, npuReady_ = false;
+  uint32_t runs_ = 0;
+
+  std::vector<double> makespan_;       // per recorded run
+  std::vector<int>    lastPath_;       // critical path of the last run, sink first
+};
+
+// --mode dag: a demo model segment on the DAG (two branches crossing devices,
+// a CPU join, a GPU → GPU chain), warmup + measured runs, stats printed
+void run_dag_benchmark(const PipelineConfig& config, const char* kernel_path);
@@ -0,0 +1,79 @@
+#pragma once
+#include "common.h"
+#include "cpu_kernels.h"
+#include "persistent_protocol.h"  // heteroedge_op/
+#include "wait_strategy.h"
+
+#include <vector>
+
+// Host reference of the PersistentRmsNorm op (heteroedge_op/): the same
+// burst loop (heteroedge::run_persistent_burst) with host device hooks, on
+// the same shared buffers and epoch flag table. execute_burst() blocks its
+// caller for the whole burst like graphExecute, so the protocol — per-step
+// producer flag, in-place RmsNorm, per-step NPU completion epoch — can be
+// tested against the CPU engine on any Linux host (test_persistent_burst).
+class PersistentNpuRef {
+public:
+  static constexpr double kDefaultTimeoutUs = 1e6;  // per step
+
+  // Input → output, both hidden_dim FP16. Waits on flag `wait_index` of the
+  // table, publishes into flag `done_index`.
+  bool init(int hidden_dim, float epsilon,
+            const IonBuffer& ion_input, const IonBuffer& ion_output,
+            const IonBuffer& ion_flag_table, int wait_index, int done_index) {
+    if (!ion_input.ptr || !ion_output.ptr || ion_flag_table.size < kFlagTableBytes) {
+      printf("[NPU-REF] bad buffers\n");
+      return false;
+    }
+    EpochFlagTable<uint32_t> table(ion_flag_table);
+    dev_.ready   = table.flag(wait_index);
+    dev_.done    = table.flag(done_index);
+    dev_.in      = static_cast<const uint16_t*>(ion_input.ptr);
+    dev_.out     = static_cast<uint16_t*>(ion_output.ptr);
+    dev_.epsilon = epsilon;
+    dev_.length  = hidden_dim;
+    gamma_.assign(hidden_dim, float_to_half(1.0f));
+    dev_.gamma   = gamma_.data();
+    return true;
+  }
+
+  // One burst (graphExecute of the persistent graph). Returns the steps
+  // completed: < steps when the producer stalls for longer than timeout_us.
+  uint32_t execute_burst(uint32_t wait_epoch, uint32_t steps, uint32_t done_epoch,
+                         double timeout_us = kDefaultTimeoutUs) {
+    dev_.timeout_us = timeout_us;
+    heteroedge::PersistentBurst b{wait_epoch, steps, done_epoch};
+    return heteroedge::run_persistent_burst(b, dev_);
+  }
+
+private:
+  struct HostDev {
+    const volatile uint32_t* ready = nullptr;
+    volatile uint32_t*       done  = nullptr;
+    const uint16_t* in    = nullptr;
+    uint16_t*       out   = nullptr;
+    const uint16_t* gamma = nullptr;
+    float  epsilon    = 1e-6f;
+    int    length     = 0;
+    double timeout_us = kDefaultTimeoutUs;
+
+    bool wait(uint32_t target) {
+      const double deadline = now_us() + timeout_us;
+      bool reached = false;
+      SpinYieldWait::until([&] {
+        reached = heteroedge::burst_epoch_reached(*ready, target);
+        return reached || now_us() > deadline;
+      });
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return reached;
+    }
+    void step() { cpuk::rmsnorm_f16(out, in, gamma, length, epsilon); }
+    void publish(uint32_t epoch) {
+      std::atomic_thread_fence(std::memory_order_release);
+      *done = epoch;
+    }
+  };
+
+  HostDev dev_;
+  std::vector<uint16_t> gamma_;
+};
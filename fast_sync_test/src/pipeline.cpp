@@ -1,19 +1,102 @@
 #include "pipeline.h"
+#include "cpu_engine.h"
 #include "gpu_engine.h"
+#include "ion_arena.h"
 #include "npu_engine.h"
+#include "predictive_wait.h"
+#include "spsc_ring.h"
+#include "sync_policy.h"
+#include "wait_strategy.h"
 
 #include <atomic>
+#include <initializer_list>
 #include <thread>
 #include <random>
 #include <unistd.h>
 #include <sched.h>
 
-// ARM yield hint: lighter than sched_yield (no context switch), just a CPU hint
-#if defined(__aarch64__)
-static inline void cpu_pause() { asm volatile("yield"); }
-#else
-static inline void cpu_pause() { }
-#endif
+static void collect_predict(PipelineResult& r, std::initializer_list<PredictiveWaiter*> waiters) {
+  for (PredictiveWaiter* p : waiters)
+    if (p) r.predict.push_back(p->stats());
+}
+
+// ── Main ↔ NPU worker handoff ───────────────────────────────────────────────
+// Step descriptors go to the worker and timing records come back over two
+// SPSC rings, so several steps can be queued and nothing on the hot path
+// allocates or shares a container between threads.
+struct StepCmd {
+  uint32_t  step     = 0;
+  int       slot     = -1;     // pipelined slot graph (-1 = the single graph)
+  bool      wait_gpu = false;  // worker waits for the GPU step itself (direct launch)
+  bool      stop     = false;  // worker exits
+  GpuTicket gpu;               // the GPU step this NPU step consumes
+  uint32_t  burst    = 0;      // persistent launch: steps in one graphExecute (waits gpu.epoch + i)
+  uint32_t  done_epoch = 0;    // persistent launch: NPU done epoch of the burst's first step
+};
+
+struct StepRecord {
+  uint32_t step           = 0;
+  double   gpu_wait_us    = 0;  // worker-side GPU wait (wait_gpu only)
+  double   gpu_done_us    = 0;  // worker observed the GPU done (now_us, wait_gpu only)
+  double   gpu_compute_us = 0;  // GpuTicket::compute_us after finish (wait_gpu only)
+  double   npu_exec_us    = 0;  // graphExecute wall time
+  double   done_us        = 0;  // NPU step finished (now_us)
+  uint32_t burst_done     = 0;  // persistent launch: steps of the burst that published
+};
+
+constexpr uint32_t kStepRingSize = 64;  // > max pipeline depth (kFlagTableSlots - 1)
+static_assert(kStepRingSize >= kFlagTableSlots - 1, "ring must hold a full pipeline");
+constexpr int kPersistentCtrlIndex = kFlagTableSlots - 1;  // doorbell line (single-stream only)
+constexpr int kNpuDoneIndex = 1;              // persistent launch: NPU done flag (single-stream only)
+constexpr double kNpuStepTimeoutUs = 2e6;     // persistent launch: host wait for one NPU step
+using StepQueue   = SpscRing<StepCmd, kStepRingSize>;
+using RecordQueue = SpscRing<StepRecord, kStepRingSize>;
+
+// NPU worker loop: pop a step, wait for its GPU step if asked to (policy G),
+// run the graph, push the timing record.
+template <typename G, typename W>
+static void npu_worker(StepQueue& cmds, RecordQueue& results, PredictiveWaiter* gpu_p) {
+  for (;;) {
+    StepCmd cmd = cmds.pop<W>();
+    if (cmd.stop) return;
+
+    StepRecord rec;
+    rec.step = cmd.step;
+    if (cmd.wait_gpu) {
+      double poll_t0 = now_us();
+      G::template wait<W>(cmd.gpu, gpu_p);
+      rec.gpu_done_us = now_us();
+      rec.gpu_wait_us = rec.gpu_done_us - poll_t0;
+      G::finish(cmd.gpu);
+      rec.gpu_compute_us = cmd.gpu.compute_us;
+    }
+    if (cmd.burst) {
+      double t0 = now_us();
+      rec.burst_done = npu_execute_burst(cmd.gpu.epoch, cmd.burst, cmd.done_epoch);
+      rec.npu_exec_us = now_us() - t0;
+    } else {
+      rec.npu_exec_us = cmd.slot >= 0 ? npu_execute_slot(cmd.slot) : npu_execute_blocking();
+    }
+    rec.done_us = now_us();
+    results.push<W>(rec);
+  }
+}
+
+// Next record from the worker, waiting for it (predictively with --predict)
+template <typename W>
+static StepRecord pop_record(RecordQueue& results, PredictiveWaiter* p, double t_start) {
+  const uint32_t next = results.popped();
+  wait_done<W>(p, t_start, results.pushed(), [next](uint32_t n) { return n != next; });
+  return results.pop<W>();
+}
+
+template <typename W>
+static void stop_worker(StepQueue& cmds, std::thread& worker) {
+  StepCmd cmd;
+  cmd.stop = true;
+  cmds.push<W>(cmd);
+  worker.join();
+}
 
 // Pin current thread to a specific CPU core. Returns true on success.
 static bool pin_to_core(int core_id) {
@@ -24,428 +107,414 @@ static bool pin_to_core(int core_id) {
   return sched_setaffinity(0, sizeof(mask), &mask) == 0;
 }
 
-// ── Mode 1: Sequential Blocking ─────────────────────────────────────────────
-static PipelineResult run_sequential(int num_steps) {
+// ── Single-stream executor: GPU completion G × NPU launch L × wait W ────────
+// Every single-stream mode is one (G, L) pair (sync_mode_policies):
+//   Seq Blocking      finish × inline     Fast Sync         flag × worker
+//   Thread+clFinish   finish × worker     Fast Sync Direct  flag × direct
+//   Event Poll        event  × worker     Parallel Sync     flag × syncwait
+//   Async NPU         flag   × async
+// and --mode custom / matrix runs any other valid pair (e.g. callback × direct).
+// One step:
+//   inline:   submit → wait GPU → graphExecute on this thread
+//   worker:   submit → wait GPU → hand the step to the NPU thread → wait NPU
+//   direct:   submit → hand the step to the NPU thread, which waits GPU itself
+//             and runs graphExecute (main thread free) → wait NPU
+//   syncwait: submit → set wait epoch → hand the step to the NPU thread at once;
+//             the DSP SyncWait op waits the GPU flag inside graphExecute
+//             (GPU sync is absorbed into npu_compute, gpu_* report 0)
+//   async:    submit → wait GPU → graphExecuteAsync → wait the NPU completion
+//             counter the QNN notify callback bumps (no NPU thread)
+//   persistent: submit → (first step of a burst: hand the burst to the NPU
+//             thread, one graphExecute for --burst steps) → wait the NPU done
+//             flag the DSP loop publishes per step, with a timeout
+// Timing, identical for every pair:
+//   gpu_compute  kernel time from profiling (flag: 0, there is no event)
+//   gpu_sync     submit start → GPU done observed, minus gpu_compute
+//   npu_compute  graphExecute wall time (async: launch → notify callback;
+//                persistent: GPU submitted → NPU done flag seen, the burst's
+//                launch lands in its first step)
+//   npu_sync     NPU launch (GPU done seen / step handed over) → main sees NPU
+//                done, minus npu_compute (persistent: 0, inside npu_compute)
+// A persistent step that never publishes (op timed out or failed) ends the
+// run with an error; num_steps is then the steps completed before it.
+template <typename G, typename L, typename W>
+static PipelineResult run_sync(int num_steps, bool predict, int npu_core, int burst) {
+  static_assert(kValidCombo<G, L>, "invalid GPU completion / NPU launch combination");
   PipelineResult result;
   result.steps.reserve(num_steps);
 
-  double total_t0 = now_us();
-  for (int i = 0; i < num_steps; ++i) {
-    StepTiming st = {};
-    double step_t0 = now_us();
-
-    // GPU: enqueue + clFinish
-    double gpu_compute = 0;
-    double gpu_wall = gpu_execute_blocking(&gpu_compute);
-    st.gpu_compute_us = gpu_compute;
-    st.gpu_sync_us = gpu_wall - gpu_compute;
-
-    // NPU: blocking graphExecute
-    double npu_t0 = now_us();
-    st.npu_compute_us = npu_execute_blocking();
-    st.npu_sync_us = 0;  // embedded in graphExecute
-
-    st.step_total_us = now_us() - step_t0;
-    result.steps.push_back(st);
+  if constexpr (G::kHasFlag) {
+    if (!G::flag_ptr()) {
+      result.error = "Flag not enabled";
+      return result;
+    }
   }
-  result.total_us = now_us() - total_t0;
-  result.num_steps = num_steps;
-  result.success = true;
-  return result;
-}
-
-// ── Mode 2: Threaded + clFinish ──────────────────────────────────────────────
-static PipelineResult run_threaded_clfinish(int num_steps, int npu_core) {
-  PipelineResult result;
-  result.steps.reserve(num_steps);
-
-  std::atomic<uint32_t> npu_start{0};
-  std::atomic<uint32_t> npu_done{0};
-  std::atomic<bool> running{true};
-  std::vector<double> npu_times;
-  npu_times.reserve(num_steps);
-
-  // NPU worker thread
-  std::thread npu_thread([&, npu_core]() {
-    pin_to_core(npu_core);
-    while (running.load(std::memory_order_acquire)) {
-      // Wait for signal to start (yield to reduce contention)
-      while (!npu_start.load(std::memory_order_acquire)) {
-        if (!running.load(std::memory_order_relaxed)) return;
-        cpu_pause();
-      }
-      npu_start.store(0, std::memory_order_relaxed);
 
-      double exec_us = npu_execute_blocking();
-      npu_times.push_back(exec_us);
-
-      npu_done.store(1, std::memory_order_release);
+  StepQueue   npu_cmds;     // main → NPU: step to run (+ GPU ticket for direct)
+  RecordQueue npu_results;  // NPU → main: step done + timing
+  PredictiveWaiter gpu_pred("gpu_done"), npu_pred("npu_done");
+  PredictiveWaiter* gpu_p = predict ? &gpu_pred : nullptr;
+  PredictiveWaiter* npu_p = predict && (L::kWorker || L::kNotify) ? &npu_pred : nullptr;
+
+  // Persistent launch: NPU done epochs continue from whatever the flag holds
+  const volatile uint32_t* npu_done = nullptr;
+  uint32_t npu_epoch = 0, burst_gpu = 0, bursts = 0;
+  if constexpr (L::kBurst) {
+    npu_done = npu_get_done_flag_ptr();
+    if (!npu_done) {
+      result.error = "NPU done flag not set up";
+      return result;
     }
-  });
+    npu_epoch = *npu_done;
+    burst = std::max(burst, 1);
+  }
+
+  std::thread npu_thread;
+  if constexpr (L::kWorker) {
+    npu_thread = std::thread([&, npu_core]() {
+      pin_to_core(npu_core);
+      npu_worker<G, W>(npu_cmds, npu_results, gpu_p);
+    });
+  }
 
   double total_t0 = now_us();
   for (int i = 0; i < num_steps; ++i) {
     StepTiming st = {};
     double step_t0 = now_us();
 
-    // GPU: enqueue + clFinish (still blocking)
-    double gpu_compute = 0;
-    double gpu_wall = gpu_execute_blocking(&gpu_compute);
-    st.gpu_compute_us = gpu_compute;
-    st.gpu_sync_us = gpu_wall - gpu_compute;
+    StepCmd cmd;
+    cmd.step = i;
+    cmd.wait_gpu = L::kWorkerWaitsGpu;
+    G::template submit<W>(cmd.gpu);
+
+    // GPU completion on the main thread (inline / worker launch)
+    if constexpr (!L::kWorkerWaitsGpu && !L::kDspWaitsGpu) {
+      G::template wait<W>(cmd.gpu, gpu_p);
+      double gpu_done_t = now_us();
+      G::finish(cmd.gpu);
+      st.gpu_compute_us = cmd.gpu.compute_us;
+      st.gpu_sync_us = (gpu_done_t - cmd.gpu.submit_us) - st.gpu_compute_us;
+    }
 
-    // Signal NPU to start
-    npu_start.store(1, std::memory_order_release);
+    if constexpr (L::kNotify) {
+      double launch_t = now_us(), npu_end_t = 0;
+      uint32_t n = NpuAsync::launch<W>(-1, &npu_end_t);
+      NpuAsync::wait<W>(n, npu_p, launch_t);
+      st.npu_compute_us = npu_end_t - launch_t;
+      st.npu_sync_us = now_us() - npu_end_t;
+    } else if constexpr (L::kBurst) {
+      // Step k of a burst waits for GPU epoch burst_gpu + k on the DSP
+      double launch_t = now_us();
+      const int k = i % burst;
+      if (k == 0) {
+        if (bursts > 0) pop_record<W>(npu_results, nullptr, launch_t);  // previous graphExecute returned
+        cmd.burst = static_cast<uint32_t>(std::min(burst, num_steps - i));
+        cmd.done_epoch = npu_epoch + 1;
+        burst_gpu = cmd.gpu.epoch;
+        npu_cmds.push<W>(cmd);
+        ++bursts;
+      } else if (cmd.gpu.epoch != burst_gpu + k) {
+        result.error = "GPU epochs not consecutive within a burst";
+        break;
+      }
 
-    // Wait for NPU completion (spin with yield)
-    double npu_wait_t0 = now_us();
-    while (!npu_done.load(std::memory_order_acquire))
-      cpu_pause();
-    npu_done.store(0, std::memory_order_relaxed);
-    double npu_wait_t1 = now_us();
+      // Done flag, or the burst's graphExecute returned without publishing
+      // this step (op failed / timed out), or our own timeout
+      const uint32_t target = ++npu_epoch, launched = bursts;
+      const double deadline = launch_t + kNpuStepTimeoutUs;
+      bool reached = false, ended = false;
+      until_done<W>(npu_p, launch_t, [&] {
+        reached = epoch_reached(*npu_done, target);
+        ended = epoch_reached(npu_results.pushed().load(std::memory_order_acquire), launched);
+        return reached || ended || now_us() > deadline;
+      });
+      reached = reached || epoch_reached(*npu_done, target);
+      if (!reached) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "NPU burst %s: %d of %d steps completed",
+                 ended ? "returned early" : "timed out", i, num_steps);
+        result.error = msg;
+        break;
+      }
+      G::finish(cmd.gpu);
+      st.npu_compute_us = now_us() - launch_t;
+      st.npu_sync_us = 0;  // the done flag poll is the wait
+    } else if constexpr (!L::kWorker) {
+      st.npu_compute_us = npu_execute_blocking();
+      st.npu_sync_us = 0;  // embedded in graphExecute
+    } else {
+      // DSP SyncWait reads the epoch from a tensor shared by all executions,
+      // so syncwait keeps one step in flight
+      if constexpr (L::kDspWaitsGpu) npu_set_wait_epoch(cmd.gpu.epoch);
+
+      double launch_t = now_us();
+      npu_cmds.push<W>(cmd);
+      StepRecord rec = pop_record<W>(npu_results, npu_p, launch_t);
+      double npu_done_t = now_us();
+
+      if constexpr (L::kWorkerWaitsGpu) {
+        st.gpu_compute_us = rec.gpu_compute_us;
+        st.gpu_sync_us = (rec.gpu_done_us - cmd.gpu.submit_us) - rec.gpu_compute_us;
+        launch_t = rec.gpu_done_us;  // graphExecute starts right after the worker sees the GPU
+      }
+      if constexpr (L::kDspWaitsGpu) G::finish(cmd.gpu);
 
-    st.npu_compute_us = npu_times.back();
-    st.npu_sync_us = (npu_wait_t1 - npu_wait_t0) - st.npu_compute_us;
-    if (st.npu_sync_us < 0) st.npu_sync_us = 0;
+      st.npu_compute_us = rec.npu_exec_us;
+      st.npu_sync_us = (npu_done_t - launch_t) - st.npu_compute_us;
+      if (st.npu_sync_us < 0) st.npu_sync_us = 0;
+    }
 
     st.step_total_us = now_us() - step_t0;
     result.steps.push_back(st);
   }
   result.total_us = now_us() - total_t0;
 
-  running.store(false, std::memory_order_release);
-  npu_start.store(1, std::memory_order_release);  // wake thread to exit
-  npu_thread.join();
+  if constexpr (L::kBurst) {
+    if (result.error.empty() && bursts > 0) pop_record<W>(npu_results, nullptr, 0);
+    result.npu_bursts = static_cast<int>(bursts);
+  }
+  // After a failed burst this joins once the op gives up on the GPU flag
+  if constexpr (L::kWorker) stop_worker<W>(npu_cmds, npu_thread);
+  collect_predict(result, {gpu_p, npu_p});
 
-  result.num_steps = num_steps;
-  result.success = true;
+  result.num_steps = static_cast<int>(result.steps.size());
+  result.success = result.error.empty();
   return result;
 }
 
-// ── Mode 3: Event Poll (clFlush + cl_event polling, driver-level) ────────────
-static PipelineResult run_event_poll(int num_steps, int usleep_hint, int npu_core) {
+// ── Pipelined (Fast Sync Direct with K steps in flight) ─────────────────────
+// Each slot owns its own ping-pong buffers and flag in the epoch table, so the main
+// thread can submit GPU work for step N+1..N+K-1 while the NPU thread is still
+// running step N. Slots model independent request streams (no data dependency
+// between consecutive steps), which is what lets GPU and NPU overlap.
+// Timeline (K=2):
+//   GPU:  [step0][step1]      [step2]      ...
+//   NPU:         [  step0  ][  step1  ][  step2  ]
+//   Steady state per step ≈ max(gpu, npu) instead of gpu + npu.
+// Up to K step descriptors sit in the command ring; the main thread drains the
+// record ring only when it needs a slot back (step i-K finished).
+template <typename W>
+static PipelineResult run_pipelined(int num_steps, int depth, bool predict, int npu_core) {
   PipelineResult result;
-  result.steps.reserve(num_steps);
+  result.steps.resize(num_steps);
 
-  std::atomic<uint32_t> npu_start{0};
-  std::atomic<uint32_t> npu_done{0};
-  std::atomic<bool> running{true};
-  std::vector<double> npu_times;
-  npu_times.reserve(num_steps);
+  StepQueue   npu_cmds;     // main → NPU: step submitted to GPU (slot, epoch, flag)
+  RecordQueue npu_results;  // NPU → main: step finished on NPU
+  PredictiveWaiter gpu_pred("gpu_flag");
+  PredictiveWaiter* gpu_p = predict ? &gpu_pred : nullptr;
+  std::vector<double> submit_t(num_steps), done_t(num_steps);  // main thread only
 
-  // NPU worker thread (yield while waiting to reduce CPU contention)
+  // NPU worker: consumes steps in order, polls the slot's flag, runs the slot's graph
   std::thread npu_thread([&, npu_core]() {
     pin_to_core(npu_core);
-    while (running.load(std::memory_order_acquire)) {
-      while (!npu_start.load(std::memory_order_acquire)) {
-        if (!running.load(std::memory_order_relaxed)) return;
-        cpu_pause();
-      }
-      npu_start.store(0, std::memory_order_relaxed);
-
-      double exec_us = npu_execute_blocking();
-      npu_times.push_back(exec_us);
-
-      npu_done.store(1, std::memory_order_release);
-    }
+    npu_worker<GpuFlag, W>(npu_cmds, npu_results, gpu_p);
   });
 
+  int completed = 0;
+  auto collect = [&]() {
+    StepRecord rec = npu_results.pop<W>();
+    StepTiming& st = result.steps[rec.step];
+    st.gpu_compute_us = 0;  // no profiling in flag mode
+    st.gpu_sync_us    = rec.gpu_wait_us;
+    st.npu_compute_us = rec.npu_exec_us;
+    st.npu_sync_us    = 0;
+    done_t[rec.step]  = rec.done_us;
+    ++completed;
+  };
+
   double total_t0 = now_us();
   for (int i = 0; i < num_steps; ++i) {
-    StepTiming st = {};
-    double step_t0 = now_us();
-
-    // GPU: non-blocking enqueue + flush (measure submit time)
-    double submit_t0 = now_us();
-    cl_event gpu_evt = gpu_execute_nonblocking();
-    double submit_t1 = now_us();
-
-    // Poll for GPU completion (cl_event polling, still goes through driver)
-    int poll_count = 0;
-    while (!gpu_poll_event(gpu_evt))
-      poll_count++;
-    double poll_t1 = now_us();
-
-    st.gpu_compute_us = gpu_event_compute_us(gpu_evt);
-    // gpu_sync = total GPU overhead = submit + poll - compute
-    st.gpu_sync_us = (poll_t1 - submit_t0) - st.gpu_compute_us;
-    clReleaseEvent(gpu_evt);
-
-    // Signal NPU to start
-    npu_start.store(1, std::memory_order_release);
-
-    // Wait for NPU with optional sleep hint
-    double npu_wait_t0 = now_us();
-    if (usleep_hint > 0)
-      usleep(usleep_hint);
-    while (!npu_done.load(std::memory_order_acquire))
-      cpu_pause();
-    npu_done.store(0, std::memory_order_relaxed);
-    double npu_wait_t1 = now_us();
-
-    st.npu_compute_us = npu_times.back();
-    st.npu_sync_us = (npu_wait_t1 - npu_wait_t0) - st.npu_compute_us;
-    if (st.npu_sync_us < 0) st.npu_sync_us = 0;
-
-    st.step_total_us = now_us() - step_t0;
-    result.steps.push_back(st);
+    // Slot reuse: step i-depth must have left the NPU before its buffers are overwritten
+    while (completed < i - depth + 1) collect();
+    int slot = i % depth;
+    StepCmd cmd;
+    cmd.step = i;
+    cmd.slot = slot;
+    cmd.wait_gpu = true;
+    cmd.gpu.flag = gpu_get_slot_flag_ptr(slot);
+    cmd.gpu.submit_us = submit_t[i] = now_us();
+    cmd.gpu.epoch = gpu_submit_slot(slot);
+    npu_cmds.push<W>(cmd);
   }
+  while (completed < num_steps) collect();
   result.total_us = now_us() - total_t0;
 
-  running.store(false, std::memory_order_release);
-  npu_start.store(1, std::memory_order_release);
-  npu_thread.join();
+  stop_worker<W>(npu_cmds, npu_thread);
+  collect_predict(result, {gpu_p});
+
+  for (int i = 0; i < num_steps; ++i) {
+    StepTiming& st = result.steps[i];
+    st.step_total_us   = done_t[i] - (i > 0 ? done_t[i - 1] : total_t0);
+    st.step_latency_us = done_t[i] - submit_t[i];
+  }
 
   result.num_steps = num_steps;
   result.success = true;
   return result;
 }
 
-// ── Mode 4: Fast Sync (paper Section 4.3: shared memory flag polling) ────────
-static PipelineResult run_fast_sync(int num_steps, int usleep_hint, int npu_core) {
+// ── Pipelined with async NPU launch (--mode pipelined --launch async) ───────
+// Same slots and flags as run_pipelined, but no NPU thread: the main thread
+// waits each step's GPU flag, launches the slot's graph with graphExecuteAsync
+// and submits the next GPU step while the NPU runs, so up to K steps sit in
+// the NPU queue and the notify callbacks report them in order.
+// Timeline (K=2):
+//   GPU:  [step0]      [step1]      [step2]
+//   NPU:         [  step0  ][  step1  ][  step2  ]
+// npu_compute of a step starts when it launched or when the NPU finished the
+// previous step, whichever is later (time queued behind it is not compute).
+template <typename W>
+static PipelineResult run_pipelined_async(int num_steps, int depth, bool predict) {
   PipelineResult result;
-  result.steps.reserve(num_steps);
-
-  volatile uint32_t* flag_ptr = gpu_get_flag_ptr();
-  if (!flag_ptr) {
-    result.error = "Flag not enabled";
-    return result;
-  }
-
-  std::atomic<uint32_t> npu_start{0};
-  std::atomic<uint32_t> npu_done{0};
-  std::atomic<bool> running{true};
-  std::vector<double> npu_times;
-  npu_times.reserve(num_steps);
-
-  // NPU worker thread
-  std::thread npu_thread([&, npu_core]() {
-    pin_to_core(npu_core);
-    while (running.load(std::memory_order_acquire)) {
-      while (!npu_start.load(std::memory_order_acquire)) {
-        if (!running.load(std::memory_order_relaxed)) return;
-        cpu_pause();
-      }
-      npu_start.store(0, std::memory_order_relaxed);
-
-      double exec_us = npu_execute_blocking();
-      npu_times.push_back(exec_us);
-
-      npu_done.store(1, std::memory_order_release);
-    }
-  });
+  result.steps.resize(num_steps);
+
+  PredictiveWaiter gpu_pred("gpu_flag"), npu_pred("npu_done");
+  PredictiveWaiter* gpu_p = predict ? &gpu_pred : nullptr;
+  PredictiveWaiter* npu_p = predict ? &npu_pred : nullptr;
+  std::vector<double> submit_t(num_steps), launch_t(num_steps), npu_end_t(num_steps),
+                      done_t(num_steps);
+  std::vector<uint32_t> npu_ticket(num_steps);
+
+  int completed = 0;
+  auto collect = [&]() {
+    int i = completed;
+    NpuAsync::wait<W>(npu_ticket[i], npu_p, launch_t[i]);
+    done_t[i] = now_us();
+    double npu_start = i > 0 ? std::max(launch_t[i], npu_end_t[i - 1]) : launch_t[i];
+    StepTiming& st = result.steps[i];
+    st.npu_compute_us = npu_end_t[i] - npu_start;
+    st.npu_sync_us    = done_t[i] - npu_end_t[i];
+    ++completed;
+  };
 
   double total_t0 = now_us();
   for (int i = 0; i < num_steps; ++i) {
-    StepTiming st = {};
-    double step_t0 = now_us();
-
-    // GPU: submit (clEnqueue + clFlush, flag auto-reset)
-    gpu_submit();
-
-    // Poll shared memory flag directly (no OpenCL driver!)
-    double poll_t0 = now_us();
-    if (usleep_hint > 0)
-      usleep(usleep_hint);
-    while (*flag_ptr == 0)
-      cpu_pause();
-    double poll_t1 = now_us();
-
-    // gpu_sync = total time from step start to flag detection - kernel compute (unknown without profiling)
-    // For flag mode, we report total GPU wall time as gpu_sync since we can't get profiling without cl_event
-    st.gpu_compute_us = 0;  // no profiling available in flag mode
-    st.gpu_sync_us = poll_t1 - step_t0;  // total GPU time (submit + wait)
-
-    // Signal NPU to start
-    npu_start.store(1, std::memory_order_release);
-
-    // Wait for NPU with optional sleep hint
-    double npu_wait_t0 = now_us();
-    while (!npu_done.load(std::memory_order_acquire))
-      cpu_pause();
-    npu_done.store(0, std::memory_order_relaxed);
-    double npu_wait_t1 = now_us();
-
-    st.npu_compute_us = npu_times.back();
-    st.npu_sync_us = (npu_wait_t1 - npu_wait_t0) - st.npu_compute_us;
-    if (st.npu_sync_us < 0) st.npu_sync_us = 0;
-
-    st.step_total_us = now_us() - step_t0;
-    result.steps.push_back(st);
+    // Slot reuse: step i-depth must have left the NPU before its buffers are overwritten
+    while (completed < i - depth + 1) collect();
+    int slot = i % depth;
+    submit_t[i] = now_us();
+    uint32_t epoch = gpu_submit_slot(slot);
+    wait_done<W>(gpu_p, submit_t[i], gpu_get_slot_flag_ptr(slot),
+                 [epoch](uint32_t v) { return epoch_reached(v, epoch); });
+    launch_t[i] = now_us();
+    result.steps[i].gpu_compute_us = 0;  // no profiling in flag mode
+    result.steps[i].gpu_sync_us    = launch_t[i] - submit_t[i];
+    npu_ticket[i] = NpuAsync::launch<W>(slot, &npu_end_t[i]);
   }
+  while (completed < num_steps) collect();
   result.total_us = now_us() - total_t0;
+  collect_predict(result, {gpu_p, npu_p});
 
-  running.store(false, std::memory_order_release);
-  npu_start.store(1, std::memory_order_release);
-  npu_thread.join();
+  for (int i = 0; i < num_steps; ++i) {
+    StepTiming& st = result.steps[i];
+    st.step_total_us   = done_t[i] - (i > 0 ? done_t[i - 1] : total_t0);
+    st.step_latency_us = done_t[i] - submit_t[i];
+  }
 
   result.num_steps = num_steps;
   result.success = true;
   return result;
 }
 
-// ── Mode 5: Fast Sync Direct (NPU thread polls flag, main thread freed) ─────
-static PipelineResult run_fast_sync_direct(int num_steps, int usleep_hint, int npu_core) {
-  PipelineResult result;
-  result.steps.reserve(num_steps);
-
-  volatile uint32_t* flag_ptr = gpu_get_flag_ptr();
-  if (!flag_ptr) {
-    result.error = "Flag not enabled";
-    return result;
+// ── Layered (decoder-style stack, --mode layered) ───────────────────────────
+// Each step (token) runs --layers L RMSNorm layers, layer l on the device
+// placement[l] names ('G' / 'N'). Layer l owns GPU slot l (flag l+1) and NPU
+// slot l, both reading ring buffer l and writing ring buffer l+1, so buffers
+// rotate through the stack and the last layer feeds the next token.
+// One main thread, flag × inline at every device switch:
+//   GPU layers:  clEnqueue + clFlush each (in-order queue, no wait in between)
+//                → poll the last GPU layer's flag before the next NPU layer
+//   NPU layers:  graphExecute each, blocking
+// Timing per step: gpu_sync = Σ GPU runs (first submit → flag seen),
+// npu_compute = Σ graphExecute wall time.
+template <typename W>
+static double run_layer_stack(const std::string& placement, PredictiveWaiter* gpu_p,
+                              StepTiming& st) {
+  const int layers = static_cast<int>(placement.size());
+  double t0 = now_us(), run_t0 = 0;
+  for (int l = 0; l < layers; ++l) {
+    if (placement[l] == 'N') {
+      st.npu_compute_us += npu_execute_slot(l);
+      continue;
+    }
+    if (l == 0 || placement[l - 1] != 'G') run_t0 = now_us();
+    uint32_t epoch = gpu_submit_slot(l);
+    if (l + 1 == layers || placement[l + 1] != 'G') {
+      wait_done<W>(gpu_p, run_t0, gpu_get_slot_flag_ptr(l),
+                   [epoch](uint32_t v) { return epoch_reached(v, epoch); });
+      st.gpu_sync_us += now_us() - run_t0;
+    }
   }
+  return now_us() - t0;
+}
 
-  std::atomic<uint32_t> gpu_submitted{0};  // main → NPU: "GPU submitted, start polling flag"
-  std::atomic<uint32_t> npu_done{0};       // NPU → main: "graphExecute done"
-  std::atomic<bool> running{true};
-  std::vector<double> npu_exec_times;      // graphExecute wall time
-  std::vector<double> npu_flag_poll_times; // time NPU thread spent polling flag
-  npu_exec_times.reserve(num_steps);
-  npu_flag_poll_times.reserve(num_steps);
-
-  // NPU worker thread: directly polls shared memory flag!
-  std::thread npu_thread([&, npu_core]() {
-    pin_to_core(npu_core);
-    while (running.load(std::memory_order_acquire)) {
-      // Wait for main to signal that GPU has been submitted
-      while (!gpu_submitted.load(std::memory_order_acquire)) {
-        if (!running.load(std::memory_order_relaxed)) return;
-        cpu_pause();
-      }
-      gpu_submitted.store(0, std::memory_order_relaxed);
-
-      // Directly poll shared memory flag (no main thread intermediary!)
-      double poll_t0 = now_us();
-      while (*flag_ptr == 0)
-        cpu_pause();
-      double poll_t1 = now_us();
-      npu_flag_poll_times.push_back(poll_t1 - poll_t0);
-
-      // GPU done — immediately execute NPU (zero relay overhead)
-      double exec_us = npu_execute_blocking();
-      npu_exec_times.push_back(exec_us);
-
-      npu_done.store(1, std::memory_order_release);
+// Boundary cost: each device's per-layer cost is first measured on the same
+// stack with every layer on that device (one sync per step, amortized over L
+// layers). Whatever a mixed placement costs beyond those per-layer costs is
+// the price of its device switches:
+//   sync per boundary = (step p50 − Σ per-layer costs) / boundaries
+// where boundaries counts switches around the ring (last layer → next token).
+template <typename W>
+static PipelineResult run_layered(int num_steps, int calib_steps, const std::string& placement,
+                                  bool predict) {
+  PipelineResult result;
+  const int layers = static_cast<int>(placement.size());
+  result.layers = layers;
+  result.gpu_layers = static_cast<int>(std::count(placement.begin(), placement.end(), 'G'));
+  for (int l = 0; l < layers; ++l)
+    if (placement[l] != placement[(l + 1) % layers]) ++result.boundaries;
+
+  auto layer_cost = [&](char dev) {
+    if (placement.find(dev) == std::string::npos) return 0.0;
+    std::string uniform(layers, dev);
+    std::vector<double> t;
+    for (int i = 0; i < calib_steps; ++i) {
+      StepTiming st = {};
+      t.push_back(run_layer_stack<W>(uniform, nullptr, st));
     }
-  });
+    return compute_stats(t).p50 / layers;
+  };
+  result.gpu_layer_us = layer_cost('G');
+  result.npu_layer_us = layer_cost('N');
 
+  PredictiveWaiter gpu_pred("gpu_flag");
+  PredictiveWaiter* gpu_p = predict ? &gpu_pred : nullptr;
+  result.steps.reserve(num_steps);
   double total_t0 = now_us();
   for (int i = 0; i < num_steps; ++i) {
     StepTiming st = {};
-    double step_t0 = now_us();
-
-    // GPU: submit (clEnqueue + clFlush, flag auto-reset)
-    gpu_submit();
-
-    // Immediately tell NPU thread to start polling flag
-    gpu_submitted.store(1, std::memory_order_release);
-
-    // Main thread is now FREE — in a real pipeline, could submit next GPU kernel here
-
-    // Wait for NPU completion
-    double npu_wait_t0 = now_us();
-    while (!npu_done.load(std::memory_order_acquire))
-      cpu_pause();
-    npu_done.store(0, std::memory_order_relaxed);
-
-    // Report gpu_sync as the flag poll time measured in NPU thread
-    st.gpu_compute_us = 0;  // no profiling in flag mode
-    st.gpu_sync_us = npu_flag_poll_times.back();  // GPU completion latency (measured in NPU thread)
-    st.npu_compute_us = npu_exec_times.back();
-    st.npu_sync_us = 0;  // NPU starts immediately after flag detection
-
-    st.step_total_us = now_us() - step_t0;
+    st.step_total_us = run_layer_stack<W>(placement, gpu_p, st);
     result.steps.push_back(st);
   }
   result.total_us = now_us() - total_t0;
-
-  running.store(false, std::memory_order_release);
-  gpu_submitted.store(1, std::memory_order_release);  // wake thread to exit
-  npu_thread.join();
+  collect_predict(result, {gpu_p});
 
   result.num_steps = num_steps;
   result.success = true;
   return result;
 }
 
-// ── Mode 6: Parallel Sync (GPU+NPU parallel launch, DSP polls GPU flag) ─────
-// Requires: npu_init_with_sync() already called (graph has SyncWait custom op).
-// Timeline:
-//   t=0:  GPU submit (clFlush) + signal NPU to start graphExecute in parallel
-//   t~80: DSP starts executing SyncWait, polls GPU flag with dcinva
-//   t~120: GPU flag set → DSP spin-poll detects it
-//   t~141: DSP done → graphExecute returns
-//   Total: ~graphExecute wall time (NPU RPC launch overlaps GPU execution)
-static PipelineResult run_parallel_sync(int num_steps, int npu_core) {
-  PipelineResult result;
-  result.steps.reserve(num_steps);
-
-  volatile uint32_t* flag_ptr = gpu_get_flag_ptr();
-  if (!flag_ptr) {
-    result.error = "GPU flag not enabled (parallel sync requires flag)";
-    return result;
+// ── Mode dispatch for one wait strategy ─────────────────────────────────────
+template <typename W>
+static PipelineResult run_mode(const PipelineConfig& config, GpuSync gpu_sync,
+                               NpuLaunch npu_launch, int depth, const std::string& placement) {
+  if (config.mode == SyncMode::LAYERED)
+    return run_layered<W>(config.num_steps, std::max(config.num_warmup, 1), placement,
+                          config.predict_wait);
+  if (config.mode == SyncMode::PIPELINED) {
+    if (npu_launch == NpuLaunch::ASYNC)
+      return run_pipelined_async<W>(config.num_steps, depth, config.predict_wait);
+    return run_pipelined<W>(config.num_steps, depth, config.predict_wait, config.npu_core);
   }
 
-  std::atomic<uint32_t> gpu_submitted{0};  // main → NPU: GPU submitted, start graphExecute
-  std::atomic<uint32_t> npu_done{0};       // NPU → main: graphExecute returned
-  std::atomic<bool> running{true};
-  std::vector<double> npu_exec_times;
-  npu_exec_times.reserve(num_steps);
-
-  // NPU thread starts graphExecute immediately after GPU submit.
-  // DSP SyncWait op handles GPU synchronization internally via flag polling.
-  std::thread npu_thread([&, npu_core]() {
-    pin_to_core(npu_core);
-    while (running.load(std::memory_order_acquire)) {
-      while (!gpu_submitted.load(std::memory_order_acquire)) {
-        if (!running.load(std::memory_order_relaxed)) return;
-        cpu_pause();
-      }
-      gpu_submitted.store(0, std::memory_order_relaxed);
-
-      double exec_us = npu_execute_blocking();
-      npu_exec_times.push_back(exec_us);
-
-      npu_done.store(1, std::memory_order_release);
-    }
+  PipelineResult result;
+  bool valid = dispatch_sync(gpu_sync, npu_launch, [&](auto g, auto l) {
+    result = run_sync<decltype(g), decltype(l), W>(config.num_steps, config.predict_wait,
+                                                   config.npu_core, config.burst_steps);
   });
-
-  double total_t0 = now_us();
-  for (int i = 0; i < num_steps; ++i) {
-    StepTiming st = {};
-    double step_t0 = now_us();
-
-    // GPU: submit (clEnqueue + clFlush, flag auto-reset to 0)
-    gpu_submit();
-
-    // Signal NPU thread to launch graphExecute in parallel with GPU execution.
-    // DSP SyncWait op will spin-poll the flag until GPU writes 1.
-    gpu_submitted.store(1, std::memory_order_release);
-
-    // Wait for NPU completion (graphExecute returns after DSP detects GPU flag)
-    double npu_wait_t0 = now_us();
-    while (!npu_done.load(std::memory_order_acquire))
-      cpu_pause();
-    npu_done.store(0, std::memory_order_relaxed);
-    double npu_wait_t1 = now_us();
-
-    st.gpu_compute_us = 0;  // GPU sync absorbed into NPU graphExecute (DSP polls internally)
-    st.gpu_sync_us = 0;
-    st.npu_compute_us = npu_exec_times.back();
-    st.npu_sync_us = (npu_wait_t1 - npu_wait_t0) - st.npu_compute_us;
-    if (st.npu_sync_us < 0) st.npu_sync_us = 0;
-
-    st.step_total_us = now_us() - step_t0;
-    result.steps.push_back(st);
-  }
-  result.total_us = now_us() - total_t0;
-
-  running.store(false, std::memory_order_release);
-  gpu_submitted.store(1, std::memory_order_release);
-  npu_thread.join();
-
-  result.num_steps = num_steps;
-  result.success = true;
+  if (!valid)
+    result.error = std::string("invalid combination ") + gpu_sync_name(gpu_sync) + "+" +
+                   npu_launch_name(npu_launch);
   return result;
 }
 
@@ -455,10 +524,70 @@ PipelineResult run_pipeline(const PipelineConfig& config, const char* kernel_pat
   int hidden = config.hidden_dim;
   size_t tensor_bytes = (size_t)hidden * 2;  // FP16, batch=1
 
+  // Single-stream modes are a (GPU completion, NPU launch) policy pair
+  GpuSync gpu_sync = config.gpu_sync;
+  NpuLaunch npu_launch = config.npu_launch;
+  bool pipelined = config.mode == SyncMode::PIPELINED;
+  bool layered = config.mode == SyncMode::LAYERED;
+  bool single_stream = !pipelined && !layered;
+  if (single_stream) {
+    if (config.mode != SyncMode::CUSTOM)
+      sync_mode_policies(config.mode, gpu_sync, npu_launch);
+    if (!sync_combo_valid(gpu_sync, npu_launch)) {
+      result.error = std::string("invalid combination ") + gpu_sync_name(gpu_sync) + "+" +
+                     npu_launch_name(npu_launch);
+      return result;
+    }
+  }
+  bool sync_graph = single_stream && npu_launch == NpuLaunch::SYNC_WAIT;
+  bool burst_graph = single_stream && npu_launch == NpuLaunch::PERSISTENT;
+
+  // LAYERED: one device letter per layer, the --placement pattern repeated
+  std::string placement;
+  if (layered) {
+    int layers = std::clamp(config.num_layers, 1, kFlagTableSlots - 1);
+    if (config.placement.empty() ||
+        config.placement.find_first_not_of("GN") != std::string::npos) {
+      result.error = "bad placement '" + config.placement + "' (G = GPU, N = NPU)";
+      return result;
+    }
+    for (int l = 0; l < layers; ++l)
+      placement += config.placement[l % config.placement.size()];
+  }
+
+  // Stage 1 is the GPU, or the host CPU engine for GpuSync::CPU (same flag contract)
+  bool cpu_stage = single_stream && gpu_sync == GpuSync::CPU;
+  auto stage_cleanup = [&] { if (cpu_stage) cpu_cleanup(); else gpu_cleanup(); };
+  auto stage_enable_flag = [&](const IonBuffer& table) {
+    return cpu_stage ? cpu_enable_flag(table, 0) : gpu_enable_flag(table, 0);
+  };
+  auto stage_disable_flag = [&] { if (cpu_stage) cpu_disable_flag(); else gpu_disable_flag(); };
+  bool persistent = single_stream && gpu_sync == GpuSync::PERSISTENT;
+
+  bool need_flag = !single_stream || gpu_sync == GpuSync::FLAG || persistent || cpu_stage;
+  int depth = std::clamp(config.pipeline_depth, 1, kFlagTableSlots - 1);
+  int ring_size = std::max(static_cast<int>(placement.size()), 2);
+
+  // --arena: every tensor below is a view of one ION allocation (destroyed
+  // on return, after the engines are cleaned up); otherwise one buffer each
+  double setup_t0 = now_us();
+  IonArena arena;
+  if (config.arena) {
+    int tensors = pipelined ? 2 * depth : layered ? ring_size : 2;
+    size_t capacity = tensors * IonArena::span(tensor_bytes) +
+                      (need_flag ? IonArena::span(kFlagTableBytes) : 0);
+    if (!arena.init(capacity)) {
+      result.error = "ION arena alloc failed";
+      return result;
+    }
+  }
+  auto alloc = [&](size_t bytes, IonBuffer& out) {
+    return config.arena ? arena.carve(bytes, out) : allocIonBuffer(bytes, 0, out);
+  };
+
   // Allocate shared ION buffers (ping-pong)
   IonBuffer ion_buf0, ion_buf1;
-  if (!allocIonBuffer(tensor_bytes, 0, ion_buf0) ||
-      !allocIonBuffer(tensor_bytes, 0, ion_buf1)) {
+  if (!alloc(tensor_bytes, ion_buf0) || !alloc(tensor_bytes, ion_buf1)) {
     result.error = "ION alloc failed";
     return result;
   }
@@ -470,28 +599,31 @@ PipelineResult run_pipeline(const PipelineConfig& config, const char* kernel_pat
   for (int i = 0; i < hidden; ++i)
     ptr[i] = float_to_half(dist(rng));
 
-  // Init GPU: reads buf0, writes buf1
-  if (!gpu_init(hidden, config.epsilon, ion_buf0, ion_buf1, kernel_path)) {
-    result.error = "GPU init failed";
+  // Init GPU (or CPU engine): reads buf0, writes buf1
+  bool stage_ok = cpu_stage
+      ? cpu_init(hidden, config.epsilon, ion_buf0, ion_buf1, config.cpu_threads, config.cpu_core)
+      : gpu_init(hidden, config.epsilon, ion_buf0, ion_buf1, kernel_path);
+  if (!stage_ok) {
+    result.error = cpu_stage ? "CPU init failed" : "GPU init failed";
     freeIonBuffer(ion_buf0); freeIonBuffer(ion_buf1);
     return result;
   }
 
-  // Allocate flag buffer for modes that need GPU shared-memory flag
+  // Allocate the epoch flag table for modes that need GPU shared-memory flags
+  // (flag 0: single-stream modes, flags 1..depth: pipelined slots / 1..L:
+  // layers, flag 1: persistent NPU launch done flag, last line: persistent
+  // kernel doorbell)
   IonBuffer ion_flag = {};
-  bool need_flag = (config.mode == SyncMode::FAST_SYNC ||
-                    config.mode == SyncMode::FAST_SYNC_DIRECT ||
-                    config.mode == SyncMode::PARALLEL_SYNC);
   if (need_flag) {
-    if (!allocIonBuffer(sizeof(uint32_t), 0, ion_flag)) {
+    if (!alloc(kFlagTableBytes, ion_flag)) {
       result.error = "ION flag alloc failed";
-      gpu_cleanup();
+      stage_cleanup();
       freeIonBuffer(ion_buf0); freeIonBuffer(ion_buf1);
       return result;
     }
-    if (!gpu_enable_flag(ion_flag)) {
-      result.error = "GPU flag enable failed";
-      gpu_cleanup();
+    if (!stage_enable_flag(ion_flag)) {
+      result.error = cpu_stage ? "CPU flag enable failed" : "GPU flag enable failed";
+      stage_cleanup();
       freeIonBuffer(ion_buf0); freeIonBuffer(ion_buf1); freeIonBuffer(ion_flag);
       return result;
     }
@@ -499,17 +631,70 @@ PipelineResult run_pipeline(const PipelineConfig& config, const char* kernel_pat
 
   // Init NPU: reads buf1, writes buf0
   bool npu_ok = false;
-  if (config.mode == SyncMode::PARALLEL_SYNC) {
-    // Sync graph: SyncWait + RmsNorm, requires GPU flag ION buffer
-    npu_ok = npu_init_with_sync(hidden, config.epsilon, ion_buf1, ion_buf0, ion_flag);
+  if (sync_graph) {
+    // Sync graph: SyncWait + RmsNorm, polls flag 0 of the epoch flag table
+    npu_ok = npu_init_with_sync(hidden, config.epsilon, ion_buf1, ion_buf0, ion_flag, 0);
+  } else if (burst_graph) {
+    // Persistent graph: waits flag 0 per step, publishes into kNpuDoneIndex
+    npu_ok = npu_init_persistent(hidden, config.epsilon, ion_buf1, ion_buf0, ion_flag,
+                                 0, kNpuDoneIndex);
   } else {
     npu_ok = npu_init(hidden, config.epsilon, ion_buf1, ion_buf0);
   }
   if (!npu_ok) {
     result.error = "NPU init failed";
-    gpu_cleanup(); freeIonBuffer(ion_buf0); freeIonBuffer(ion_buf1); freeIonBuffer(ion_flag);
+    stage_cleanup(); freeIonBuffer(ion_buf0); freeIonBuffer(ion_buf1); freeIonBuffer(ion_flag);
+    return result;
+  }
+
+  // PIPELINED: slot 0 reuses buf0/buf1, slots 1..depth-1 get their own pair.
+  // Slot s publishes into flag s+1 of the shared flag table.
+  std::vector<IonBuffer> slot_bufs;  // extra buffers owned here, freed at cleanup
+  if (pipelined) {
+    for (int s = 0; s < depth; ++s) {
+      IonBuffer in = ion_buf0, out = ion_buf1;
+      if (s > 0) {
+        if (!alloc(tensor_bytes, in) || !alloc(tensor_bytes, out)) {
+          result.error = "ION slot alloc failed";
+          break;
+        }
+        memcpy(in.ptr, ion_buf0.ptr, tensor_bytes);
+        slot_bufs.push_back(in); slot_bufs.push_back(out);
+      }
+      // GPU reads in → writes out; NPU reads out → writes in (same as ping-pong)
+      if (gpu_add_slot(in, out, ion_flag, s + 1) != s || npu_add_slot(out, in) != s) {
+        result.error = "slot setup failed";
+        break;
+      }
+    }
+  } else if (layered) {
+    // LAYERED: a ring of max(L, 2) buffers starting with buf0/buf1; layer l
+    // reads ring[l] and writes ring[l+1] on both devices, flag l+1
+    std::vector<IonBuffer> ring = {ion_buf0, ion_buf1};
+    for (int b = 2; b < ring_size && result.error.empty(); ++b) {
+      IonBuffer buf;
+      if (!alloc(tensor_bytes, buf)) {
+        result.error = "ION layer alloc failed";
+        break;
+      }
+      slot_bufs.push_back(buf);
+      ring.push_back(buf);
+    }
+    for (int l = 0; l < static_cast<int>(placement.size()) && result.error.empty(); ++l) {
+      const IonBuffer& in = ring[l];
+      const IonBuffer& out = ring[(l + 1) % ring_size];
+      if (gpu_add_slot(in, out, ion_flag, l + 1) != l || npu_add_slot(in, out) != l)
+        result.error = "layer setup failed";
+    }
+  }
+  if (!result.error.empty()) {
+    npu_cleanup(); stage_cleanup();
+    for (auto& b : slot_bufs) freeIonBuffer(b);
+    freeIonBuffer(ion_buf0); freeIonBuffer(ion_buf1); freeIonBuffer(ion_flag);
     return result;
   }
+  double setup_ms = (now_us() - setup_t0) / 1e3;
+  int ion_buffers = config.arena ? 1 : 2 + (need_flag ? 1 : 0) + static_cast<int>(slot_bufs.size());
 
   // Pin main thread if requested
   if (config.main_core >= 0) {
@@ -520,54 +705,60 @@ PipelineResult run_pipeline(const PipelineConfig& config, const char* kernel_pat
   }
 
   // Warmup (sequential blocking)
-  if (config.mode == SyncMode::PARALLEL_SYNC) {
-    // PARALLEL_SYNC: NPU graph has SyncWait op that polls GPU flag.
-    // Warmup sequentially: GPU submit → flag set → NPU executes.
+  if (sync_graph || burst_graph) {
+    // SyncWait launch: NPU graph has SyncWait op that polls GPU flag.
+    // Warmup sequentially: GPU submit → epoch published → NPU executes
+    // (persistent graph: a one-step burst).
     for (int i = 0; i < config.num_warmup; ++i) {
-      gpu_submit();
-      volatile uint32_t* fp = gpu_get_flag_ptr();
-      while (*fp == 0) cpu_pause();
-      npu_execute_blocking();
+      uint32_t epoch = cpu_stage ? cpu_submit() : gpu_submit();
+      volatile uint32_t* fp = cpu_stage ? cpu_get_flag_ptr() : gpu_get_flag_ptr();
+      SpinWait::wait(fp, [epoch](uint32_t v) { return epoch_reached(v, epoch); });
+      if (burst_graph) {
+        if (npu_execute_burst(epoch, 1, *npu_get_done_flag_ptr() + 1) == 0)
+          break;  // the op can't run bursts; the measured run reports it
+      } else {
+        npu_set_wait_epoch(epoch);
+        npu_execute_blocking();
+      }
     }
   } else {
     // Other modes: warmup without flag (plain clFinish + graphExecute)
-    gpu_disable_flag();
+    stage_disable_flag();
     for (int i = 0; i < config.num_warmup; ++i) {
-      gpu_execute_blocking(nullptr);
+      if (cpu_stage) cpu_execute_blocking();
+      else           gpu_execute_blocking(nullptr);
       npu_execute_blocking();
     }
     if (need_flag)
-      gpu_enable_flag(ion_flag);
-  }
-
-  // Run pipeline
-  switch (config.mode) {
-    case SyncMode::SEQUENTIAL_BLOCKING:
-      result = run_sequential(config.num_steps);
-      break;
-    case SyncMode::THREADED_CLFINISH:
-      result = run_threaded_clfinish(config.num_steps, config.npu_core);
-      break;
-    case SyncMode::EVENT_POLL:
-      result = run_event_poll(config.num_steps, config.usleep_hint, config.npu_core);
-      break;
-    case SyncMode::FAST_SYNC:
-      result = run_fast_sync(config.num_steps, config.usleep_hint, config.npu_core);
-      break;
-    case SyncMode::FAST_SYNC_DIRECT:
-      result = run_fast_sync_direct(config.num_steps, config.usleep_hint, config.npu_core);
-      break;
-    case SyncMode::PARALLEL_SYNC:
-      result = run_parallel_sync(config.num_steps, config.npu_core);
-      break;
-  }
-
-  result.avg_step_us = result.total_us / result.num_steps;
+      stage_enable_flag(ion_flag);
+  }
+
+  // Persistent: one launch from here on, every step is a doorbell store
+  if (persistent && !gpu_start_persistent(ion_flag, kPersistentCtrlIndex)) {
+    result.error = "GPU persistent kernel launch failed";
+    npu_cleanup(); stage_cleanup();
+    freeIonBuffer(ion_buf0); freeIonBuffer(ion_buf1); freeIonBuffer(ion_flag);
+    return result;
+  }
+
+  // Run pipeline with the selected wait strategy
+  double cpu_t0 = now_cpu_us();
+  result = dispatch_wait(config.wait, [&](auto w) {
+    return run_mode<decltype(w)>(config, gpu_sync, npu_launch, depth, placement);
+  });
+  result.cpu_us = now_cpu_us() - cpu_t0;
+  result.setup_ms = setup_ms;
+  result.ion_buffers = ion_buffers;
+
+  if (result.num_steps > 0)
+    result.avg_step_us = result.total_us / result.num_steps;
 
   // Cleanup
-  gpu_disable_flag();
+  if (persistent) gpu_stop_persistent();
+  stage_disable_flag();
   npu_cleanup();
-  gpu_cleanup();
+  stage_cleanup();
+  for (auto& b : slot_bufs) freeIonBuffer(b);
   freeIonBuffer(ion_buf0);
   freeIonBuffer(ion_buf1);
   freeIonBuffer(ion_flag);
@@ -575,8 +766,105 @@ PipelineResult run_pipeline(const PipelineConfig& config, const char* kernel_pat
   return result;
 }
 
+// ── NPU async queue check ──────────────────────────────────────────────────
+namespace {
+
+struct AsyncQueueCheck {
+  std::vector<int> order;              // completion position → launch index
+  std::atomic<uint32_t> claimed{0};    // positions handed to callbacks
+  std::atomic<uint32_t> completed{0};  // callbacks that recorded theirs
+};
+
+struct AsyncQueueProbe {
+  AsyncQueueCheck* check = nullptr;
+  int index = 0;
+  std::atomic<int> hits{0};
+};
+
+void on_async_queue_done(void* param) {
+  AsyncQueueProbe* probe = static_cast<AsyncQueueProbe*>(param);
+  probe->hits.fetch_add(1, std::memory_order_relaxed);
+  AsyncQueueCheck* check = probe->check;
+  uint32_t pos = check->claimed.fetch_add(1, std::memory_order_relaxed);
+  if (pos < check->order.size()) check->order[pos] = probe->index;
+  check->completed.fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace
+
+bool run_async_queue_check(int hidden_dim, int launches) {
+  size_t tensor_bytes = (size_t)hidden_dim * 2;
+  IonBuffer ion_in, ion_out;
+  if (!allocIonBuffer(tensor_bytes, 0, ion_in) ||
+      !allocIonBuffer(tensor_bytes, 0, ion_out)) {
+    printf("[AsyncQ] ION alloc failed\n");
+    freeIonBuffer(ion_in);
+    return false;
+  }
+  uint16_t* ptr = reinterpret_cast<uint16_t*>(ion_in.ptr);
+  for (int i = 0; i < hidden_dim; ++i) ptr[i] = float_to_half(1.0f);
+
+  if (!npu_init(hidden_dim, 1e-6f, ion_in, ion_out)) {
+    printf("[AsyncQ] NPU init failed\n");
+    freeIonBuffer(ion_in); freeIonBuffer(ion_out);
+    return false;
+  }
+
+  AsyncQueueCheck check;
+  check.order.assign(launches, -1);
+  std::vector<AsyncQueueProbe> probes(launches);
+  uint32_t max_ahead = 0;
+  int launched = 0;
+  double t0 = now_us();
+  for (; launched < launches; ++launched) {
+    probes[launched].check = &check;
+    probes[launched].index = launched;
+    if (!npu_execute_async(-1, &on_async_queue_done, &probes[launched])) break;
+    // Executions whose notify has not started; a bounded ring keeps this
+    // <= the depth
+    max_ahead = std::max(max_ahead, npu_async_in_flight());
+  }
+  double t1 = now_us();
+  const double deadline = now_us() + 10e6;
+  SpinYieldWait::until([&] {
+    return check.completed.load(std::memory_order_acquire) >= static_cast<uint32_t>(launched) ||
+           now_us() > deadline;
+  });
+  double t2 = now_us();
+  const bool timed_out =
+      check.completed.load(std::memory_order_acquire) < static_cast<uint32_t>(launched);
+  if (timed_out)
+    printf("[AsyncQ] %u of %d notifies after 10 s, draining\n", check.completed.load(), launched);
+  // Drains every outstanding notify before check / probes / buffers go away
+  npu_cleanup();
+
+  int lost = 0, repeated = 0, out_of_order = 0;
+  for (int i = 0; i < launched; ++i) {
+    int hits = probes[i].hits.load(std::memory_order_relaxed);
+    lost     += hits == 0;
+    repeated += hits > 1;
+    out_of_order += check.order[i] != i;
+  }
+  bool ok = !timed_out && launched == launches && lost == 0 && repeated == 0 && out_of_order == 0 &&
+            max_ahead <= NpuEngine::kAsyncQueueDepth;
+
+  printf("=== NPU Async Queue (%d launches, queue depth %u) ===\n", launches,
+         NpuEngine::kAsyncQueueDepth);
+  printf("  launched %d, completed %u, max in flight %u\n", launched,
+         check.completed.load(), max_ahead);
+  printf("  lost %d, repeated %d, out of order %d\n", lost, repeated, out_of_order);
+  printf("  launch %.1f us, drain %.1f us\n", t1 - t0, t2 - t1);
+  printf("  %s\n", ok ? "PASS" : "FAIL");
+
+  freeIonBuffer(ion_in);
+  freeIonBuffer(ion_out);
+  return ok;
+}
+
 // ── GPU-only diagnostic ────────────────────────────────────────────────────
-void run_gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path) {
+// Event and flag polls use W, so --wait compares strategies here as well.
+template <typename W>
+static void gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path) {
   size_t tensor_bytes = (size_t)hidden_dim * 2;
   IonBuffer ion_in, ion_out;
   if (!allocIonBuffer(tensor_bytes, 0, ion_in) ||
@@ -617,10 +905,10 @@ void run_gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path)
   std::vector<double> prof_queue_delay, prof_submit_delay, prof_compute, prof_total_device;
   for (int i = 0; i < num_steps; ++i) {
     cl_event evt = gpu_execute_nonblocking();
-    clWaitForEvents(1, &evt);
+    gpu_wait_event(evt);
 
     GpuProfilingInfo prof = gpu_event_profiling(evt);
-    clReleaseEvent(evt);
+    gpu_release_event(evt);
 
     prof_queue_delay.push_back(prof.queue_delay);
     prof_submit_delay.push_back(prof.submit_delay);
@@ -637,11 +925,11 @@ void run_gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path)
     double t1 = now_us();
 
     int count = 0;
-    while (!gpu_poll_event(evt)) count++;
+    W::until([&] { return gpu_poll_event(evt) || (++count, false); });
     double t2 = now_us();
 
     double compute = gpu_event_compute_us(evt);
-    clReleaseEvent(evt);
+    gpu_release_event(evt);
 
     submit_times.push_back(t1 - t0);
     poll_times.push_back(t2 - t1);
@@ -655,10 +943,10 @@ void run_gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path)
   for (int i = 0; i < num_steps; ++i) {
     double t0 = now_us();
     cl_event evt = gpu_execute_nonblocking();
-    clWaitForEvents(1, &evt);
+    gpu_wait_event(evt);
     double t1 = now_us();
     double compute = gpu_event_compute_us(evt);
-    clReleaseEvent(evt);
+    gpu_release_event(evt);
     wait_evt_times.push_back(t1 - t0);
     wait_evt_compute.push_back(compute);
   }
@@ -667,21 +955,21 @@ void run_gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path)
   IonBuffer ion_flag;
   std::vector<double> flag_times;
   std::vector<int> flag_poll_counts;
-  bool flag_ok = allocIonBuffer(sizeof(uint32_t), 0, ion_flag) && gpu_enable_flag(ion_flag);
+  bool flag_ok = allocIonBuffer(kFlagTableBytes, 0, ion_flag) && gpu_enable_flag(ion_flag, 0);
   if (flag_ok) {
     // Warmup with flag kernel
     for (int i = 0; i < 10; ++i) {
-      gpu_submit();
+      uint32_t epoch = gpu_submit();
       volatile uint32_t* fp = gpu_get_flag_ptr();
-      while (*fp == 0) ;
+      W::wait(fp, [epoch](uint32_t v) { return epoch_reached(v, epoch); });
     }
     // Measure
     for (int i = 0; i < num_steps; ++i) {
       volatile uint32_t* fp = gpu_get_flag_ptr();
       double t0 = now_us();
-      gpu_submit();  // resets flag, enqueue, flush
+      uint32_t epoch = gpu_submit();  // enqueue, flush (no flag reset)
       int count = 0;
-      while (*fp == 0) count++;
+      W::wait(fp, [&](uint32_t v) { return epoch_reached(v, epoch) || (++count, false); });
       double t1 = now_us();
       flag_times.push_back(t1 - t0);
       flag_poll_counts.push_back(count);
@@ -699,7 +987,8 @@ void run_gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path)
     return v[v.size()/2];
   };
 
-  printf("--- GPU Sync Diagnostic (hidden=%d, %d iters) ---\n", hidden_dim, num_steps);
+  printf("--- GPU Sync Diagnostic (hidden=%d, %d iters, wait %s) ---\n",
+         hidden_dim, num_steps, W::kName);
   printf("  Method                  total_p50    extra\n");
   printf("  clFinish (blocking)    %8.1f us\n", p50(noprof_wall));
   printf("  clFlush+cl_event poll  %8.1f us   submit=%.1f poll=%.1f polls=%d\n",
@@ -737,3 +1026,7 @@ void run_gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path)
   freeIonBuffer(ion_out);
   if (flag_ok) freeIonBuffer(ion_flag);
 }
+
+void run_gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path, WaitKind wait) {
+  dispatch_wait(wait, [&](auto w) { gpu_diagnostic<decltype(w)>(hidden_dim, num_steps, kernel_path); });
+}
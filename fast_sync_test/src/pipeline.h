@@ -3,5 +3,14 @@
 
 PipelineResult run_pipeline(const PipelineConfig& config, const char* kernel_path);
 
-// GPU-only diagnostic: compare clFinish vs event-poll overhead
-void run_gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path);
+// GPU-only diagnostic: compare clFinish vs event-poll overhead; the event and
+// flag polls use the selected wait strategy
+void run_gpu_diagnostic(int hidden_dim, int num_steps, const char* kernel_path, WaitKind wait);
+
+// NPU async queue: more than kAsyncQueueDepth graphExecuteAsync launches in
+// flight from one thread; checks every notify ran once, in order. Returns
+// false on a lost, repeated or misrouted completion.
+bool run_async_queue_check(int hidden_dim, int launches);
+
+// Host-only: wake-up latency and CPU burn of every wait strategy
+void run_wait_benchmark(int delay_us, int iters);
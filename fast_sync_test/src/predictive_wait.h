@@ -0,0 +1,121 @@
+#pragma once
+// Predictive sleep-then-spin waiter for completions with a repeatable latency
+// (GPU flag after submit, NPU graphExecute after signal).
+//
+// A fixed usleep(hint) is either too short (the CPU spins anyway) or too long
+// (every step pays the oversleep). This waiter learns the completion time
+// instead: it keeps an EWMA of the mean and variance of observed durations
+// (start → completion seen), sleeps until
+//
+//   t_start + mean - k·stddev - oversleep - kSpinMarginUs
+//
+// and spins (with the selected wait strategy) only for the remaining tail.
+// oversleep is an EWMA of how late nanosleep() itself returns on this core.
+//
+// A wake-up is "late" when the completion had already happened by the time
+// the sleep returned — its detection latency was set by the timer, not by the
+// spin. Late wake-ups widen the guard (k += 1); on-time ones slowly narrow it,
+// so the late rate settles at a few percent without hand tuning.
+//
+// One waiter per completion source and per thread; not thread safe.
+
+#include "common.h"
+#include "wait_strategy.h"
+
+#include <cmath>
+#include <ctime>
+#include <sys/prctl.h>
+
+class PredictiveWaiter {
+public:
+  static constexpr int    kWarmupSamples = 8;      // pure spin until the model has data
+  static constexpr double kAlpha         = 0.125;  // EWMA gain for mean / variance / oversleep
+  static constexpr double kMinSleepUs    = 30;     // shorter sleeps are not worth the syscall
+  static constexpr double kSpinMarginUs  = 5;      // spin at least this long before the prediction
+  static constexpr double kMinK = 1.0, kMaxK = 8.0, kStartK = 2.0;
+
+  explicit PredictiveWaiter(const char* name) { stats_.name = name; }
+
+  // Wait on a word until done(value); t_start is when the awaited work began
+  template <typename W, typename Word, typename Pred>
+  void wait(double t_start, const Word& w, Pred done) {
+    double t_spin = sleep_phase(t_start, [&] { return done(waitdetail::load(w)); });
+    W::wait(w, done);
+    record(t_start, t_spin);
+  }
+
+  // Wait until done() (e.g. cl_event status)
+  template <typename W, typename Pred>
+  void until(double t_start, Pred done) {
+    double t_spin = sleep_phase(t_start, done);
+    W::until(done);
+    record(t_start, t_spin);
+  }
+
+  const PredictStats& stats() const { return stats_; }
+
+private:
+  // Sleeps until shortly before the predicted completion (if that is far
+  // enough away). Returns the time the spin phase starts.
+  template <typename Ready>
+  double sleep_phase(double t_start, Ready ready) {
+    double now = now_us();
+    if (samples_ < kWarmupSamples) return now;
+
+    double guard = k_ * std::sqrt(var_) + oversleep_ + kSpinMarginUs;
+    double sleep_us = t_start + mean_ - guard - now;
+    if (sleep_us < kMinSleepUs || ready()) return now;
+
+    sleep_for_us(sleep_us);
+    double woke = now_us();
+    double over = (woke - now) - sleep_us;
+    oversleep_ += kAlpha * ((over > 0 ? over : 0) - oversleep_);
+    stats_.sleeps++;
+    stats_.slept_us += woke - now;
+
+    if (ready()) {
+      stats_.late++;
+      k_ = std::min(k_ + 1.0, kMaxK);
+    } else {
+      k_ = std::max(k_ - 0.05, kMinK);
+    }
+    return woke;
+  }
+
+  void record(double t_start, double t_spin) {
+    double t_done = now_us();
+    stats_.waits++;
+    stats_.spun_us += t_done - t_spin;
+
+    double x = t_done - t_start;
+    if (samples_++ == 0) {
+      mean_ = x;
+      var_ = 0;
+    } else {
+      double d = x - mean_;
+      mean_ += kAlpha * d;
+      var_ = (1 - kAlpha) * (var_ + kAlpha * d * d);
+    }
+    stats_.predict_us = mean_;
+  }
+
+  static void sleep_for_us(double us) {
+    // Default timer slack is 50 us (more for background threads on Android),
+    // which alone is larger than most of the steps here. Per thread, set once.
+    static thread_local bool slack_set = false;
+    if (!slack_set) {
+      prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+      slack_set = true;
+    }
+    long ns = static_cast<long>(us * 1000);
+    struct timespec ts = {ns / 1000000000L, ns % 1000000000L};
+    nanosleep(&ts, nullptr);
+  }
+
+  PredictStats stats_;
+  int    samples_   = 0;
+  double mean_      = 0;
+  double var_       = 0;
+  double oversleep_ = 0;
+  double k_         = kStartK;
+};
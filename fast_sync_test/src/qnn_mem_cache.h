@@ -0,0 +1,204 @@
+#pragma once
+// QNN memory-registration cache for one context.
+//
+// memRegister maps the buffer into the DSP's SMMU — hundreds of us per call —
+// and engines register the same ION buffer with the same shape again and
+// again: ping-pong buffers that are one graph's input and the next slot's
+// output, layer rings, per-case setup. QnnMemCache hands out one handle per
+// (buffer, offset, dims, dtype):
+//
+//   acquire()  cached handle (hit) or memRegister (miss); pins it
+//   release()  unpins; the registration stays cached for the next acquire
+//   clear()    memDeRegister everything — before contextFree, since handles
+//              belong to the context
+//
+// A tensor covering only part of the buffer (offset > 0 or fewer bytes) is
+// registered as an HTP shared buffer at its offset, the whole buffer as ION.
+// Beyond `capacity` entries the least recently used unpinned registration is
+// deregistered. Freeing an ION buffer whose registration is cached is a bug
+// (a later buffer can get the same fd): call forget() first, or clear().
+//
+// Same copy in each NPU project (like wait_strategy.h). Not thread-safe:
+// registration happens at init, on the thread that owns the context.
+
+#include "common.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "QNN/QnnInterface.h"
+#include "QNN/QnnMem.h"
+#include "QNN/QnnTypes.h"
+#include "QNN/HTP/QnnHtpMem.h"
+
+class QnnMemCache {
+public:
+  struct Stats {
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    double   register_us   = 0.0;  // summed over misses
+    double   deregister_us = 0.0;
+  };
+
+  void init(const QNN_INTERFACE_VER_TYPE* qnn, Qnn_ContextHandle_t context, size_t capacity = 64) {
+    qnn_ = qnn;
+    context_ = context;
+    capacity_ = capacity;
+  }
+
+  // Pinned handle for dims/dtype at `offset` bytes into `ion`; nullptr if
+  // memRegister failed
+  Qnn_MemHandle_t acquire(const IonBuffer& ion, size_t offset, const uint32_t* dims, uint32_t rank,
+                          Qnn_DataType_t dtype) {
+    if (rank > kMaxRank) return nullptr;
+    for (Entry& e : entries_) {
+      if (e.fd == ion.fd && e.base == ion.ptr && e.offset == offset && e.dtype == dtype &&
+          e.rank == rank && !memcmp(e.dims, dims, rank * sizeof(uint32_t))) {
+        ++stats_.hits;
+        ++e.pins;
+        e.last_use = ++tick_;
+        return e.handle;
+      }
+    }
+
+    Entry e;
+    e.fd = ion.fd; e.base = ion.ptr; e.offset = offset; e.dtype = dtype; e.rank = rank;
+    memcpy(e.dims, dims, rank * sizeof(uint32_t));
+
+    size_t tensor_bytes = dtype_bytes(dtype);
+    for (uint32_t i = 0; i < rank; ++i) tensor_bytes *= dims[i];
+
+    Qnn_MemDescriptor_t desc = QNN_MEM_DESCRIPTOR_INIT;
+    desc.memShape.numDim  = rank;
+    desc.memShape.dimSize = e.dims;
+    desc.dataType         = dtype;
+    QnnMemHtp_Descriptor_t htpDesc;
+    if (offset > 0 || offset + tensor_bytes < ion.size) {
+      htpDesc.type = QNN_HTP_MEM_SHARED_BUFFER;
+      htpDesc.size = ion.size;
+      htpDesc.sharedBufferConfig.fd     = ion.fd;
+      htpDesc.sharedBufferConfig.offset = offset;
+      desc.memType    = QNN_MEM_TYPE_CUSTOM;
+      desc.customInfo = &htpDesc;
+    } else {
+      desc.memType    = QNN_MEM_TYPE_ION;
+      desc.ionInfo.fd = ion.fd;
+    }
+
+    const double t0 = now_us();
+    if (QNN_SUCCESS != qnn_->memRegister(context_, &desc, 1, &e.handle)) {
+      printf("[NPU] memRegister failed (fd=%d, offset=%zu, bytes=%zu)\n", ion.fd, offset,
+             tensor_bytes);
+      return nullptr;
+    }
+    stats_.register_us += now_us() - t0;
+    ++stats_.misses;
+    e.pins = 1;
+    e.last_use = ++tick_;
+    entries_.push_back(e);
+    evict_to_capacity();
+    return e.handle;
+  }
+
+  void release(Qnn_MemHandle_t handle) {
+    if (!handle) return;
+    for (Entry& e : entries_)
+      if (e.handle == handle && e.pins > 0) { --e.pins; break; }
+    evict_to_capacity();
+  }
+
+  // Deregister the unpinned registrations of one buffer (before freeing it)
+  void forget(const IonBuffer& ion) {
+    for (size_t i = 0; i < entries_.size();) {
+      if (entries_[i].fd == ion.fd && entries_[i].base == ion.ptr && entries_[i].pins == 0)
+        drop(i);
+      else
+        ++i;
+    }
+  }
+
+  void clear() {
+    if (qnn_ && qnn_->memDeRegister && !entries_.empty()) {
+      std::vector<Qnn_MemHandle_t> handles;
+      for (const Entry& e : entries_) handles.push_back(e.handle);
+      const double t0 = now_us();
+      qnn_->memDeRegister(handles.data(), static_cast<uint32_t>(handles.size()));
+      stats_.deregister_us += now_us() - t0;
+    }
+    entries_.clear();
+  }
+
+  size_t size() const { return entries_.size(); }
+  const Stats& stats() const { return stats_; }
+
+  void print_stats(const char* tag) const {
+    const uint64_t n = stats_.hits + stats_.misses;
+    if (n == 0) return;
+    printf("%s mem registrations: %llu requests, %llu hits (%.0f%%), %llu memRegister %.2f ms "
+           "(%.0f us avg), %llu evictions\n",
+           tag, (unsigned long long)n, (unsigned long long)stats_.hits, 100.0 * stats_.hits / n,
+           (unsigned long long)stats_.misses, stats_.register_us / 1e3,
+           stats_.misses ? stats_.register_us / stats_.misses : 0.0,
+           (unsigned long long)stats_.evictions);
+  }
+
+private:
+  static constexpr uint32_t kMaxRank = 8;
+
+  struct Entry {
+    int             fd     = -1;
+    const void*     base   = nullptr;
+    size_t          offset = 0;
+    Qnn_DataType_t  dtype{};
+    uint32_t        rank   = 0;
+    uint32_t        dims[kMaxRank] = {};
+    Qnn_MemHandle_t handle = nullptr;
+    uint32_t        pins   = 0;
+    uint64_t        last_use = 0;
+  };
+
+  static size_t dtype_bytes(Qnn_DataType_t dt) {
+    switch (dt) {  // the types the engines register; anything else is sized as bytes
+      case QNN_DATATYPE_FLOAT_16:
+        return 2;
+      case QNN_DATATYPE_FLOAT_32: case QNN_DATATYPE_UINT_32: case QNN_DATATYPE_INT_32:
+        return 4;
+      default:
+        return 1;
+    }
+  }
+
+  static double now_us() {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void drop(size_t i) {
+    Qnn_MemHandle_t h = entries_[i].handle;
+    const double t0 = now_us();
+    if (qnn_ && qnn_->memDeRegister) qnn_->memDeRegister(&h, 1);
+    stats_.deregister_us += now_us() - t0;
+    entries_.erase(entries_.begin() + i);
+  }
+
+  void evict_to_capacity() {
+    while (entries_.size() > capacity_) {
+      size_t victim = entries_.size();
+      for (size_t i = 0; i < entries_.size(); ++i)
+        if (entries_[i].pins == 0 &&
+            (victim == entries_.size() || entries_[i].last_use < entries_[victim].last_use))
+          victim = i;
+      if (victim == entries_.size()) return;  // everything pinned
+      drop(victim);
+      ++stats_.evictions;
+    }
+  }
+
+  const QNN_INTERFACE_VER_TYPE* qnn_ = nullptr;
+  Qnn_ContextHandle_t context_ = nullptr;
+  size_t capacity_ = 64;
+  std::vector<Entry> entries_;
+  uint64_t tick_ = 0;
+  Stats stats_;
+};
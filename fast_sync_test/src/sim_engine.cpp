@@ -0,0 +1,552 @@
+#include "sim_engine.h"
+#include "cpu_kernels.h"
+#include "npu_engine.h"  // NpuEngine::kAsyncQueueDepth
+#include "persistent_protocol.h"  // heteroedge_op/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/prctl.h>
+
+// Simulated event: the GPU queue fills the timestamps, the driver queue
+// completes it. One reference for the host handle, one for the driver.
+struct SimEvent {
+  double queued_us = 0, submit_us = 0, start_us = 0, end_us = 0;
+  std::atomic<uint32_t> complete{0};
+  std::atomic<void (CL_CALLBACK*)(cl_event, cl_int, void*)> callback{nullptr};
+  void* user_data = nullptr;
+  std::atomic<bool> fired{false};
+  std::atomic<int>  refs{2};
+};
+
+namespace {
+
+bool      g_enabled = false;
+SimConfig g_config;
+
+SimGpuEngine g_gpu;  // process-default instances (gpu_* / npu_* wrappers)
+SimNpuEngine g_npu;
+
+constexpr double kSpinTailUs = 60;  // sleep until this close to the target, then spin
+constexpr double kSimBurstTimeoutUs = 1e6;  // persistent op: per-step producer wait
+
+SimEvent* to_sim(cl_event evt) { return reinterpret_cast<SimEvent*>(evt); }
+cl_event  to_cl(SimEvent* evt) { return reinterpret_cast<cl_event>(evt); }
+
+void release(SimEvent* evt) {
+  if (evt->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete evt;
+}
+
+// Exactly one of the driver (on completion) and the host (on registration
+// of an already-complete event) runs the callback
+void fire_callback(SimEvent* evt) {
+  auto fn = evt->callback.load();
+  if (fn && !evt->fired.exchange(true)) fn(to_cl(evt), CL_COMPLETE, evt->user_data);
+}
+
+struct NamedDist { const char* name; SimDist SimConfig::*field; };
+const NamedDist kDists[] = {
+  {"gpu_queue",     &SimConfig::gpu_queue},
+  {"gpu_sched",     &SimConfig::gpu_sched},
+  {"gpu_compute",   &SimConfig::gpu_compute},
+  {"gpu_driver",    &SimConfig::gpu_driver},
+  {"gpu_doorbell",  &SimConfig::gpu_doorbell},
+  {"npu_rpc",       &SimConfig::npu_rpc},
+  {"npu_compute",   &SimConfig::npu_compute},
+  {"npu_sync_wait", &SimConfig::npu_sync_wait},
+};
+
+}  // namespace
+
+// ── Latency model ───────────────────────────────────────────────────────────
+
+bool sim_parse_latency(const char* spec, SimConfig& cfg) {
+  std::string s(spec);
+  size_t pos = 0;
+  while (pos < s.size()) {
+    size_t end = s.find(',', pos);
+    if (end == std::string::npos) end = s.size();
+    std::string item = s.substr(pos, end - pos);
+    pos = end + 1;
+
+    size_t eq = item.find('=');
+    if (eq == std::string::npos) return false;
+    std::string name = item.substr(0, eq);
+    const NamedDist* nd = nullptr;
+    for (const NamedDist& d : kDists)
+      if (name == d.name) nd = &d;
+    if (!nd) return false;
+
+    SimDist& dist = cfg.*(nd->field);
+    char* rest = nullptr;
+    dist.mean_us = strtod(item.c_str() + eq + 1, &rest);
+    dist.stddev_us = (*rest == '/') ? strtod(rest + 1, nullptr) : 0.0;
+  }
+  return true;
+}
+
+void sim_print_config(const SimConfig& cfg) {
+  printf("Simulation: host devices, seed=%llu, latency mean/stddev (us):\n",
+         (unsigned long long)cfg.seed);
+  for (const NamedDist& d : kDists) {
+    const SimDist& dist = cfg.*(d.field);
+    printf("  %-14s %7.1f / %.1f\n", d.name, dist.mean_us, dist.stddev_us);
+  }
+}
+
+void sim_enable(const SimConfig& cfg) {
+  g_config  = cfg;
+  g_enabled = true;
+  ionUseMemfd() = true;
+}
+
+bool sim_enabled()              { return g_enabled; }
+const SimConfig& sim_config()   { return g_config; }
+
+// ── SimDevice ───────────────────────────────────────────────────────────────
+
+void SimDevice::start(uint64_t seed, std::function<void(const SimJob&)> handler) {
+  if (running()) return;
+  handler_ = std::move(handler);
+  rng_.seed(seed);
+  thread_ = std::thread([this] {
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+    for (;;) {
+      SimJob job = ring_.pop<SpinFutexWait>();
+      if (job.stop) return;
+      handler_(job);
+    }
+  });
+}
+
+void SimDevice::stop() {
+  if (!running()) return;
+  SimJob job;
+  job.stop = true;
+  push(job);
+  thread_.join();
+}
+
+void SimDevice::push(const SimJob& job) {
+  ring_.push<SpinFutexWait>(job);
+}
+
+double SimDevice::sample(const SimDist& d) {
+  if (d.stddev_us <= 0 || d.mean_us <= 0) return std::max(0.0, d.mean_us);
+  // Log-normal with the requested mean and stddev
+  double var   = std::log(1.0 + (d.stddev_us * d.stddev_us) / (d.mean_us * d.mean_us));
+  double mu    = std::log(d.mean_us) - 0.5 * var;
+  std::lognormal_distribution<double> dist(mu, std::sqrt(var));
+  return dist(rng_);
+}
+
+void SimDevice::sleep_until(double t_us) {
+  double remaining = t_us - now_us();
+  if (remaining > 2 * kSpinTailUs) {
+    struct timespec ts;
+    long ns = static_cast<long>((remaining - kSpinTailUs) * 1000);
+    ts.tv_sec  = ns / 1000000000L;
+    ts.tv_nsec = ns % 1000000000L;
+    nanosleep(&ts, nullptr);
+  }
+  while (now_us() < t_us) std::this_thread::yield();
+}
+
+// ── SimGpuEngine ────────────────────────────────────────────────────────────
+
+void SimGpuEngine::print_info() const {
+  if (!gpu_.running()) return;
+  const SimConfig& c = sim_config();
+  printf("  GPU: simulated (queue %.1f + sched %.1f + compute %.1f us, driver %.1f us)\n",
+         c.gpu_queue.mean_us, c.gpu_sched.mean_us, c.gpu_compute.mean_us, c.gpu_driver.mean_us);
+}
+
+bool SimGpuEngine::init(int hidden_dim, float epsilon,
+                        const IonBuffer& ion_input, const IonBuffer& ion_output) {
+  if (!ion_input.ptr || !ion_output.ptr) { printf("[GPU-SIM] null buffer\n"); return false; }
+  hidden_  = hidden_dim;
+  epsilon_ = epsilon;
+  input_   = static_cast<const uint16_t*>(ion_input.ptr);
+  output_  = static_cast<uint16_t*>(ion_output.ptr);
+  gamma_.assign(hidden_dim, float_to_half(1.0f));
+  uint64_t seed = sim_config().seed;
+  gpu_.start(seed, [this](const SimJob& job) { run(job); });
+  driver_.start(seed + 1, [this](const SimJob& job) { complete(job); });
+  return true;
+}
+
+bool SimGpuEngine::enable_flag(const IonBuffer& ion_flag_table, int flag_index) {
+  if (!ion_flag_table.ptr || ion_flag_table.size < kFlagTableBytes) {
+    printf("[GPU-SIM] flag table too small\n");
+    return false;
+  }
+  EpochFlagTable<uint32_t> table(ion_flag_table);
+  flagPtr_ = table.flag(flag_index);
+  epoch_ = std::max(epoch_, table.load(flag_index));
+  return true;
+}
+
+void SimGpuEngine::disable_flag() {
+  flagPtr_ = nullptr;
+}
+
+SimEvent* SimGpuEngine::enqueue(const uint16_t* in, uint16_t* out, volatile uint32_t* flag,
+                                uint32_t epoch, bool with_event) {
+  SimJob job;
+  job.submit_us = now_us();
+  job.input  = in;
+  job.output = out;
+  job.flag   = flag;
+  job.epoch  = epoch;
+  job.doorbell = persistent_;
+  if (with_event) {
+    job.event = new SimEvent;
+    job.event->queued_us = job.submit_us;
+  }
+  gpu_.push(job);
+  return job.event;
+}
+
+// GPU queue: launch latency from submit (or the previous kernel's END, the
+// queue is in order), compute, flag write at END, then hand the event to the
+// driver queue. A doorbell step skips the launch: the resident kernel sees it
+// one poll later.
+void SimGpuEngine::run(const SimJob& job) {
+  double submit = job.submit_us;
+  double start;
+  if (job.doorbell) {
+    start = std::max(submit + gpu_.sample(sim_config().gpu_doorbell), now_us());
+  } else {
+    submit += gpu_.sample(sim_config().gpu_queue);
+    start = std::max(submit + gpu_.sample(sim_config().gpu_sched), now_us());
+  }
+  SimDevice::sleep_until(start);
+  start = now_us();
+  double compute = gpu_.sample(sim_config().gpu_compute);
+  cpuk::rmsnorm_f16(job.output, job.input, gamma_.data(), hidden_, epsilon_);
+  SimDevice::sleep_until(start + compute);
+  double end = now_us();
+
+  if (job.flag) {
+    std::atomic_thread_fence(std::memory_order_release);
+    *job.flag = job.epoch;
+  }
+  if (job.event) {
+    job.event->submit_us = std::min(submit, start);
+    job.event->start_us  = start;
+    job.event->end_us    = end;
+    driver_.push(job);
+  }
+}
+
+// Driver queue: the event turns CL_COMPLETE gpu_driver after END
+void SimGpuEngine::complete(const SimJob& job) {
+  SimEvent* evt = job.event;
+  SimDevice::sleep_until(evt->end_us + driver_.sample(sim_config().gpu_driver));
+  evt->complete.store(1);
+  SpinFutexWait::notify(evt->complete);
+  fire_callback(evt);
+  release(evt);
+}
+
+double SimGpuEngine::execute_blocking(double* compute_us) {
+  stop_persistent();  // like GpuEngine: a regular launch ends persistent mode
+  double t0 = now_us();
+  cl_event evt = to_cl(enqueue(input_, output_, nullptr, 0, true));
+  wait_event(evt);
+  double t1 = now_us();
+  if (compute_us) *compute_us = event_compute_us(evt);
+  release_event(evt);
+  return t1 - t0;
+}
+
+cl_event SimGpuEngine::execute_nonblocking() {
+  stop_persistent();
+  return to_cl(enqueue(input_, output_, nullptr, 0, true));
+}
+
+uint32_t SimGpuEngine::submit() {
+  uint32_t epoch = ++epoch_;
+  enqueue(input_, output_, flagPtr_, epoch, false);
+  return epoch;
+}
+
+bool SimGpuEngine::start_persistent(const IonBuffer& ion_flag_table, int ctrl_index) {
+  if (!flagPtr_) { printf("[GPU-SIM] persistent mode needs enable_flag()\n"); return false; }
+  if (ion_flag_table.size < kFlagTableBytes || ctrl_index < 0 || ctrl_index >= kFlagTableSlots)
+    return false;
+  persistent_ = true;
+  return true;
+}
+
+int SimGpuEngine::add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output,
+                           const IonBuffer& ion_flag_table, int flag_index) {
+  if (!ion_input.ptr || !ion_output.ptr || ion_flag_table.size < kFlagTableBytes) return -1;
+  EpochFlagTable<uint32_t> table(ion_flag_table);
+  Slot slot;
+  slot.input   = static_cast<const uint16_t*>(ion_input.ptr);
+  slot.output  = static_cast<uint16_t*>(ion_output.ptr);
+  slot.flagPtr = table.flag(flag_index);
+  slot.epoch   = table.load(flag_index);
+  slots_.push_back(slot);
+  return static_cast<int>(slots_.size()) - 1;
+}
+
+uint32_t SimGpuEngine::submit_slot(int slot, cl_uint, const cl_event*, cl_event* event) {
+  stop_persistent();
+  Slot& s = slots_[slot];
+  uint32_t epoch = ++s.epoch;
+  SimEvent* e = enqueue(s.input, s.output, s.flagPtr, epoch, event != nullptr);
+  if (event) *event = to_cl(e);
+  return epoch;
+}
+
+bool SimGpuEngine::poll_event(cl_event evt) {
+  return to_sim(evt)->complete.load(std::memory_order_acquire) != 0;
+}
+
+double SimGpuEngine::event_compute_us(cl_event evt) {
+  wait_event(evt);
+  SimEvent* e = to_sim(evt);
+  return e->end_us - e->start_us;
+}
+
+GpuProfilingInfo SimGpuEngine::event_profiling(cl_event evt) {
+  wait_event(evt);
+  SimEvent* e = to_sim(evt);
+  GpuProfilingInfo info = {};
+  info.queued_us    = 0;
+  info.submit_us    = e->submit_us - e->queued_us;
+  info.start_us     = e->start_us - e->queued_us;
+  info.end_us       = e->end_us - e->queued_us;
+  info.queue_delay  = info.submit_us;
+  info.submit_delay = info.start_us - info.submit_us;
+  info.compute      = info.end_us - info.start_us;
+  info.total_device = info.end_us;
+  return info;
+}
+
+// clFinish / clWaitForEvents: blocks in the driver
+void SimGpuEngine::wait_event(cl_event evt) {
+  SpinFutexWait::wait(to_sim(evt)->complete, [](uint32_t c) { return c != 0; });
+}
+
+void SimGpuEngine::release_event(cl_event evt) {
+  release(to_sim(evt));
+}
+
+bool SimGpuEngine::set_complete_callback(cl_event evt,
+                                         void (CL_CALLBACK* fn)(cl_event, cl_int, void*),
+                                         void* user_data) {
+  SimEvent* e = to_sim(evt);
+  e->user_data = user_data;
+  e->callback.store(fn);
+  if (e->complete.load()) fire_callback(e);
+  return true;
+}
+
+void SimGpuEngine::cleanup() {
+  gpu_.stop();     // drains queued kernels first (in-order queue)
+  driver_.stop();  // then their completions
+  slots_.clear();
+  gamma_.clear();
+  input_ = nullptr; output_ = nullptr;
+  flagPtr_ = nullptr;
+  epoch_ = 0;
+  persistent_ = false;
+}
+
+// ── SimNpuEngine ────────────────────────────────────────────────────────────
+
+void SimNpuEngine::print_info() const {
+  if (!dsp_.running()) return;
+  const SimConfig& c = sim_config();
+  printf("  NPU: simulated (rpc %.1f + compute %.1f us, SyncWait %.1f us)%s\n",
+         c.npu_rpc.mean_us, c.npu_compute.mean_us, c.npu_sync_wait.mean_us,
+         doneFlag_ ? ", persistent graph" : waitFlag_ ? ", sync graph" : "");
+}
+
+bool SimNpuEngine::init(int hidden_dim, float epsilon,
+                        const IonBuffer& ion_input, const IonBuffer& ion_output) {
+  if (!ion_input.ptr || !ion_output.ptr) { printf("[NPU-SIM] null buffer\n"); return false; }
+  hidden_  = hidden_dim;
+  epsilon_ = epsilon;
+  input_   = static_cast<const uint16_t*>(ion_input.ptr);
+  output_  = static_cast<uint16_t*>(ion_output.ptr);
+  gamma_.assign(hidden_dim, float_to_half(1.0f));
+  issued_ = 0;
+  done_.store(0, std::memory_order_relaxed);
+  dsp_.start(sim_config().seed + 2, [this](const SimJob& job) { run(job); });
+  return true;
+}
+
+bool SimNpuEngine::init_with_sync(int hidden_dim, float epsilon,
+                                  const IonBuffer& ion_input, const IonBuffer& ion_output,
+                                  const IonBuffer& ion_flag_table, int flag_index) {
+  if (!ion_flag_table.ptr || ion_flag_table.size < kFlagTableBytes) {
+    printf("[NPU-SIM] flag table too small\n");
+    return false;
+  }
+  if (!init(hidden_dim, epsilon, ion_input, ion_output)) return false;
+  waitFlag_ = EpochFlagTable<uint32_t>(ion_flag_table).flag(flag_index);
+  return true;
+}
+
+bool SimNpuEngine::init_persistent(int hidden_dim, float epsilon,
+                                   const IonBuffer& ion_input, const IonBuffer& ion_output,
+                                   const IonBuffer& ion_flag_table, int wait_index, int done_index) {
+  if (!init_with_sync(hidden_dim, epsilon, ion_input, ion_output, ion_flag_table, wait_index))
+    return false;
+  doneFlag_ = EpochFlagTable<uint32_t>(ion_flag_table).flag(done_index);
+  return true;
+}
+
+SimJob SimNpuEngine::make_job(const uint16_t* in, uint16_t* out) {
+  SimJob job;
+  job.submit_us  = now_us();
+  job.input      = in;
+  job.output     = out;
+  job.wait_flag  = waitFlag_;
+  job.wait_epoch = waitEpoch_;  // read once at launch, like the DMA-copied tensor
+  job.seq        = ++issued_;
+  return job;
+}
+
+// graphExecute: blocks for the RPC round trip while the DSP thread runs the graph
+double SimNpuEngine::execute(const uint16_t* in, uint16_t* out) {
+  SimJob job = make_job(in, out);
+  dsp_.push(job);
+  uint32_t seq = job.seq;
+  SpinFutexWait::wait(done_, [seq](uint32_t d) { return epoch_reached(d, seq); });
+  return now_us() - job.submit_us;
+}
+
+// Persistent graph: one graphExecute for the whole burst; completed steps are
+// read back from the done flag, like NpuEngine::execute_burst()
+uint32_t SimNpuEngine::execute_burst(uint32_t wait_epoch, uint32_t steps, uint32_t done_epoch) {
+  if (!doneFlag_) return 0;
+  SimJob job = make_job(input_, output_);
+  job.wait_epoch = wait_epoch;
+  job.burst      = steps;
+  job.done_epoch = done_epoch;
+  dsp_.push(job);
+  uint32_t seq = job.seq;
+  SpinFutexWait::wait(done_, [seq](uint32_t d) { return epoch_reached(d, seq); });
+  return heteroedge::burst_steps_done({wait_epoch, steps, done_epoch}, *doneFlag_);
+}
+
+// graphExecuteAsync: same job, the DSP thread calls fn instead of waking us
+bool SimNpuEngine::execute_async(int slot, void (*fn)(void*), void* param) {
+  if (!dsp_.running()) return false;
+  const uint32_t launched = asyncLaunched_++;
+  SpinYieldWait::wait(asyncDone_, [launched](uint32_t done) {
+    return launched - done < NpuEngine::kAsyncQueueDepth;
+  });
+  SimJob job = slot >= 0 ? make_job(slots_[slot].input, slots_[slot].output)
+                         : make_job(input_, output_);
+  job.notify       = fn;
+  job.notify_param = param;
+  dsp_.push(job);
+  return true;
+}
+
+void SimNpuEngine::run(const SimJob& job) {
+  if (job.burst) {
+    run_burst(job);
+    return;
+  }
+  const SimConfig& c = sim_config();
+  double rpc_half = dsp_.sample(c.npu_rpc) / 2;
+  SimDevice::sleep_until(job.submit_us + rpc_half);
+
+  if (job.wait_flag) {
+    // SyncWait: poll the flag in DDR, then the passthrough copy
+    uint32_t target = job.wait_epoch;
+    SpinYieldWait::wait(job.wait_flag, [target](uint32_t v) { return epoch_reached(v, target); });
+    SimDevice::sleep_until(now_us() + dsp_.sample(c.npu_sync_wait));
+  }
+
+  double start = now_us();
+  double compute = dsp_.sample(c.npu_compute);
+  cpuk::rmsnorm_f16(job.output, job.input, gamma_.data(), hidden_, epsilon_);
+  SimDevice::sleep_until(start + compute);
+
+  SimDevice::sleep_until(now_us() + rpc_half);
+  done_.store(job.seq, std::memory_order_release);
+  SpinFutexWait::notify(done_);
+  if (job.notify) {
+    asyncDone_.fetch_add(1, std::memory_order_release);  // like NpuEngine: slot free, then fn
+    job.notify(job.notify_param);
+  }
+}
+
+// PersistentRmsNorm on the DSP thread: the protocol's own loop with sampled
+// latencies; the RPC round trip is paid once, around the whole burst
+void SimNpuEngine::run_burst(const SimJob& job) {
+  struct Dev {
+    SimNpuEngine* npu;
+    const SimJob* job;
+    bool wait(uint32_t target) {
+      const double deadline = now_us() + kSimBurstTimeoutUs;  // the op's poll bound
+      bool reached = false;
+      SpinYieldWait::until([&] {
+        reached = heteroedge::burst_epoch_reached(*job->wait_flag, target);
+        return reached || now_us() > deadline;
+      });
+      if (reached) SimDevice::sleep_until(now_us() + npu->dsp_.sample(sim_config().npu_sync_wait));
+      return reached;
+    }
+    void step() {
+      double start = now_us();
+      double compute = npu->dsp_.sample(sim_config().npu_compute);
+      cpuk::rmsnorm_f16(job->output, job->input, npu->gamma_.data(), npu->hidden_, npu->epsilon_);
+      SimDevice::sleep_until(start + compute);
+    }
+    void publish(uint32_t epoch) {
+      std::atomic_thread_fence(std::memory_order_release);
+      *npu->doneFlag_ = epoch;
+    }
+  } dev{this, &job};
+
+  double rpc_half = dsp_.sample(sim_config().npu_rpc) / 2;
+  SimDevice::sleep_until(job.submit_us + rpc_half);
+  heteroedge::run_persistent_burst({job.wait_epoch, job.burst, job.done_epoch}, dev);
+  SimDevice::sleep_until(now_us() + rpc_half);
+  done_.store(job.seq, std::memory_order_release);
+  SpinFutexWait::notify(done_);
+}
+
+double SimNpuEngine::execute_blocking() {
+  return execute(input_, output_);
+}
+
+int SimNpuEngine::add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output) {
+  if (!dsp_.running() || !ion_input.ptr || !ion_output.ptr) return -1;
+  Slot slot;
+  slot.input  = static_cast<const uint16_t*>(ion_input.ptr);
+  slot.output = static_cast<uint16_t*>(ion_output.ptr);
+  slots_.push_back(slot);
+  return static_cast<int>(slots_.size()) - 1;
+}
+
+double SimNpuEngine::execute_slot(int slot) {
+  return execute(slots_[slot].input, slots_[slot].output);
+}
+
+void SimNpuEngine::cleanup() {
+  dsp_.stop();  // runs every queued job (and its notify) before the stop job
+  slots_.clear();
+  gamma_.clear();
+  input_ = nullptr; output_ = nullptr;
+  waitFlag_ = nullptr;
+  doneFlag_ = nullptr;
+  waitEpoch_ = 0;
+  asyncLaunched_ = 0;
+  asyncDone_.store(0, std::memory_order_relaxed);
+}
+
+// ── Process-default instances ───────────────────────────────────────────────
+
+SimGpuEngine& sim_gpu_engine() { return g_gpu; }
+SimNpuEngine& sim_npu_engine() { return g_npu; }
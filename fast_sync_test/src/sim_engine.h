@@ -0,0 +1,252 @@
+#pragma once
+#include "common.h"
+#include "engine.h"
+#include "gpu_engine.h"
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Host simulation of the GPU and NPU engines (--sim).
+//
+// Simulated devices run the real FP16 RMSNorm on the CPU (cpu_kernels.h), on
+// the same shared buffers, from background threads that model the device
+// timeline with a latency model seeded from on-device measurements. Flags,
+// events, callbacks and blocking calls behave like the real engines, so every
+// sync mode, the pipelined executor and the CPU engine run unchanged on a
+// Linux workstation without libcdsprpc / libQnnHtp / an Adreno driver.
+//
+// While simulation is enabled the gpu_* / npu_* wrappers route to the default
+// SimGpuEngine / SimNpuEngine and allocIonBuffer() hands out memfd buffers.
+
+// ── Latency model ───────────────────────────────────────────────────────────
+
+// One latency: fixed (stddev 0) or log-normal with the given mean / stddev
+// (positive, right-skewed like measured device latencies)
+struct SimDist {
+  double mean_us   = 0;
+  double stddev_us = 0;
+};
+
+// Defaults: SM8850, hidden=4096, FP16 (README "OpenCL Profiling 时间线" and
+// test_graph_overhead). gpu_queue + gpu_sched + gpu_compute = 292.2 us, the
+// host-observed submit → flag time.
+struct SimConfig {
+  SimDist gpu_queue     { 98.4, 10.0};  // QUEUED → SUBMIT: driver translation
+  SimDist gpu_sched     {175.1, 25.0};  // SUBMIT → START: GPU scheduling
+  SimDist gpu_compute   { 18.7,  2.0};  // START → END: kernel (flag written at END)
+  SimDist gpu_driver    {384.1, 40.0};  // END → clFinish returns / CL_COMPLETE
+  SimDist gpu_doorbell  {  2.0,  0.5};  // persistent kernel: doorbell store → START (estimate)
+  SimDist npu_rpc       {270.0, 20.0};  // graphExecute fixed cost (FastRPC + ARM side), half each way
+  SimDist npu_compute   {  4.0,  1.0};  // RmsNorm on HVX
+  SimDist npu_sync_wait { 57.0,  5.0};  // SyncWait passthrough copy after the flag is seen
+  uint64_t seed = 42;
+};
+
+// Override latencies from "name=mean[/stddev],..." (names as in SimConfig,
+// e.g. "gpu_compute=40/5,npu_rpc=80"). Returns false on an unknown name.
+bool sim_parse_latency(const char* spec, SimConfig& cfg);
+void sim_print_config(const SimConfig& cfg);
+
+// Route the gpu_* / npu_* wrappers to the simulated engines and switch
+// allocIonBuffer() to memfd. Call once, before any engine is initialized.
+void sim_enable(const SimConfig& cfg);
+bool sim_enabled();
+const SimConfig& sim_config();
+
+// ── Simulated device queue ──────────────────────────────────────────────────
+
+struct SimEvent;
+
+// One unit of device work. The engine that owns the queue interprets it.
+struct SimJob {
+  double          submit_us = 0;        // host submit time (origin of the latencies)
+  const uint16_t* input     = nullptr;
+  uint16_t*       output    = nullptr;
+  volatile uint32_t* flag   = nullptr;  // GPU: flag to publish `epoch` into at END
+  uint32_t        epoch     = 0;
+  const volatile uint32_t* wait_flag = nullptr;  // NPU sync graph: flag SyncWait polls
+  uint32_t        wait_epoch = 0;
+  SimEvent*       event     = nullptr;  // GPU: event completed by the driver queue
+  uint32_t        seq       = 0;        // NPU: execution number
+  uint32_t        burst     = 0;        // NPU persistent graph: steps, waiting wait_epoch + i
+  uint32_t        done_epoch = 0;       // NPU persistent graph: epoch step 0 publishes
+  bool            doorbell  = false;    // GPU: posted to the persistent kernel
+  void (*notify)(void*)     = nullptr;  // NPU async: completion callback (DSP thread)
+  void*           notify_param = nullptr;
+  bool            stop      = false;
+};
+
+// A thread that runs jobs in submission order, like a hardware command queue.
+// push() is single-producer; the handler runs on the device thread and may
+// sample latencies with sample().
+class SimDevice {
+public:
+  SimDevice() = default;
+  SimDevice(const SimDevice&) = delete;
+  SimDevice& operator=(const SimDevice&) = delete;
+  ~SimDevice() { stop(); }
+
+  void start(uint64_t seed, std::function<void(const SimJob&)> handler);
+  void stop();
+  bool running() const { return thread_.joinable(); }
+
+  void push(const SimJob& job);
+
+  // Device thread only
+  double sample(const SimDist& d);
+
+  // Sleep (timer slack 1 ns) until shortly before t_us, then spin to it
+  static void sleep_until(double t_us);
+
+private:
+  SpscRing<SimJob, 64> ring_;
+  std::function<void(const SimJob&)> handler_;
+  std::mt19937_64 rng_;
+  std::thread thread_;
+};
+
+// ── Simulated GPU ───────────────────────────────────────────────────────────
+// Same interface as GpuEngine. Two queues: the GPU (launch, compute, flag
+// write at END) and the driver (CL_COMPLETE / clFinish return gpu_driver
+// after END, off the GPU's critical path like the real post-processing).
+// Events are SimEvent handles cast to cl_event; only the static helpers
+// below may touch them.
+class SimGpuEngine : public Engine {
+public:
+  SimGpuEngine() = default;
+  ~SimGpuEngine() override { cleanup(); }
+
+  bool init(int hidden_dim, float epsilon,
+            const IonBuffer& ion_input, const IonBuffer& ion_output);
+  bool enable_flag(const IonBuffer& ion_flag_table, int flag_index = 0);
+  void disable_flag();
+  volatile uint32_t* flag_ptr() const { return flagPtr_; }
+
+  double execute_blocking(double* compute_us);
+  double execute_blocking() override { return execute_blocking(nullptr); }
+  cl_event execute_nonblocking();
+  uint32_t submit();
+
+  int add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output,
+               const IonBuffer& ion_flag_table, int flag_index);
+  // The queue is in order, so a wait list of this engine's events is
+  // already satisfied by submission order
+  uint32_t submit_slot(int slot, cl_uint num_wait = 0, const cl_event* wait_list = nullptr,
+                       cl_event* event = nullptr);
+  volatile uint32_t* slot_flag_ptr(int slot) const { return slots_[slot].flagPtr; }
+
+  // Persistent kernel: submit() pays gpu_doorbell instead of gpu_queue +
+  // gpu_sched. The control line and the idle timeout are not modelled.
+  bool start_persistent(const IonBuffer& ion_flag_table, int ctrl_index);
+  void stop_persistent() { persistent_ = false; }
+  bool persistent() const { return persistent_; }
+
+  static bool poll_event(cl_event evt);
+  static double event_compute_us(cl_event evt);
+  static GpuProfilingInfo event_profiling(cl_event evt);
+  static void wait_event(cl_event evt);
+  static void release_event(cl_event evt);
+  static bool set_complete_callback(cl_event evt,
+                                    void (CL_CALLBACK* fn)(cl_event, cl_int, void*),
+                                    void* user_data);
+
+  const char* name() const override { return "gpu-sim"; }
+  void print_info() const override;
+  void cleanup() override;
+
+private:
+  struct Slot {
+    const uint16_t* input  = nullptr;
+    uint16_t*       output = nullptr;
+    volatile uint32_t* flagPtr = nullptr;
+    uint32_t        epoch  = 0;
+  };
+
+  SimEvent* enqueue(const uint16_t* in, uint16_t* out, volatile uint32_t* flag,
+                    uint32_t epoch, bool with_event);
+  void run(const SimJob& job);       // GPU queue
+  void complete(const SimJob& job);  // driver queue
+
+  SimDevice gpu_, driver_;
+  int   hidden_  = 0;
+  float epsilon_ = 1e-6f;
+  const uint16_t* input_  = nullptr;
+  uint16_t*       output_ = nullptr;
+  std::vector<uint16_t> gamma_;
+  volatile uint32_t* flagPtr_ = nullptr;
+  uint32_t epoch_ = 0;
+  bool persistent_ = false;
+  std::vector<Slot> slots_;
+};
+
+// ── Simulated NPU ───────────────────────────────────────────────────────────
+// Same interface as NpuEngine. graphExecute blocks the caller for the whole
+// RPC round trip; the DSP thread runs the graph in between (sync graph: poll
+// the flag like SyncWait, then the passthrough copy, then RmsNorm; persistent
+// graph: the PersistentRmsNorm burst loop, one RPC round trip per burst).
+// execute_async() queues the same job and returns; the DSP thread calls the
+// notify callback where the blocking caller would have been woken. Async
+// launches are bounded like NpuEngine's (kAsyncQueueDepth in flight).
+class SimNpuEngine : public Engine {
+public:
+  SimNpuEngine() = default;
+  ~SimNpuEngine() override { cleanup(); }
+
+  bool init(int hidden_dim, float epsilon,
+            const IonBuffer& ion_input, const IonBuffer& ion_output);
+  bool init_with_sync(int hidden_dim, float epsilon,
+                      const IonBuffer& ion_input, const IonBuffer& ion_output,
+                      const IonBuffer& ion_flag_table, int flag_index = 0);
+  bool init_persistent(int hidden_dim, float epsilon,
+                       const IonBuffer& ion_input, const IonBuffer& ion_output,
+                       const IonBuffer& ion_flag_table, int wait_index, int done_index);
+  void set_wait_epoch(uint32_t epoch) { waitEpoch_ = epoch; }
+  uint32_t execute_burst(uint32_t wait_epoch, uint32_t steps, uint32_t done_epoch);
+  const volatile uint32_t* done_flag_ptr() const { return doneFlag_; }
+
+  double execute_blocking() override;
+  int add_slot(const IonBuffer& ion_input, const IonBuffer& ion_output);
+  double execute_slot(int slot);
+  bool execute_async(int slot, void (*fn)(void*), void* param);
+  uint32_t async_in_flight() const {
+    return asyncLaunched_ - asyncDone_.load(std::memory_order_acquire);
+  }
+
+  const char* name() const override { return "npu-sim"; }
+  void print_info() const override;
+  void cleanup() override;
+
+private:
+  struct Slot {
+    const uint16_t* input  = nullptr;
+    uint16_t*       output = nullptr;
+  };
+
+  SimJob make_job(const uint16_t* in, uint16_t* out);
+  double execute(const uint16_t* in, uint16_t* out);
+  void run(const SimJob& job);  // DSP thread
+  void run_burst(const SimJob& job);
+
+  SimDevice dsp_;
+  int   hidden_  = 0;
+  float epsilon_ = 1e-6f;
+  const uint16_t* input_  = nullptr;
+  uint16_t*       output_ = nullptr;
+  std::vector<uint16_t> gamma_;
+  const volatile uint32_t* waitFlag_ = nullptr;  // sync / persistent graph
+  volatile uint32_t* doneFlag_ = nullptr;        // persistent graph only
+  uint32_t waitEpoch_ = 0;
+  uint32_t issued_ = 0;                          // executions started (caller)
+  alignas(64) std::atomic<uint32_t> done_{0};    // executions finished (DSP)
+  uint32_t asyncLaunched_ = 0;                   // execute_async calls (caller)
+  alignas(64) std::atomic<uint32_t> asyncDone_{0};  // notify callbacks started (DSP)
+  std::vector<Slot> slots_;
+};
+
+// ── Process-default instances (behind gpu_* / npu_* while sim_enabled()) ────
+SimGpuEngine& sim_gpu_engine();
+SimNpuEngine& sim_npu_engine();
@@ -0,0 +1,86 @@
+#pragma once
+// Bounded lock-free single-producer / single-consumer ring.
+//
+// Carries step descriptors (main → NPU worker) and per-step timing records
+// (NPU worker → main) between exactly two threads. Storage is fixed at
+// construction, so nothing allocates on the hot path, and more than one
+// step can be queued at a time.
+//
+// head_ / tail_ are free-running counters (items pushed / popped), each on its
+// own cache line together with the owner's cached copy of the other side's
+// counter, so a push or pop normally touches one foreign line only when the
+// cached view says the ring is full / empty. Every cell is cache-line aligned
+// so the producer filling cell i+1 never invalidates the cell being read.
+//
+// The counters are std::atomic<uint32_t> words, so blocking push / pop go
+// through the same wait strategies (wait_strategy.h) as every other wait.
+
+#include "wait_strategy.h"
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T, uint32_t N>
+class SpscRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of two");
+  static_assert(N <= (1u << 31), "free-running counters need N <= 2^31");
+
+public:
+  static constexpr uint32_t kCapacity = N;
+
+  // ── Producer side ──
+  bool try_push(const T& v) {
+    const uint32_t h = head_.load(std::memory_order_relaxed);
+    if (h - tail_cache_ == N) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (h - tail_cache_ == N) return false;
+    }
+    cells_[h & (N - 1)].value = v;
+    head_.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename W>
+  void push(const T& v) {
+    const uint32_t h = head_.load(std::memory_order_relaxed);
+    W::wait(tail_, [h](uint32_t t) { return h - t < N; });
+    try_push(v);
+    W::notify(head_);
+  }
+
+  // ── Consumer side ──
+  bool try_pop(T& out) {
+    const uint32_t t = tail_.load(std::memory_order_relaxed);
+    if (t == head_cache_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (t == head_cache_) return false;
+    }
+    out = cells_[t & (N - 1)].value;
+    tail_.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename W>
+  T pop() {
+    const uint32_t t = tail_.load(std::memory_order_relaxed);
+    W::wait(head_, [t](uint32_t h) { return h != t; });
+    T v;
+    try_pop(v);
+    W::notify(tail_);
+    return v;
+  }
+
+  // Consumer: word to wait on for "next item available" (items pushed so far)
+  // and the consumer's own position; the ring is non-empty while they differ.
+  const std::atomic<uint32_t>& pushed() const { return head_; }
+  uint32_t popped() const { return tail_.load(std::memory_order_relaxed); }
+
+private:
+  struct alignas(64) Cell { T value; };
+
+  alignas(64) std::atomic<uint32_t> head_{0};  // written by the producer
+  uint32_t tail_cache_ = 0;                    // producer's view of tail_
+  alignas(64) std::atomic<uint32_t> tail_{0};  // written by the consumer
+  uint32_t head_cache_ = 0;                    // consumer's view of head_
+  alignas(64) Cell cells_[N];
+};
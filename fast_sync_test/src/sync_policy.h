@@ -0,0 +1,312 @@
+#pragma once
+// Compile-time policies for the GPU → NPU step executor (pipeline.cpp).
+//
+// The executor is run_sync<G, L, W>:
+//   G  GPU completion policy  GpuFinish | GpuEventPoll | GpuEventCallback | GpuFlag
+//                             | GpuPersistent (doorbell to the resident kernel)
+//                             | CpuFlag (stage 1 on the host CPU engine)
+//   L  NPU launch policy      NpuInlineLaunch | NpuWorkerLaunch | NpuDirectLaunch | NpuSyncWaitLaunch
+//                             | NpuAsyncLaunch (graphExecuteAsync, no NPU thread)
+//                             | NpuPersistentLaunch (one graphExecute per --burst steps)
+//   W  wait strategy          wait_strategy.h
+// Everything is resolved at compile time; the only runtime switch is the one
+// in dispatch_sync() that picks the instantiation before the run starts.
+//
+// GPU policy interface (all static):
+//   submit<W>(GpuTicket&)          enqueue one step (clFinish: and wait for it)
+//   wait<W>(GpuTicket&, waiter)    block until the step is observed done
+//   finish(GpuTicket&)             fill compute_us, release per-step resources
+//   kAsync    wait() may run on another thread than submit()
+//   kHasFlag  the kernel publishes the epoch flag (the DSP can wait on it);
+//             flag_ptr() is then that flag (null: flag not enabled)
+
+#include "common.h"
+#include "cpu_engine.h"
+#include "gpu_engine.h"
+#include "npu_engine.h"
+#include "predictive_wait.h"
+#include "wait_strategy.h"
+
+#include <atomic>
+
+// Wait for a completion whose work began at t_start: predictive sleep-then-spin
+// when a waiter is given (--predict), the plain strategy W otherwise
+template <typename W, typename Word, typename Pred>
+inline void wait_done(PredictiveWaiter* p, double t_start, const Word& w, Pred done) {
+  if (p) p->wait<W>(t_start, w, done);
+  else   W::wait(w, done);
+}
+
+template <typename W, typename Pred>
+inline void until_done(PredictiveWaiter* p, double t_start, Pred done) {
+  if (p) p->until<W>(t_start, done);
+  else   W::until(done);
+}
+
+// Completion counter fed from a driver thread (CL_COMPLETE callback, QNN
+// notify): the callback bumps it, the waiter watches it with W and never
+// calls into the driver. Both counts only grow and every submitted step is
+// waited for, so they stay in step across runs. One counter per Tag.
+template <typename Tag>
+struct CompletionCounter {
+  static std::atomic<uint32_t>& completed() {
+    static std::atomic<uint32_t> n{0};
+    return n;
+  }
+  static uint32_t& submitted() {  // submitting thread only
+    static uint32_t n = 0;
+    return n;
+  }
+  template <typename W>
+  static void signal() {
+    completed().fetch_add(1, std::memory_order_release);
+    W::notify(completed());
+  }
+  // Wait until the n-th submission completed (n as returned by ++submitted())
+  template <typename W>
+  static void wait(uint32_t n, PredictiveWaiter* p, double t_start) {
+    wait_done<W>(p, t_start, completed(), [n](uint32_t c) { return epoch_reached(c, n); });
+  }
+};
+
+// One GPU step in flight
+struct GpuTicket {
+  double   submit_us  = 0;        // submit start (origin of the completion prediction)
+  double   compute_us = 0;        // kernel time from profiling (flag: 0, no event)
+  cl_event evt        = nullptr;  // event policies
+  uint32_t epoch      = 0;        // flag: epoch to reach; callback: completion count to reach
+  const volatile uint32_t* flag = nullptr;  // flag policy
+};
+
+// ── GPU completion policies ─────────────────────────────────────────────────
+
+// clEnqueue + clFinish: the step is done when submit() returns
+struct GpuFinish {
+  static constexpr bool kAsync   = false;
+  static constexpr bool kHasFlag = false;
+
+  template <typename W>
+  static void submit(GpuTicket& t) {
+    t.submit_us = now_us();
+    gpu_execute_blocking(&t.compute_us);
+  }
+  template <typename W>
+  static void wait(GpuTicket&, PredictiveWaiter*) {}
+  static void finish(GpuTicket&) {}
+};
+
+// clEnqueue + clFlush, then poll clGetEventInfo (through the driver)
+struct GpuEventPoll {
+  static constexpr bool kAsync   = true;
+  static constexpr bool kHasFlag = false;
+
+  template <typename W>
+  static void submit(GpuTicket& t) {
+    t.submit_us = now_us();
+    t.evt = gpu_execute_nonblocking();
+  }
+  template <typename W>
+  static void wait(GpuTicket& t, PredictiveWaiter* p) {
+    cl_event evt = t.evt;
+    until_done<W>(p, t.submit_us, [evt] { return gpu_poll_event(evt); });
+  }
+  static void finish(GpuTicket& t) {
+    t.compute_us = gpu_event_compute_us(t.evt);
+    gpu_release_event(t.evt);
+    t.evt = nullptr;
+  }
+};
+
+// clEnqueue + clFlush; the driver's CL_COMPLETE callback bumps a completion
+// counter that the waiter watches with W, so the waiting thread never calls
+// into the driver. Falls back to polling if the callback can't be set.
+struct GpuEventCallback {
+  static constexpr bool kAsync   = true;
+  static constexpr bool kHasFlag = false;
+  using Done = CompletionCounter<GpuEventCallback>;
+
+  template <typename W>
+  static void submit(GpuTicket& t) {
+    t.submit_us = now_us();
+    t.evt = gpu_execute_nonblocking();
+    t.epoch = ++Done::submitted();
+    if (!gpu_set_complete_callback(t.evt, &on_complete<W>, nullptr)) {
+      --Done::submitted();
+      t.epoch = 0;
+    }
+  }
+  template <typename W>
+  static void wait(GpuTicket& t, PredictiveWaiter* p) {
+    if (t.epoch == 0) {
+      GpuEventPoll::wait<W>(t, p);
+      return;
+    }
+    Done::wait<W>(t.epoch, p, t.submit_us);
+  }
+  static void finish(GpuTicket& t) { GpuEventPoll::finish(t); }
+
+private:
+  template <typename W>
+  static void CL_CALLBACK on_complete(cl_event, cl_int, void*) { Done::signal<W>(); }
+};
+
+// clEnqueue + clFlush, then poll the shared-memory epoch flag (no driver)
+struct GpuFlag {
+  static constexpr bool kAsync   = true;
+  static constexpr bool kHasFlag = true;
+
+  template <typename W>
+  static void submit(GpuTicket& t) {
+    t.submit_us = now_us();
+    t.epoch = gpu_submit();
+    t.flag = gpu_get_flag_ptr();
+  }
+  template <typename W>
+  static void wait(GpuTicket& t, PredictiveWaiter* p) {
+    uint32_t epoch = t.epoch;
+    wait_done<W>(p, t.submit_us, t.flag,
+                 [epoch](uint32_t v) { return epoch_reached(v, epoch); });
+  }
+  static void finish(GpuTicket&) {}
+  static const volatile uint32_t* flag_ptr() { return gpu_get_flag_ptr(); }
+};
+
+// Resident kernel (GpuEngine::start_persistent): gpu_submit() is a doorbell
+// store, the kernel publishes the same epoch flag as GpuFlag
+struct GpuPersistent : GpuFlag {};
+
+// Stage 1 on the host CPU engine (cpu_engine.h): same ticket and flag wait as
+// GpuFlag, the last CPU worker publishes the epoch
+struct CpuFlag {
+  static constexpr bool kAsync   = true;
+  static constexpr bool kHasFlag = true;
+
+  template <typename W>
+  static void submit(GpuTicket& t) {
+    t.submit_us = now_us();
+    t.epoch = cpu_submit();
+    t.flag = cpu_get_flag_ptr();
+  }
+  template <typename W>
+  static void wait(GpuTicket& t, PredictiveWaiter* p) { GpuFlag::wait<W>(t, p); }
+  static void finish(GpuTicket&) {}
+  static const volatile uint32_t* flag_ptr() { return cpu_get_flag_ptr(); }
+};
+
+// ── NPU launch policies ─────────────────────────────────────────────────────
+// kWorker          graphExecute runs on the NPU worker thread
+// kWorkerWaitsGpu  the worker waits for the GPU itself (needs G::kAsync)
+// kDspWaitsGpu     launched before the GPU is done; SyncWait waits on the
+//                  DSP (needs G::kHasFlag and the sync graph)
+// kNotify          graphExecuteAsync from the main thread; completion comes
+//                  back through NpuAsync's counter (no thread blocks in QNN)
+// kBurst           the NPU thread runs one graphExecute of the persistent
+//                  graph per burst; its DSP loop waits the GPU flag step by
+//                  step and publishes each step into the NPU done flag
+struct NpuInlineLaunch {
+  static constexpr bool kWorker = false, kWorkerWaitsGpu = false, kDspWaitsGpu = false;
+  static constexpr bool kNotify = false, kBurst = false;
+};
+struct NpuWorkerLaunch {
+  static constexpr bool kWorker = true, kWorkerWaitsGpu = false, kDspWaitsGpu = false;
+  static constexpr bool kNotify = false, kBurst = false;
+};
+struct NpuDirectLaunch {
+  static constexpr bool kWorker = true, kWorkerWaitsGpu = true, kDspWaitsGpu = false;
+  static constexpr bool kNotify = false, kBurst = false;
+};
+struct NpuSyncWaitLaunch {
+  static constexpr bool kWorker = true, kWorkerWaitsGpu = false, kDspWaitsGpu = true;
+  static constexpr bool kNotify = false, kBurst = false;
+};
+struct NpuAsyncLaunch {
+  static constexpr bool kWorker = false, kWorkerWaitsGpu = false, kDspWaitsGpu = false;
+  static constexpr bool kNotify = true, kBurst = false;
+};
+struct NpuPersistentLaunch {
+  static constexpr bool kWorker = true, kWorkerWaitsGpu = false, kDspWaitsGpu = true;
+  static constexpr bool kNotify = false, kBurst = true;
+};
+
+// graphExecuteAsync whose QNN notify callback stamps the completion time and
+// bumps a CompletionCounter, the same contract as GpuEventCallback's
+// CL_COMPLETE. launch() returns the completion count to wait for; 0 means
+// the async launch was rejected and the step already ran blocking.
+struct NpuAsync {
+  using Done = CompletionCounter<NpuAsync>;
+
+  // slot -1: the engine's own buffers. *done_us is written before the count
+  // is published, so it is valid once wait() returns.
+  template <typename W>
+  static uint32_t launch(int slot, double* done_us) {
+    uint32_t n = ++Done::submitted();
+    if (npu_execute_async(slot, &on_done<W>, done_us)) return n;
+    --Done::submitted();
+    if (slot >= 0) npu_execute_slot(slot);
+    else           npu_execute_blocking();
+    *done_us = now_us();
+    return 0;
+  }
+  template <typename W>
+  static void wait(uint32_t n, PredictiveWaiter* p, double t_start) {
+    if (n) Done::wait<W>(n, p, t_start);
+  }
+
+private:
+  template <typename W>
+  static void on_done(void* done_us) {
+    *static_cast<double*>(done_us) = now_us();
+    Done::signal<W>();
+  }
+};
+
+template <typename G, typename L>
+constexpr bool kValidCombo = (!L::kWorkerWaitsGpu || G::kAsync) &&
+                             (!L::kDspWaitsGpu || G::kHasFlag);
+
+// ── Runtime selection ───────────────────────────────────────────────────────
+template <typename F>
+inline auto dispatch_gpu_sync(GpuSync g, F&& f) {
+  switch (g) {
+    case GpuSync::FINISH:         return f(GpuFinish{});
+    case GpuSync::EVENT_POLL:     return f(GpuEventPoll{});
+    case GpuSync::EVENT_CALLBACK: return f(GpuEventCallback{});
+    case GpuSync::PERSISTENT:     return f(GpuPersistent{});
+    case GpuSync::CPU:            return f(CpuFlag{});
+    case GpuSync::FLAG:           break;
+  }
+  return f(GpuFlag{});
+}
+
+template <typename F>
+inline auto dispatch_npu_launch(NpuLaunch l, F&& f) {
+  switch (l) {
+    case NpuLaunch::INLINE:     return f(NpuInlineLaunch{});
+    case NpuLaunch::WORKER:     return f(NpuWorkerLaunch{});
+    case NpuLaunch::SYNC_WAIT:  return f(NpuSyncWaitLaunch{});
+    case NpuLaunch::ASYNC:      return f(NpuAsyncLaunch{});
+    case NpuLaunch::PERSISTENT: return f(NpuPersistentLaunch{});
+    case NpuLaunch::DIRECT:     break;
+  }
+  return f(NpuDirectLaunch{});
+}
+
+// Call f(G{}, L{}) for a valid combination; returns false (f not called) otherwise
+template <typename F>
+inline bool dispatch_sync(GpuSync g, NpuLaunch l, F&& f) {
+  return dispatch_gpu_sync(g, [&](auto gp) {
+    using G = decltype(gp);
+    return dispatch_npu_launch(l, [&](auto lp) {
+      if constexpr (kValidCombo<G, decltype(lp)>) {
+        f(gp, lp);
+        return true;
+      } else {
+        return false;
+      }
+    });
+  });
+}
+
+inline bool sync_combo_valid(GpuSync g, NpuLaunch l) {
+  return dispatch_sync(g, l, [](auto, auto) {});
+}
@@ -0,0 +1,133 @@
+//=============================================================================
+// Unit test: persistent NPU burst protocol (PersistentRmsNorm) on the host
+//
+// The CPU engine plays the GPU (RMSNorm buf0 → buf1, epoch flag 0) and
+// PersistentNpuRef plays the DSP op (RMSNorm buf1 → buf0, epoch flag 1), one
+// execute_burst() call for the whole run, exactly as one graphExecute of the
+// persistent graph would. The main thread only submits CPU steps once the
+// NPU published the previous step.
+//
+// Checks:
+//   1. every step's result matches a serial CPU reference of the same chain
+//   2. the NPU flag ends at done_epoch + steps - 1
+//   3. a producer that stops early ends the burst after the timeout with
+//      exactly the posted steps completed
+//=============================================================================
+
+#include "common.h"
+#include "cpu_engine.h"
+#include "cpu_kernels.h"
+#include "persistent_ref.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kWaitFlag = 0;  // CPU engine (producer) publishes here
+constexpr int kDoneFlag = 1;  // persistent NPU reference publishes here
+
+int g_failures = 0;
+
+void expect(bool cond, const char* what) {
+  printf("  [%s] %s\n", cond ? "PASS" : "FAIL", what);
+  if (!cond) ++g_failures;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int hidden = 4096;
+  int steps  = 200;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--hidden") && i+1 < argc) hidden = atoi(argv[++i]);
+    if (!strcmp(argv[i], "--steps") && i+1 < argc) steps = atoi(argv[++i]);
+  }
+  printf("=== Persistent NPU Burst Test (host reference) ===\n");
+  printf("hidden=%d, steps=%d\n\n", hidden, steps);
+
+  ionUseMemfd() = true;  // host buffers, no libcdsprpc needed
+  const size_t tensor_bytes = (size_t)hidden * 2;
+  IonBuffer buf0, buf1, flags;
+  if (!allocIonBuffer(tensor_bytes, 0, buf0) || !allocIonBuffer(tensor_bytes, 0, buf1) ||
+      !allocIonBuffer(kFlagTableBytes, 0, flags)) {
+    printf("buffer alloc failed\n"); return 1;
+  }
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> dist(0.1f, 1.0f);
+  uint16_t* x0 = static_cast<uint16_t*>(buf0.ptr);
+  for (int i = 0; i < hidden; ++i) x0[i] = float_to_half(dist(rng));
+
+  // Serial reference of the same chain: x → rmsnorm (CPU) → rmsnorm (NPU) → ...
+  std::vector<uint16_t> ref(x0, x0 + hidden), tmp(hidden), gamma(hidden, float_to_half(1.0f));
+  const float eps = 1e-6f;
+
+  // One worker: the engine's reduction order then matches the serial reference
+  CpuEngine cpu;
+  PersistentNpuRef npu;
+  if (!cpu.init(hidden, eps, buf0, buf1, 1) || !cpu.enable_flag(flags, kWaitFlag) ||
+      !npu.init(hidden, eps, buf1, buf0, flags, kWaitFlag, kDoneFlag)) {
+    printf("init failed\n"); return 1;
+  }
+  EpochFlagTable<uint32_t> table(flags);
+
+  // ── 1 + 2: full burst ────────────────────────────────────────────────────
+  printf("Burst of %d steps:\n", steps);
+  {
+    const uint32_t wait0 = table.load(kWaitFlag) + 1;  // epoch of the first CPU step
+    const uint32_t done0 = table.load(kDoneFlag) + 1;
+    uint32_t completed = 0;
+    double t0 = now_us();
+    std::thread dsp([&] { completed = npu.execute_burst(wait0, steps, done0); });
+
+    bool match = true;
+    for (int i = 0; i < steps; ++i) {
+      cpuk::rmsnorm_f16(tmp.data(), ref.data(), gamma.data(), hidden, eps);
+      cpuk::rmsnorm_f16(ref.data(), tmp.data(), gamma.data(), hidden, eps);
+
+      uint32_t epoch = cpu.submit();
+      if (epoch != wait0 + i) match = false;
+      const uint32_t done = done0 + i;
+      SpinYieldWait::wait(table.flag(kDoneFlag),
+                          [done](uint32_t v) { return epoch_reached(v, done); });
+      if (memcmp(x0, ref.data(), tensor_bytes) != 0) match = false;
+    }
+    dsp.join();
+    double per_step = (now_us() - t0) / steps;
+
+    expect(completed == (uint32_t)steps, "burst completed every step");
+    expect(match, "outputs match the serial reference, epochs in lockstep");
+    expect(table.load(kDoneFlag) == done0 + steps - 1, "NPU flag at done_epoch + steps - 1");
+    printf("  %.1f us/step round trip (CPU step + NPU step + two flag handoffs)\n", per_step);
+  }
+
+  // ── 3: producer stops early ──────────────────────────────────────────────
+  printf("\nProducer stops after 3 of 5 steps:\n");
+  {
+    const uint32_t wait0 = table.load(kWaitFlag) + 1;
+    const uint32_t done0 = table.load(kDoneFlag) + 1;
+    uint32_t completed = 0;
+    std::thread dsp([&] { completed = npu.execute_burst(wait0, 5, done0, 20000); });
+    for (int i = 0; i < 3; ++i) {
+      cpu.submit();
+      const uint32_t done = done0 + i;
+      SpinYieldWait::wait(table.flag(kDoneFlag),
+                          [done](uint32_t v) { return epoch_reached(v, done); });
+    }
+    dsp.join();
+    expect(completed == 3, "burst ends after the timeout with 3 steps done");
+    expect(table.load(kDoneFlag) == done0 + 2, "no epoch published for unposted steps");
+  }
+
+  cpu.cleanup();
+  freeIonBuffer(buf0);
+  freeIonBuffer(buf1);
+  freeIonBuffer(flags);
+
+  printf("\n%s (%d failure(s))\n", g_failures ? "FAILED" : "ALL PASSED", g_failures);
+  return g_failures ? 1 : 0;
+}
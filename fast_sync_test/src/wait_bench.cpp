@@ -0,0 +1,98 @@
+// Wait-strategy microbenchmark: wake-up latency vs CPU burn.
+//
+// Host only (no GPU/NPU needed). A producer thread plays the device: it waits
+// delay_us (≈ one GPU/NPU step), then publishes a word. The consumer waits
+// for it with each strategy and records
+//   wake    — publish → consumer observes it (the latency a strategy adds)
+//   cpu     — consumer thread CPU time / wall time spent waiting
+// Two cases per strategy:
+//   host word   — producer calls W::notify() (thread handoff, e.g. npu_done)
+//   device word — nobody notifies (GPU flag in shared memory)
+#include "pipeline.h"
+#include "wait_strategy.h"
+
+#include <thread>
+#include <time.h>
+
+namespace {
+
+double thread_cpu_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+struct WaitBenchResult {
+  Stats  wake;
+  double cpu_pct = 0;
+};
+
+template <typename W, bool kNotify>
+WaitBenchResult bench_one(int delay_us, int iters) {
+  std::atomic<uint32_t> word{0};   // producer → consumer: iteration published
+  std::atomic<uint32_t> ready{0};  // consumer → producer: iteration started
+  double publish_t = 0;            // written before the release store of word
+
+  std::thread producer([&] {
+    for (int i = 1; i <= iters; ++i) {
+      SpinWait::wait(ready, [i](uint32_t v) { return v >= (uint32_t)i; });
+      // Busy-wait the delay so the publish time itself is precise
+      double deadline = now_us() + delay_us;
+      while (now_us() < deadline) cpu_pause();
+      publish_t = now_us();
+      word.store(i, std::memory_order_release);
+      if (kNotify) W::notify(word);
+    }
+  });
+
+  std::vector<double> wake;
+  wake.reserve(iters);
+  double wait_total = 0, cpu_total = 0;
+  for (int i = 1; i <= iters; ++i) {
+    auto done = [i](uint32_t v) { return v >= (uint32_t)i; };
+    double c0 = thread_cpu_us();
+    double t0 = now_us();
+    ready.store(i, std::memory_order_release);
+    if (kNotify)
+      W::wait(word, done);
+    else
+      W::wait(reinterpret_cast<const volatile uint32_t*>(&word), done);
+    double t1 = now_us();
+    double c1 = thread_cpu_us();
+    wake.push_back(t1 - publish_t);
+    wait_total += t1 - t0;
+    cpu_total  += c1 - c0;
+  }
+  producer.join();
+
+  WaitBenchResult r;
+  r.wake = compute_stats(wake);
+  r.cpu_pct = wait_total > 0 ? 100.0 * cpu_total / wait_total : 0;
+  return r;
+}
+
+}  // namespace
+
+void run_wait_benchmark(int delay_us, int iters) {
+  printf("=== Wait Strategy Benchmark (delay=%d us, %d iters) ===\n", delay_us, iters);
+  printf("  wake = publish → observed (us), cpu = waiter CPU time / wait time\n\n");
+  printf("  %-8s | %8s %8s %8s %6s | %8s %8s %8s %6s\n", "",
+         "host p50", "p99", "max", "cpu%", "dev p50", "p99", "max", "cpu%");
+  for (int i = 0; i < 77; ++i) printf("-");
+  printf("\n");
+
+  const WaitKind kinds[] = {WaitKind::SPIN, WaitKind::YIELD, WaitKind::FUTEX,
+                            WaitKind::ATOMIC, WaitKind::WFE};
+  for (WaitKind k : kinds) {
+    dispatch_wait(k, [&](auto w) {
+      using W = decltype(w);
+      WaitBenchResult host = bench_one<W, true>(delay_us, iters);
+      WaitBenchResult dev  = bench_one<W, false>(delay_us, iters);
+      printf("  %-8s | %8.1f %8.1f %8.1f %5.0f%% | %8.1f %8.1f %8.1f %5.0f%%\n",
+             W::kName,
+             host.wake.p50, host.wake.p99, host.wake.max, host.cpu_pct,
+             dev.wake.p50, dev.wake.p99, dev.wake.max, dev.cpu_pct);
+      return 0;
+    });
+  }
+}
@@ -0,0 +1,299 @@
+#pragma once
+// Wait strategies for completion flags and thread handoff words.
+//
+// Every busy-wait goes through one of these, picked at compile time (template
+// parameter), so a hot loop has no dispatch. They trade wake-up latency
+// against CPU burn — on a phone two big cores spinning for a whole run is
+// enough to hit thermal throttling:
+//
+//   SpinWait       pure spin + yield hint         lowest latency, burns the core
+//   SpinYieldWait  short spin, then sched_yield()  core given to other runnable threads
+//   SpinFutexWait  bounded spin, then futex sleep  sleeps after ~kSpinIters polls
+//   AtomicWait     sleep immediately              std::atomic::wait semantics (futex)
+//   WfeWait        aarch64 WFE on the flag line   low-power wait, woken by the store
+//
+// Three things can be waited on:
+//   wait(std::atomic<uint32_t>&, pred)  host word: written by another CPU thread,
+//                                       which calls W::notify() after the store
+//   wait(const volatile uint32_t*, pred) device word: flag written by the GPU
+//                                       kernel / DSP. Nobody can notify, so
+//                                       sleeping strategies nap kDeviceNapUs and
+//                                       re-check
+//   until(pred)                         arbitrary condition (e.g. cl_event status)
+//
+// pred receives the loaded word value and returns true when done.
+//
+// SenseBarrier<W> is a sense-reversing barrier on top of a strategy.
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// ── CPU relax hint ──────────────────────────────────────────────────────────
+// ARM yield hint: lighter than sched_yield (no context switch), just a CPU hint
+#if defined(__aarch64__)
+inline void cpu_pause() { asm volatile("yield" ::: "memory"); }
+#elif defined(__x86_64__)
+inline void cpu_pause() { __builtin_ia32_pause(); }
+#else
+inline void cpu_pause() { asm volatile("" ::: "memory"); }
+#endif
+
+namespace waitdetail {
+
+constexpr long kDeviceNapUs = 20;    // device words: re-check period while sleeping
+constexpr long kHostNapUs   = 1000;  // host words: safety net if a notify is missed
+
+inline uint32_t load(const std::atomic<uint32_t>& w) {
+  return w.load(std::memory_order_acquire);
+}
+inline uint32_t load(const volatile uint32_t* w) {
+  uint32_t v = *w;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return v;
+}
+
+inline const void* addr(const std::atomic<uint32_t>& w) { return &w; }
+inline const void* addr(const volatile uint32_t* w) { return const_cast<const uint32_t*>(w); }
+
+inline long nap_us(const std::atomic<uint32_t>&) { return kHostNapUs; }
+inline long nap_us(const volatile uint32_t*) { return kDeviceNapUs; }
+
+// Sleep while *addr == expected, at most timeout_us (spurious wakeups allowed)
+inline void futex_wait(const void* addr, uint32_t expected, long timeout_us) {
+  struct timespec ts;
+  ts.tv_sec  = timeout_us / 1000000;
+  ts.tv_nsec = (timeout_us % 1000000) * 1000;
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+}
+
+inline void futex_wake_all(const void* addr) {
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+inline void nap(long us) {
+  struct timespec ts = {0, us * 1000};
+  nanosleep(&ts, nullptr);
+}
+
+// Sleep on the word until pred(value) holds
+template <typename Word, typename Pred>
+inline void block_on(const Word& w, Pred done) {
+  for (;;) {
+    uint32_t v = load(w);
+    if (done(v)) return;
+    futex_wait(addr(w), v, nap_us(w));
+  }
+}
+
+}  // namespace waitdetail
+
+// ── Pure spin ───────────────────────────────────────────────────────────────
+struct SpinWait {
+  static constexpr const char* kName = "spin";
+
+  template <typename Pred>
+  static void until(Pred done) {
+    while (!done()) cpu_pause();
+  }
+  template <typename Word, typename Pred>
+  static void wait(const Word& w, Pred done) {
+    while (!done(waitdetail::load(w))) cpu_pause();
+  }
+  static void notify(std::atomic<uint32_t>&) {}
+};
+
+// ── Spin, then yield the core ───────────────────────────────────────────────
+struct SpinYieldWait {
+  static constexpr const char* kName = "yield";
+  static constexpr int kSpinIters = 256;
+
+  template <typename Pred>
+  static void until(Pred done) {
+    for (int i = 0; i < kSpinIters; ++i) {
+      if (done()) return;
+      cpu_pause();
+    }
+    while (!done()) sched_yield();
+  }
+  template <typename Word, typename Pred>
+  static void wait(const Word& w, Pred done) {
+    until([&] { return done(waitdetail::load(w)); });
+  }
+  static void notify(std::atomic<uint32_t>&) {}
+};
+
+// ── Bounded spin, then futex ────────────────────────────────────────────────
+// Spins long enough to catch short waits at spin latency (~10 us on a big
+// core), then sleeps. Costs one FUTEX_WAKE syscall per notify.
+struct SpinFutexWait {
+  static constexpr const char* kName = "futex";
+  static constexpr int kSpinIters = 2000;
+
+  template <typename Pred>
+  static void until(Pred done) {
+    for (int i = 0; i < kSpinIters; ++i) {
+      if (done()) return;
+      cpu_pause();
+    }
+    while (!done()) waitdetail::nap(waitdetail::kDeviceNapUs);
+  }
+  template <typename Word, typename Pred>
+  static void wait(const Word& w, Pred done) {
+    for (int i = 0; i < kSpinIters; ++i) {
+      if (done(waitdetail::load(w))) return;
+      cpu_pause();
+    }
+    waitdetail::block_on(w, done);
+  }
+  static void notify(std::atomic<uint32_t>& w) { waitdetail::futex_wake_all(&w); }
+};
+
+// ── Sleep immediately (std::atomic::wait) ───────────────────────────────────
+// C++17 has no std::atomic::wait; on Linux libstdc++/libc++ implement it with
+// the same futex calls, so that is what this uses unless C++20 is available.
+struct AtomicWait {
+  static constexpr const char* kName = "atomic";
+
+  template <typename Pred>
+  static void until(Pred done) {
+    while (!done()) waitdetail::nap(waitdetail::kDeviceNapUs);
+  }
+  template <typename Pred>
+  static void wait(const std::atomic<uint32_t>& w, Pred done) {
+#if defined(__cpp_lib_atomic_wait)
+    for (uint32_t v; !done(v = w.load(std::memory_order_acquire));)
+      w.wait(v, std::memory_order_acquire);
+#else
+    waitdetail::block_on(w, done);
+#endif
+  }
+  template <typename Pred>
+  static void wait(const volatile uint32_t* w, Pred done) {
+    waitdetail::block_on(w, done);
+  }
+  static void notify(std::atomic<uint32_t>& w) {
+#if defined(__cpp_lib_atomic_wait)
+    w.notify_all();
+#else
+    waitdetail::futex_wake_all(&w);
+#endif
+  }
+};
+
+// ── aarch64 WFE on the exclusive monitor ────────────────────────────────────
+// ldaxr arms the exclusive monitor on the flag's cache line; a store to that
+// line from another observer clears it and generates the wake-up event. The
+// core sits in WFE (clock-gated) instead of issuing loads. Device writes that
+// bypass the CPU's coherent view may not raise the event; the kernel's 10 kHz
+// event stream still wakes WFE, so worst-case latency is ~100 us there.
+// Falls back to SpinWait on other architectures.
+struct WfeWait {
+  static constexpr const char* kName = "wfe";
+
+  template <typename Pred>
+  static void until(Pred done) {
+    // No address to monitor: WFE only wakes on the event stream
+#if defined(__aarch64__)
+    while (!done()) asm volatile("wfe" ::: "memory");
+#else
+    SpinWait::until(done);
+#endif
+  }
+  template <typename Word, typename Pred>
+  static void wait(const Word& w, Pred done) {
+#if defined(__aarch64__)
+    const volatile uint32_t* p =
+        reinterpret_cast<const volatile uint32_t*>(waitdetail::addr(w));
+    uint32_t v;
+    asm volatile("sevl" ::: "memory");  // first WFE falls through
+    for (;;) {
+      asm volatile("wfe" ::: "memory");
+      asm volatile("ldaxr %w0, [%1]" : "=&r"(v) : "r"(p) : "memory");
+      if (done(v)) break;
+    }
+    asm volatile("clrex" ::: "memory");
+#else
+    SpinWait::wait(w, done);
+#endif
+  }
+  static void notify(std::atomic<uint32_t>&) {}  // the store itself is the event
+};
+
+// ── Runtime selection ───────────────────────────────────────────────────────
+enum class WaitKind { SPIN, YIELD, FUTEX, ATOMIC, WFE };
+
+inline const char* wait_kind_name(WaitKind k) {
+  switch (k) {
+    case WaitKind::SPIN:   return SpinWait::kName;
+    case WaitKind::YIELD:  return SpinYieldWait::kName;
+    case WaitKind::FUTEX:  return SpinFutexWait::kName;
+    case WaitKind::ATOMIC: return AtomicWait::kName;
+    case WaitKind::WFE:    return WfeWait::kName;
+  }
+  return "unknown";
+}
+
+// Returns false if name is not a known strategy
+inline bool parse_wait_kind(const char* name, WaitKind& out) {
+  const WaitKind all[] = {WaitKind::SPIN, WaitKind::YIELD, WaitKind::FUTEX,
+                          WaitKind::ATOMIC, WaitKind::WFE};
+  for (WaitKind k : all) {
+    if (!strcmp(name, wait_kind_name(k))) { out = k; return true; }
+  }
+  return false;
+}
+
+// Call f(W{}) with the strategy type selected by k — the single point where a
+// runtime choice becomes a template instantiation.
+template <typename F>
+inline auto dispatch_wait(WaitKind k, F&& f) {
+  switch (k) {
+    case WaitKind::YIELD:  return f(SpinYieldWait{});
+    case WaitKind::FUTEX:  return f(SpinFutexWait{});
+    case WaitKind::ATOMIC: return f(AtomicWait{});
+    case WaitKind::WFE:    return f(WfeWait{});
+    case WaitKind::SPIN:   break;
+  }
+  return f(SpinWait{});
+}
+
+// X-macro over every strategy, for explicitly instantiating code that is
+// templated on W in a .cpp (e.g. the bandwidth engines' barrier wait).
+#define WAIT_STRATEGY_LIST(X) \
+  X(SpinWait) X(SpinYieldWait) X(SpinFutexWait) X(AtomicWait) X(WfeWait)
+
+// ── Sense-reversing barrier ─────────────────────────────────────────────────
+// The arrival counter and the release word sit on separate cache lines, so
+// threads waiting on the sense never contend with threads still arriving, and
+// the last arrival releases everyone with a single store (+ notify). Reusable
+// back to back: a thread reads the current sense on arrival and waits for it
+// to flip, which cannot happen before it has arrived.
+template <typename W = SpinWait>
+class SenseBarrier {
+public:
+  explicit SenseBarrier(int count) : count_(count) {}
+
+  void arrive_and_wait() {
+    const uint32_t target = sense_.load(std::memory_order_relaxed) ^ 1u;
+    if (arrived_.fetch_add(1, std::memory_order_acq_rel) == count_ - 1) {
+      arrived_.store(0, std::memory_order_relaxed);
+      sense_.store(target, std::memory_order_release);
+      W::notify(sense_);
+    } else {
+      W::wait(sense_, [target](uint32_t s) { return s == target; });
+    }
+  }
+
+private:
+  const int count_;
+  alignas(64) std::atomic<int> arrived_{0};
+  alignas(64) std::atomic<uint32_t> sense_{0};
+};
@@ -69,12 +69,81 @@ static void print_device_info(cl_device_id device) {
     printf("最大内存分配大小: %.2f GB\n", max_mem_alloc_size / (1024.0 * 1024.0 * 1024.0));
 }
 
-// 测试带宽
-static double test_bandwidth(cl_command_queue queue, cl_kernel kernel, cl_mem src_buffer,
-                            cl_mem dst_buffer, size_t data_size, size_t num_elements,
-                            int num_iterations, const char* kernel_name, cl_device_id device) {
-    size_t global_work_size = num_elements;
+// 数据分段: 单个 cl_mem 不能超过 CL_DEVICE_MAX_MEM_ALLOC_SIZE，更大的数据量
+// 拆成多段，每段一对源/目标缓冲区和一个 kernel 实例，每次迭代逐段 NDRange
+struct Segment {
+    cl_mem src;
+    cl_mem dst;
+    cl_kernel kernel;
+    size_t bytes;
+    int num_vecs;  // float8 个数
+};
+
+static void release_segments(Segment* segs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (segs[i].kernel) clReleaseKernel(segs[i].kernel);
+        if (segs[i].dst) clReleaseMemObject(segs[i].dst);
+        if (segs[i].src) clReleaseMemObject(segs[i].src);
+    }
+    free(segs);
+}
+
+// 按 segment_size 切分 data_size，创建每段的缓冲区和 kernel 并写入测试数据
+static Segment* create_segments(cl_context context, cl_command_queue queue, cl_program program,
+                                size_t data_size, size_t segment_size, size_t* count) {
+    *count = (data_size + segment_size - 1) / segment_size;
+    Segment* segs = (Segment*)calloc(*count, sizeof(Segment));
+    if (!segs) return NULL;
+
+    void* host_data = malloc(segment_size < data_size ? segment_size : data_size);
+    if (!host_data) {
+        free(segs);
+        return NULL;
+    }
+
+    cl_int err = CL_SUCCESS;
+    for (size_t i = 0; i < *count; i++) {
+        Segment* sg = &segs[i];
+        size_t offset = i * segment_size;
+        sg->bytes = (data_size - offset < segment_size) ? data_size - offset : segment_size;
+        sg->num_vecs = (int)(sg->bytes / (sizeof(float) * 8));
+
+        sg->src = clCreateBuffer(context, CL_MEM_READ_ONLY, sg->bytes, NULL, &err);
+        if (err != CL_SUCCESS) {
+            printf("错误: 无法创建源缓冲区 (分段 %zu, %zu MB)\n", i, sg->bytes / (1024 * 1024));
+            break;
+        }
+        sg->dst = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sg->bytes, NULL, &err);
+        if (err != CL_SUCCESS) {
+            printf("错误: 无法创建目标缓冲区 (分段 %zu, %zu MB)\n", i, sg->bytes / (1024 * 1024));
+            break;
+        }
+        sg->kernel = clCreateKernel(program, "vector_copy_float8", &err);
+        if (err != CL_SUCCESS) {
+            printf("错误: 无法创建 kernel\n");
+            break;
+        }
+        clSetKernelArg(sg->kernel, 0, sizeof(cl_mem), &sg->dst);
+        clSetKernelArg(sg->kernel, 1, sizeof(cl_mem), &sg->src);
+        clSetKernelArg(sg->kernel, 2, sizeof(int), &sg->num_vecs);
+
+        // 初始化源缓冲区数据
+        memset(host_data, 0xAA, sg->bytes);  // 填充测试数据
+        clEnqueueWriteBuffer(queue, sg->src, CL_TRUE, 0, sg->bytes, host_data, 0, NULL, NULL);
+    }
+    free(host_data);
 
+    if (err != CL_SUCCESS) {
+        release_segments(segs, *count);
+        return NULL;
+    }
+    return segs;
+}
+
+// 测试带宽
+static double test_bandwidth(cl_command_queue queue, const Segment* segs, size_t num_segs,
+                             size_t data_size, int num_iterations, const char* kernel_name,
+                             cl_device_id device) {
     // 查询设备的最佳工作组大小
     size_t max_work_group_size;
     clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &max_work_group_size, NULL);
@@ -85,24 +154,30 @@ static double test_bandwidth(cl_command_queue queue, cl_kernel kernel, cl_mem sr
         local_work_size = max_work_group_size;
     }
 
-    // 确保 global_work_size 是 local_work_size 的倍数
-    if (global_work_size % local_work_size != 0) {
-        global_work_size = ((global_work_size / local_work_size) + 1) * local_work_size;
+    // 每段的 global_work_size，确保是 local_work_size 的倍数
+    size_t* global_work_size = (size_t*)malloc(num_segs * sizeof(size_t));
+    for (size_t s = 0; s < num_segs; s++) {
+        global_work_size[s] = ((segs[s].num_vecs + local_work_size - 1) / local_work_size) * local_work_size;
     }
 
     // 预热
     for (int i = 0; i < 3; i++) {
-        clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_work_size, &local_work_size, 0, NULL, NULL);
+        for (size_t s = 0; s < num_segs; s++) {
+            clEnqueueNDRangeKernel(queue, segs[s].kernel, 1, NULL, &global_work_size[s], &local_work_size, 0, NULL, NULL);
+        }
     }
     clFinish(queue);
 
     // 实际测试
     double start_time = get_time();
     for (int i = 0; i < num_iterations; i++) {
-        clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_work_size, &local_work_size, 0, NULL, NULL);
+        for (size_t s = 0; s < num_segs; s++) {
+            clEnqueueNDRangeKernel(queue, segs[s].kernel, 1, NULL, &global_work_size[s], &local_work_size, 0, NULL, NULL);
+        }
     }
     clFinish(queue);
     double end_time = get_time();
+    free(global_work_size);
 
     double elapsed = end_time - start_time;
     double total_data = (double)data_size * num_iterations * 2;  // 读+写
@@ -121,6 +196,7 @@ int main(int argc, char* argv[]) {
     size_t data_size_mb = (argc > 1) ? atoi(argv[1]) : 1024;  // 默认 1GB
     size_t data_size = data_size_mb * 1024 * 1024;
     int num_iterations = (argc > 2) ? atoi(argv[2]) : 10;    // 默认 10 次迭代
+    size_t segment_mb = (argc > 3) ? atoi(argv[3]) : 0;      // 默认按设备单次分配上限分段
 
     printf("测试配置:\n");
     printf("  数据大小: %zu MB\n", data_size_mb);
@@ -133,8 +209,6 @@ int main(int argc, char* argv[]) {
     cl_context context = NULL;
     cl_command_queue queue = NULL;
     cl_program program = NULL;
-    cl_mem src_buffer = NULL;
-    cl_mem dst_buffer = NULL;
 
     // 1. 获取平台和设备
     err = clGetPlatformIDs(1, &platform, NULL);
@@ -201,53 +275,34 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // 4. 创建缓冲区
-    src_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY, data_size, NULL, &err);
-    if (err != CL_SUCCESS) {
-        printf("错误: 无法创建源缓冲区\n");
-        clReleaseProgram(program);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return 1;
+    // 4. 创建缓冲区（按分段）
+    cl_ulong max_mem_alloc_size = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong), &max_mem_alloc_size, NULL);
+    size_t segment_size = max_mem_alloc_size ? (size_t)max_mem_alloc_size : data_size;
+    if (segment_mb > 0 && segment_mb * 1024 * 1024 < segment_size) {
+        segment_size = segment_mb * 1024 * 1024;
     }
+    segment_size = segment_size / (1024 * 1024) * (1024 * 1024);  // 整 MB，保持 float8 对齐
+    if (segment_size == 0) segment_size = 1024 * 1024;
 
-    dst_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, data_size, NULL, &err);
-    if (err != CL_SUCCESS) {
-        printf("错误: 无法创建目标缓冲区\n");
-        clReleaseMemObject(src_buffer);
+    size_t num_segs = 0;
+    Segment* segs = create_segments(context, queue, program, data_size, segment_size, &num_segs);
+    if (!segs) {
         clReleaseProgram(program);
         clReleaseCommandQueue(queue);
         clReleaseContext(context);
         return 1;
     }
-
-    // 初始化源缓冲区数据
-    void* host_data = malloc(data_size);
-    memset(host_data, 0xAA, data_size);  // 填充测试数据
-    clEnqueueWriteBuffer(queue, src_buffer, CL_TRUE, 0, data_size, host_data, 0, NULL, NULL);
-    free(host_data);
+    if (num_segs > 1) {
+        printf("数据分段: %zu 段 x %zu MB（单个 cl_mem 上限 %.2f GB）\n\n", num_segs,
+               segment_size / (1024 * 1024), max_mem_alloc_size / (1024.0 * 1024.0 * 1024.0));
+    }
 
     printf("=== 带宽测试结果 ===\n");
 
     // 5. 测试 kernel
-    cl_kernel kernel = clCreateKernel(program, "vector_copy_float8", &err);
-    if (err != CL_SUCCESS) {
-        printf("错误: 无法创建 kernel\n");
-        clReleaseMemObject(dst_buffer);
-        clReleaseMemObject(src_buffer);
-        clReleaseProgram(program);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return 1;
-    }
-
-    size_t num_vecs = data_size / (sizeof(float) * 8);
-    clSetKernelArg(kernel, 0, sizeof(cl_mem), &dst_buffer);
-    clSetKernelArg(kernel, 1, sizeof(cl_mem), &src_buffer);
-    clSetKernelArg(kernel, 2, sizeof(int), &num_vecs);
-
-    double bandwidth = test_bandwidth(queue, kernel, src_buffer, dst_buffer,
-                                     data_size, num_vecs, num_iterations, "vector_copy_float8", device);
+    double bandwidth = test_bandwidth(queue, segs, num_segs, data_size, num_iterations,
+                                      "vector_copy_float8", device);
 
     printf("\n=== 总结 ===\n");
     printf("实际带宽: %.2f GB/s (%.2f MB/s)\n", bandwidth, bandwidth * 1024.0);
@@ -255,11 +310,8 @@ int main(int argc, char* argv[]) {
     printf("带宽利用率: %.1f%%\n", bandwidth / 84.8 * 100.0);
     printf("实际带宽受内存控制器效率、缓存、系统负载等因素影响\n");
 
-    clReleaseKernel(kernel);
-
     // 清理资源
-    clReleaseMemObject(dst_buffer);
-    clReleaseMemObject(src_buffer);
+    release_segments(segs, num_segs);
     clReleaseProgram(program);
     clReleaseCommandQueue(queue);
     clReleaseContext(context);
@@ -58,3 +58,13 @@ __kernel void rmsnorm(
     y[i] = TO_SCALAR(val * rms_inv * g);
   }
 }
+
+// Completion flag for shared-buffer mode: enqueued right after rmsnorm on the
+// in-order queue, so the store lands once every row has been written.
+__kernel void publish_flag(
+    __global volatile uint* table,       // epoch flag table (ION)
+    const uint word,                     // flag index in uints
+    const uint epoch)
+{
+  table[word] = epoch;
+}
@@ -13,6 +13,7 @@ adb shell "mkdir -p ${DEVICE_DIR}/kernels ${LIB_DIR} ${HTP_DIR}"
 # Push binary and kernel
 adb push build/android/rmsnorm_benchmark "${DEVICE_DIR}/"
 adb push kernels/rmsnorm.cl "${DEVICE_DIR}/kernels/"
+adb push cost_table.csv "${DEVICE_DIR}/"
 
 # Push QNN ARM64 libraries
 adb push "${QNN_SDK_ROOT}/lib/aarch64-android/libQnnHtp.so" "${LIB_DIR}/"
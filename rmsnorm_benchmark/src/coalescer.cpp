@@ -0,0 +1,207 @@
+#include "coalescer.h"
+#include "cpu_rmsnorm.h"
+#include "gpu_rmsnorm.h"
+#include "npu_rmsnorm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t   kFlagTableBytes = 4096;
+constexpr uint32_t kGpuFlagWord    = 0;
+constexpr uint32_t kDoneOk         = 1;
+constexpr uint32_t kDoneFailed     = 2;
+
+CoalesceConfig g_config;
+bool           g_ready = false;
+
+// GPU: shared ION input/output + flag table; CPU: plain host rows
+IonBuffer g_input, g_output, g_flags;
+std::vector<uint16_t> g_cpuIn, g_cpuOut, g_gamma;
+uint32_t  g_epoch = 0;
+
+std::mutex              g_mutex;
+std::condition_variable g_cv;
+std::deque<RowRequest*> g_queue;
+bool                    g_stop = false;
+std::thread             g_dispatcher;
+CoalesceStats           g_stats;  // written by the dispatcher under g_mutex
+
+uint16_t* batch_input() {
+  switch (g_config.device) {
+    case Device::GPU: return static_cast<uint16_t*>(g_input.ptr);
+    case Device::NPU: return static_cast<uint16_t*>(npu_rmsnorm_cache_input());
+    case Device::CPU: return g_cpuIn.data();
+  }
+  return nullptr;
+}
+
+const uint16_t* batch_output() {
+  switch (g_config.device) {
+    case Device::GPU: return static_cast<const uint16_t*>(g_output.ptr);
+    case Device::NPU: return static_cast<const uint16_t*>(npu_rmsnorm_cache_output());
+    case Device::CPU: return g_cpuOut.data();
+  }
+  return nullptr;
+}
+
+// One batched launch over the first `rows` rows of the batch input, blocking
+bool launch(int rows) {
+  switch (g_config.device) {
+    case Device::GPU: {
+      const uint32_t epoch = ++g_epoch;
+      if (!gpu_rmsnorm_submit(epoch, rows)) return false;
+      volatile uint32_t* flag = static_cast<volatile uint32_t*>(g_flags.ptr) + kGpuFlagWord;
+      while (!epoch_reached(*flag, epoch)) std::this_thread::yield();
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return true;
+    }
+    case Device::NPU:
+      return npu_rmsnorm_cache_execute(rows);
+    case Device::CPU:
+      cpu_rmsnorm_rows(g_cpuOut.data(), g_cpuIn.data(), g_gamma.data(), rows, g_config.hidden,
+                       g_config.epsilon);
+      return true;
+  }
+  return false;
+}
+
+void dispatcher() {
+  const size_t row_bytes = (size_t)g_config.hidden * 2;
+  const auto window = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double, std::micro>(g_config.window_us));
+  std::vector<RowRequest*> batch;
+  batch.reserve(g_config.max_batch);
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(g_mutex);
+      g_cv.wait(lock, [] { return g_stop || !g_queue.empty(); });
+      if (g_queue.empty()) return;  // stopping
+
+      // Window opens at the first queued row (arrival seen by the dispatcher)
+      const auto close = std::chrono::steady_clock::now() + window;
+      g_cv.wait_until(lock, close, [] {
+        return g_stop || g_queue.size() >= (size_t)g_config.max_batch;
+      });
+      const size_t n = std::min(g_queue.size(), (size_t)g_config.max_batch);
+      batch.assign(g_queue.begin(), g_queue.begin() + n);
+      g_queue.erase(g_queue.begin(), g_queue.begin() + n);
+    }
+
+    const double t0 = now_seconds();
+    uint16_t* in = batch_input();
+    for (size_t i = 0; i < batch.size(); ++i)
+      memcpy(in + i * g_config.hidden, batch[i]->input, row_bytes);
+    const bool ok = launch(static_cast<int>(batch.size()));
+    if (ok) {
+      const uint16_t* out = batch_output();
+      for (size_t i = 0; i < batch.size(); ++i)
+        memcpy(batch[i]->output, out + i * g_config.hidden, row_bytes);
+    }
+    const double t1 = now_seconds();
+
+    {
+      std::lock_guard<std::mutex> lock(g_mutex);
+      g_stats.requests += batch.size();
+      g_stats.batches++;
+      g_stats.max_rows = std::max(g_stats.max_rows, static_cast<int>(batch.size()));
+      g_stats.launch_us += (t1 - t0) * 1e6;
+      if (!ok) g_stats.failed = true;
+    }
+    for (RowRequest* r : batch)
+      r->done.store(ok ? kDoneOk : kDoneFailed, std::memory_order_release);
+  }
+}
+
+}  // namespace
+
+bool coalescer_init(const CoalesceConfig& config, const char* kernel_path) {
+  g_config = config;
+  if (g_config.max_batch < 1) g_config.max_batch = 1;
+  g_stats = CoalesceStats{};
+  g_stop = false;
+  g_epoch = 0;
+
+  const size_t tensor_bytes = (size_t)g_config.max_batch * g_config.hidden * 2;
+  RMSNormConfig batch_cfg = {g_config.max_batch, g_config.hidden, g_config.epsilon};
+  g_ready = true;  // from here cleanup releases the device, even after a failed init
+  switch (g_config.device) {
+    case Device::GPU:
+      if (!allocIonBuffer(tensor_bytes, 0, g_input) || !allocIonBuffer(tensor_bytes, 0, g_output) ||
+          !allocIonBuffer(kFlagTableBytes, 0, g_flags)) {
+        printf("[COALESCE] ION alloc failed\n");
+        return false;
+      }
+      if (!gpu_rmsnorm_init_shared(batch_cfg, kernel_path, g_input, g_output, 0, g_flags,
+                                   kGpuFlagWord))
+        return false;
+      break;
+    case Device::NPU:
+      if (!npu_rmsnorm_cache_init(g_config.hidden, g_config.max_batch, NpuMode::NATIVE))
+        return false;
+      break;
+    case Device::CPU: {
+      const size_t elems = (size_t)g_config.max_batch * g_config.hidden;
+      g_cpuIn.assign(elems, 0);
+      g_cpuOut.assign(elems, 0);
+      g_gamma.assign(g_config.hidden, 0x3C00);  // FP16 1.0
+      break;
+    }
+  }
+  g_dispatcher = std::thread(dispatcher);
+  return true;
+}
+
+void coalescer_submit(RowRequest* req) {
+  req->done.store(0, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_queue.push_back(req);
+  }
+  g_cv.notify_one();
+}
+
+bool coalescer_wait(RowRequest* req) {
+  uint32_t d;
+  while ((d = req->done.load(std::memory_order_acquire)) == 0) std::this_thread::yield();
+  return d == kDoneOk;
+}
+
+CoalesceStats coalescer_stats() {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_stats;
+}
+
+void coalescer_cleanup() {
+  if (g_dispatcher.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(g_mutex);
+      g_stop = true;
+    }
+    g_cv.notify_one();
+    g_dispatcher.join();
+  }
+  if (g_ready) {
+    switch (g_config.device) {
+      case Device::GPU: gpu_rmsnorm_cleanup(); break;
+      case Device::NPU: npu_rmsnorm_cache_cleanup(); break;
+      case Device::CPU: break;
+    }
+  }
+  g_ready = false;
+  g_queue.clear();
+  freeIonBuffer(g_input);
+  freeIonBuffer(g_output);
+  freeIonBuffer(g_flags);
+  g_cpuIn.clear();
+  g_cpuOut.clear();
+  g_gamma.clear();
+}
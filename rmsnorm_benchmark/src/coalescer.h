@@ -0,0 +1,53 @@
+#pragma once
+#include "common.h"
+#include "cost_table.h"
+
+#include <atomic>
+
+// Request coalescing in front of one device: decode sessions submit single
+// RMSNorm rows, a dispatcher thread packs whatever is queued into one batched
+// launch and scatters the rows back.
+//
+// A batch closes when it holds max_batch rows or window_us after its first
+// row arrived, whichever comes first; rows that arrive while a batch runs
+// queue for the next one. Launch per device, on ION buffers of max_batch rows
+// (gamma = 1 everywhere):
+//
+//   GPU  rows gathered into the shared input, gpu_rmsnorm_submit(epoch, n)
+//        (one work-group per row) + spin on the GPU's ION epoch flag
+//   NPU  rows gathered into the graph cache input, npu_rmsnorm_cache_execute(n)
+//        (smallest batch bucket >= n, padded)
+//   CPU  cpu_rmsnorm_rows over the gathered rows
+//
+// max_batch = 1 (or window_us = 0 with one session) is the uncoalesced
+// baseline: one launch per request.
+
+struct CoalesceConfig {
+  Device device    = Device::GPU;
+  int    hidden    = 4096;
+  int    max_batch = 64;
+  double window_us = 50.0;
+  float  epsilon   = 1e-6f;
+};
+
+struct RowRequest {
+  const uint16_t* input  = nullptr;  // hidden FP16
+  uint16_t*       output = nullptr;  // hidden FP16, valid once done
+  std::atomic<uint32_t> done{0};
+};
+
+struct CoalesceStats {
+  uint64_t requests = 0;
+  uint64_t batches  = 0;
+  int      max_rows = 0;     // largest batch launched
+  double   launch_us = 0.0;  // summed gather + launch + completion + scatter
+  bool     failed   = false;
+};
+
+bool coalescer_init(const CoalesceConfig& config, const char* kernel_path);
+// Thread-safe, non-blocking. req must stay alive until done.
+void coalescer_submit(RowRequest* req);
+// Spin-yield until req is done; false when its batch failed
+bool coalescer_wait(RowRequest* req);
+CoalesceStats coalescer_stats();
+void coalescer_cleanup();
@@ -2,6 +2,7 @@
 #include <dlfcn.h>
 #include <atomic>
 #include <chrono>
+#include <climits>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
@@ -52,14 +53,21 @@ inline RpcMemApi& getRpcMemApi() {
 
 constexpr int RPCMEM_HEAP_ID_SYSTEM = 25;
 
-inline bool allocIonBuffer(size_t size, uint8_t fillValue, IonBuffer& out) {
+// rpcmem only: no host (memfd) backend in this project, see ion_pool.h
+inline bool ionBackendHost() { return false; }
+
+// Raw allocation behind the pool (ion_pool.h), contents undefined
+inline bool ionBackendAlloc(size_t size, IonBuffer& out) {
   auto& rpc = getRpcMemApi();
   if (!rpc.alloc || !rpc.toFd) return false;
 
+  if (size > static_cast<size_t>(INT_MAX)) {  // rpcmem_alloc takes an int size
+    printf("[ION] %zu bytes exceeds the 2 GB rpcmem limit; split it into segments\n", size);
+    return false;
+  }
   out.ptr = rpc.alloc(RPCMEM_HEAP_ID_SYSTEM, 0, static_cast<int>(size));
   if (!out.ptr) return false;
   out.size = size;
-  std::memset(out.ptr, fillValue, size);
 
   out.fd = rpc.toFd(out.ptr);
   if (out.fd < 0) {
@@ -70,14 +78,57 @@ inline bool allocIonBuffer(size_t size, uint8_t fillValue, IonBuffer& out) {
   return true;
 }
 
-inline void freeIonBuffer(IonBuffer& buf) {
-  if (buf.ptr) {
-    auto& rpc = getRpcMemApi();
-    if (rpc.freeMem) rpc.freeMem(buf.ptr);
-    buf.ptr = nullptr;
-    buf.fd  = -1;
-    buf.size = 0;
-  }
+inline void ionBackendFree(IonBuffer& buf) {
+  auto& rpc = getRpcMemApi();
+  if (rpc.freeMem) rpc.freeMem(buf.ptr);
+}
+
+// ── Buffer pool ─────────────────────────────────────────────────────────────
+// allocIonBuffer / freeIonBuffer go through a size-classed pool over rpcmem:
+// a released buffer keeps its fd and mapping for the next allocation of a
+// similar size (ion_pool.h). provisionIonBuffer() picks the fill policy
+// (none / parallel value / pattern, ion_fill.h); allocIonBuffer() is a
+// parallel value fill.
+#include "ion_pool.h"
+#include "ion_fill.h"
+
+inline bool allocIonBuffer(size_t size, uint8_t fillValue, IonBuffer& out) {
+  return provisionIonBuffer(size, IonFillSpec::value_of(fillValue), out);
+}
+
+inline void freeIonBuffer(IonBuffer& buf) { ionPool().release(buf); }
+
+// ── FP16 conversion ─────────────────────────────────────────────────────────
+// Truncating, no denormals: enough for test data, gammas and error checks
+inline uint16_t float_to_half(float f) {
+  uint32_t x;
+  memcpy(&x, &f, 4);
+  uint16_t sign = (x >> 16) & 0x8000;
+  int exp = ((x >> 23) & 0xFF) - 127 + 15;
+  uint32_t mant = x & 0x7FFFFF;
+  if (exp <= 0) return sign;
+  if (exp >= 31) return sign | 0x7C00;
+  return sign | (exp << 10) | (mant >> 13);
+}
+
+inline float half_to_float(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  int exp = (h >> 10) & 0x1F;
+  uint32_t mant = h & 0x3FF;
+  uint32_t x;
+  if (exp == 0) x = sign;                                   // zero / denormal → 0
+  else if (exp == 31) x = sign | 0x7F800000 | (mant << 13); // inf / nan
+  else x = sign | ((uint32_t)(exp - 15 + 127) << 23) | (mant << 13);
+  float f;
+  memcpy(&f, &x, 4);
+  return f;
+}
+
+// ── Epoch flags ─────────────────────────────────────────────────────────────
+// Wrap-safe "observed >= target" (serial number arithmetic): correct as long
+// as producer and consumer are less than 2^31 epochs apart.
+inline bool epoch_reached(uint32_t observed, uint32_t target) {
+  return static_cast<int32_t>(observed - target) >= 0;
 }
 
 // ── Theoretical peak ────────────────────────────────────────────────────────
@@ -0,0 +1,153 @@
+#include "cost_table.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+double elements(int batch, int hidden) { return (double)batch * hidden; }
+
+}  // namespace
+
+const char* device_name(Device d) {
+  switch (d) {
+    case Device::GPU: return "gpu";
+    case Device::NPU: return "npu";
+    case Device::CPU: return "cpu";
+  }
+  return "?";
+}
+
+bool parse_device(const char* s, Device& out) {
+  if (!strcmp(s, "gpu")) { out = Device::GPU; return true; }
+  if (!strcmp(s, "npu")) { out = Device::NPU; return true; }
+  if (!strcmp(s, "cpu")) { out = Device::CPU; return true; }
+  return false;
+}
+
+// ── Cost table ──────────────────────────────────────────────────────────────
+
+void CostTable::set(Device dev, const std::string& op, int batch, int hidden, double latency_us) {
+  auto& pts = points_[{static_cast<int>(dev), op}];
+  for (Point& p : pts) {
+    if (p.batch == batch && p.hidden == hidden) { p.latency_us = latency_us; return; }
+  }
+  pts.push_back({batch, hidden, latency_us});
+  std::sort(pts.begin(), pts.end(), [](const Point& a, const Point& b) {
+    double ea = elements(a.batch, a.hidden), eb = elements(b.batch, b.hidden);
+    return ea != eb ? ea < eb : a.hidden < b.hidden;
+  });
+}
+
+bool CostTable::has(Device dev, const std::string& op) const {
+  return points_.count({static_cast<int>(dev), op}) > 0;
+}
+
+bool CostTable::measured(const std::string& op, int batch, int hidden) const {
+  for (auto& kv : points_) {
+    if (kv.first.second != op) continue;
+    for (const Point& p : kv.second)
+      if (p.batch == batch && p.hidden == hidden) return true;
+  }
+  return false;
+}
+
+size_t CostTable::size() const {
+  size_t n = 0;
+  for (auto& kv : points_) n += kv.second.size();
+  return n;
+}
+
+double CostTable::latency_us(Device dev, const std::string& op, int batch, int hidden) const {
+  auto it = points_.find({static_cast<int>(dev), op});
+  if (it == points_.end() || it->second.empty()) return -1.0;
+  const std::vector<Point>& pts = it->second;
+  for (const Point& p : pts)
+    if (p.batch == batch && p.hidden == hidden) return p.latency_us;
+
+  // Curve over element count; shapes of equal size are averaged
+  std::vector<std::pair<double, double>> curve;
+  for (size_t i = 0; i < pts.size();) {
+    const double x = elements(pts[i].batch, pts[i].hidden);
+    double sum = 0;
+    size_t n = 0;
+    for (; i < pts.size() && elements(pts[i].batch, pts[i].hidden) == x; ++i, ++n)
+      sum += pts[i].latency_us;
+    curve.push_back({x, sum / n});
+  }
+
+  const double x = elements(batch, hidden);
+  if (x <= curve.front().first) return curve.front().second;
+  if (curve.size() == 1)  // one point: scale with size above it
+    return curve[0].second * x / curve[0].first;
+
+  size_t hi = 1;
+  while (hi + 1 < curve.size() && curve[hi].first < x) ++hi;
+  const auto& a = curve[hi - 1];
+  const auto& b = curve[hi];
+  const double slope = (b.second - a.second) / (b.first - a.first);
+  return std::max(0.0, a.second + slope * (x - a.first));
+}
+
+bool CostTable::load(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  char line[256];
+  int lineno = 0;
+  while (fgets(line, sizeof(line), f)) {
+    ++lineno;
+    if (line[0] == '#' || line[0] == '\n') continue;
+    char dev_s[16], op_s[64];
+    int batch = 0, hidden = 0;
+    double lat = 0;
+    Device dev;
+    if (sscanf(line, "%15[^,],%63[^,],%d,%d,%lf", dev_s, op_s, &batch, &hidden, &lat) != 5 ||
+        !parse_device(dev_s, dev) || batch <= 0 || hidden <= 0 || lat < 0) {
+      printf("[COST] %s:%d: bad row, skipped\n", path, lineno);
+      continue;
+    }
+    set(dev, op_s, batch, hidden, lat);
+  }
+  fclose(f);
+  return true;
+}
+
+bool CostTable::save(const char* path) const {
+  FILE* f = fopen(path, "w");
+  if (!f) { printf("[COST] cannot write %s\n", path); return false; }
+  fprintf(f, "# device,op,batch,hidden,latency_us\n");
+  for (auto& kv : points_) {
+    const char* dev = device_name(static_cast<Device>(kv.first.first));
+    for (const Point& p : kv.second)
+      fprintf(f, "%s,%s,%d,%d,%.2f\n", dev, kv.first.second.c_str(), p.batch, p.hidden, p.latency_us);
+  }
+  fclose(f);
+  return true;
+}
+
+// ── Placement ───────────────────────────────────────────────────────────────
+
+Placement place_op(const CostTable& table, const PlacementModel& model, const std::string& op,
+                   int batch, int hidden, Device prev) {
+  Placement pl;
+  const double input_bytes = (double)batch * hidden * 2;
+  for (int d = 0; d < kNumDevices; ++d) {
+    const Device dev = static_cast<Device>(d);
+    pl.compute_us[d] = model.allowed[d] ? table.latency_us(dev, op, batch, hidden) : -1.0;
+    pl.handoff_us[d] = 0.0;
+    if (dev != prev) {
+      pl.handoff_us[d] = model.sync_us[static_cast<int>(prev)];
+      if (model.transfer_gbps > 0)
+        pl.handoff_us[d] += input_bytes / (model.transfer_gbps * 1e3);  // GB/s = 1e3 bytes/us
+    }
+    if (pl.compute_us[d] < 0) continue;
+    const double total = pl.compute_us[d] + pl.handoff_us[d];
+    if (!pl.valid || total < pl.total_us) {
+      pl.valid = true;
+      pl.device = dev;
+      pl.total_us = total;
+    }
+  }
+  return pl;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ── Devices ─────────────────────────────────────────────────────────────────
+enum class Device { GPU, NPU, CPU };
+constexpr int kNumDevices = 3;
+
+const char* device_name(Device d);             // "gpu" / "npu" / "cpu"
+bool parse_device(const char* s, Device& out);
+
+// ── Cost table ──────────────────────────────────────────────────────────────
+// Measured per-call latency per (device, op) at a set of {batch, hidden}
+// shapes, persisted as CSV (one "device,op,batch,hidden,latency_us" row per
+// point, '#' comments). Lookups at unmeasured shapes interpolate on the
+// element count batch × hidden:
+//   between two measured sizes   linear
+//   below the smallest           the smallest's latency (launch-bound)
+//   above the largest            the last segment's slope (bandwidth-bound)
+class CostTable {
+public:
+  // Add a point, replacing an existing one at the same shape
+  void set(Device dev, const std::string& op, int batch, int hidden, double latency_us);
+
+  bool has(Device dev, const std::string& op) const;
+  // Some device has a point at exactly this shape
+  bool measured(const std::string& op, int batch, int hidden) const;
+  size_t size() const;
+
+  // Latency at any shape; < 0 when the device has no point for the op
+  double latency_us(Device dev, const std::string& op, int batch, int hidden) const;
+
+  // Merges into the current table (file rows win). false if unreadable.
+  bool load(const char* path);
+  bool save(const char* path) const;
+
+private:
+  struct Point {
+    int    batch;
+    int    hidden;
+    double latency_us;
+  };
+  using Key = std::pair<int, std::string>;  // (device, op)
+  std::map<Key, std::vector<Point>> points_; // sorted by batch × hidden
+};
+
+// ── Placement ───────────────────────────────────────────────────────────────
+// Cost of running the next op on a device given where its input was
+// produced: the measured latency, plus — when the device changes — the time
+// to see the producer's completion and, if the buffers are not zero-copy,
+// to move the input.
+struct PlacementModel {
+  // Completion detection of the producing device (fast_sync_test Big+Big,
+  // flag polling): GPU flag ~98 us, NPU graphExecute return, CPU in-thread
+  double sync_us[kNumDevices] = {98.0, 0.2, 0.0};
+  // Copy bandwidth for a cross-device input; 0 = shared ION buffers (UMA)
+  double transfer_gbps = 0.0;
+  // Devices the placer may pick
+  bool   allowed[kNumDevices] = {true, true, true};
+};
+
+struct Placement {
+  bool   valid = false;                     // some allowed device has costs
+  Device device = Device::GPU;              // cheapest
+  double total_us = 0.0;
+  double compute_us[kNumDevices] = {};      // < 0: no cost data / not allowed
+  double handoff_us[kNumDevices] = {};      // sync + transfer into the device
+};
+
+// Cheapest device for `op` at {batch, hidden} whose input was produced on
+// `prev` (FP16 activations of batch × hidden)
+Placement place_op(const CostTable& table, const PlacementModel& model, const std::string& op,
+                   int batch, int hidden, Device prev);
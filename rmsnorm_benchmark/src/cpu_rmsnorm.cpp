@@ -0,0 +1,78 @@
+#include "cpu_rmsnorm.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<uint16_t> g_input, g_output, g_gamma;
+int g_batch  = 0;
+int g_hidden = 0;
+
+void rmsnorm_rows(float eps) {
+  cpu_rmsnorm_rows(g_output.data(), g_input.data(), g_gamma.data(), g_batch, g_hidden, eps);
+}
+
+}  // namespace
+
+void cpu_rmsnorm_rows(uint16_t* out, const uint16_t* in, const uint16_t* gamma,
+                      int rows, int hidden, float eps) {
+  for (int b = 0; b < rows; ++b) {
+    const uint16_t* x = in + (size_t)b * hidden;
+    uint16_t* y = out + (size_t)b * hidden;
+    float ss = 0.0f;
+    for (int i = 0; i < hidden; ++i) {
+      float v = half_to_float(x[i]);
+      ss += v * v;
+    }
+    const float scale = 1.0f / std::sqrt(ss / hidden + eps);
+    for (int i = 0; i < hidden; ++i)
+      y[i] = float_to_half(half_to_float(x[i]) * scale * half_to_float(gamma[i]));
+  }
+}
+
+bool cpu_rmsnorm_init(const RMSNormConfig& config) {
+  g_batch  = config.batch_size;
+  g_hidden = config.hidden_dim;
+  const size_t n = (size_t)g_batch * g_hidden;
+  g_input.resize(n);
+  g_output.assign(n, 0);
+  g_gamma.assign(g_hidden, float_to_half(1.0f));
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> dist(0.1f, 1.0f);
+  for (auto& v : g_input) v = float_to_half(dist(rng));
+  return true;
+}
+
+RMSNormResult cpu_rmsnorm_run(const RMSNormConfig& config, int num_warmup, int num_iters) {
+  RMSNormResult res;
+  res.num_iterations = num_iters;
+
+  for (int i = 0; i < num_warmup; ++i) rmsnorm_rows(config.epsilon);
+
+  double t0 = now_seconds();
+  for (int i = 0; i < num_iters; ++i) rmsnorm_rows(config.epsilon);
+  double elapsed = now_seconds() - t0;
+
+  double bytes_per_call = (double)g_batch * g_hidden * 2 * 2 + (double)g_hidden * 2;
+  res.latency_us     = (elapsed / num_iters) * 1e6;
+  res.bandwidth_gbps = (bytes_per_call * num_iters / (1024.0*1024.0*1024.0)) / elapsed;
+  res.success = true;
+  return res;
+}
+
+bool cpu_rmsnorm_read_output(void* dst, size_t bytes) {
+  if (bytes > g_output.size() * 2) return false;
+  memcpy(dst, g_output.data(), bytes);
+  return true;
+}
+
+void cpu_rmsnorm_cleanup() {
+  g_input.clear();  g_input.shrink_to_fit();
+  g_output.clear(); g_output.shrink_to_fit();
+  g_gamma.clear();  g_gamma.shrink_to_fit();
+  g_batch = g_hidden = 0;
+}
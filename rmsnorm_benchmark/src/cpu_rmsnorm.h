@@ -0,0 +1,12 @@
+#pragma once
+#include "common.h"
+
+// Host CPU reference engine: FP16 in/out, FP32 accumulation, one thread.
+// The kernel on caller buffers: rows × hidden FP16, in → out (may alias)
+void cpu_rmsnorm_rows(uint16_t* out, const uint16_t* in, const uint16_t* gamma,
+                      int rows, int hidden, float eps);
+
+bool cpu_rmsnorm_init(const RMSNormConfig& config);
+RMSNormResult cpu_rmsnorm_run(const RMSNormConfig& config, int num_warmup, int num_iters);
+bool cpu_rmsnorm_read_output(void* dst, size_t bytes);
+void cpu_rmsnorm_cleanup();
@@ -8,6 +8,28 @@
 #include <random>
 #include <vector>
 
+// Qualcomm ION extension for zero-copy buffer import
+#ifndef CL_MEM_ION_HOST_PTR_QCOM
+#define CL_MEM_ION_HOST_PTR_QCOM 0x40A8
+#endif
+#ifndef CL_MEM_EXT_HOST_PTR_QCOM
+#define CL_MEM_EXT_HOST_PTR_QCOM (1 << 29)
+#endif
+#ifndef CL_MEM_HOST_UNCACHED_QCOM
+#define CL_MEM_HOST_UNCACHED_QCOM 0
+#endif
+
+typedef struct {
+  cl_uint allocation_type;
+  cl_uint host_cache_policy;
+} cl_mem_ext_host_ptr;
+
+typedef struct {
+  cl_mem_ext_host_ptr ext_host_ptr;
+  int   ion_filedesc;
+  void* ion_hostptr;
+} cl_mem_ion_host_ptr;
+
 namespace {
 
 cl_platform_id   g_platform = nullptr;
@@ -23,6 +45,13 @@ size_t           g_elem_size = 0;  // bytes per element (2 for fp16, 4 for fp32)
 int              g_batch     = 0;
 int              g_hidden    = 0;
 
+// Shared mode (gpu_rmsnorm_init_shared): rows of caller-owned ION buffers
+cl_mem           g_parentInput  = nullptr;
+cl_mem           g_parentOutput = nullptr;
+cl_mem           g_bufFlags     = nullptr;
+cl_kernel        g_flagKernel   = nullptr;
+size_t           g_local        = 0;
+
 static char* read_file(const char* path, size_t* out_size) {
   FILE* f = fopen(path, "r");
   if (!f) return nullptr;
@@ -37,18 +66,6 @@ static char* read_file(const char* path, size_t* out_size) {
   return buf;
 }
 
-// Convert float to IEEE 754 half-precision
-static uint16_t float_to_half(float f) {
-  uint32_t x;
-  memcpy(&x, &f, 4);
-  uint16_t sign = (x >> 16) & 0x8000;
-  int exp = ((x >> 23) & 0xFF) - 127 + 15;
-  uint32_t mant = x & 0x7FFFFF;
-  if (exp <= 0) return sign;
-  if (exp >= 31) return sign | 0x7C00;
-  return sign | (exp << 10) | (mant >> 13);
-}
-
 }  // namespace
 
 void gpu_rmsnorm_print_info() {
@@ -62,11 +79,11 @@ void gpu_rmsnorm_print_info() {
   printf("  GPU: %s, %u CU, %.2f GB\n", name, cu, mem / (1024.0*1024.0*1024.0));
 }
 
-bool gpu_rmsnorm_init(const RMSNormConfig& config, const char* kernel_path) {
+namespace {
+
+// Platform, device, context, queue, program, rmsnorm kernel
+bool setup_device(const char* kernel_path) {
   cl_int err;
-  g_batch  = config.batch_size;
-  g_hidden = config.hidden_dim;
-  g_elem_size = 2;  // FP16
 
   // Platform & device
   err = clGetPlatformIDs(1, &g_platform, nullptr);
@@ -103,6 +120,70 @@ bool gpu_rmsnorm_init(const RMSNormConfig& config, const char* kernel_path) {
 
   g_kernel = clCreateKernel(g_program, "rmsnorm", &err);
   if (err != CL_SUCCESS) { printf("[GPU] clCreateKernel: %d\n", err); return false; }
+  return true;
+}
+
+cl_mem import_ion_buffer(const IonBuffer& ion, cl_mem_flags flags) {
+  cl_mem_ion_host_ptr ion_mem = {};
+  ion_mem.ext_host_ptr.allocation_type   = CL_MEM_ION_HOST_PTR_QCOM;
+  ion_mem.ext_host_ptr.host_cache_policy = CL_MEM_HOST_UNCACHED_QCOM;
+  ion_mem.ion_filedesc = ion.fd;
+  ion_mem.ion_hostptr  = ion.ptr;
+
+  cl_int err;
+  cl_mem buf = clCreateBuffer(g_context, flags | CL_MEM_USE_HOST_PTR | CL_MEM_EXT_HOST_PTR_QCOM,
+                              ion.size, &ion_mem, &err);
+  if (err != CL_SUCCESS) {
+    printf("[GPU] clCreateBuffer (ION import) failed: %d\n", err);
+    return nullptr;
+  }
+  return buf;
+}
+
+cl_mem sub_buffer(cl_mem parent, cl_mem_flags flags, size_t offset, size_t bytes) {
+  cl_buffer_region region = { offset, bytes };
+  cl_int err;
+  cl_mem buf = clCreateSubBuffer(parent, flags, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+  if (err != CL_SUCCESS) {
+    printf("[GPU] clCreateSubBuffer(offset=%zu) failed: %d\n", offset, err);
+    return nullptr;
+  }
+  return buf;
+}
+
+bool init_gamma() {
+  cl_int err;
+  size_t gamma_bytes = (size_t)g_hidden * g_elem_size;
+  g_bufGamma = clCreateBuffer(g_context, CL_MEM_READ_ONLY, gamma_bytes, nullptr, &err);
+  if (err != CL_SUCCESS) { printf("[GPU] gamma buffer: %d\n", err); return false; }
+  std::vector<uint16_t> host_gamma(g_hidden, float_to_half(1.0f));
+  clEnqueueWriteBuffer(g_queue, g_bufGamma, CL_TRUE, 0, gamma_bytes, host_gamma.data(), 0, nullptr, nullptr);
+  return true;
+}
+
+void set_rmsnorm_args(float eps) {
+  g_local = 256;
+  size_t max_wg;
+  clGetDeviceInfo(g_device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_wg), &max_wg, nullptr);
+  if (g_local > max_wg) g_local = max_wg;
+
+  int hd = g_hidden;
+  clSetKernelArg(g_kernel, 0, sizeof(cl_mem), &g_bufOutput);
+  clSetKernelArg(g_kernel, 1, sizeof(cl_mem), &g_bufInput);
+  clSetKernelArg(g_kernel, 2, sizeof(cl_mem), &g_bufGamma);
+  clSetKernelArg(g_kernel, 3, sizeof(int), &hd);
+  clSetKernelArg(g_kernel, 4, sizeof(float), &eps);
+  clSetKernelArg(g_kernel, 5, g_local * sizeof(float), nullptr);  // local memory
+}
+
+}  // namespace
+
+bool gpu_rmsnorm_init(const RMSNormConfig& config, const char* kernel_path) {
+  cl_int err;
+  g_batch  = config.batch_size;
+  g_hidden = config.hidden_dim;
+  g_elem_size = 2;  // FP16
+  if (!setup_device(kernel_path)) return false;
 
   // Allocate buffers
   size_t tensor_bytes = (size_t)g_batch * g_hidden * g_elem_size;
@@ -130,6 +211,60 @@ bool gpu_rmsnorm_init(const RMSNormConfig& config, const char* kernel_path) {
   return true;
 }
 
+bool gpu_rmsnorm_init_shared(const RMSNormConfig& config, const char* kernel_path,
+                             const IonBuffer& input, const IonBuffer& output, int row_offset,
+                             const IonBuffer& flags, uint32_t flag_word) {
+  cl_int err;
+  g_batch  = config.batch_size;
+  g_hidden = config.hidden_dim;
+  g_elem_size = 2;  // FP16
+  if (!setup_device(kernel_path)) return false;
+
+  g_flagKernel = clCreateKernel(g_program, "publish_flag", &err);
+  if (err != CL_SUCCESS) { printf("[GPU] clCreateKernel(publish_flag): %d\n", err); return false; }
+
+  g_parentInput  = import_ion_buffer(input, CL_MEM_READ_ONLY);
+  g_parentOutput = import_ion_buffer(output, CL_MEM_WRITE_ONLY);
+  g_bufFlags     = import_ion_buffer(flags, CL_MEM_READ_WRITE);
+  if (!g_parentInput || !g_parentOutput || !g_bufFlags) return false;
+
+  // Sub-buffer origins must be CL_DEVICE_MEM_BASE_ADDR_ALIGN aligned (bits)
+  const size_t offset = (size_t)row_offset * g_hidden * g_elem_size;
+  const size_t bytes  = (size_t)g_batch * g_hidden * g_elem_size;
+  if (offset == 0) {
+    g_bufInput = g_parentInput;   clRetainMemObject(g_bufInput);
+    g_bufOutput = g_parentOutput; clRetainMemObject(g_bufOutput);
+  } else {
+    cl_uint align_bits = 0;
+    clGetDeviceInfo(g_device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(align_bits), &align_bits, nullptr);
+    if (align_bits && offset % (align_bits / 8) != 0) {
+      printf("[GPU] row offset %d not %u-byte aligned\n", row_offset, align_bits / 8);
+      return false;
+    }
+    g_bufInput  = sub_buffer(g_parentInput, CL_MEM_READ_ONLY, offset, bytes);
+    g_bufOutput = sub_buffer(g_parentOutput, CL_MEM_WRITE_ONLY, offset, bytes);
+    if (!g_bufInput || !g_bufOutput) return false;
+  }
+  if (!init_gamma()) return false;
+
+  set_rmsnorm_args(config.epsilon);
+  clSetKernelArg(g_flagKernel, 0, sizeof(cl_mem), &g_bufFlags);
+  clSetKernelArg(g_flagKernel, 1, sizeof(cl_uint), &flag_word);
+  return true;
+}
+
+bool gpu_rmsnorm_submit(uint32_t epoch, int rows) {
+  size_t global = (size_t)(rows > 0 && rows < g_batch ? rows : g_batch) * g_local;
+  size_t one = 1;
+  clSetKernelArg(g_flagKernel, 2, sizeof(cl_uint), &epoch);
+  cl_int err = clEnqueueNDRangeKernel(g_queue, g_kernel, 1, nullptr, &global, &g_local, 0, nullptr, nullptr);
+  if (err == CL_SUCCESS)
+    err = clEnqueueNDRangeKernel(g_queue, g_flagKernel, 1, nullptr, &one, &one, 0, nullptr, nullptr);
+  if (err != CL_SUCCESS) { printf("[GPU] submit failed: %d\n", err); return false; }
+  clFlush(g_queue);
+  return true;
+}
+
 RMSNormResult gpu_rmsnorm_run(const RMSNormConfig& config, int num_warmup, int num_iters) {
   RMSNormResult res;
   res.num_iterations = num_iters;
@@ -183,7 +318,13 @@ bool gpu_rmsnorm_read_output(void* dst, size_t bytes) {
 }
 
 void gpu_rmsnorm_cleanup() {
+  if (g_queue)     clFinish(g_queue);
   if (g_kernel)    clReleaseKernel(g_kernel);
+  if (g_flagKernel)     clReleaseKernel(g_flagKernel);
+  if (g_parentInput)    clReleaseMemObject(g_parentInput);
+  if (g_parentOutput)   clReleaseMemObject(g_parentOutput);
+  if (g_bufFlags)       clReleaseMemObject(g_bufFlags);
+  g_flagKernel = nullptr; g_parentInput = nullptr; g_parentOutput = nullptr; g_bufFlags = nullptr;
   if (g_bufInput)  clReleaseMemObject(g_bufInput);
   if (g_bufOutput) clReleaseMemObject(g_bufOutput);
   if (g_bufGamma)  clReleaseMemObject(g_bufGamma);
@@ -4,6 +4,18 @@
 // Initialize OpenCL: device, compile kernel, create buffers.
 bool gpu_rmsnorm_init(const RMSNormConfig& config, const char* kernel_path);
 
+// Shared mode: rows [row_offset, row_offset + batch_size) of caller-owned
+// ION buffers (imported zero-copy; a non-zero offset must be
+// CL_DEVICE_MEM_BASE_ADDR_ALIGN aligned). Each submit publishes its epoch
+// into uint `flag_word` of the ION flag table once the rows are written.
+bool gpu_rmsnorm_init_shared(const RMSNormConfig& config, const char* kernel_path,
+                             const IonBuffer& input, const IonBuffer& output, int row_offset,
+                             const IonBuffer& flags, uint32_t flag_word);
+
+// Shared mode: enqueue the rows + the flag store, flush, don't wait.
+// rows > 0 runs only the first `rows` rows (one work-group each).
+bool gpu_rmsnorm_submit(uint32_t epoch, int rows = 0);
+
 // Run benchmark: warmup + timed iterations. Returns average latency and bandwidth.
 RMSNormResult gpu_rmsnorm_run(const RMSNormConfig& config, int num_warmup, int num_iters);
 
@@ -1,11 +1,18 @@
+#include "coalescer.h"
 #include "common.h"
+#include "cost_table.h"
+#include "cpu_rmsnorm.h"
 #include "gpu_rmsnorm.h"
 #include "npu_rmsnorm.h"
+#include "split_rmsnorm.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
 #include <vector>
 
 static void print_usage(const char* prog) {
@@ -14,6 +21,69 @@ static void print_usage(const char* prog) {
   printf("  --batch N           single batch size to test\n");
   printf("  --iters N           iterations per test (default: auto)\n");
   printf("  --warmup N          warmup iterations (default: 10)\n");
+  printf("  --cost-table PATH   cost table CSV; measurements are merged into it (default: cost_table.csv)\n");
+  printf("  --place             no measurement: load --cost-table and print the placement sweep\n");
+  printf("  --sync-us G,N,C     completion-detection cost per producing device (default: 98,0.2,0)\n");
+  printf("  --transfer-gbps X   copy bandwidth for cross-device inputs (default: 0 = zero-copy)\n");
+  printf("  --devices LIST      devices the placer may pick, e.g. gpu,npu (default: gpu,npu,cpu)\n");
+  printf("  --split R           also run each batch>=16 case split across devices: auto (rows from the\n");
+  printf("                      cost table + --sync-us, over --devices) or G,N,C row fractions\n");
+  printf("  --coalesce DEV      decode sessions submit single rows to gpu|npu|cpu through a coalescing\n");
+  printf("                      queue, vs one launch per row (--iters requests per session, default 500)\n");
+  printf("  --sessions N        concurrent sessions for --coalesce (default: 16)\n");
+  printf("  --window-us X       coalescing window (default: 50)\n");
+  printf("  --max-batch N       rows per coalesced launch (default: 64)\n");
+  printf("  --graph-cache N     NPU only: bucketed graph cache up to batch N, random prefill lengths\n");
+  printf("                      1..N (--iters calls, default 200)\n");
+}
+
+static bool parse_sync_us(const char* s, PlacementModel& m) {
+  return sscanf(s, "%lf,%lf,%lf", &m.sync_us[0], &m.sync_us[1], &m.sync_us[2]) == 3;
+}
+
+static bool parse_devices(const char* s, PlacementModel& m) {
+  for (bool& a : m.allowed) a = false;
+  std::string list(s);
+  size_t pos = 0;
+  while (pos <= list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) end = list.size();
+    Device d;
+    if (!parse_device(list.substr(pos, end - pos).c_str(), d)) return false;
+    m.allowed[static_cast<int>(d)] = true;
+    pos = end + 1;
+  }
+  return true;
+}
+
+// Placement of one rmsnorm per batch size (powers of two), for each device
+// the input may come from. '*' marks shapes with no measured point.
+static void print_placement(const CostTable& table, const PlacementModel& model, int hidden) {
+  printf("--- Placement: rmsnorm, hidden=%d ---\n", hidden);
+  printf("sync_us: gpu=%.1f npu=%.1f cpu=%.1f, transfer: %s\n\n",
+         model.sync_us[0], model.sync_us[1], model.sync_us[2],
+         model.transfer_gbps > 0 ? "copy" : "zero-copy");
+  printf("%5s  | %9s %9s %9s | %-9s %-9s %-9s\n", "batch", "GPU(us)", "NPU(us)", "CPU(us)",
+         "from gpu", "from npu", "from cpu");
+  for (int i = 0; i < 72; ++i) printf("-");
+  printf("\n");
+
+  for (int batch = 1; batch <= 2048; batch *= 2) {
+    Placement same = place_op(table, model, "rmsnorm", batch, hidden, Device::GPU);
+    printf("%5d  |", batch);
+    for (int d = 0; d < kNumDevices; ++d) {
+      if (same.compute_us[d] < 0) printf(" %9s", "-");
+      else printf(" %9.1f", same.compute_us[d]);
+    }
+    printf(" |");
+    for (int d = 0; d < kNumDevices; ++d) {
+      Placement pl = place_op(table, model, "rmsnorm", batch, hidden, static_cast<Device>(d));
+      if (pl.valid) printf(" %-9s", device_name(pl.device));
+      else printf(" %-9s", "-");
+    }
+    printf("%s\n", table.measured("rmsnorm", batch, hidden) ? "" : " *");
+  }
+  printf("\n");
 }
 
 static int auto_iters(int batch, int hidden, double estimated_bw_gbps) {
@@ -26,20 +96,276 @@ static int auto_iters(int batch, int hidden, double estimated_bw_gbps) {
 
 struct TestCase { int batch; int hidden; const char* label; };
 
+// Split executor per case vs the same executor with every row on the GPU
+// (same launch + flag join, so the comparison is per call, not throughput)
+static void run_split(const std::vector<TestCase>& cases, const std::string& split,
+                      const CostTable& table, const PlacementModel& model, int warmup,
+                      int user_iters) {
+  printf("--- Split RMSNorm: rows across GPU | NPU | CPU, one call at a time ---\n\n");
+  printf("%-12s %5s | %-16s | %9s %9s | %8s %8s %8s | %9s | %6s | %s\n",
+         "场景", "batch", "rows g/n/c", "split(us)", "GB/s", "gpu_done", "npu_done", "cpu_done",
+         "GPU-only", "加速", "max_err");
+  for (int i = 0; i < 118; ++i) printf("-");
+  printf("\n");
+
+  for (auto& tc : cases) {
+    if (tc.batch < 16) continue;
+    RMSNormConfig cfg = {tc.batch, tc.hidden, 1e-6f};
+    SplitPlan plan;
+    if (split == "auto") {
+      plan = split_by_cost(table, model, tc.batch, tc.hidden);
+    } else {
+      double ratio[kNumDevices] = {};
+      if (sscanf(split.c_str(), "%lf,%lf,%lf", &ratio[0], &ratio[1], &ratio[2]) < 2) {
+        printf("bad --split %s\n", split.c_str());
+        return;
+      }
+      plan = split_by_ratio(tc.batch, ratio);
+    }
+    int iters = user_iters > 0 ? user_iters : std::min(auto_iters(tc.batch, tc.hidden, 20.0), 1000);
+
+    SplitResult r = {};
+    if (split_rmsnorm_init(cfg, plan, "kernels/rmsnorm.cl"))
+      r = split_rmsnorm_run(cfg, warmup, iters);
+    split_rmsnorm_cleanup();
+
+    SplitPlan gpu_only;
+    gpu_only.rows[static_cast<int>(Device::GPU)] = tc.batch;
+    SplitResult base = {};
+    if (split_rmsnorm_init(cfg, gpu_only, "kernels/rmsnorm.cl"))
+      base = split_rmsnorm_run(cfg, warmup, iters);
+    split_rmsnorm_cleanup();
+
+    char rows[32];
+    snprintf(rows, sizeof(rows), "%d/%d/%d", plan.rows[0], plan.rows[1], plan.rows[2]);
+    printf("%-12s %5d | %-16s", tc.label, tc.batch, rows);
+    if (r.total.success)
+      printf(" | %9.1f %9.2f | %8.1f %8.1f %8.1f", r.total.latency_us, r.total.bandwidth_gbps,
+             r.done_us[0], r.done_us[1], r.done_us[2]);
+    else
+      printf(" | %9s %9s | %8s %8s %8s", "FAIL", "-", "-", "-", "-");
+    if (base.total.success) printf(" | %9.1f", base.total.latency_us);
+    else                    printf(" | %9s", "FAIL");
+    if (r.total.success && base.total.success)
+      printf(" | %5.2fx", base.total.latency_us / r.total.latency_us);
+    else
+      printf(" | %6s", "-");
+    if (r.total.success) printf(" | %.4f %s", r.max_err, r.verified ? "PASS" : "FAIL");
+    printf("\n");
+  }
+  printf("\n");
+}
+
+struct CoalesceRun {
+  double req_per_sec = 0, mean_us = 0, p50_us = 0, p99_us = 0, max_err = 0;
+  CoalesceStats stats;
+  bool ok = false;
+};
+
+// `sessions` threads, each a decode loop: submit its row, wait, repeat.
+// Latency is submit → done as the session sees it.
+static CoalesceRun run_sessions(const CoalesceConfig& cfg, int sessions, int requests) {
+  CoalesceRun run;
+  if (!coalescer_init(cfg, "kernels/rmsnorm.cl")) { coalescer_cleanup(); return run; }
+
+  std::vector<std::vector<double>> lat(sessions);
+  std::vector<double> err(sessions, 0.0);
+  std::vector<bool> ok(sessions, true);
+  std::vector<std::thread> threads;
+  const double t0 = now_seconds();
+  for (int s = 0; s < sessions; ++s) {
+    threads.emplace_back([&, s] {
+      std::mt19937 rng(100 + s);
+      std::uniform_real_distribution<float> dist(0.1f, 1.0f);
+      std::vector<uint16_t> in(cfg.hidden), out(cfg.hidden), ref(cfg.hidden);
+      std::vector<uint16_t> gamma(cfg.hidden, float_to_half(1.0f));
+      for (auto& v : in) v = float_to_half(dist(rng));
+      cpu_rmsnorm_rows(ref.data(), in.data(), gamma.data(), 1, cfg.hidden, cfg.epsilon);
+
+      RowRequest req;
+      req.input = in.data();
+      req.output = out.data();
+      lat[s].reserve(requests);
+      for (int i = 0; i < requests; ++i) {
+        const double t = now_seconds();
+        coalescer_submit(&req);
+        if (!coalescer_wait(&req)) { ok[s] = false; return; }
+        lat[s].push_back((now_seconds() - t) * 1e6);
+        if (i == 0)
+          for (int k = 0; k < cfg.hidden; ++k)
+            err[s] = std::max(err[s], (double)std::fabs(half_to_float(out[k]) - half_to_float(ref[k])));
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  const double elapsed = now_seconds() - t0;
+  run.stats = coalescer_stats();
+  coalescer_cleanup();
+
+  std::vector<double> all;
+  for (int s = 0; s < sessions; ++s) {
+    if (!ok[s]) return run;
+    all.insert(all.end(), lat[s].begin(), lat[s].end());
+    run.max_err = std::max(run.max_err, err[s]);
+  }
+  if (all.empty()) return run;
+  std::sort(all.begin(), all.end());
+  double sum = 0;
+  for (double v : all) sum += v;
+  run.req_per_sec = all.size() / elapsed;
+  run.mean_us = sum / all.size();
+  run.p50_us  = all[all.size() / 2];
+  run.p99_us  = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+  run.ok = true;
+  return run;
+}
+
+// Single-row decode requests from concurrent sessions: one launch per
+// request vs launches coalesced within --window-us / --max-batch
+static void run_coalesce(Device dev, int hidden, int sessions, int requests, double window_us,
+                         int max_batch) {
+  printf("--- Request coalescing: %s, hidden=%d, %d sessions x %d requests ---\n\n",
+         device_name(dev), hidden, sessions, requests);
+  printf("%-22s | %8s %9s | %9s | %8s %8s %8s | %10s %10s | %s\n", "mode", "launches",
+         "rows/lnch", "req/s", "mean(us)", "p50(us)", "p99(us)", "us/launch", "us/request",
+         "max_err");
+  for (int i = 0; i < 124; ++i) printf("-");
+  printf("\n");
+
+  CoalesceConfig per_request = {dev, hidden, 1, 0.0, 1e-6f};
+  CoalesceConfig coalesced   = {dev, hidden, max_batch, window_us, 1e-6f};
+  char label[64];
+  snprintf(label, sizeof(label), "coalesced %dus/%d", (int)window_us, max_batch);
+  const std::pair<const char*, CoalesceConfig> modes[] = {{"per-request", per_request},
+                                                          {label, coalesced}};
+  for (auto& m : modes) {
+    CoalesceRun r = run_sessions(m.second, sessions, requests);
+    printf("%-22s", m.first);
+    if (!r.ok) { printf(" | FAIL\n"); continue; }
+    const CoalesceStats& st = r.stats;
+    printf(" | %8llu %9.1f | %9.0f | %8.1f %8.1f %8.1f | %10.1f %10.2f | %.4f %s\n",
+           (unsigned long long)st.batches, (double)st.requests / st.batches, r.req_per_sec,
+           r.mean_us, r.p50_us, r.p99_us, st.launch_us / st.batches, st.launch_us / st.requests,
+           r.max_err, r.max_err < 1e-2 ? "PASS" : "FAIL");
+  }
+  printf("\n");
+}
+
+// NPU with the prefill length changing every call: one pre-finalized graph
+// per power-of-two bucket, each call padded up to its bucket. Against an
+// exact-shape cache, where each first-seen length pays build + finalize.
+static void run_graph_cache(int hidden, int max_batch, int calls) {
+  printf("--- NPU graph cache: batch buckets 1..%d, hidden=%d, %d calls ---\n\n",
+         max_batch, hidden, calls);
+  double t0 = now_seconds();
+  if (!npu_rmsnorm_cache_init(hidden, max_batch, NpuMode::NATIVE)) {
+    printf("graph cache init failed\n\n");
+    npu_rmsnorm_cache_cleanup();
+    return;
+  }
+  double init_ms = (now_seconds() - t0) * 1e3;
+
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> len(1, max_batch);
+  std::vector<double> lat;
+  std::vector<bool> seen(max_batch + 1, false);
+  int distinct = 0;
+  for (int i = 0; i < calls; ++i) {
+    int rows = len(rng);
+    if (!seen[rows]) { seen[rows] = true; ++distinct; }
+    double t = now_seconds();
+    if (!npu_rmsnorm_cache_execute(rows)) { printf("exec failed at call %d\n\n", i); break; }
+    lat.push_back((now_seconds() - t) * 1e6);
+  }
+  npu_rmsnorm_cache_print_stats();
+
+  if (!lat.empty()) {
+    std::sort(lat.begin(), lat.end());
+    double sum = 0;
+    for (double v : lat) sum += v;
+    printf("\n  cache init (backend + all buckets): %.1f ms\n", init_ms);
+    printf("  per call: mean %.1f us, p50 %.1f us, p99 %.1f us\n", sum / lat.size(),
+           lat[lat.size() / 2], lat[std::min(lat.size() - 1, lat.size() * 99 / 100)]);
+  }
+
+  // Exact shapes: a graph per distinct length, timed on a few lengths
+  double build_ms = 0;
+  const int probe[] = {3, 37, 100};
+  int probed = 0;
+  for (int rows : probe) {
+    if (rows > max_batch) continue;
+    RMSNormConfig cfg = {rows, hidden, 1e-6f};
+    double t = now_seconds();
+    bool ok = npu_rmsnorm_init(cfg, NpuMode::NATIVE);
+    double ms = (now_seconds() - t) * 1e3;
+    npu_rmsnorm_cleanup();
+    if (!ok) continue;
+    printf("  exact shape batch=%d: init + finalize %.1f ms\n", rows, ms);
+    build_ms += ms;
+    ++probed;
+  }
+  if (probed > 0)
+    printf("  exact-shape cache: %d distinct lengths x %.1f ms = ~%.0f ms of finalize on the request path\n",
+           distinct, build_ms / probed, distinct * build_ms / probed);
+  printf("\n");
+}
+
 int main(int argc, char* argv[]) {
   int hidden_dim   = 4096;
   int single_batch = 0;
   int user_iters   = 0;
   int warmup       = 10;
+  std::string cost_path = "cost_table.csv";
+  bool place_only = false;
+  std::string split;
+  int graph_cache = 0;
+  std::string coalesce;
+  int sessions = 16, max_batch = 64;
+  double window_us = 50.0;
+  PlacementModel model;
 
   for (int i = 1; i < argc; ++i) {
     if (!strcmp(argv[i], "--hidden-dim") && i+1 < argc) hidden_dim = atoi(argv[++i]);
     else if (!strcmp(argv[i], "--batch") && i+1 < argc) single_batch = atoi(argv[++i]);
     else if (!strcmp(argv[i], "--iters") && i+1 < argc) user_iters = atoi(argv[++i]);
     else if (!strcmp(argv[i], "--warmup") && i+1 < argc) warmup = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--cost-table") && i+1 < argc) cost_path = argv[++i];
+    else if (!strcmp(argv[i], "--place")) place_only = true;
+    else if (!strcmp(argv[i], "--split") && i+1 < argc) split = argv[++i];
+    else if (!strcmp(argv[i], "--graph-cache") && i+1 < argc) graph_cache = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--coalesce") && i+1 < argc) coalesce = argv[++i];
+    else if (!strcmp(argv[i], "--sessions") && i+1 < argc) sessions = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--window-us") && i+1 < argc) window_us = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--max-batch") && i+1 < argc) max_batch = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--transfer-gbps") && i+1 < argc) model.transfer_gbps = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--sync-us") && i+1 < argc) {
+      if (!parse_sync_us(argv[++i], model)) { print_usage(argv[0]); return 1; }
+    }
+    else if (!strcmp(argv[i], "--devices") && i+1 < argc) {
+      if (!parse_devices(argv[++i], model)) { print_usage(argv[0]); return 1; }
+    }
     else if (!strcmp(argv[i], "--help")) { print_usage(argv[0]); return 0; }
   }
 
+  CostTable table;
+  if (place_only) {
+    if (!table.load(cost_path.c_str())) { printf("Cannot read %s\n", cost_path.c_str()); return 1; }
+    printf("Cost table: %s (%zu points)\n\n", cost_path.c_str(), table.size());
+    print_placement(table, model, hidden_dim);
+    return 0;
+  }
+  if (!coalesce.empty()) {
+    Device dev;
+    if (!parse_device(coalesce.c_str(), dev)) { print_usage(argv[0]); return 1; }
+    run_coalesce(dev, hidden_dim, sessions, user_iters > 0 ? user_iters : 500, window_us, max_batch);
+    return 0;
+  }
+  if (graph_cache > 0) {
+    run_graph_cache(hidden_dim, graph_cache, user_iters > 0 ? user_iters : 200);
+    return 0;
+  }
+  table.load(cost_path.c_str());  // keep points of shapes not re-measured
+
   printf("=== RMSNorm Benchmark: GPU (FP16) vs NPU (FP16) ===\n");
   printf("平台: SM8850, Adreno 840 + Hexagon V81\n");
   printf("理论峰值带宽: %.1f GB/s (LPDDR5X-5300)\n\n", kTheoreticalBandwidthGBps);
@@ -77,10 +403,10 @@ int main(int argc, char* argv[]) {
   // Benchmark: GPU FP16 RmsNorm vs NPU FP16 RmsNorm
   printf("--- GPU RMSNorm (FP16) vs NPU RMSNorm (FP16) ---\n\n");
 
-  printf("%-12s %5s %6s | %9s %9s | %9s %9s | %7s\n",
+  printf("%-12s %5s %6s | %9s %9s | %9s %9s | %9s | %7s\n",
          "场景", "batch", "hidden",
-         "GPU(us)", "GPU(GB/s)", "NPU(us)", "NPU(GB/s)", "GPU/NPU");
-  for (int i = 0; i < 82; ++i) printf("-");
+         "GPU(us)", "GPU(GB/s)", "NPU(us)", "NPU(GB/s)", "CPU(us)", "GPU/NPU");
+  for (int i = 0; i < 94; ++i) printf("-");
   printf("\n");
 
   for (auto& tc : cases) {
@@ -97,6 +423,17 @@ int main(int argc, char* argv[]) {
       npu = npu_rmsnorm_run(cfg, warmup, iters);
     npu_rmsnorm_cleanup();
 
+    // Scalar host loop: ~10x slower per byte than the estimate above
+    RMSNormResult cpu = {};
+    if (cpu_rmsnorm_init(cfg))
+      cpu = cpu_rmsnorm_run(cfg, std::min(warmup, 3),
+                            user_iters > 0 ? user_iters : auto_iters(tc.batch, tc.hidden, 2.0));
+    cpu_rmsnorm_cleanup();
+
+    if (gpu.success) table.set(Device::GPU, "rmsnorm", tc.batch, tc.hidden, gpu.latency_us);
+    if (npu.success) table.set(Device::NPU, "rmsnorm", tc.batch, tc.hidden, npu.latency_us);
+    if (cpu.success) table.set(Device::CPU, "rmsnorm", tc.batch, tc.hidden, cpu.latency_us);
+
     printf("%-12s %5d %6d", tc.label, tc.batch, tc.hidden);
 
     if (gpu.success) printf(" | %9.1f %9.2f", gpu.latency_us, gpu.bandwidth_gbps);
@@ -105,6 +442,9 @@ int main(int argc, char* argv[]) {
     if (npu.success) printf(" | %9.1f %9.2f", npu.latency_us, npu.bandwidth_gbps);
     else             printf(" | %9s %9s", "FAIL", "-");
 
+    if (cpu.success) printf(" | %9.1f", cpu.latency_us);
+    else             printf(" | %9s", "FAIL");
+
     if (gpu.success && npu.success)
       printf(" | %5.1fx", npu.latency_us / gpu.latency_us);
     else
@@ -114,7 +454,17 @@ int main(int argc, char* argv[]) {
   }
 
   printf("\n--- 结论 ---\n");
-  printf("GPU/NPU: GPU 相对 NPU FP16 RMSNorm 的加速比 (同精度苹果对苹果比较)\n");
+  printf("GPU/NPU: GPU 相对 NPU FP16 RMSNorm 的加速比 (同精度苹果对苹果比较)\n\n");
+
+  if (table.save(cost_path.c_str()))
+    printf("Cost table: %s (%zu points)\n\n", cost_path.c_str(), table.size());
+  print_placement(table, model, hidden_dim);
+
+  if (!split.empty())
+    run_split(cases, split, table, model, warmup, user_iters);
+
+  ionPrintProvisionStats("");
+  ionPool().print_stats("");
 
   return 0;
 }
@@ -1,4 +1,6 @@
 #include "npu_rmsnorm.h"
+#include "htp_shape_plan.h"
+#include "qnn_mem_cache.h"
 
 #include <dlfcn.h>
 #include <cstring>
@@ -19,6 +21,7 @@
 #include "QNN/QnnTensor.h"
 #include "QNN/HTP/QnnHtpDevice.h"
 #include "QNN/HTP/QnnHtpGraph.h"
+#include "QNN/HTP/QnnHtpMem.h"
 #include "QNN/HTP/QnnHtpPerfInfrastructure.h"
 
 namespace {
@@ -39,6 +42,7 @@ IonBuffer g_ionInput, g_ionOutput, g_ionGamma, g_ionBeta;
 
 struct RegMem { Qnn_MemHandle_t handle = nullptr; };
 RegMem g_regInput, g_regOutput;
+QnnMemCache g_memCache;  // registrations of the current context
 
 Qnn_Tensor_t g_execInputs[1];
 Qnn_Tensor_t g_execOutputs[1];
@@ -53,6 +57,8 @@ uint32_t g_dimsAxes[1];              // [1]
 int g_batch  = 0;
 int g_hidden = 0;
 size_t g_elem_bytes = 2;
+bool   g_sharedIO   = false;  // input/output owned by the caller (npu_rmsnorm_init_shared)
+size_t g_ioOffset   = 0;      // byte offset of our rows in the shared buffers
 
 void qnnLogCallback(const char* fmt, QnnLog_Level_t level,
                      uint64_t /*timestamp*/, va_list args) {
@@ -71,39 +77,16 @@ bool check(Qnn_ErrorHandle_t s, const char* w) {
   return true;
 }
 
-static uint16_t float_to_half(float f) {
-  uint32_t x;
-  memcpy(&x, &f, 4);
-  uint16_t sign = (x >> 16) & 0x8000;
-  int exp = ((x >> 23) & 0xFF) - 127 + 15;
-  uint32_t mant = x & 0x7FFFFF;
-  if (exp <= 0) return sign;
-  if (exp >= 31) return sign | 0x7C00;
-  return sign | (exp << 10) | (mant >> 13);
-}
-
 bool registerBuffer(const IonBuffer& ion, const uint32_t* dims, uint32_t ndims,
-                    Qnn_DataType_t dtype, RegMem& out) {
-  Qnn_MemDescriptor_t desc = QNN_MEM_DESCRIPTOR_INIT;
-  desc.memShape.numDim  = ndims;
-  desc.memShape.dimSize = const_cast<uint32_t*>(dims);
-  desc.dataType         = dtype;
-  desc.memType          = QNN_MEM_TYPE_ION;
-  desc.ionInfo.fd       = ion.fd;
-  if (QNN_SUCCESS != g_qnn->memRegister(g_context, &desc, 1, &out.handle)) {
-    printf("[NPU] memRegister failed (fd=%d)\n", ion.fd);
-    return false;
-  }
-  return true;
+                    Qnn_DataType_t dtype, RegMem& out, size_t offset = 0) {
+  out.handle = g_memCache.acquire(ion, offset, dims, ndims, dtype);
+  return out.handle != nullptr;
 }
 
 void deregisterAll() {
-  if (!g_qnn || !g_qnn->memDeRegister) return;
-  std::vector<Qnn_MemHandle_t> handles;
-  if (g_regInput.handle)  handles.push_back(g_regInput.handle);
-  if (g_regOutput.handle) handles.push_back(g_regOutput.handle);
-  if (!handles.empty())
-    g_qnn->memDeRegister(handles.data(), static_cast<uint32_t>(handles.size()));
+  g_memCache.release(g_regInput.handle);
+  g_memCache.release(g_regOutput.handle);
+  g_memCache.clear();
   g_regInput.handle = g_regOutput.handle = nullptr;
 }
 
@@ -415,36 +398,33 @@ void npu_rmsnorm_print_info() {
   printf("  NPU: Hexagon V81, %u core(s), %s\n", g_coreCount, mode_str);
 }
 
-bool npu_rmsnorm_init(const RMSNormConfig& config, NpuMode mode) {
-  g_batch  = config.batch_size;
-  g_hidden = config.hidden_dim;
+namespace {
+
+// Per-batch tensor dimensions
+void setBatchDims(int batch) {
+  g_batch = batch;
+  g_dimsIO[0] = g_batch; g_dimsIO[1] = 1; g_dimsIO[2] = 1; g_dimsIO[3] = g_hidden;
+  g_dimsMean[0] = g_batch; g_dimsMean[1] = 1; g_dimsMean[2] = 1; g_dimsMean[3] = 1;
+}
+
+// Gamma/beta, QNN backend + context (no graph yet)
+bool openBackend(int hidden_dim, NpuMode mode) {
+  g_hidden = hidden_dim;
   g_mode   = mode;
   g_elem_bytes = 2;  // FP16
 
-  size_t tensor_bytes = (size_t)g_batch * g_hidden * g_elem_bytes;
   size_t gamma_bytes  = (size_t)g_hidden * g_elem_bytes;
 
   // Set tensor dimensions
-  g_dimsIO[0] = g_batch; g_dimsIO[1] = 1; g_dimsIO[2] = 1; g_dimsIO[3] = g_hidden;
   g_dimsGamma[0] = 1; g_dimsGamma[1] = 1; g_dimsGamma[2] = 1; g_dimsGamma[3] = g_hidden;
   g_dimsGamma1D[0] = g_hidden;
   g_dimsScalar[0] = 1; g_dimsScalar[1] = 1; g_dimsScalar[2] = 1; g_dimsScalar[3] = 1;
-  g_dimsMean[0] = g_batch; g_dimsMean[1] = 1; g_dimsMean[2] = 1; g_dimsMean[3] = 1;
 
-  // Allocate ION buffers
-  if (!allocIonBuffer(tensor_bytes, 1, g_ionInput) ||
-      !allocIonBuffer(tensor_bytes, 0, g_ionOutput) ||
-      !allocIonBuffer(gamma_bytes, 0, g_ionGamma) ||
+  if (!allocIonBuffer(gamma_bytes, 0, g_ionGamma) ||
       !allocIonBuffer(gamma_bytes, 0, g_ionBeta)) {
     printf("[NPU] Failed to alloc ION buffers\n"); return false;
   }
 
-  // Init input with random FP16 (same seed as GPU)
-  std::mt19937 rng(42);
-  std::uniform_real_distribution<float> dist(0.1f, 1.0f);
-  uint16_t* ptr = reinterpret_cast<uint16_t*>(g_ionInput.ptr);
-  for (int i = 0; i < g_batch * g_hidden; ++i)
-    ptr[i] = float_to_half(dist(rng));
   // Init gamma = 1.0
   uint16_t one = float_to_half(1.0f);
   uint16_t* gp = reinterpret_cast<uint16_t*>(g_ionGamma.ptr);
@@ -493,16 +473,27 @@ bool npu_rmsnorm_init(const RMSNormConfig& config, NpuMode mode) {
 
   if (!check(g_qnn->contextCreate(g_backend, g_device, nullptr, &g_context), "contextCreate"))
     return false;
+  g_memCache = QnnMemCache{};
+  g_memCache.init(g_qnn, g_context);
 
   g_coreCount = queryCoreCount();
+  return true;
+}
+
+// Register g_ionInput / g_ionOutput (at g_ioOffset) with the current batch
+// dims, build + finalize graph `gname`, bind the memhandles
+bool buildBoundGraph(const char* gname) {
+  if (!htp_dims_ok(g_dimsIO))  // C is the normalized axis here: cannot be re-planned
+    printf("[NPU] hidden=%d exceeds the HTP channel limit %u: expect a tiler fallback\n",
+           g_hidden, kHtpMaxChannels);
 
   // Register ION buffers
-  if (!registerBuffer(g_ionInput,  g_dimsIO, kTensorRank, QNN_DATATYPE_FLOAT_16, g_regInput) ||
-      !registerBuffer(g_ionOutput, g_dimsIO, kTensorRank, QNN_DATATYPE_FLOAT_16, g_regOutput))
+  if (!registerBuffer(g_ionInput,  g_dimsIO, kTensorRank, QNN_DATATYPE_FLOAT_16, g_regInput, g_ioOffset) ||
+      !registerBuffer(g_ionOutput, g_dimsIO, kTensorRank, QNN_DATATYPE_FLOAT_16, g_regOutput, g_ioOffset))
     return false;
 
   // Build graph
-  if (!buildGraph(mode, "rmsnorm_graph"))
+  if (!buildGraph(g_mode, gname))
     return false;
 
   // Bind registered memory handles
@@ -514,6 +505,47 @@ bool npu_rmsnorm_init(const RMSNormConfig& config, NpuMode mode) {
   return true;
 }
 
+bool setup(const RMSNormConfig& config, NpuMode mode) {
+  if (!openBackend(config.hidden_dim, mode)) return false;
+  setBatchDims(config.batch_size);
+  return buildBoundGraph("rmsnorm_graph");
+}
+
+}  // namespace
+
+bool npu_rmsnorm_init(const RMSNormConfig& config, NpuMode mode) {
+  size_t tensor_bytes = (size_t)config.batch_size * config.hidden_dim * 2;
+  g_sharedIO = false;
+  g_ioOffset = 0;
+  if (!allocIonBuffer(tensor_bytes, 1, g_ionInput) ||
+      !allocIonBuffer(tensor_bytes, 0, g_ionOutput)) {
+    printf("[NPU] Failed to alloc ION buffers\n"); return false;
+  }
+
+  // Init input with random FP16 (same seed as GPU)
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> dist(0.1f, 1.0f);
+  uint16_t* ptr = reinterpret_cast<uint16_t*>(g_ionInput.ptr);
+  for (size_t i = 0; i < (size_t)config.batch_size * config.hidden_dim; ++i)
+    ptr[i] = float_to_half(dist(rng));
+
+  return setup(config, mode);
+}
+
+bool npu_rmsnorm_init_shared(const RMSNormConfig& config, NpuMode mode,
+                             const IonBuffer& input, const IonBuffer& output, int row_offset) {
+  g_sharedIO = true;
+  g_ioOffset = (size_t)row_offset * config.hidden_dim * 2;
+  g_ionInput  = input;
+  g_ionOutput = output;
+  return setup(config, mode);
+}
+
+bool npu_rmsnorm_execute() {
+  return check(g_qnn->graphExecute(g_graph, g_execInputs, 1, g_execOutputs, 1, nullptr, nullptr),
+               "graphExecute");
+}
+
 RMSNormResult npu_rmsnorm_run(const RMSNormConfig& config, int num_warmup, int num_iters) {
   RMSNormResult res;
   res.num_iterations = num_iters;
@@ -548,7 +580,7 @@ RMSNormResult npu_rmsnorm_run(const RMSNormConfig& config, int num_warmup, int n
 
 bool npu_rmsnorm_read_output(void* dst, size_t bytes) {
   if (!g_ionOutput.ptr) return false;
-  memcpy(dst, g_ionOutput.ptr, bytes);
+  memcpy(dst, static_cast<const char*>(g_ionOutput.ptr) + g_ioOffset, bytes);
   return true;
 }
 
@@ -562,8 +594,137 @@ void npu_rmsnorm_cleanup() {
   g_context = nullptr; g_device = nullptr; g_backend = nullptr;
   g_graph = nullptr; g_qnn = nullptr; g_libHandle = nullptr; g_log = nullptr;
 
+  if (g_sharedIO) {  // not ours to free
+    g_ionInput = IonBuffer{};
+    g_ionOutput = IonBuffer{};
+  }
   freeIonBuffer(g_ionInput);
   freeIonBuffer(g_ionOutput);
   freeIonBuffer(g_ionGamma);
   freeIonBuffer(g_ionBeta);
+  g_sharedIO = false;
+  g_ioOffset = 0;
+}
+
+// ── Bucketed graph cache ────────────────────────────────────────────────────
+
+namespace {
+
+struct Bucket {
+  int rows = 0;
+  uint32_t dims[kTensorRank] = {};  // [rows, 1, 1, hidden] for in/out below
+  Qnn_GraphHandle_t graph = nullptr;
+  Qnn_Tensor_t in = QNN_TENSOR_INIT, out = QNN_TENSOR_INIT;
+  RegMem regIn, regOut;
+  double build_ms = 0;
+  uint64_t calls = 0, used_rows = 0;
+};
+
+std::vector<Bucket> g_buckets;  // ascending rows; reserved, so &dims is stable
+bool g_dynamicDims = false;
+
+bool dynamicDimsSupported() {
+#ifdef QNN_PROPERTY_TENSOR_SUPPORT_DYNAMIC_DIMENSIONS
+  return g_qnn->propertyHasCapability &&
+         g_qnn->propertyHasCapability(QNN_PROPERTY_TENSOR_SUPPORT_DYNAMIC_DIMENSIONS) ==
+             QNN_PROPERTY_SUPPORTED;
+#else
+  return false;
+#endif
+}
+
+}  // namespace
+
+bool npu_rmsnorm_cache_init(int hidden_dim, int max_batch, NpuMode mode) {
+  int top = 1, count = 1;
+  while (top < max_batch) { top *= 2; ++count; }
+
+  size_t tensor_bytes = (size_t)top * hidden_dim * 2;
+  g_sharedIO = false;
+  g_ioOffset = 0;
+  if (!allocIonBuffer(tensor_bytes, 1, g_ionInput) ||
+      !allocIonBuffer(tensor_bytes, 0, g_ionOutput)) {
+    printf("[NPU] Failed to alloc ION buffers\n"); return false;
+  }
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> dist(0.1f, 1.0f);
+  uint16_t* ptr = reinterpret_cast<uint16_t*>(g_ionInput.ptr);
+  for (size_t i = 0; i < (size_t)top * hidden_dim; ++i)
+    ptr[i] = float_to_half(dist(rng));
+
+  if (!openBackend(hidden_dim, mode)) return false;
+  g_dynamicDims = dynamicDimsSupported();
+
+  g_buckets.clear();
+  g_buckets.reserve(count);
+  for (int rows = 1; rows <= top; rows *= 2) {
+    char name[32];
+    snprintf(name, sizeof(name), "rmsnorm_b%d", rows);
+    setBatchDims(rows);
+    double t0 = now_seconds();
+    if (!buildBoundGraph(name)) return false;
+
+    g_buckets.emplace_back();
+    Bucket& b = g_buckets.back();
+    b.rows = rows;
+    memcpy(b.dims, g_dimsIO, sizeof(b.dims));
+    b.graph = g_graph;
+    b.in  = g_execInputs[0];
+    b.out = g_execOutputs[0];
+    b.in.v1.dimensions  = b.dims;
+    b.out.v1.dimensions = b.dims;
+    b.regIn  = g_regInput;
+    b.regOut = g_regOutput;
+    b.build_ms = (now_seconds() - t0) * 1e3;
+    g_regInput.handle = g_regOutput.handle = nullptr;  // owned by the bucket now
+  }
+  return true;
+}
+
+void* npu_rmsnorm_cache_input() { return g_ionInput.ptr; }
+const void* npu_rmsnorm_cache_output() { return g_ionOutput.ptr; }
+
+bool npu_rmsnorm_cache_execute(int rows) {
+  for (Bucket& b : g_buckets) {
+    if (b.rows < rows) continue;
+    b.calls++;
+    b.used_rows += rows;
+    return check(g_qnn->graphExecute(b.graph, &b.in, 1, &b.out, 1, nullptr, nullptr),
+                 "graphExecute");
+  }
+  printf("[NPU] no bucket for %d rows\n", rows);
+  return false;
+}
+
+void npu_rmsnorm_cache_print_stats() {
+  printf("  dynamic dims: %s\n", g_dynamicDims
+             ? "reported by backend (buckets used anyway: one finalized graph per shape)"
+             : "not reported by backend");
+  printf("  %6s | %9s | %7s | %9s | %9s | %6s\n",
+         "bucket", "build(ms)", "calls", "rows", "padded", "waste");
+  uint64_t used = 0, run = 0;
+  double build = 0;
+  for (const Bucket& b : g_buckets) {
+    uint64_t executed = b.calls * b.rows;
+    printf("  %6d | %9.2f | %7llu | %9llu | %9llu | %5.1f%%\n", b.rows, b.build_ms,
+           (unsigned long long)b.calls, (unsigned long long)b.used_rows,
+           (unsigned long long)(executed - b.used_rows),
+           executed ? 100.0 * (executed - b.used_rows) / executed : 0.0);
+    used  += b.used_rows;
+    run   += executed;
+    build += b.build_ms;
+  }
+  printf("  total: %zu graphs built in %.1f ms, padding %.1f%% of executed rows\n",
+         g_buckets.size(), build, run ? 100.0 * (run - used) / run : 0.0);
+  g_memCache.print_stats("  npu");
+}
+
+void npu_rmsnorm_cache_cleanup() {
+  for (const Bucket& b : g_buckets) {
+    g_memCache.release(b.regIn.handle);
+    g_memCache.release(b.regOut.handle);
+  }
+  g_buckets.clear();
+  g_dynamicDims = false;
+  npu_rmsnorm_cleanup();
 }
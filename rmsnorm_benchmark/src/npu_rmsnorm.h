@@ -7,7 +7,27 @@ enum class NpuMode {
 };
 
 bool npu_rmsnorm_init(const RMSNormConfig& config, NpuMode mode);
+// Shared mode: rows [row_offset, row_offset + batch_size) of caller-owned
+// ION buffers, registered as HTP shared buffers at the rows' byte offset.
+bool npu_rmsnorm_init_shared(const RMSNormConfig& config, NpuMode mode,
+                             const IonBuffer& input, const IonBuffer& output, int row_offset);
+// One blocking graphExecute
+bool npu_rmsnorm_execute();
 RMSNormResult npu_rmsnorm_run(const RMSNormConfig& config, int num_warmup, int num_iters);
 bool npu_rmsnorm_read_output(void* dst, size_t bytes);
 void npu_rmsnorm_print_info();
 void npu_rmsnorm_cleanup();
+
+// Graph cache for a varying batch (prefill length): one finalized graph per
+// power-of-two bucket 1, 2, 4 .. >= max_batch, built once up front so a new
+// length never pays graphFinalize. Every bucket is bound to the same ION
+// input/output (sized for the largest bucket); a call runs the smallest
+// bucket that fits and the rows past `rows` are padding — their outputs are
+// don't-care. Replaces any npu_rmsnorm_init state (one QNN context).
+bool npu_rmsnorm_cache_init(int hidden_dim, int max_batch, NpuMode mode);
+void* npu_rmsnorm_cache_input();         // [max bucket rows, hidden] FP16
+const void* npu_rmsnorm_cache_output();  // rows [0, rows) valid after execute
+// One blocking graphExecute of the smallest bucket >= rows
+bool npu_rmsnorm_cache_execute(int rows);
+void npu_rmsnorm_cache_print_stats();
+void npu_rmsnorm_cache_cleanup();
@@ -0,0 +1,239 @@
+#include "split_rmsnorm.h"
+#include "cpu_rmsnorm.h"
+#include "gpu_rmsnorm.h"
+#include "npu_rmsnorm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t   kFlagSlotBytes  = 64;   // one cache line per flag
+constexpr size_t   kFlagTableBytes = 4096;
+constexpr uint32_t kGpuFlagWord    = 0;
+constexpr uint32_t kNpuFlagWord    = kFlagSlotBytes / sizeof(uint32_t);
+
+IonBuffer g_input, g_output, g_flags;
+SplitPlan g_plan;
+int       g_batch  = 0;
+int       g_hidden = 0;
+bool      g_gpuReady = false, g_npuReady = false;
+std::vector<uint16_t> g_gamma;  // CPU rows
+uint32_t  g_epoch = 0;
+
+// NPU worker: one graphExecute per posted epoch, then its flag
+std::thread           g_npuThread;
+std::atomic<uint32_t> g_npuGo{0};
+std::atomic<bool>     g_npuStop{false};
+std::atomic<bool>     g_npuFailed{false};
+double                g_npuDoneSec = 0;  // written before the flag store
+
+volatile uint32_t* flag(uint32_t word) {
+  return static_cast<volatile uint32_t*>(g_flags.ptr) + word;
+}
+
+void npu_worker() {
+  uint32_t seen = g_npuGo.load(std::memory_order_relaxed);
+  for (;;) {
+    uint32_t go;
+    while ((go = g_npuGo.load(std::memory_order_acquire)) == seen) {
+      if (g_npuStop.load(std::memory_order_relaxed)) return;
+      std::this_thread::yield();
+    }
+    seen = go;
+    if (!npu_rmsnorm_execute()) g_npuFailed.store(true, std::memory_order_relaxed);
+    g_npuDoneSec = now_seconds();
+    std::atomic_thread_fence(std::memory_order_release);
+    *flag(kNpuFlagWord) = go;
+  }
+}
+
+// One cooperative call. Fills done_sec (seconds after launch) when given.
+bool run_once(float eps, double* done_sec) {
+  const uint32_t epoch = ++g_epoch;
+  const int g = g_plan.rows[static_cast<int>(Device::GPU)];
+  const int n = g_plan.rows[static_cast<int>(Device::NPU)];
+  const int c = g_plan.rows[static_cast<int>(Device::CPU)];
+
+  const double t0 = now_seconds();
+  if (g > 0 && !gpu_rmsnorm_submit(epoch)) return false;
+  if (n > 0) g_npuGo.store(epoch, std::memory_order_release);
+  if (c > 0) {
+    const size_t off = (size_t)(g + n) * g_hidden;
+    cpu_rmsnorm_rows(static_cast<uint16_t*>(g_output.ptr) + off,
+                     static_cast<const uint16_t*>(g_input.ptr) + off,
+                     g_gamma.data(), c, g_hidden, eps);
+    if (done_sec) done_sec[static_cast<int>(Device::CPU)] = now_seconds() - t0;
+  }
+
+  bool gpu_done = g == 0, npu_done = n == 0;
+  while (!gpu_done || !npu_done) {
+    if (!gpu_done && epoch_reached(*flag(kGpuFlagWord), epoch)) {
+      gpu_done = true;
+      if (done_sec) done_sec[static_cast<int>(Device::GPU)] = now_seconds() - t0;
+    }
+    if (!npu_done && epoch_reached(*flag(kNpuFlagWord), epoch)) npu_done = true;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (done_sec && n > 0) done_sec[static_cast<int>(Device::NPU)] = g_npuDoneSec - t0;
+  return !g_npuFailed.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+// ── Plans ───────────────────────────────────────────────────────────────────
+
+SplitPlan split_by_ratio(int batch, const double ratio[kNumDevices]) {
+  SplitPlan plan;
+  double sum = 0;
+  for (int d = 0; d < kNumDevices; ++d) sum += std::max(0.0, ratio[d]);
+  if (sum <= 0) { plan.rows[static_cast<int>(Device::GPU)] = batch; return plan; }
+
+  int assigned = 0, largest = 0;
+  for (int d = 0; d < kNumDevices; ++d) {
+    plan.rows[d] = (int)(batch * std::max(0.0, ratio[d]) / sum);
+    assigned += plan.rows[d];
+    if (ratio[d] > ratio[largest]) largest = d;
+  }
+  plan.rows[largest] += batch - assigned;
+  return plan;
+}
+
+SplitPlan split_by_cost(const CostTable& table, const PlacementModel& model, int batch, int hidden) {
+  auto cost = [&](int d, int rows) {
+    return table.latency_us(static_cast<Device>(d), "rmsnorm", rows, hidden) + model.sync_us[d];
+  };
+  bool usable[kNumDevices];
+  double t_hi = -1;
+  for (int d = 0; d < kNumDevices; ++d) {
+    usable[d] = model.allowed[d] && table.has(static_cast<Device>(d), "rmsnorm");
+    if (usable[d] && (t_hi < 0 || cost(d, batch) < t_hi)) t_hi = cost(d, batch);
+  }
+  SplitPlan plan;
+  if (t_hi < 0) return plan;
+
+  // Most rows device d finishes within t (latency is non-decreasing in rows)
+  auto rows_within = [&](int d, double t) {
+    if (!usable[d] || cost(d, 1) > t) return 0;
+    int lo = 1, hi = batch;
+    while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      if (cost(d, mid) <= t) lo = mid; else hi = mid - 1;
+    }
+    return lo;
+  };
+
+  // Smallest finish time t at which the devices together cover the batch
+  double t_lo = 0;
+  for (int it = 0; it < 40; ++it) {
+    double t = 0.5 * (t_lo + t_hi);
+    int total = 0;
+    for (int d = 0; d < kNumDevices; ++d) total += rows_within(d, t);
+    if (total >= batch) t_hi = t; else t_lo = t;
+  }
+  int excess = -batch;
+  for (int d = 0; d < kNumDevices; ++d) excess += (plan.rows[d] = rows_within(d, t_hi));
+  for (int d = kNumDevices - 1; d >= 0 && excess > 0; --d) {  // trim CPU, then NPU, then GPU
+    int cut = std::min(excess, plan.rows[d]);
+    plan.rows[d] -= cut;
+    excess -= cut;
+  }
+  return plan;
+}
+
+// ── Executor ────────────────────────────────────────────────────────────────
+
+bool split_rmsnorm_init(const RMSNormConfig& config, const SplitPlan& plan, const char* kernel_path) {
+  g_batch  = config.batch_size;
+  g_hidden = config.hidden_dim;
+  g_plan   = plan;
+  int total = 0;
+  for (int r : plan.rows) total += r;
+  if (total != g_batch) { printf("[SPLIT] plan covers %d of %d rows\n", total, g_batch); return false; }
+
+  const size_t tensor_bytes = (size_t)g_batch * g_hidden * 2;
+  if (!allocIonBuffer(tensor_bytes, 0, g_input) || !allocIonBuffer(tensor_bytes, 0, g_output) ||
+      !allocIonBuffer(kFlagTableBytes, 0, g_flags)) {
+    printf("[SPLIT] ION alloc failed\n");
+    return false;
+  }
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> dist(0.1f, 1.0f);
+  uint16_t* in = static_cast<uint16_t*>(g_input.ptr);
+  for (size_t i = 0; i < (size_t)g_batch * g_hidden; ++i) in[i] = float_to_half(dist(rng));
+  g_gamma.assign(g_hidden, float_to_half(1.0f));
+
+  const int g = plan.rows[static_cast<int>(Device::GPU)];
+  const int n = plan.rows[static_cast<int>(Device::NPU)];
+  if (g > 0) {
+    RMSNormConfig part = {g, g_hidden, config.epsilon};
+    if (!gpu_rmsnorm_init_shared(part, kernel_path, g_input, g_output, 0, g_flags, kGpuFlagWord))
+      return false;
+    g_gpuReady = true;
+  }
+  if (n > 0) {
+    RMSNormConfig part = {n, g_hidden, config.epsilon};
+    if (!npu_rmsnorm_init_shared(part, NpuMode::NATIVE, g_input, g_output, g))
+      return false;
+    g_npuReady = true;
+    g_npuStop.store(false);
+    g_npuFailed.store(false);
+    g_npuThread = std::thread(npu_worker);
+  }
+  return true;
+}
+
+SplitResult split_rmsnorm_run(const RMSNormConfig& config, int num_warmup, int num_iters) {
+  SplitResult res;
+  res.total.num_iterations = num_iters;
+
+  for (int i = 0; i < num_warmup; ++i) {
+    if (!run_once(config.epsilon, nullptr)) { res.total.error = "warmup failed"; return res; }
+  }
+
+  double elapsed = 0;
+  double done_sum[kNumDevices] = {};
+  for (int i = 0; i < num_iters; ++i) {
+    double done[kNumDevices] = {};
+    const double t0 = now_seconds();
+    if (!run_once(config.epsilon, done)) { res.total.error = "exec failed"; return res; }
+    elapsed += now_seconds() - t0;
+    for (int d = 0; d < kNumDevices; ++d) done_sum[d] += done[d];
+  }
+
+  double bytes_per_call = (double)g_batch * g_hidden * 2 * 2 + (double)g_hidden * 2;
+  res.total.latency_us     = (elapsed / num_iters) * 1e6;
+  res.total.bandwidth_gbps = (bytes_per_call * num_iters / (1024.0*1024.0*1024.0)) / elapsed;
+  res.total.success = true;
+  for (int d = 0; d < kNumDevices; ++d) res.done_us[d] = done_sum[d] / num_iters * 1e6;
+
+  // Every partition against one CPU pass over the whole batch
+  std::vector<uint16_t> ref((size_t)g_batch * g_hidden);
+  cpu_rmsnorm_rows(ref.data(), static_cast<const uint16_t*>(g_input.ptr), g_gamma.data(),
+                   g_batch, g_hidden, config.epsilon);
+  const uint16_t* out = static_cast<const uint16_t*>(g_output.ptr);
+  for (size_t i = 0; i < ref.size(); ++i)
+    res.max_err = std::max(res.max_err, (double)std::fabs(half_to_float(out[i]) - half_to_float(ref[i])));
+  res.verified = res.max_err < 1e-2;
+  return res;
+}
+
+void split_rmsnorm_cleanup() {
+  if (g_npuThread.joinable()) {
+    g_npuStop.store(true);
+    g_npuThread.join();
+  }
+  if (g_npuReady) npu_rmsnorm_cleanup();
+  if (g_gpuReady) gpu_rmsnorm_cleanup();
+  g_npuReady = g_gpuReady = false;
+  freeIonBuffer(g_input);
+  freeIonBuffer(g_output);
+  freeIonBuffer(g_flags);
+  g_gamma.clear();
+  g_plan = SplitPlan{};
+  g_epoch = 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "common.h"
+#include "cost_table.h"
+
+// Cooperative RMSNorm: the rows of one batched call split across GPU, NPU
+// and CPU over shared ION buffers. Partition order in the buffers is GPU
+// rows first (offset 0, so no sub-buffer alignment constraint), then NPU
+// rows (HTP shared buffer at the row offset), then CPU rows.
+//
+// Each call launches every partition at once — GPU enqueue + flush, NPU
+// graphExecute on a resident worker thread, CPU rows on the calling thread —
+// and joins on per-partition epoch flags in an ION flag table: the GPU
+// publishes with a flag kernel after its rows, the NPU worker after
+// graphExecute returns. Nothing calls clFinish.
+
+struct SplitPlan {
+  int rows[kNumDevices] = {};  // indexed by Device
+};
+
+// Rows proportional to `ratio` (normalized), the rounding remainder going to
+// the largest share
+SplitPlan split_by_ratio(int batch, const double ratio[kNumDevices]);
+
+// Rows that equalize the predicted finish of every partition: the table's
+// latency at the partition's row count plus the model's sync cost of the
+// device. Devices that are not allowed or have no cost data get no rows.
+SplitPlan split_by_cost(const CostTable& table, const PlacementModel& model, int batch, int hidden);
+
+struct SplitResult {
+  RMSNormResult total;                // per call: launch → every partition joined
+  double done_us[kNumDevices] = {};   // per call: launch → partition complete (0 = no rows)
+  double max_err  = 0.0;              // output vs a single-pass CPU reference
+  bool   verified = false;
+};
+
+bool split_rmsnorm_init(const RMSNormConfig& config, const SplitPlan& plan, const char* kernel_path);
+SplitResult split_rmsnorm_run(const RMSNormConfig& config, int num_warmup, int num_iters);
+void split_rmsnorm_cleanup();
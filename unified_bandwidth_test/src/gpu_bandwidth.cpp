@@ -185,7 +185,8 @@ bool gpu_init(const IonBuffer& A, const IonBuffer& B, const IonBuffer& C,
   return true;
 }
 
-BandwidthResult gpu_run(int num_warmup, int num_iters, SpinBarrier* barrier) {
+template <typename W>
+BandwidthResult gpu_run(int num_warmup, int num_iters, SenseBarrier<W>* barrier) {
   BandwidthResult res;
   res.num_iterations = num_iters;
   res.total_data_bytes = (double)g_data_size * 3.0 * num_iters;  // 2 read + 1 write
@@ -220,6 +221,11 @@ BandwidthResult gpu_run(int num_warmup, int num_iters, SpinBarrier* barrier) {
   return res;
 }
 
+#define INSTANTIATE_GPU_RUN(W) \
+  template BandwidthResult gpu_run<W>(int, int, SenseBarrier<W>*);
+WAIT_STRATEGY_LIST(INSTANTIATE_GPU_RUN)
+#undef INSTANTIATE_GPU_RUN
+
 void gpu_cleanup() {
   if (g_kernel)  clReleaseKernel(g_kernel);
   if (g_bufA)    clReleaseMemObject(g_bufA);
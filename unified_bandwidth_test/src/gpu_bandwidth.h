@@ -8,7 +8,9 @@ bool gpu_init(const IonBuffer& A, const IonBuffer& B, const IonBuffer& C,
               size_t offset = 0, size_t partition_size = 0);
 
 // Run bandwidth test.  If barrier != nullptr, waits on it after warmup.
-BandwidthResult gpu_run(int num_warmup, int num_iters, SpinBarrier* barrier);
+// Instantiated for every strategy in WAIT_STRATEGY_LIST.
+template <typename W>
+BandwidthResult gpu_run(int num_warmup, int num_iters, SenseBarrier<W>* barrier);
 
 // Print device info.
 void gpu_print_info();
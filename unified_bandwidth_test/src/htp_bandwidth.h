@@ -9,7 +9,9 @@ bool htp_init(const IonBuffer& A, const IonBuffer& B, const IonBuffer& C,
               size_t partition_size = 0, int force_cores = 0);
 
 // Run bandwidth test.  If barrier != nullptr, waits on it after warmup.
-BandwidthResult htp_run(int num_warmup, int num_iters, SpinBarrier* barrier);
+// Instantiated for every strategy in WAIT_STRATEGY_LIST.
+template <typename W>
+BandwidthResult htp_run(int num_warmup, int num_iters, SenseBarrier<W>* barrier);
 
 // Print device info.
 void htp_print_info();
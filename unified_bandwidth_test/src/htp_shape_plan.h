@@ -0,0 +1,92 @@
+#pragma once
+// HTP tensor shape planner: NHWC dims for a flat byte range.
+//
+// The HTP tiler splits along C. With C <= 1048576 elements a 128 MB Add runs
+// at ~52 GB/s; with C = 4M it finds "no valid splitting rule" and falls back
+// to ~1.4 GB/s (htp_bandwidth_test/README.md). So a flat range becomes
+// [N, 1, 1, C] with
+//
+//   C <= kHtpMaxChannels                 tiler limit
+//   C * elem_bytes % kHtpVectorBytes == 0  whole HVX vectors per row
+//   C >= kHtpMinChannels                 rows long enough to amortize per-row cost
+//   N * C == elements                    nothing dropped
+//
+// and the largest such C wins. When the element count has no such divisor the
+// range is split into parts at increasing byte offsets: a [N, 1, 1, 1M] body
+// and a [1, 1, 1, rest] tail (rest < 1M). Each part is one registered
+// sub-tensor (HTP shared buffer at its offset) — one node per part in one
+// graph, or one execute per part.
+//
+// Header-only and QNN-free so every NPU engine can use it (same copy in each
+// project, like wait_strategy.h).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+constexpr uint32_t kHtpMaxChannels = 1048576;
+constexpr uint32_t kHtpMinChannels = 32768;
+constexpr size_t   kHtpVectorBytes = 128;
+
+struct HtpTensorPart {
+  size_t   offset_bytes = 0;  // from the start of the planned range
+  size_t   bytes        = 0;
+  uint32_t dims[4]      = {};  // NHWC
+};
+
+struct HtpShapePlan {
+  std::vector<HtpTensorPart> parts;
+  size_t elem_bytes      = 1;
+  size_t uncovered_bytes = 0;  // trailing bytes short of one element
+
+  bool split() const { return parts.size() > 1; }
+};
+
+// True when C is within the tiler limit (and the dims hold at least one element)
+inline bool htp_dims_ok(const uint32_t dims[4]) {
+  return dims[0] && dims[1] && dims[2] && dims[3] && dims[3] <= kHtpMaxChannels;
+}
+
+inline HtpShapePlan htp_plan_shape(size_t bytes, size_t elem_bytes) {
+  HtpShapePlan plan;
+  plan.elem_bytes      = elem_bytes ? elem_bytes : 1;
+  plan.uncovered_bytes = bytes % plan.elem_bytes;
+
+  size_t elems  = bytes / plan.elem_bytes;
+  size_t offset = 0;
+  const uint32_t step = static_cast<uint32_t>(
+      kHtpVectorBytes % plan.elem_bytes ? 1 : kHtpVectorBytes / plan.elem_bytes);
+
+  auto add = [&](size_t n, uint32_t c) {
+    HtpTensorPart p;
+    p.offset_bytes = offset;
+    p.bytes = n * c * plan.elem_bytes;
+    p.dims[0] = static_cast<uint32_t>(n); p.dims[1] = 1; p.dims[2] = 1; p.dims[3] = c;
+    plan.parts.push_back(p);
+    offset += p.bytes;
+    elems  -= n * c;
+  };
+
+  while (elems > 0) {
+    if (elems <= kHtpMaxChannels) { add(1, static_cast<uint32_t>(elems)); break; }
+
+    uint32_t best = 0;
+    for (uint32_t c = kHtpMaxChannels / step * step; c >= kHtpMinChannels; c -= step)
+      if (elems % c == 0) { best = c; break; }
+    if (best) { add(elems / best, best); break; }
+
+    add(elems / kHtpMaxChannels, kHtpMaxChannels);  // body; the tail is < 1M
+  }
+  return plan;
+}
+
+inline void htp_print_plan(const HtpShapePlan& plan, const char* prefix = "  ") {
+  for (size_t i = 0; i < plan.parts.size(); ++i) {
+    const HtpTensorPart& p = plan.parts[i];
+    printf("%s[%u, %u, %u, %u] @ +%zu (%zu B)%s\n", prefix, p.dims[0], p.dims[1], p.dims[2],
+           p.dims[3], p.offset_bytes, p.bytes, plan.split() ? " (split)" : "");
+  }
+  if (plan.uncovered_bytes)
+    printf("%s%zu trailing byte(s) not covered (< one element)\n", prefix, plan.uncovered_bytes);
+}
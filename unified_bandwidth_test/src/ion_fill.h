@@ -0,0 +1,188 @@
+#pragma once
+// Buffer provisioning: how a new ION buffer's contents are set up.
+//
+// One memset on one core over 3 × 512 MB is seconds of start-up: a single
+// core streams every byte and takes every page fault. provisionIonBuffer()
+// takes a fill policy instead:
+//
+//   NONE     contents undefined (outputs the kernel overwrites, buffers whose
+//            data does not matter to a bandwidth run)
+//   VALUE    every byte = value; large buffers are split over worker threads
+//            pinned to the big cores, so first touch happens in parallel
+//   PATTERN  byte i = ion_pattern_byte(seed, i), deterministic and position
+//            dependent: verification data a wrong offset cannot pass. Bytes
+//            are 0..127, so the sum of two patterns fits a byte and
+//            saturating (quantized NPU) and wrapping (GPU) adds agree
+//
+// Big cores are the online CPUs whose cpuinfo_max_freq is at least 2/3 of the
+// fastest one (little cluster excluded; all CPUs without cpufreq). Buffers
+// under kParallelMin are filled inline. Alloc and fill time accumulate in
+// ionProvisionStats(). Same copy in each project (like ion_pool.h).
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class IonFill { NONE, VALUE, PATTERN };
+
+struct IonFillSpec {
+  IonFill  kind  = IonFill::VALUE;
+  uint8_t  value = 0;  // VALUE
+  uint32_t seed  = 0;  // PATTERN
+
+  static IonFillSpec none() { return {IonFill::NONE, 0, 0}; }
+  static IonFillSpec value_of(uint8_t v) { return {IonFill::VALUE, v, 0}; }
+  static IonFillSpec pattern(uint32_t seed) { return {IonFill::PATTERN, 0, seed}; }
+};
+
+inline uint8_t ion_pattern_byte(uint32_t seed, size_t i) {
+  return static_cast<uint8_t>((seed * 0x3Bu + i * 0x9Du + (i >> 9) * 0x1Fu + (i >> 17)) & 0x7F);
+}
+
+struct IonProvisionStats {
+  int    buffers      = 0;
+  size_t bytes        = 0;  // requested
+  size_t filled_bytes = 0;  // VALUE / PATTERN
+  double alloc_ms     = 0;  // pool / backend
+  double fill_ms      = 0;
+  int    max_threads  = 0;  // widest fill
+};
+
+namespace ion_fill_detail {
+
+constexpr size_t kParallelMin = 16ull << 20;  // below: one memset inline
+constexpr size_t kPerThread   = 8ull << 20;   // at least this much per worker
+
+inline double now_ms() {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline const std::vector<int>& big_cores() {
+  static const std::vector<int> cores = [] {
+    const int n = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    std::vector<long> freq(n, 0);
+    long top = 0;
+    for (int c = 0; c < n; ++c) {
+      char path[96];
+      snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", c);
+      if (FILE* f = fopen(path, "r")) {
+        if (fscanf(f, "%ld", &freq[c]) != 1) freq[c] = 0;
+        fclose(f);
+      }
+      top = std::max(top, freq[c]);
+    }
+    std::vector<int> big;
+    for (int c = 0; c < n; ++c)
+      if (top == 0 || freq[c] * 3 >= top * 2) big.push_back(c);
+    return big;
+  }();
+  return cores;
+}
+
+inline void fill_range(uint8_t* p, size_t lo, size_t hi, const IonFillSpec& fill) {
+  if (fill.kind == IonFill::VALUE) {
+    std::memset(p + lo, fill.value, hi - lo);
+  } else {
+    // ion_pattern_byte() repeats every 128 bytes within a 512-byte block: one
+    // 128-byte row per block, copied out (lo is a multiple of 512)
+    uint8_t ramp[128], row[128];
+    for (int j = 0; j < 128; ++j) ramp[j] = static_cast<uint8_t>(j * 0x9Du);
+    for (size_t i = lo; i < hi; i += 512) {
+      const uint8_t base = static_cast<uint8_t>(fill.seed * 0x3Bu + (i >> 9) * 0x1Fu + (i >> 17));
+      for (int j = 0; j < 128; ++j) row[j] = static_cast<uint8_t>(base + ramp[j]) & 0x7F;
+      const size_t end = std::min(hi, i + 512);
+      for (size_t k = i; k < end; k += 128) std::memcpy(p + k, row, std::min<size_t>(128, end - k));
+    }
+  }
+}
+
+inline void pin_to_core(int core_id) {
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(core_id, &mask);
+  sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+inline std::mutex& stats_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+inline IonProvisionStats& stats() {
+  static IonProvisionStats s;
+  return s;
+}
+
+}  // namespace ion_fill_detail
+
+// Fill [0, size) of ptr per `fill`; returns the number of threads used
+inline int ion_fill(void* ptr, size_t size, const IonFillSpec& fill) {
+  using namespace ion_fill_detail;
+  if (fill.kind == IonFill::NONE || size == 0) return 0;
+  uint8_t* p = static_cast<uint8_t*>(ptr);
+  const std::vector<int>& cores = big_cores();
+  const int nthreads = size < kParallelMin ? 1
+                       : static_cast<int>(std::min<size_t>(cores.size(), size / kPerThread));
+  if (nthreads <= 1) {
+    fill_range(p, 0, size, fill);
+    return 1;
+  }
+  // Contiguous page-aligned chunk per worker
+  size_t chunk = (size + nthreads - 1) / nthreads;
+  chunk = (chunk + 4095) & ~size_t(4095);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < nthreads; ++t) {
+    workers.emplace_back([&, t]() {
+      pin_to_core(cores[t]);
+      size_t lo = std::min(size, t * chunk);
+      fill_range(p, lo, std::min(size, lo + chunk), fill);
+    });
+  }
+  for (auto& w : workers) w.join();
+  return nthreads;
+}
+
+// Pooled allocation of `size` bytes, filled per `fill`
+inline bool provisionIonBuffer(size_t size, const IonFillSpec& fill, IonBuffer& out) {
+  using namespace ion_fill_detail;
+  double t0 = now_ms();
+  if (!ionPool().acquire(size, out)) return false;
+  double t1 = now_ms();
+  int threads = ion_fill(out.ptr, size, fill);
+  double t2 = now_ms();
+
+  std::lock_guard<std::mutex> lock(stats_mutex());
+  IonProvisionStats& s = stats();
+  ++s.buffers;
+  s.bytes    += size;
+  s.alloc_ms += t1 - t0;
+  if (threads > 0) {
+    s.filled_bytes += size;
+    s.fill_ms      += t2 - t1;
+    s.max_threads   = std::max(s.max_threads, threads);
+  }
+  return true;
+}
+
+inline IonProvisionStats ionProvisionStats() {
+  std::lock_guard<std::mutex> lock(ion_fill_detail::stats_mutex());
+  return ion_fill_detail::stats();
+}
+
+inline void ionPrintProvisionStats(const char* tag) {
+  const IonProvisionStats s = ionProvisionStats();
+  if (s.buffers == 0) return;
+  printf("%sION provisioning: %d buffers, %.1f MB (%.1f MB filled), alloc %.1f ms, fill %.1f ms "
+         "(up to %d threads)\n",
+         tag, s.buffers, s.bytes / 1048576.0, s.filled_bytes / 1048576.0, s.alloc_ms, s.fill_ms,
+         s.max_threads);
+}
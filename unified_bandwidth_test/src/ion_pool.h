@@ -0,0 +1,183 @@
+#pragma once
+// Pooled, size-classed ION buffer allocator behind allocIonBuffer /
+// freeIonBuffer.
+//
+// rpcmem_alloc + rpcmem_to_fd (and the DSP-side mapping FastRPC sets up on
+// first use) cost far more than the benchmark step being measured, and every
+// case used to pay them again on init and give the memory back on cleanup.
+// The pool keeps released buffers, fd and mapping included, in free lists by
+// size class and hands them out again:
+//
+//   size classes  4 KB, then four per power of two (< 25% slack): a buffer
+//                 released by one shape is reused by the next, close shape.
+//                 Capped at kMaxClass so a request under 2 GB never becomes
+//                 a class rpcmem_alloc's int size cannot express
+//   cache limit   released buffers beyond it go straight back to the backend
+//   trim()        free every cached buffer (e.g. before a memory-hungry case)
+//
+// The caller sees a buffer of the requested size (IonBuffer::size); the fd's
+// allocation is the class size, which is fine for CL import / QNN
+// registration of [0, size). CL imports and QNN registrations belong to the
+// engine's context and are still made per context; a recycled buffer keeps
+// its fd and pointer, so the registration cache hits on it within a context.
+//
+// The backend is the project's common.h: ionBackendHost() (true when new
+// buffers are memfd host memory instead of rpcmem), ionBackendAlloc(),
+// ionBackendFree(). Thread-safe. Same copy in each project (like
+// wait_strategy.h).
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct IonPoolStats {
+  uint64_t allocs       = 0;  // allocIonBuffer calls
+  uint64_t hits         = 0;  // of which served from the free lists
+  size_t   live_bytes   = 0;  // handed out, class sizes
+  size_t   peak_bytes   = 0;  // max live_bytes
+  size_t   live_request = 0;  // handed out, requested sizes
+  size_t   peak_request = 0;  // live_request at peak_bytes (slack = the difference)
+  size_t   cached_bytes = 0;  // released, kept for reuse
+  int      fds          = 0;  // backend buffers open: live + cached
+  double   backend_us   = 0;  // time in backend alloc + free
+};
+
+class IonPool {
+public:
+  static constexpr size_t kMinClass          = 4096;
+  static constexpr size_t kDefaultCacheLimit = 512ull << 20;
+  static constexpr size_t kMaxClass = size_t(INT_MAX) / kMinClass * kMinClass;  // 2 GB - 4 KB
+
+  static size_t size_class(size_t bytes) {
+    if (bytes <= kMinClass) return kMinClass;
+    int k = 0;
+    while ((size_t(2) << k) < bytes) ++k;  // 2^k < bytes <= 2^(k+1)
+    size_t step = std::max(kMinClass, (size_t(1) << k) / 4);
+    size_t cls = (bytes + step - 1) / step * step;
+    return std::max(bytes, std::min(cls, kMaxClass));
+  }
+
+  // A buffer of at least `bytes` (contents undefined)
+  bool acquire(size_t bytes, IonBuffer& out) {
+    const size_t cls = size_class(bytes);
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.allocs;
+    const bool host = ionBackendHost();
+    Live whole{IonBuffer{}, host, bytes};
+    auto it = free_[host].find(cls);
+    if (it != free_[host].end() && !it->second.empty()) {
+      whole.buf = it->second.back();
+      it->second.pop_back();
+      ++stats_.hits;
+      stats_.cached_bytes -= cls;
+    } else {
+      const double t0 = now_us();
+      if (!ionBackendAlloc(cls, whole.buf)) return false;
+      stats_.backend_us += now_us() - t0;
+      ++stats_.fds;
+    }
+    live_[whole.buf.ptr] = whole;
+    stats_.live_bytes   += cls;
+    stats_.live_request += bytes;
+    if (stats_.live_bytes > stats_.peak_bytes) {
+      stats_.peak_bytes   = stats_.live_bytes;
+      stats_.peak_request = stats_.live_request;
+    }
+    out = whole.buf;
+    out.size = bytes;
+    return true;
+  }
+
+  // Back to the free list (or the backend, over the cache limit). Buffers the
+  // pool did not hand out go straight to the backend.
+  void release(IonBuffer& buf) {
+    if (!buf.ptr) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = live_.find(buf.ptr);
+    if (it == live_.end()) {
+      ionBackendFree(buf);
+      buf = IonBuffer{};
+      return;
+    }
+    Live whole = it->second;
+    live_.erase(it);
+    const size_t cls = whole.buf.size;
+    stats_.live_bytes   -= cls;
+    stats_.live_request -= whole.requested;
+    if (stats_.cached_bytes + cls > limit_) {
+      backend_free(whole.buf);
+    } else {
+      free_[whole.host][cls].push_back(whole.buf);
+      stats_.cached_bytes += cls;
+    }
+    buf = IonBuffer{};
+  }
+
+  void trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& lists : free_) {
+      for (auto& cls : lists)
+        for (IonBuffer& b : cls.second) backend_free(b);
+      lists.clear();
+    }
+    stats_.cached_bytes = 0;
+  }
+
+  void set_cache_limit(size_t bytes) {
+    { std::lock_guard<std::mutex> lock(mutex_); limit_ = bytes; }
+    if (stats().cached_bytes > bytes) trim();
+  }
+
+  IonPoolStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  void print_stats(const char* tag) const {
+    const IonPoolStats s = stats();
+    if (s.allocs == 0) return;
+    printf("%sION pool: %llu allocs, %llu reused (%.0f%%), live %zu KB, "
+           "peak %zu KB for %zu KB requested, cached %zu KB, %d fds, backend %.2f ms\n",
+           tag, (unsigned long long)s.allocs, (unsigned long long)s.hits,
+           100.0 * s.hits / s.allocs, s.live_bytes >> 10, s.peak_bytes >> 10,
+           s.peak_request >> 10, s.cached_bytes >> 10, s.fds, s.backend_us / 1e3);
+  }
+
+private:
+  static double now_us() {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void backend_free(IonBuffer& b) {
+    const double t0 = now_us();
+    ionBackendFree(b);
+    stats_.backend_us += now_us() - t0;
+    --stats_.fds;
+  }
+
+  // A handed-out buffer: the whole class-size allocation and its backend
+  struct Live {
+    IonBuffer buf;
+    bool      host;
+    size_t    requested;  // caller's size
+  };
+
+  mutable std::mutex mutex_;
+  // Free lists by class size, [0] rpcmem, [1] memfd: a buffer only goes back
+  // out on the backend it came from
+  std::unordered_map<size_t, std::vector<IonBuffer>> free_[2];
+  std::unordered_map<void*, Live> live_;  // ptr → whole buffer
+  size_t limit_ = kDefaultCacheLimit;
+  IonPoolStats stats_;
+};
+
+inline IonPool& ionPool() {
+  static IonPool pool;
+  return pool;
+}
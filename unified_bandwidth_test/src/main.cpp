@@ -35,8 +35,46 @@ static size_t verify_region(const void* ptr, size_t offset, size_t len,
   return mismatches;
 }
 
+// Inputs are position-dependent patterns under --verify, so C[i] is checked
+// against A[i] + B[i] at its own offset rather than one constant
+constexpr uint32_t kSeedA = 1, kSeedB = 2;
+
+// Verify C = A + B over a region of the pattern-filled inputs.  Returns mismatches.
+static size_t verify_sum_region(const void* ptr, size_t offset, size_t len, const char* label) {
+  if (!g_verify) return 0;
+  const uint8_t* p = static_cast<const uint8_t*>(ptr);
+  size_t mismatches = 0;
+  size_t first_bad = 0;
+  uint8_t first_val = 0, first_exp = 0;
+  for (size_t i = offset; i < offset + len; ++i) {
+    uint8_t expected = ion_pattern_byte(kSeedA, i) + ion_pattern_byte(kSeedB, i);
+    if (p[i] != expected) {
+      if (mismatches == 0) { first_bad = i; first_val = p[i]; first_exp = expected; }
+      ++mismatches;
+    }
+  }
+  if (mismatches == 0) {
+    printf("  [VERIFY] %s: PASS (%zu bytes, C = A + B)\n", label, len);
+  } else {
+    printf("  [VERIFY] %s: FAIL (%zu / %zu mismatches, first @ byte %zu: 0x%02x != 0x%02x)\n",
+           label, mismatches, len, first_bad, first_val, first_exp);
+  }
+  return mismatches;
+}
+
 // ── Helpers ─────────────────────────────────────────────────────────────────
 
+// A / B / C provisioning: a bandwidth run only needs the pages, so inputs get
+// a parallel value fill and C none; --verify fills patterns and zeroes C (the
+// padding gap is checked for zero)
+static bool alloc_abc(size_t bytes, IonBuffer& A, IonBuffer& B, IonBuffer& C) {
+  IonFillSpec fa = g_verify ? IonFillSpec::pattern(kSeedA) : IonFillSpec::value_of(1);
+  IonFillSpec fb = g_verify ? IonFillSpec::pattern(kSeedB) : IonFillSpec::value_of(2);
+  IonFillSpec fc = g_verify ? IonFillSpec::value_of(0) : IonFillSpec::none();
+  return provisionIonBuffer(bytes, fa, A) && provisionIonBuffer(bytes, fb, B) &&
+         provisionIonBuffer(bytes, fc, C);
+}
+
 static void print_result(const char* label, const BandwidthResult& r) {
   if (!r.success) {
     printf("  %s: FAILED (%s)\n", label, r.error.c_str());
@@ -48,6 +86,9 @@ static void print_result(const char* label, const BandwidthResult& r) {
 
 enum class Mode { GPU, NPU, CONCURRENT, ALL };
 
+// Wait strategy for the concurrent start barrier (--wait).
+static WaitKind g_wait = WaitKind::SPIN;
+
 static void print_usage(const char* prog) {
   printf("Usage: %s [options]\n", prog);
   printf("  --mode gpu|npu|concurrent|all   (default: all)\n");
@@ -58,6 +99,7 @@ static void print_usage(const char* prog) {
   printf("  --pad-mb N                      padding MB between partitions (default: 0)\n");
   printf("  --npu-cores N                   force NPU core count (default: auto)\n");
   printf("  --verify                        verify computation results (C=A+B)\n");
+  printf("  --wait spin|yield|futex|atomic|wfe  concurrent start barrier (default: spin)\n");
 }
 
 // Auto-compute iterations targeting ~100ms runtime
@@ -72,9 +114,7 @@ static int auto_iters(size_t partition_bytes, double estimated_bw_gbps) {
 
 static BandwidthResult run_gpu_only(size_t size_bytes, int iters) {
   IonBuffer A, B, C;
-  if (!allocIonBuffer(size_bytes, 1, A) ||
-      !allocIonBuffer(size_bytes, 2, B) ||
-      !allocIonBuffer(size_bytes, 0, C)) {
+  if (!alloc_abc(size_bytes, A, B, C)) {
     freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
     return {.error = "ION alloc failed"};
   }
@@ -85,19 +125,17 @@ static BandwidthResult run_gpu_only(size_t size_bytes, int iters) {
     return {.error = "GPU init failed"};
   }
 
-  auto res = gpu_run(3, iters, nullptr);
+  auto res = gpu_run<SpinWait>(3, iters, nullptr);
   gpu_cleanup();
   if (res.success)
-    verify_region(C.ptr, 0, size_bytes, 3, "GPU C=A+B");
+    verify_sum_region(C.ptr, 0, size_bytes, "GPU C=A+B");
   freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
   return res;
 }
 
 static BandwidthResult run_npu_only(size_t size_bytes, int iters, int force_cores = 0) {
   IonBuffer A, B, C;
-  if (!allocIonBuffer(size_bytes, 1, A) ||
-      !allocIonBuffer(size_bytes, 2, B) ||
-      !allocIonBuffer(size_bytes, 0, C)) {
+  if (!alloc_abc(size_bytes, A, B, C)) {
     freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
     return {.error = "ION alloc failed"};
   }
@@ -108,10 +146,10 @@ static BandwidthResult run_npu_only(size_t size_bytes, int iters, int force_core
     return {.error = "HTP init failed"};
   }
 
-  auto res = htp_run(3, iters, nullptr);
+  auto res = htp_run<SpinWait>(3, iters, nullptr);
   htp_cleanup();
   if (res.success)
-    verify_region(C.ptr, 0, size_bytes, 3, "NPU C=A+B");
+    verify_sum_region(C.ptr, 0, size_bytes, "NPU C=A+B");
   freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
   return res;
 }
@@ -132,9 +170,7 @@ static ConcurrentResult run_concurrent(
   ConcurrentResult cr = {};
 
   IonBuffer A, B, C;
-  if (!allocIonBuffer(total_bytes, 1, A) ||
-      !allocIonBuffer(total_bytes, 2, B) ||
-      !allocIonBuffer(total_bytes, 0, C)) {
+  if (!alloc_abc(total_bytes, A, B, C)) {
     freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
     cr.gpu.error = "ION alloc failed";
     return cr;
@@ -157,31 +193,34 @@ static ConcurrentResult run_concurrent(
     return cr;
   }
 
-  SpinBarrier barrier(2);
-  double wall_t0 = now_seconds();
+  dispatch_wait(g_wait, [&](auto strategy) {
+    using W = decltype(strategy);
+    SenseBarrier<W> barrier(2);
+    double wall_t0 = now_seconds();
 
-  std::thread gpu_thread([&]() {
-    cr.gpu = gpu_run(3, gpu_iters, &barrier);
-  });
-  std::thread npu_thread([&]() {
-    cr.npu = htp_run(3, npu_iters, &barrier);
-  });
+    std::thread gpu_thread([&]() {
+      cr.gpu = gpu_run<W>(3, gpu_iters, &barrier);
+    });
+    std::thread npu_thread([&]() {
+      cr.npu = htp_run<W>(3, npu_iters, &barrier);
+    });
 
-  gpu_thread.join();
-  npu_thread.join();
+    gpu_thread.join();
+    npu_thread.join();
 
-  cr.wall_seconds = now_seconds() - wall_t0;
+    cr.wall_seconds = now_seconds() - wall_t0;
+  });
 
   gpu_cleanup();
   htp_cleanup();
 
   // Verify computation results on unified buffer C
   if (cr.npu.success)
-    verify_region(C.ptr, 0, npu_bytes, 3, "NPU partition [0, npu_bytes)");
+    verify_sum_region(C.ptr, 0, npu_bytes, "NPU partition [0, npu_bytes)");
   if (gpu_offset > npu_bytes)
     verify_region(C.ptr, npu_bytes, gpu_offset - npu_bytes, 0, "Padding gap (untouched)");
   if (cr.gpu.success)
-    verify_region(C.ptr, gpu_offset, gpu_bytes, 3, "GPU partition [gpu_offset, total)");
+    verify_sum_region(C.ptr, gpu_offset, gpu_bytes, "GPU partition [gpu_offset, total)");
 
   freeIonBuffer(A); freeIonBuffer(B); freeIonBuffer(C);
   return cr;
@@ -219,6 +258,8 @@ int main(int argc, char* argv[]) {
       npu_cores = atoi(argv[++i]);
     } else if (!strcmp(argv[i], "--verify")) {
       g_verify = true;
+    } else if (!strcmp(argv[i], "--wait") && i+1 < argc) {
+      if (!parse_wait_kind(argv[++i], g_wait)) { print_usage(argv[0]); return 1; }
     } else if (!strcmp(argv[i], "--help")) {
       print_usage(argv[0]); return 0;
     }
@@ -251,6 +292,7 @@ int main(int argc, char* argv[]) {
          npu_bytes/(1024*1024), (1.0-gpu_ratio)*100);
   if (pad_mb > 0)
     printf("分区间距: %zu MB\n", pad_mb);
+  printf("并发启动屏障: %s\n", wait_kind_name(g_wait));
   printf("\n");
 
   BandwidthResult gpu_solo = {}, npu_solo = {};
@@ -276,6 +318,10 @@ int main(int argc, char* argv[]) {
     printf("\n");
   }
 
+  // Between cases: released buffers (up to the pool's cache limit) would
+  // otherwise stay mapped on top of the next case's peak
+  ionPool().trim();
+
   // ── NPU-only baseline ──────────────────────────────────────────────────
   if (mode == Mode::NPU || mode == Mode::ALL) {
     printf("--- NPU 设备信息 ---\n");
@@ -298,6 +344,10 @@ int main(int argc, char* argv[]) {
     printf("\n");
   }
 
+  // Between cases: released buffers (up to the pool's cache limit) would
+  // otherwise stay mapped on top of the next case's peak
+  ionPool().trim();
+
   // ── Concurrent (unified buffer) ────────────────────────────────────────
   if (mode == Mode::CONCURRENT || mode == Mode::ALL) {
     printf("=== GPU + NPU 并发 (统一缓冲区 %zuMB: GPU %zuMB + NPU %zuMB",
@@ -354,5 +404,8 @@ int main(int argc, char* argv[]) {
 
   }
 
+  ionPrintProvisionStats("");
+  ionPool().print_stats("");
+
   return 0;
 }